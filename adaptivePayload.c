@@ -0,0 +1,283 @@
+/* adaptivePayload.c */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "adaptivePayload.h"
+#include "audiocArgs.h"         /* enum payload */
+
+#define DURATIONS 3             /* 1, 2 and 3 times the requested packet duration */
+
+struct level {
+    const struct payloadDesc *desc;
+    int packetDuration;         /* ms */
+    int bandwidth;              /* bit/s */
+};
+
+struct adaptive {
+    int levels;
+    struct level *level;        /* highest bandwidth first */
+    int current;
+    int maxLoss;                /* 1/256 units */
+    int maxPacketDuration;
+    int started;                /* 0 until the first report */
+    u_int32 lastChange;         /* 1/65536 s */
+    u_int32 lastBad;            /* last report with loss over maxLoss / 2, or jitter */
+};
+
+
+/* bit/s on the network of 'desc' in packets of 'packetDuration' ms */
+static int _bandwidth (const struct payloadDesc *desc, int packetDuration)
+{
+    long bytes = payload_frame_payload_bytes (desc, packetDuration) + RTP_HEADER_SIZE + ADPT_OVERHEAD;
+
+    return (int) (bytes * 8 * 1000 / packetDuration);
+}
+
+
+static int _compareLevels (const void *a, const void *b)
+{
+    const struct level *la = a;
+    const struct level *lb = b;
+
+    if (la->bandwidth != lb->bandwidth) {
+        return (la->bandwidth < lb->bandwidth) ? 1 : -1;
+    }
+    /* same bandwidth: keep the order of the table, then shorter packets */
+    if (la->desc != lb->desc) {
+        return (la->desc < lb->desc) ? -1 : 1;
+    }
+    return la->packetDuration - lb->packetDuration;
+}
+
+
+/*=====================================================================*/
+void *adpt_create (int payload, int packetDuration, int maxBandwidth, int maxLoss)
+{
+    struct adaptive *a;
+    const struct payloadDesc *table;
+    int count, i, d, first;
+
+    if (packetDuration <= 0 || maxBandwidth <= 0) {
+        printf ("Invalid adaptive payload parameters: packet duration %d, bandwidth %d\n", packetDuration, maxBandwidth);
+        return NULL;
+    }
+    if ((a = calloc (1, sizeof (struct adaptive))) == NULL) {
+        printf ("Error reserving memory in adaptivePayload\n");
+        return NULL;
+    }
+    table = payload_table (&count);
+    if ((a->level = calloc (count * DURATIONS, sizeof (struct level))) == NULL) {
+        printf ("Error reserving memory in adaptivePayload\n");
+        free (a);
+        return NULL;
+    }
+    for (i = 0; i < count; i++) {
+        for (d = 1; d <= DURATIONS; d++) {
+            struct level *l = &a->level[a->levels++];
+            l->desc = &table[i];
+            l->packetDuration = packetDuration * d;
+            l->bandwidth = _bandwidth (l->desc, l->packetDuration);
+        }
+    }
+    qsort (a->level, a->levels, sizeof (struct level), _compareLevels);
+
+    /* levels over the ceiling are removed; the lowest one is kept anyway */
+    for (first = 0; first < a->levels - 1 && a->level[first].bandwidth > maxBandwidth; first++)
+        ;
+    if (a->level[first].bandwidth > maxBandwidth) {
+        printf ("No payload fits in %d bit/s, using %s (%d bit/s)\n", maxBandwidth, a->level[first].desc->name, a->level[first].bandwidth);
+    }
+    /* a level with the bandwidth of the one before (PCMU and PCMA) would be a
+     * step which saves nothing: only one of them is kept, 'payload' if it is one */
+    for (i = first, d = 0; i < a->levels; i++) {
+        if (d > 0 && a->level[i].bandwidth == a->level[d - 1].bandwidth) {
+            if (a->level[i].desc->payload == payload) {
+                a->level[d - 1] = a->level[i];
+            }
+            continue;
+        }
+        a->level[d++] = a->level[i];
+    }
+    a->levels = d;
+
+    a->maxLoss = maxLoss;
+    a->maxPacketDuration = packetDuration * DURATIONS;
+    a->current = 0;
+    for (i = 0; i < a->levels; i++) {
+        if (a->level[i].desc->payload == payload && a->level[i].packetDuration == packetDuration) {
+            a->current = i;
+        }
+    }
+    return a;
+}
+
+
+int adpt_report (void *adaptive, const struct rtcpReport *report, u_int32 now)
+{
+    struct adaptive *a = adaptive;
+    const struct level *l = &a->level[a->current];
+    /* jitter is in timestamp units of the payload */
+    int jitterMs = (int) ((unsigned long long) report->jitter * 1000 / l->desc->rate);
+    int congested = report->fractionLost > a->maxLoss || jitterMs > l->packetDuration;
+
+    if (!a->started) {
+        /* going down is allowed from the first report; going up, after ADPT_UP_HOLD s of reports */
+        a->started = 1;
+        a->lastBad = now;
+        a->lastChange = now - ADPT_DOWN_HOLD * 65536u;
+    }
+    if (congested || report->fractionLost > a->maxLoss / 2) {
+        a->lastBad = now;
+    }
+    if (congested) {
+        if (a->current < a->levels - 1 && now - a->lastChange >= ADPT_DOWN_HOLD * 65536u) {
+            a->current++;
+            a->lastChange = now;
+            return 1;
+        }
+        return 0;
+    }
+    if (a->current > 0 && now - a->lastBad >= ADPT_UP_HOLD * 65536u && now - a->lastChange >= ADPT_UP_HOLD * 65536u) {
+        a->current--;
+        a->lastChange = now;
+        return 1;
+    }
+    return 0;
+}
+
+
+const struct payloadDesc *adpt_payload (void *adaptive)
+{
+    struct adaptive *a = adaptive;
+
+    return a->level[a->current].desc;
+}
+
+
+int adpt_packet_duration (void *adaptive)
+{
+    struct adaptive *a = adaptive;
+
+    return a->level[a->current].packetDuration;
+}
+
+
+int adpt_bandwidth (void *adaptive)
+{
+    struct adaptive *a = adaptive;
+
+    return a->level[a->current].bandwidth;
+}
+
+
+int adpt_max_packet_duration (void *adaptive)
+{
+    return ((struct adaptive *) adaptive)->maxPacketDuration;
+}
+
+
+void adpt_destroy (void *adaptive)
+{
+    struct adaptive *a = adaptive;
+
+    free (a->level);
+    free (a);
+}
+
+
+/* TEST vectors for adpt functions.
+ * To execute them, use following code  */
+
+/* #include "adaptivePayload.h"
+void _adpt_test_controller(void);
+void main (void)
+{
+    _adpt_test_controller();
+} */
+
+
+enum test_vector_pos {TIME, LOSS, JITTER, CHANGED, BANDWIDTH}; /* Test vector components */
+
+/* Feeds the reports of 'test_vector' to 'a', and checks them; exits on error */
+static void _adptTestRun (void *a, int test_vector[][5], int tests, const char *name)
+{
+    int test;
+
+    if (a == NULL) {
+        exit (1);
+    }
+    for (test = 0; test < tests; test++) {
+        int *line = test_vector[test];
+        struct rtcpReport report = {0};
+        int changed;
+
+        report.fractionLost = line[LOSS];
+        report.jitter = (u_int32) line[JITTER] * adpt_payload (a)->rate / 1000;
+        changed = adpt_report (a, &report, (u_int32) line[TIME] * 65536u);
+        if (changed != line[CHANGED] || adpt_bandwidth (a) != line[BANDWIDTH]) {
+            printf ("_adpt_test_controller error at %s test number %d: returned %d, %s %d ms, %d bit/s\n", name, test,
+                    changed, adpt_payload (a)->name, adpt_packet_duration (a), adpt_bandwidth (a));
+            adpt_destroy (a);
+            exit (1);
+        }
+    }
+}
+
+
+void _adpt_test_controller (void)
+{
+
+    /* 20 ms packets, ceiling 800 kbit/s and 5% loss. The first levels are
+     * L16_1_48K in 20, 40 and 60 ms packets (784, 776, 773.3 kbit/s), and
+     * L16_1 in 20, 40 and 60 ms (721.6, 713.6, 710.9 kbit/s); L16_1 in 20 ms
+     * is the initial one */
+    int test_vector[][5] = {
+        /* Each line contains
+         *  Time of the report, s
+         *  Fraction lost, 1/256 units
+         *  Jitter, ms
+         *  Expected return of adpt_report
+         *  Expected bandwidth of the current level, bit/s */
+        {  0,   0,   0, 0, 721600},   /* up only after ADPT_UP_HOLD s of reports */
+        { 20,   0,   0, 1, 773333},   /* L16_1_48K, 60 ms */
+        { 30,   0,   0, 0, 773333},   /* up only ADPT_UP_HOLD s after the last change */
+        { 40,   0,   0, 1, 776000},
+        { 60,   0,   0, 1, 784000},   /* L16_1_48K, 20 ms: the highest level */
+        { 61,  20,   0, 0, 784000},   /* 7.8% lost, but ADPT_DOWN_HOLD s after the last change */
+        { 66,  20,   0, 1, 776000},
+        { 68,  20,   0, 0, 776000},
+        { 71,  20,   0, 1, 773333},
+        { 76,   0,  70, 1, 721600},   /* jitter over the packet duration (60 ms) */
+        { 80,  10,   0, 0, 721600},   /* 3.9% lost: no change, but delays going up */
+        { 95,   0,   0, 0, 721600},
+        {100,   0,   0, 1, 773333},
+        /* you can add more tests here */
+    };
+    /* 20 ms packets of PCMU, ceiling 100 kbit/s: PCMA has the same bandwidth
+     * in each duration, so the levels are only PCMU in 20, 40 and 60 ms (80,
+     * 72, 69.3 kbit/s), and every step changes the bandwidth */
+    int pcmu_vector[][5] = {
+        {  0,  20,   0, 1,  72000},   /* PCMU 40 ms, not PCMA 20 ms */
+        {  5,  20,   0, 1,  69333},
+        { 10,  20,   0, 0,  69333},   /* the lowest level */
+        { 30,   0,   0, 1,  72000},
+        { 50,   0,   0, 1,  80000},
+    };
+    int tests = sizeof (test_vector) / (5 * sizeof (int));
+    int pcmuTests = sizeof (pcmu_vector) / (5 * sizeof (int));
+    void *a = adpt_create (L16_1, 20, 800000, 13);
+
+    _adptTestRun (a, test_vector, tests, "L16_1");
+    adpt_destroy (a);
+
+    a = adpt_create (PCMU, 20, 100000, 13);
+    _adptTestRun (a, pcmu_vector, pcmuTests, "PCMU");
+    if (adpt_payload (a)->payload != PCMU) {
+        printf ("_adpt_test_controller error: %s instead of PCMU\n", adpt_payload (a)->name);
+        exit (1);
+    }
+    adpt_destroy (a);
+
+    printf ("Tests PASSED (number of tests: %d)\n", tests + pcmuTests);
+}
@@ -0,0 +1,54 @@
+/* adaptivePayload.h */
+
+/* Selection of the payload and packet duration of a sender from the RTCP
+ * reports of its receivers, to stay under a bandwidth and a loss ceiling.
+ * The combinations (levels) of each payload of the table with packet
+ * durations of 1, 2 and 3 times the requested one are ordered by the
+ * bandwidth they use on the network (headers included), and those above the
+ * bandwidth ceiling are discarded. Of the levels with the same bandwidth
+ * (PCMU and PCMA), only one is kept: a step to the other would save nothing. Longer packets are tried first, as they
+ * save headers without losing quality; then payloads with fewer bits.
+ *
+ * With hysteresis:
+ * - one level down when a report shows loss above the ceiling, or jitter
+ *   greater than the packet duration (queues growing), at most once every
+ *   ADPT_DOWN_HOLD s, so that the reports can reflect the previous change
+ * - one level up when no report has shown loss above half the ceiling (or
+ *   excessive jitter) for ADPT_UP_HOLD s
+ * The worst receiver decides: any report can step down.
+ */
+
+#ifndef ADAPTIVE_PAYLOAD_H
+#define ADAPTIVE_PAYLOAD_H
+
+#include "rtp.h"
+#include "rtcp.h"
+#include "payloadTable.h"
+
+#define ADPT_OVERHEAD 28        /* bytes of IPv4 and UDP headers per packet, besides RTP */
+#define ADPT_DOWN_HOLD 5        /* s */
+#define ADPT_UP_HOLD 20         /* s */
+
+/* Returns a pointer which represents the controller, to be used by the rest
+ * of functions. It starts with 'payload' and 'packetDuration' ms if they are
+ * under 'maxBandwidth' bit/s, otherwise with the best level which is.
+ * 'maxLoss' is the loss ceiling, in 1/256 units (as fraction lost in reports).
+ * On error, memory could not be allocated, returns NULL. */
+void *adpt_create (int payload, int packetDuration, int maxBandwidth, int maxLoss);
+
+/* Processes a report block about our stream, received at 'now' (see
+ * rtcp_now_65536). Returns 1 if the level changed, 0 otherwise */
+int adpt_report (void *adaptive, const struct rtcpReport *report, u_int32 now);
+
+/* Current level */
+const struct payloadDesc *adpt_payload (void *adaptive);
+int adpt_packet_duration (void *adaptive);
+int adpt_bandwidth (void *adaptive);     /* bit/s */
+
+/* Longest packet duration of the levels, ms */
+int adpt_max_packet_duration (void *adaptive);
+
+/* Frees memory of the controller */
+void adpt_destroy (void *adaptive);
+
+#endif /* ADAPTIVE_PAYLOAD_H */
@@ -0,0 +1,111 @@
+/* alignedMemory.c */
+
+#define _GNU_SOURCE /* MAP_HUGETLB, MADV_HUGEPAGE */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "alignedMemory.h"
+
+/* Stored in the AMEM_ALIGN bytes before the pointer returned */
+struct amemHeader {
+    void *base;                 /* start of the allocation */
+    size_t length;              /* mmap'ed length, 0 if obtained with posix_memalign */
+    size_t locked;              /* bytes locked with mlock, from the returned pointer */
+};
+
+static int warnedHuge = 0;
+static int warnedLock = 0;
+
+
+/* mmap of 'length' bytes, with huge pages if possible */
+static void *_mapHuge (size_t length)
+{
+    void *base;
+
+    base = mmap (NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (base != MAP_FAILED) {
+        return base;
+    }
+    /* no reserved huge pages: transparent huge pages, if the kernel has them */
+    base = mmap (NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        return NULL;
+    }
+    if (madvise (base, length, MADV_HUGEPAGE) < 0 && !warnedHuge) {
+        printf ("Huge pages not available (%s), using normal pages\n", strerror (errno));
+        warnedHuge = 1;
+    }
+    return base;
+}
+
+
+/*=====================================================================*/
+void *amem_alloc (size_t size, int flags)
+{
+    struct amemHeader *header;
+    unsigned char *base;
+    unsigned char *pointer;
+    size_t length = 0;
+
+    if (flags & AMEM_LOCK) {
+        flags |= AMEM_PREFAULT;
+    }
+    if ((flags & AMEM_HUGE) && size >= AMEM_HUGE_MIN) {
+        length = (AMEM_ALIGN + size + AMEM_HUGE_MIN - 1) & ~(size_t) (AMEM_HUGE_MIN - 1);
+        if ((base = _mapHuge (length)) == NULL) {
+            printf ("Error reserving memory in alignedMemory: %s\n", strerror (errno));
+            return NULL;
+        }
+        /* mmap'ed memory is already 0 */
+    } else {
+        /* not touched: without AMEM_PREFAULT, pages are mapped when they are first used */
+        if (posix_memalign ((void **) &base, AMEM_ALIGN, AMEM_ALIGN + size) != 0) {
+            printf ("Error reserving memory in alignedMemory\n");
+            return NULL;
+        }
+    }
+
+    pointer = base + AMEM_ALIGN;
+    header = (struct amemHeader *) (pointer - AMEM_ALIGN);
+    header->base = base;
+    header->length = length;
+    header->locked = 0;
+
+    if (flags & AMEM_PREFAULT) {
+        /* writing makes the kernel map every page now */
+        memset (pointer, 0, size);
+    }
+    if (flags & AMEM_LOCK) {
+        if (mlock (pointer, size) == 0) {
+            header->locked = size;
+        } else if (!warnedLock) {
+            printf ("Memory could not be locked (%s), continuing without locking\n", strerror (errno));
+            warnedLock = 1;
+        }
+    }
+    return pointer;
+}
+
+
+void amem_free (void *pointer)
+{
+    struct amemHeader *header;
+
+    if (pointer == NULL) {
+        return;
+    }
+    header = (struct amemHeader *) ((unsigned char *) pointer - AMEM_ALIGN);
+    if (header->locked > 0) {
+        munlock (pointer, header->locked);
+    }
+    if (header->length > 0) {
+        munmap (header->base, header->length);
+    } else {
+        free (header->base);
+    }
+}
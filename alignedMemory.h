@@ -0,0 +1,38 @@
+/* alignedMemory.h */
+
+/* Allocation of buffers for audio data: always aligned to AMEM_ALIGN bytes
+ * (a cache line, and the widest SIMD load used), and optionally backed by
+ * huge pages, prefaulted and locked in memory at creation time, so that the
+ * first seconds of a call do not take page faults.
+ */
+
+#ifndef ALIGNED_MEMORY_H
+#define ALIGNED_MEMORY_H
+
+#include <stddef.h>
+
+#define AMEM_ALIGN 64
+
+/* rounds 'size' up to a multiple of AMEM_ALIGN */
+#define AMEM_ROUND(size) (((size) + AMEM_ALIGN - 1) & ~(size_t) (AMEM_ALIGN - 1))
+
+/* Flags for amem_alloc, can be combined with | */
+enum amem_flags {
+    AMEM_DEFAULT = 0,
+    AMEM_PREFAULT = 1,          /* touch every page now */
+    AMEM_LOCK = 2,              /* mlock: pages are never swapped out (implies AMEM_PREFAULT) */
+    AMEM_HUGE = 4               /* huge pages, for buffers of AMEM_HUGE_MIN bytes or more */
+};
+
+#define AMEM_HUGE_MIN (2 * 1024 * 1024)
+
+/* Returns 'size' bytes aligned to AMEM_ALIGN, not initialized (as malloc),
+ * or NULL on error.
+ * If huge pages or locking are not available (e.g. RLIMIT_MEMLOCK), the
+ * memory is returned without them and a message is printed once. */
+void *amem_alloc (size_t size, int flags);
+
+/* Frees memory returned by amem_alloc. NULL is ignored */
+void amem_free (void *pointer);
+
+#endif /* ALIGNED_MEMORY_H */
@@ -0,0 +1,290 @@
+/* asyncLog.c */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+
+#include "asyncLog.h"
+
+#define BATCH_BYTES 8192        /* output written with each write call, at most */
+#define LINE_BYTES 512          /* longest record formatted */
+
+struct record {
+    unsigned long long seq;     /* position + 1 when it can be read, position + ALOG_RING when it can be written */
+    int level;
+    const char *format;
+    long long arg[ALOG_ARGS];
+};
+
+/* one logger per process, as stdout */
+static struct record ring[ALOG_RING];
+static unsigned long long tail;         /* next position reserved by alog */
+static unsigned long long head;         /* next position read by the background thread */
+static unsigned long long dropped;
+static unsigned long long reported;     /* drops already written */
+static int logLevel = ALOG_INFO;
+static int running;
+static int stopRequested;
+static int outFd;
+static pthread_t thread;
+
+
+/*=====================================================================*/
+static void _write (const char *data, int length)
+{
+    int result;
+
+    while (length > 0) {
+        if ((result = write (outFd, data, length)) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;     /* nowhere to report it */
+        }
+        data += result;
+        length -= result;
+    }
+}
+
+
+/* Formats and writes all the records published */
+static void _drain (void)
+{
+    char out[BATCH_BYTES];
+    int length = 0;
+    unsigned long long lost;
+
+    while (1) {
+        struct record *r = &ring[head & (ALOG_RING - 1)];
+        int n;
+        if (__atomic_load_n (&r->seq, __ATOMIC_ACQUIRE) != head + 1) {
+            break;
+        }
+        n = snprintf (out + length, LINE_BYTES, r->format, r->arg[0], r->arg[1], r->arg[2]);
+        length += (n < LINE_BYTES) ? n : LINE_BYTES - 1;   /* longer records are truncated */
+        if (length > BATCH_BYTES - LINE_BYTES) {
+            _write (out, length);
+            length = 0;
+        }
+        __atomic_store_n (&r->seq, head + ALOG_RING, __ATOMIC_RELEASE);
+        head++;
+    }
+    lost = __atomic_load_n (&dropped, __ATOMIC_RELAXED);
+    if (lost > reported) {
+        length += snprintf (out + length, LINE_BYTES, "\n[%llu log records dropped]\n", lost - reported);
+        reported = lost;
+    }
+    if (length > 0) {
+        _write (out, length);
+    }
+}
+
+
+static void *_writer (void *arg __attribute__ ((unused)))
+{
+    struct timespec pause = { 0, ALOG_POLL_MS * 1000000L };
+    int last;
+
+    do {
+        last = __atomic_load_n (&stopRequested, __ATOMIC_ACQUIRE);
+        _drain ();
+        if (!last) {
+            nanosleep (&pause, NULL);
+        }
+    } while (!last);
+    return NULL;
+}
+
+
+/*=====================================================================*/
+int alog_start (enum alog_level level, int fd)
+{
+    sigset_t all, previous;
+    int i, result;
+
+    if (running) {
+        printf ("asyncLog already started\n");
+        return -1;
+    }
+    logLevel = level;
+    outFd = fd;
+    for (i = 0; i < ALOG_RING; i++) {
+        ring[i].seq = i;
+    }
+    tail = head = 0;
+    dropped = reported = 0;
+    stopRequested = 0;
+    /* what was printed before must come first */
+    fflush (stdout);
+    __atomic_store_n (&running, 1, __ATOMIC_RELEASE);
+    /* the writer inherits a mask with all the signals blocked: they are taken by the threads of the program */
+    sigfillset (&all);
+    pthread_sigmask (SIG_SETMASK, &all, &previous);
+    result = pthread_create (&thread, NULL, _writer, NULL);
+    pthread_sigmask (SIG_SETMASK, &previous, NULL);
+    if (result != 0) {
+        printf ("Could not create the logging thread\n");
+        running = 0;
+        return -1;
+    }
+    return 0;
+}
+
+
+void alog (enum alog_level level, const char *format, long long a, long long b, long long c)
+{
+    unsigned long long pos;
+    struct record *r;
+
+    if ((int) level > logLevel) {
+        return;
+    }
+    if (!__atomic_load_n (&running, __ATOMIC_ACQUIRE)) {
+        printf (format, a, b, c);
+        return;
+    }
+    pos = __atomic_load_n (&tail, __ATOMIC_RELAXED);
+    while (1) {
+        long long diff;
+        r = &ring[pos & (ALOG_RING - 1)];
+        diff = (long long) (__atomic_load_n (&r->seq, __ATOMIC_ACQUIRE) - pos);
+        if (diff == 0) {
+            /* free: reserve it, unless another thread did first (pos is updated then) */
+            if (__atomic_compare_exchange_n (&tail, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            /* not read yet: the ring is full */
+            __atomic_add_fetch (&dropped, 1, __ATOMIC_RELAXED);
+            return;
+        } else {
+            pos = __atomic_load_n (&tail, __ATOMIC_RELAXED);
+        }
+    }
+    r->level = level;
+    r->format = format;
+    r->arg[0] = a;
+    r->arg[1] = b;
+    r->arg[2] = c;
+    __atomic_store_n (&r->seq, pos + 1, __ATOMIC_RELEASE);
+}
+
+
+unsigned long long alog_dropped (void)
+{
+    return __atomic_load_n (&dropped, __ATOMIC_RELAXED);
+}
+
+
+void alog_stop (void)
+{
+    if (!running) {
+        return;
+    }
+    /* new records are printed; the ones stored are written by the last drain */
+    __atomic_store_n (&running, 0, __ATOMIC_RELEASE);
+    __atomic_store_n (&stopRequested, 1, __ATOMIC_RELEASE);
+    pthread_join (thread, NULL);
+}
+
+
+/* TEST for asyncLog functions.
+ * To execute it, use following code  */
+
+/* #include "asyncLog.h"
+void _alog_test_ring(void);
+void main (void)
+{
+    _alog_test_ring();
+} */
+
+
+#define TEST_THREADS 4
+#define TEST_RECORDS 1000       /* per thread, less than ALOG_RING in total */
+
+static void *_testProducer (void *arg)
+{
+    long long id = (long long) (size_t) arg;
+    int i;
+
+    for (i = 0; i < TEST_RECORDS; i++) {
+        alog (ALOG_INFO, "%lld %lld\n", id, i, 0);
+    }
+    return NULL;
+}
+
+
+static int _testOutput (int fd, int expectedLines, const char *name)
+{
+    static char text[1 << 20];
+    int length, lines = 0, i;
+
+    length = pread (fd, text, sizeof (text) - 1, 0);
+    for (i = 0; i < length; i++) {
+        lines += (text[i] == '\n');
+    }
+    if (lines != expectedLines) {
+        printf ("_alog_test_ring: %s wrote %d lines, expected %d\n", name, lines, expectedLines);
+        return 1;
+    }
+    return 0;
+}
+
+
+void _alog_test_ring (void)
+{
+    char path[] = "/tmp/asyncLogXXXXXX";
+    pthread_t producers[TEST_THREADS];
+    int fd, i, errors = 0;
+    unsigned long long lost;
+
+    /* 1: records of several threads, and only the levels requested */
+    if ((fd = mkstemp (path)) < 0) {
+        printf ("_alog_test_ring: cannot create %s\n", path);
+        exit (1);
+    }
+    unlink (path);
+    alog_start (ALOG_INFO, fd);
+    for (i = 0; i < TEST_THREADS; i++) {
+        pthread_create (&producers[i], NULL, _testProducer, (void *) (size_t) i);
+    }
+    alog (ALOG_DEBUG, "not logged\n", 0, 0, 0);
+    for (i = 0; i < TEST_THREADS; i++) {
+        pthread_join (producers[i], NULL);
+    }
+    alog_stop ();
+    errors += _testOutput (fd, TEST_THREADS * TEST_RECORDS, "4 threads");
+    if (alog_dropped () != 0) {
+        printf ("_alog_test_ring: %llu records dropped with room in the ring\n", alog_dropped ());
+        errors++;
+    }
+    close (fd);
+
+    /* 2: a burst of 3 rings is not waited for; what is dropped is counted and reported */
+    strcpy (path, "/tmp/asyncLogXXXXXX");
+    fd = mkstemp (path);
+    unlink (path);
+    alog_start (ALOG_DEBUG, fd);
+    for (i = 0; i < 3 * ALOG_RING; i++) {
+        alog (ALOG_DEBUG, "%lld\n", i, 0, 0);
+    }
+    alog_stop ();
+    lost = alog_dropped ();
+    if (lost == 0) {
+        printf ("_alog_test_ring: a burst of %d records did not fill the ring\n", 3 * ALOG_RING);
+        errors++;
+    }
+    /* the report of the drops is 2 lines */
+    errors += _testOutput (fd, 3 * ALOG_RING - (int) lost + 2, "burst");
+    close (fd);
+
+    if (errors > 0) {
+        exit (1);
+    }
+    printf ("Tests PASSED (number of tests: 2)\n");
+}
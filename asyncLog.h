@@ -0,0 +1,51 @@
+/* asyncLog.h */
+
+/* Logging for the loops which handle each packet or fragment, where a
+ * printf is a write system call (or several) per packet and can block on a
+ * slow terminal. alog only stores a record of fixed size (level, format and
+ * up to ALOG_ARGS integer arguments) in a lock-free ring of ALOG_RING
+ * records; a background thread formats the records and writes them in
+ * batches, every ALOG_POLL_MS. When the ring is full the record is dropped
+ * and counted, never waited for: logging cannot delay the audio. The
+ * records dropped are reported in the output.
+ * The format is not copied: it must be a string constant, with a %lld for
+ * each argument used (as many as ALOG_ARGS; the rest are ignored).
+ * Records of a level over the one given to alog_start are discarded by alog
+ * at the cost of a comparison, so the calls can stay in the code.
+ * Before alog_start (or after alog_stop), alog prints with printf, as the
+ * rest of the code.
+ * The ring accepts records from any number of threads; the order of the
+ * output is the order in which the records were reserved.
+ */
+
+#ifndef ASYNC_LOG_H
+#define ASYNC_LOG_H
+
+#define ALOG_RING 4096          /* records, power of 2 */
+#define ALOG_ARGS 3
+#define ALOG_POLL_MS 20         /* how often the background thread writes */
+
+enum alog_level {
+    ALOG_ERROR,
+    ALOG_WARNING,
+    ALOG_INFO,                  /* default */
+    ALOG_DEBUG                  /* each packet or fragment, with -c */
+};
+
+/* Starts the background thread, which writes in the file descriptor 'fd'
+ * the records of 'level' and lower. The thread blocks all the signals, so
+ * they are delivered to the threads of the program. Returns 0, or -1 on
+ * error (a message is printed, and alog keeps printing synchronously) */
+int alog_start (enum alog_level level, int fd);
+
+/* Stores a record, if 'level' is logged */
+void alog (enum alog_level level, const char *format, long long a, long long b, long long c);
+
+/* Records dropped because the ring was full */
+unsigned long long alog_dropped (void);
+
+/* Writes the records pending and stops the background thread. It joins the
+ * thread: do not call it from a signal handler */
+void alog_stop (void);
+
+#endif /* ASYNC_LOG_H */
@@ -0,0 +1,252 @@
+/* audioFile.c */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "audioFile.h"
+
+#define WAV_FORMAT_PCM 1
+#define WAV_FORMAT_EXTENSIBLE 0xFFFE    /* the subformat is not checked: PCM is assumed */
+
+struct audioFile {
+    struct audioFileFormat format;
+    const unsigned char *data;
+    long bytes;
+    void *map;
+    size_t mapLength;
+};
+
+
+/*=====================================================================*/
+static unsigned int _le16 (const unsigned char *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+
+static unsigned long _le32 (const unsigned char *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned long) p[3] << 24);
+}
+
+
+/* Finds the fmt and data chunks of the RIFF file in 'map'. Returns 0, 1 if it
+ * is not a WAV file, or -1 if it is a WAV file which cannot be streamed */
+static int _parseWav (struct audioFile *f, const char *name)
+{
+    const unsigned char *p = f->map;
+    size_t offset = 12;
+    int haveFormat = 0;
+
+    if (f->mapLength < 12 || memcmp (p, "RIFF", 4) != 0 || memcmp (p + 8, "WAVE", 4) != 0) {
+        return 1;
+    }
+    while (offset + 8 <= f->mapLength) {
+        const unsigned char *chunk = p + offset;
+        unsigned long size = _le32 (chunk + 4);
+        size_t available = f->mapLength - offset - 8;
+
+        if (memcmp (chunk, "fmt ", 4) == 0) {
+            unsigned int type, bits;
+            if (size < 16 || available < 16) {
+                break;
+            }
+            type = _le16 (chunk + 8);
+            bits = _le16 (chunk + 22);
+            if ((type != WAV_FORMAT_PCM && type != WAV_FORMAT_EXTENSIBLE) || (bits != 8 && bits != 16)) {
+                printf ("%s: only PCM WAV files of 8 or 16 bits can be streamed (format %u, %u bits)\n", name, type, bits);
+                return -1;
+            }
+            f->format.channels = _le16 (chunk + 10);
+            f->format.rate = _le32 (chunk + 12);
+            f->format.bytesPerSample = bits / 8;
+            haveFormat = 1;
+        } else if (memcmp (chunk, "data", 4) == 0) {
+            if (!haveFormat) {
+                break;
+            }
+            f->data = chunk + 8;
+            /* the size of a file being written, or of a streamed one, may be wrong */
+            f->bytes = (size > available) ? (long) available : (long) size;
+            return 0;
+        }
+        /* chunks are padded to an even size */
+        offset += 8 + size + (size & 1);
+    }
+    printf ("%s: WAV file without fmt and data chunks\n", name);
+    return -1;
+}
+
+
+/*=====================================================================*/
+void *afile_open (const char *name, const struct audioFileFormat *raw)
+{
+    struct audioFile *f;
+    struct stat info;
+    int file;
+    int result;
+
+    if ((f = calloc (1, sizeof (struct audioFile))) == NULL) {
+        printf ("Error reserving memory in audioFile\n");
+        return NULL;
+    }
+    if ((file = open (name, O_RDONLY)) < 0 || fstat (file, &info) < 0) {
+        printf ("File %s could not be opened, error %s\n", name, strerror (errno));
+        if (file >= 0) close (file);
+        free (f);
+        return NULL;
+    }
+    if (info.st_size == 0) {
+        printf ("File %s is empty\n", name);
+        close (file);
+        free (f);
+        return NULL;
+    }
+    f->mapLength = info.st_size;
+    f->map = mmap (NULL, f->mapLength, PROT_READ, MAP_PRIVATE, file, 0);
+    close (file);   /* the mapping keeps the file */
+    if (f->map == MAP_FAILED) {
+        printf ("File %s could not be mapped, error %s\n", name, strerror (errno));
+        free (f);
+        return NULL;
+    }
+    /* read ahead, and do not keep pages already streamed in front of others */
+    madvise (f->map, f->mapLength, MADV_SEQUENTIAL);
+
+    if ((result = _parseWav (f, name)) < 0) {
+        afile_close (f);
+        return NULL;
+    }
+    if (result == 1) {
+        f->format = *raw;
+        f->data = f->map;
+        f->bytes = f->mapLength;
+    }
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    if (f->format.bytesPerSample == 2) {
+        printf ("%s: 16-bit files are little endian, they cannot be streamed in this host\n", name);
+        afile_close (f);
+        return NULL;
+    }
+#endif
+    if (f->format.channels < 1 || f->format.rate < 1) {
+        printf ("%s: %d channels at %d Hz cannot be streamed\n", name, f->format.channels, f->format.rate);
+        afile_close (f);
+        return NULL;
+    }
+    f->bytes -= f->bytes % (f->format.channels * f->format.bytesPerSample);
+    return f;
+}
+
+
+const struct audioFileFormat *afile_format (const void *audioFile)
+{
+    const struct audioFile *f = audioFile;
+    return &f->format;
+}
+
+
+const unsigned char *afile_data (const void *audioFile, long *bytes)
+{
+    const struct audioFile *f = audioFile;
+    *bytes = f->bytes;
+    return f->data;
+}
+
+
+void afile_close (void *audioFile)
+{
+    struct audioFile *f = audioFile;
+
+    munmap (f->map, f->mapLength);
+    free (f);
+}
+
+
+/* TEST for audioFile functions.
+ * To execute it, use following code  */
+
+/* #include "audioFile.h"
+void _afile_test_formats(void);
+void main (void)
+{
+    _afile_test_formats();
+} */
+
+
+static void _writeFile (const char *name, const unsigned char *content, int length)
+{
+    FILE *file = fopen (name, "wb");
+    if (file == NULL || fwrite (content, 1, length, file) != (size_t) length) {
+        printf ("_afile_test_formats: could not write %s\n", name);
+        exit (1);
+    }
+    fclose (file);
+}
+
+
+void _afile_test_formats (void)
+{
+    const char *name = "/tmp/_afile_test.wav";
+    /* 44100 Hz stereo 16 bits, with a LIST chunk of odd size before data, and 5 bytes
+     * of samples (one frame and one byte) */
+    const unsigned char wav[] = "RIFF\x00\x00\x00\x00WAVE"
+            "fmt \x10\x00\x00\x00\x01\x00\x02\x00\x44\xac\x00\x00\x10\xb1\x02\x00\x04\x00\x10\x00"
+            "LIST\x03\x00\x00\x00" "abc\x00"
+            "data\x05\x00\x00\x00\x01\x02\x03\x04\x05";
+    const struct audioFileFormat raw = { 8000, 1, 1 };
+    const struct audioFileFormat *format;
+    const unsigned char *data;
+    long bytes;
+    void *f;
+    int errors = 0;
+
+    /* 1: WAV header */
+    _writeFile (name, wav, sizeof (wav) - 1);
+    if ((f = afile_open (name, &raw)) == NULL) {
+        exit (1);
+    }
+    format = afile_format (f);
+    data = afile_data (f, &bytes);
+    if (format->rate != 44100 || format->channels != 2 || format->bytesPerSample != 2) {
+        printf ("_afile_test_formats: WAV format %d Hz %d channels %d bytes\n", format->rate, format->channels, format->bytesPerSample);
+        errors++;
+    }
+    if (bytes != 4 || data[0] != 1 || data[3] != 4) {
+        printf ("_afile_test_formats: WAV data of %ld bytes, starting with %d\n", bytes, data[0]);
+        errors++;
+    }
+    afile_close (f);
+
+    /* 2: raw file, in the format given */
+    _writeFile (name, (const unsigned char *) "\x80\x81\x82", 3);
+    if ((f = afile_open (name, &raw)) == NULL) {
+        exit (1);
+    }
+    data = afile_data (f, &bytes);
+    if (afile_format (f)->rate != 8000 || bytes != 3 || data[2] != 0x82) {
+        printf ("_afile_test_formats: raw file of %ld bytes\n", bytes);
+        errors++;
+    }
+    afile_close (f);
+
+    /* 3: WAV files which cannot be streamed are rejected */
+    _writeFile (name, (const unsigned char *) "RIFF\x00\x00\x00\x00WAVEfmt \x10\x00\x00\x00\x03\x00\x01\x00\x40\x1f\x00\x00\x00\x7d\x00\x00\x04\x00\x20\x00", 36);
+    if ((f = afile_open (name, &raw)) != NULL) {
+        printf ("_afile_test_formats: float WAV file accepted\n");
+        afile_close (f);
+        errors++;
+    }
+
+    unlink (name);
+    if (errors > 0) {
+        exit (1);
+    }
+    printf ("Tests PASSED (number of tests: 3)\n");
+}
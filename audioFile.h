@@ -0,0 +1,43 @@
+/* audioFile.h */
+
+/* Audio files to be streamed, memory-mapped: the samples are read by the
+ * packetize functions straight from the mapping, without copies or read
+ * buffers, and the pages are shared by every process streaming the same
+ * file (only the page cache holds the file, once).
+ * A file can be
+ * - WAV (RIFF), PCM with 8 bits (unsigned) or 16 bits (signed little
+ *   endian) per sample; its header gives rate, channels and sample size.
+ * - raw, without any header, in the format given to afile_open.
+ * Only whole frames (a sample for each channel) are given.
+ * Restrictions
+ * - 16-bit files are given as they are: the host must be little endian, as
+ *   the S16_LE format used with the soundcard.
+ * - The file must not be truncated while it is mapped (the process would
+ *   get SIGBUS).
+ */
+
+#ifndef AUDIO_FILE_H
+#define AUDIO_FILE_H
+
+/* Format of the samples of a file, as in struct payloadDesc */
+struct audioFileFormat {
+    int rate;                   /* Hz */
+    int channels;
+    int bytesPerSample;         /* per channel: 1 (U8) or 2 (S16_LE) */
+};
+
+/* Maps the file 'name'. If it has no WAV header, its samples are in the
+ * format 'raw'. Returns a pointer which represents the file, to be used by
+ * the rest of functions, or NULL on error (a message is printed). */
+void *afile_open (const char *name, const struct audioFileFormat *raw);
+
+/* Format of the samples, from the WAV header or the 'raw' of afile_open */
+const struct audioFileFormat *afile_format (const void *audioFile);
+
+/* First sample of the file; 'bytes' returns the length of the samples */
+const unsigned char *afile_data (const void *audioFile, long *bytes);
+
+/* Unmaps the file and frees memory */
+void afile_close (void *audioFile);
+
+#endif /* AUDIO_FILE_H */
@@ -18,7 +18,29 @@ RATE sampling rate in Hz
 
 default values:  8 bits, vol 90, sampling rate 8000, 1 channel, 4096 bytes per block 
 
-gcc -Wall -Wextra -o audioc audiocArgs.c circularBuffer.c configureSndcard.c easyUDPSockets_1.c audioc.c
+gcc -Wall -Wextra -o audioc audiocArgs.c circularBuffer.c configureSndcard.c easyUDPSockets.c payloadTable.c sampleConvert.c reframer.c alignedMemory.c payloadSwitch.c adaptivePayload.c rtcp.c rtpSource.c jitterBuffer.c gainControl.c srtp.c pacer.c audioFile.c fanOut.c sendPressure.c stageProfiler.c asyncLog.c audioc.c -lpthread -lm
+
+The soundcard is configured once (see PSW_DEVICE_* in payloadSwitch.h); the payload
+given with -y is the initial one. Each SIGUSR1 (kill -USR1 PID) changes the payload
+sent to the next one of the table, in the middle of the stream.
+With -aBANDWIDTH, the RTCP reports sent by the receivers to PORT + 1 are read, and
+the payload and packet duration are adapted to them (see adaptivePayload.h).
+The volume -v is a digital gain applied to the audio captured (VOL / 100), not
+the mixer of the soundcard; -g adds automatic gain control (see gainControl.h).
+With -FFILE, the WAV or raw file is streamed instead of the soundcard (which is
+not opened), paced as it would be played, and -R streams it again and again.
+With -P[RATE], packets are made longer (2 or 3 times -l) when the host is
+saturated: packet rate over RATE, CPU or socket backlog (see sendPressure.h).
+With -UFILE, packets are sent to the unicast destinations listed in FILE (see
+fanOut.h) instead of the group; MULTICAST_ADDR is still used for the RTCP of -a
+(which is received from any source, whatever -S or -X say).
+With -KKEY, packets are sent as SRTP (see srtp.h); add -maes -msha -msse4.1 to
+the compilation to use the instructions of the CPU for AES and SHA-1.
+With -C, the cost per packet of capture, encoding and sending is measured with
+the performance counters (see stageProfiler.h), and printed on SIGUSR2
+(kill -USR2 PID) and at the end.
+Messages of the sending loop are written by a background thread (see asyncLog.h);
+with -c, a dot is shown for each fragment captured.
 */
 
 #include <stdbool.h>
@@ -31,11 +53,26 @@ gcc -Wall -Wextra -o audioc audiocArgs.c circularBuffer.c configureSndcard.c eas
 #include <errno.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
 
 #include "audiocArgs.h"
 #include "circularBuffer.h"
 #include "configureSndcard.h"
-#include "easyUDPSockets_1.h"
+#include "easyUDPSockets.h"
+#include "payloadTable.h"
+#include "reframer.h"
+#include "payloadSwitch.h"
+#include "adaptivePayload.h"
+#include "rtcp.h"
+#include "gainControl.h"
+#include "srtp.h"
+#include "pacer.h"
+#include "audioFile.h"
+#include "fanOut.h"
+#include "sendPressure.h"
+#include "stageProfiler.h"
+#include "asyncLog.h"
 
 void record (int descSnd, const char *fileName, int fragmentSize);
 void play (int descSnd, const char *fileName, int fragmentSize);
@@ -47,46 +84,303 @@ const float MILI_PER_SEC = 1000.0;
 /* only declare here variables which are used inside the signal handler */
 char *buf = NULL;
 char *fileName = NULL;     /* Memory is allocated by audioSimpleArgs, remember to free it */
-
-/* activated by Ctrl-C */
+unsigned char *packet = NULL;
+void *reframer = NULL;
+void *payloadSwitch = NULL;
+void *adaptive = NULL;
+void *gain = NULL;
+void *srtp = NULL;
+struct easySocket *rtpSocket = NULL;
+struct easySocket *rtcpSocket = NULL;
+void *audioFile = NULL;
+void *pacer = NULL;
+void *fan = NULL;          /* unicast destinations, with -U */
+void *pressure = NULL;
+void *profiler = NULL;     /* with -C */
+volatile sig_atomic_t finishRequested = 0;
+volatile sig_atomic_t switchRequested = 0;
+volatile sig_atomic_t profileRequested = 0;
+
+/* activated by Ctrl-C: the loops call finish, out of the signal handler */
 void signalHandler (int sigNum __attribute__ ((unused)))  /* __attribute__ ((unused))   -> this indicates gcc not to show an 'unused parameter' warning about sigNum: is not used, but the function must be declared with this parameter */
 {
+    finishRequested = 1;
+}
+
+/* Frees everything and exits, after Ctrl-C */
+void finish(void)
+{
+    alog_stop();
     printf ("\naudioSimple was requested to finish\n");
     if (buf) free(buf);
     if (fileName) free(fileName);
+    if (packet) free(packet);
+    if (reframer) refr_destroy(reframer);
+    if (payloadSwitch) psw_destroy(payloadSwitch);
+    if (adaptive) adpt_destroy(adaptive);
+    if (gain) gain_destroy(gain);
+    if (srtp) srtp_destroy(srtp);
+    if (rtpSocket) easy_close(rtpSocket);
+    if (rtcpSocket) easy_close(rtcpSocket);
+    if (audioFile) afile_close(audioFile);
+    if (pacer) { pace_print(pacer, "Stream"); pace_destroy(pacer); }
+    if (fan) { fan_print_stats(fan); fan_destroy(fan); }
+    if (pressure) press_destroy(pressure);
+    if (profiler) { prof_print(profiler); prof_destroy(profiler); }
     exit (0);
 }
 
-void send(int descSnd, int fragmentSize){
+/* activated by SIGUSR1: the payload is changed by sendAudio, before the next packet */
+void switchHandler (int sigNum __attribute__ ((unused)))
+{
+    switchRequested = 1;
+}
 
-    int bytesRead;
-    printf("entro");
+/* activated by SIGUSR2: the stage costs are printed by the sending loop */
+void profileHandler (int sigNum __attribute__ ((unused)))
+{
+    profileRequested = 1;
+}
+
+/* With -C, creates the profiler of the stages, for the calling thread */
+void openProfiler(const struct audiocOptions *options){
+
+    if (options->profile && (profiler = prof_create()) == NULL)
+        exit(1);
+}
+
+/* Prints the stage costs if SIGUSR2 was received */
+void printProfile(void){
 
-    if(easy_init_1() < 0){
-        printf("easy_init_1");
+    if (profileRequested && profiler != NULL) {
+        profileRequested = 0;
+        printf("\n");
+        prof_print(profiler);
+    }
+}
+
+/* Opens where the RTP packets are sent: the socket of options->group:port,
+ * or the unicast destinations of options->unicast. Packets are of
+ * 'maxPacketBytes' at most */
+void openOutput(int port, int maxPacketBytes, const struct audiocOptions *options){
+
+    if (options->unicast != NULL) {
+        if ((fan = fan_create(options->unicast, port, maxPacketBytes, &options->socket)) == NULL) {
+            exit(1);
+        }
+        printf("Sending to %d unicast destinations\n", fan_destinations(fan));
+        return;
+    }
+    if ((rtpSocket = easy_open(options->group, port, EASY_SEND, &options->socket)) == NULL) {
         exit(1);
     }
+    packet = malloc (maxPacketBytes);
+    if (packet == NULL) {
+        printf("Could not reserve memory for RTP packets.\n");
+        exit (1);
+    }
+}
 
-    buf = malloc (fragmentSize); 
-    if (buf == NULL) { 
+/* Buffer in which the next packet is built, for sendPacket */
+unsigned char *nextPacket(void){
+
+    return (fan != NULL) ? fan_packet(fan) : packet;
+}
+
+/* Sends the packet built in the buffer of nextPacket. With the unicast
+ * destinations, it is queued until flushOutput */
+void sendPacket(unsigned char *p, int length){
+
+    if (fan != NULL) {
+        if (fan_send(fan, p, length) < 0)
+            exit(1);
+    }
+    else if (easy_send(rtpSocket, p, length) < 0) {
+        exit(1);
+    }
+}
+
+void flushOutput(void){
+
+    if (fan != NULL && fan_flush(fan) < 0)
+        exit(1);
+}
+
+/* Socket of the packets sent, and datagrams sent for each packet, for the send pressure */
+int outputFd(void){
+
+    return (fan != NULL) ? fan_fd(fan) : easy_fd(rtpSocket);
+}
+
+int outputCopies(void){
+
+    return (fan != NULL) ? fan_destinations(fan) : 1;
+}
+
+/* Packet duration chosen by the controllers: the longest of the RTCP one
+ * (adaptive) and the send pressure one, or 'requested' if there are none */
+int chosenDuration(int requested){
+
+    int duration = (adaptive != NULL) ? adpt_packet_duration(adaptive) : requested;
+
+    if (pressure != NULL && press_packet_duration(pressure) > duration)
+        duration = press_packet_duration(pressure);
+    return duration;
+}
+
+/* Reads the RTCP packets pending in 'sock' and passes the reports about
+ * 'ssrc' to the adaptive controller. Returns 1 if the level changed */
+int readReports(int sock, unsigned int ssrc){
+
+    unsigned char rtcpPacket[RTCP_MAX_PACKET];
+    struct rtcpReceived info;
+    int length;
+    int i;
+    int changed = 0;
+
+    while ((length = recv(sock, rtcpPacket, sizeof(rtcpPacket), MSG_DONTWAIT)) > 0) {
+        if (rtcp_parse(rtcpPacket, length, ssrc, NULL, &info) < 0)
+            continue;
+        for (i = 0; i < info.reports; i++) {
+            changed |= adpt_report(adaptive, &info.report[i], rtcp_now_65536());
+        }
+    }
+    return changed;
+}
+
+/* Reads fragments of 'fragmentSize' bytes from the soundcard and sends them in
+ * RTP packets of exactly packetDuration ms of audio, built by the payload
+ * switch, starting with 'payload'. The soundcard may have configured any fragment size.
+ * With options->maxBandwidth, payload and packet duration follow the RTCP
+ * reports received on port + 1; with options->pressure, packet duration is
+ * also made longer when the host is saturated. The audio captured is multiplied
+ * by vol / 100 (and options->agc) before it is encoded. With options->srtp,
+ * packets are protected with SRTP. Packets are sent to options->group:port,
+ * with the socket options of options->socket, or to the unicast destinations
+ * of options->unicast (all the packets of each fragment in one batch) */
+void sendAudio(int descSnd, int fragmentSize, int packetDuration, int payload, unsigned int ssrc,
+        int port, int vol, const struct audiocOptions *options){
+
+    int bytesRead;
+    int requestedDuration = packetDuration;
+    int maxPacketDuration = packetDuration;
+    int samples;
+    int sent;
+    int packetLength;
+    unsigned char *frame;
+    u_int16 seq = random();     /* random initial values, RFC 3550 5.1 */
+    u_int32 ts = random();
+
+    if (options->maxBandwidth > 0) {
+        /* the reports come from the receivers: no source filter, only the group */
+        struct easySocketConfig rtcpConfig = options->socket;
+        rtcpConfig.filter = EASY_ANY_SOURCE;
+        rtcpConfig.groups = 0;
+        adaptive = adpt_create (payload, packetDuration, options->maxBandwidth, options->maxLoss);
+        if (adaptive == NULL || (rtcpSocket = easy_open (options->group, port + 1, EASY_RECEIVE, &rtcpConfig)) == NULL) {
+            exit (1);
+        }
+        /* buffers are reserved for the longest packets */
+        maxPacketDuration = adpt_max_packet_duration (adaptive);
+        payload = adpt_payload (adaptive)->payload;
+    }
+    if (options->pressure) {
+        if ((pressure = press_create (packetDuration, options->maxPacketRate)) == NULL) {
+            exit (1);
+        }
+        if (press_max_packet_duration (pressure) > maxPacketDuration)
+            maxPacketDuration = press_max_packet_duration (pressure);
+    }
+
+    reframer = refr_create (fragmentSize, psw_device_frame_bytes(maxPacketDuration), options->memFlags);
+    if (reframer == NULL) { 
         printf("Could not reserve memory for audio data.\n"); 
         exit (1); /* very unusual case */ 
     }
+    payloadSwitch = psw_create (payload, maxPacketDuration, payload_max_frame_payload_bytes (maxPacketDuration), options->memFlags);
+    if (payloadSwitch == NULL) {
+        exit (1);
+    }
+    packetDuration = chosenDuration (requestedDuration);
+    if (adaptive != NULL) {
+        printf ("Sending payload %s, %d ms packets, %d bit/s\n", psw_current (payloadSwitch)->name, packetDuration, adpt_bandwidth (adaptive));
+    }
+    psw_set_packet_duration (payloadSwitch, packetDuration);
+    refr_set_block_size (reframer, psw_device_frame_bytes(packetDuration));
+    openOutput (port, psw_max_packet_bytes (payloadSwitch) + SRTP_AUTH_TAG_BYTES, options);
+    gain = gain_create (PSW_DEVICE_RATE, PSW_DEVICE_CHANNELS, GAIN_LOOK_AHEAD_MS, options->memFlags);
+    if (gain == NULL) {
+        exit (1);
+    }
+    gain_set (gain, vol / 100.0f);
+    gain_agc (gain, options->agc);
+    if (options->srtp && (srtp = srtp_create (options->srtpMaster, 1)) == NULL) {
+        exit (1);
+    }
+    openProfiler (options);
 
     while (1) 
     { /* until Ctrl-C */
-        bytesRead = read (descSnd, buf, fragmentSize); 
+        prof_begin (profiler, PROF_CAPTURE);
+        bytesRead = read (descSnd, refr_pointer_to_write (reframer), fragmentSize);
+        prof_end (profiler, PROF_CAPTURE, 1);
+        if (finishRequested)
+            finish();
         if (bytesRead!= fragmentSize)
-            printf ("Recorded a different number of bytes than expected (recorded %d bytes, expected %d)\n", bytesRead, fragmentSize);
-        printf (".");fflush (stdout);
+            alog (ALOG_WARNING, "Recorded a different number of bytes than expected (recorded %lld bytes, expected %lld)\n", bytesRead, fragmentSize, 0);
+        alog (ALOG_DEBUG, ".", 0, 0, 0);
 
         // bytesRead = write (file, buf, fragmentSize);
         // if (bytesRead!= fragmentSize)
         //     printf("Written in file a different number of bytes than expected");
 
-        if(easy_send_1(buf) < 0){
-            printf("easy_send_1");
-            exit(1);
+        if (bytesRead <= 0)
+            continue;
+        prof_begin (profiler, PROF_ENCODE);
+        gain_process (gain, (int16_t *) refr_pointer_to_write (reframer), bytesRead / (PSW_DEVICE_CHANNELS * PSW_DEVICE_BYTES_PER_SAMPLE));
+        refr_written (reframer, bytesRead);
+        prof_end (profiler, PROF_ENCODE, 0);
+
+        if (adaptive != NULL && readReports (easy_fd (rtcpSocket), ssrc)) {
+            packetDuration = chosenDuration (requestedDuration);
+            psw_select (payloadSwitch, adpt_payload (adaptive)->payload);
+            psw_set_packet_duration (payloadSwitch, packetDuration);
+            refr_set_block_size (reframer, psw_device_frame_bytes(packetDuration));
+            alog (ALOG_INFO, "\nSending payload %lld, %lld ms packets, %lld bit/s\n", psw_current (payloadSwitch)->payload, packetDuration, adpt_bandwidth (adaptive));
+        }
+
+        /* all the complete frames are sent, so there is always room for the next fragment */
+        sent = 0;
+        while ((frame = refr_pointer_to_read (reframer)) != NULL) {
+            unsigned char *out = nextPacket();
+            if (switchRequested) {
+                switchRequested = 0;
+                psw_select_next (payloadSwitch);
+                alog (ALOG_INFO, "\nSending payload %lld\n", psw_current (payloadSwitch)->payload, 0, 0);
+            }
+            prof_begin(profiler, PROF_ENCODE);
+            packetLength = psw_packetize(payloadSwitch, out, frame, seq, ts, ssrc, &samples);
+            if (srtp != NULL)
+                packetLength = srtp_protect(srtp, out, packetLength);
+            prof_end(profiler, PROF_ENCODE, 1);
+            prof_begin(profiler, PROF_SEND);
+            sendPacket(out, packetLength);
+            prof_end(profiler, PROF_SEND, 1);
+            seq++;
+            ts += samples;
+            sent++;
+        }
+        prof_begin(profiler, PROF_SEND);
+        flushOutput();
+        prof_end(profiler, PROF_SEND, 0);
+        printProfile();
+
+        if (pressure != NULL && press_sample (pressure, sent * outputCopies (), outputFd ())
+                && chosenDuration (requestedDuration) != packetDuration) {
+            packetDuration = chosenDuration (requestedDuration);
+            psw_set_packet_duration (payloadSwitch, packetDuration);
+            refr_set_block_size (reframer, psw_device_frame_bytes(packetDuration));
+            alog (ALOG_INFO, "\nSending %lld ms packets (send pressure)\n", packetDuration, 0, 0);
         }
 
     }
@@ -98,6 +392,140 @@ void send(int descSnd, int fragmentSize){
 }
 
 
+/* Streams options->file (WAV, or raw in the format of 'payload') to
+ * options->group:port, as 'payload' if the format of the file is the one of
+ * 'payload', or as the first payload of the table with the format of the file.
+ * Packets are built straight from the mapping of the file, and each one is
+ * sent at the time given by its timestamp (see pacer.h). The last packet
+ * of the file is shorter if the file does not end in a whole packet.
+ * With options->loop the file starts again when it ends, with the timestamps
+ * going on. -v and -g do not apply: the file is not modified. With options->srtp,
+ * packets are protected with SRTP. With options->unicast, packets are sent to
+ * the unicast destinations. With options->pressure, packet duration is made
+ * longer when the host is saturated */
+void streamFile(int packetDuration, int payload, unsigned int ssrc, int port, const struct audiocOptions *options){
+
+    const struct payloadDesc *desc = payload_lookup(payload);
+    const struct audioFileFormat raw = { desc->rate, desc->channels, desc->bytesPerSample };
+    const struct audioFileFormat *format;
+    const unsigned char *samples;
+    long length, offset = 0;
+    int requestedDuration = packetDuration;
+    int maxPacketDuration = packetDuration;
+    int frameBytes, sampleBytes, packetLength;
+    u_int16 seq = random();     /* random initial values, RFC 3550 5.1 */
+    u_int32 ts = random();
+
+    if ((audioFile = afile_open(options->file, &raw)) == NULL) {
+        exit(1);
+    }
+    format = afile_format(audioFile);
+    if (format->rate != desc->rate || format->channels != desc->channels || format->bytesPerSample != desc->bytesPerSample) {
+        const struct payloadDesc *table;
+        int count, i;
+        desc = NULL;
+        table = payload_table(&count);
+        for (i = 0; i < count && desc == NULL; i++) {
+            if (format->rate == table[i].rate && format->channels == table[i].channels && format->bytesPerSample == table[i].bytesPerSample)
+                desc = &table[i];
+        }
+        if (desc == NULL) {
+            printf("No payload for %s: %d Hz, %d channels, %d bits\n", options->file, format->rate, format->channels, 8 * format->bytesPerSample);
+            exit(1);
+        }
+    }
+    samples = afile_data(audioFile, &length);
+    if (length == 0) {
+        printf("%s has no audio\n", options->file);
+        exit(1);
+    }
+    sampleBytes = desc->channels * desc->bytesPerSample;
+    frameBytes = payload_frame_bytes(desc, packetDuration);
+    printf("Streaming %s as %s, %d ms packets, %.1f s%s\n", options->file, desc->name, packetDuration,
+            (double) length / sampleBytes / desc->rate, options->loop ? " in a loop" : "");
+
+    if (options->pressure) {
+        if ((pressure = press_create (packetDuration, options->maxPacketRate)) == NULL) {
+            exit (1);
+        }
+        maxPacketDuration = press_max_packet_duration (pressure);
+    }
+    openOutput(port, RTP_HEADER_SIZE + payload_frame_payload_bytes(desc, maxPacketDuration) + SRTP_AUTH_TAG_BYTES, options);
+    if (options->srtp && (srtp = srtp_create (options->srtpMaster, 1)) == NULL) {
+        exit (1);
+    }
+    /* a stall of more than 200 ms restarts the schedule instead of bursting */
+    if ((pacer = pace_create (desc->rate, 200)) == NULL) {
+        exit (1);
+    }
+    openProfiler (options);
+
+    while (1) 
+    { /* until the end of the file, or Ctrl-C */
+        int bytes = (length - offset < frameBytes) ? (int) (length - offset) : frameBytes;
+        int frames = bytes / sampleBytes;
+        unsigned char *out = nextPacket();
+
+        while (pace_wait(pacer, ts) < 0) {
+            /* interrupted by a signal */
+            if (finishRequested)
+                finish();
+        }
+        prof_begin(profiler, PROF_ENCODE);
+        packetLength = desc->packetize(out, samples + offset, frames, seq, ts, ssrc);
+        if (srtp != NULL)
+            packetLength = srtp_protect(srtp, out, packetLength);
+        prof_end(profiler, PROF_ENCODE, 1);
+        prof_begin(profiler, PROF_SEND);
+        sendPacket(out, packetLength);
+        flushOutput();
+        prof_end(profiler, PROF_SEND, 1);
+        printProfile();
+        if (pressure != NULL && press_sample (pressure, outputCopies (), outputFd ())) {
+            packetDuration = chosenDuration (requestedDuration);
+            frameBytes = payload_frame_bytes(desc, packetDuration);
+            alog(ALOG_INFO, "Sending %lld ms packets (send pressure)\n", packetDuration, 0, 0);
+        }
+        seq++;
+        ts += frames;
+        offset += bytes;
+        if (offset == length) {
+            if (!options->loop)
+                break;
+            offset = 0;
+        }
+    }
+
+    pace_print(pacer, "Stream");
+    pace_destroy(pacer);
+    pacer = NULL;
+    afile_close(audioFile);
+    audioFile = NULL;
+    if (srtp != NULL) {
+        srtp_destroy(srtp);
+        srtp = NULL;
+    }
+    if (pressure != NULL) {
+        press_destroy(pressure);
+        pressure = NULL;
+    }
+    if (profiler != NULL) {
+        prof_print(profiler);
+        prof_destroy(profiler);
+        profiler = NULL;
+    }
+    if (fan != NULL) {
+        fan_print_stats(fan);
+        fan_destroy(fan);
+        fan = NULL;
+    }
+    else {
+        easy_close(rtpSocket);
+        rtpSocket = NULL;
+        free(packet);
+        packet = NULL;
+    }
+}
 
 
 void main(int argc, char *argv[])
@@ -116,6 +544,7 @@ void main(int argc, char *argv[])
     // int audioSimpleOperation;       /* record, play */
     int descriptorSnd;
     int requestedFragmentSize;
+    int frameSize;      /* bytes of packetDuration ms of audio, in the soundcard format */
 
     /****************************************
     new variables
@@ -135,7 +564,9 @@ void main(int argc, char *argv[])
                                */
     int bufferingTime;  /* Returns the buffering time requested before starting playout.
                                Time measured in ms. */
+    struct audiocOptions options; /* Returns the additional options */
 
+    const struct payloadDesc *desc;
     int numberOfBlocks;
 
     float aux1;
@@ -149,6 +580,17 @@ void main(int argc, char *argv[])
         printf("Error installing signal, error: %s", strerror(errno)); 
         exit(1);
     }
+    sigInfo.sa_handler = switchHandler;
+    if ((sigaction (SIGUSR1, &sigInfo, NULL)) < 0) {
+        printf("Error installing signal, error: %s", strerror(errno)); 
+        exit(1);
+    }
+    sigInfo.sa_handler = profileHandler;
+    sigInfo.sa_flags = SA_RESTART;   /* the soundcard read keeps waiting */
+    if ((sigaction (SIGUSR2, &sigInfo, NULL)) < 0) {
+        printf("Error installing signal, error: %s", strerror(errno)); 
+        exit(1);
+    }
 
     /****************************************
     old capture args
@@ -167,27 +609,34 @@ void main(int argc, char *argv[])
      ***************************************/
 
     /* obtain values from the command line - or default values otherwise */
-    if (-1 == args_capture_audioc(argc, argv, &multicastIp, &ssrc, 
-            &port, &vol, &packetDuration, &verbose, &payload, &bufferingTime))
+    if (EXIT_FAILURE == args_capture_audioc(argc, argv, (struct in_addr *) &multicastIp, &ssrc, 
+            &port, &vol, &packetDuration, &verbose, &payload, &bufferingTime, &options))
     { exit(1);  /* there was an error parsing the arguments, the error type 
                    is printed by the args_capture function */
     };
+    /* messages of the hot loops; -c adds the ones of each fragment */
+    alog_start(verbose ? ALOG_DEBUG : ALOG_INFO, STDOUT_FILENO);
 
     /****************************************
     get BITS_PER_BYTE, channelNumber, rate, requestedFragmentSize
      ***************************************/
-    channelNumber = 1;
-
-    if(payload == PCMU){
-        rate = 8000;
-        sndCardFormat = U8;
-    }else if(payload == L16_1){
-        rate = 44100;
-        sndCardFormat = S16_LE;
+    if ((desc = payload_lookup(payload)) == NULL) {
+        printf("Unrecognized payload number %d\n", payload);
+        exit(1);
     }
-    aux1 = ((float) packetDuration / MILI_PER_SEC) * (float) rate;
-    aux2 = (channelNumber * sndCardFormat / BITS_PER_BYTE);
-    requestedFragmentSize = (int) aux1 * aux2;
+    if (options.file != NULL) {
+        /* nothing to configure in the soundcard */
+        streamFile(packetDuration, payload, ssrc, port, &options);
+        alog_stop();
+        exit(0);
+    }
+
+    /* the soundcard format does not depend on the payload, which can change */
+    channelNumber = PSW_DEVICE_CHANNELS;
+    rate = PSW_DEVICE_RATE;
+    sndCardFormat = PSW_DEVICE_FORMAT;
+    frameSize = psw_device_frame_bytes(packetDuration);
+    requestedFragmentSize = frameSize; /* the soundcard may configure a different one */
     // printf("%d\n", (int) aux1);
     // printf("%d\n", aux2);
     // printf("%d\n", requestedFragmentSize);
@@ -196,7 +645,6 @@ void main(int argc, char *argv[])
 
      * Also configures fragment size */
     configSndcard (&descriptorSnd, &sndCardFormat, &channelNumber, &rate, &requestedFragmentSize); 
-    vol = configVol (channelNumber, descriptorSnd, vol);
     printf("%d\n", requestedFragmentSize);
 
     /****************************************
@@ -206,7 +654,7 @@ void main(int argc, char *argv[])
     aux1 = ((float) bufferingTime / MILI_PER_SEC) * (float) rate;
     aux2 = (channelNumber * sndCardFormat / BITS_PER_BYTE);
     int buffer_size_bytes = (int) aux1 * aux2;
-    numberOfBlocks = (int)((float) buffer_size_bytes / (float) requestedFragmentSize);
+    numberOfBlocks = (int)((float) buffer_size_bytes / (float) frameSize);
     printf("%d\n", numberOfBlocks);
 
     /****************************************
@@ -245,8 +693,7 @@ void main(int argc, char *argv[])
     /****************************************
     create circular buffer
      ***************************************/
-    printf("entro1");
-    send(descriptorSnd, requestedFragmentSize);
+    sendAudio(descriptorSnd, requestedFragmentSize, packetDuration, payload, ssrc, port, vol, &options);
 
 
 
@@ -287,9 +734,11 @@ void record (int descSnd, const char * fileName, int fragmentSize)
     while (1) 
     { /* until Ctrl-C */
         bytesRead = read (descSnd, buf, fragmentSize); 
+        if (finishRequested)
+            finish();
         if (bytesRead!= fragmentSize)
-            printf ("Recorded a different number of bytes than expected (recorded %d bytes, expected %d)\n", bytesRead, fragmentSize);
-        printf (".");fflush (stdout);
+            alog (ALOG_WARNING, "Recorded a different number of bytes than expected (recorded %lld bytes, expected %lld)\n", bytesRead, fragmentSize, 0);
+        alog (ALOG_DEBUG, ".", 0, 0, 0);
 
         bytesRead = write (file, buf, fragmentSize);
         if (bytesRead!= fragmentSize)
@@ -298,18 +747,28 @@ void record (int descSnd, const char * fileName, int fragmentSize)
 }
 
 /* This function opens an existing file 'fileName'. It reads 'fragmentSize'
- * bytes and sends them to the soundcard, for playback
+ * bytes and sends them to the soundcard, for playback, each one at the time
+ * given by the audio before it (the file is in the PSW_DEVICE_* format), so
+ * that a descriptor which does not block (e.g. a file or a pipe) does not
+ * get the whole file at once. The send-time error is printed at the end.
  * If an error is found in the configuration of the soundcard, the process 
  * is stopped and an error message reported. */
 void play (int descSnd, const char * fileName, int fragmentSize)
 {
     int file;
     int bytesRead;
+    void *pacer;
+    uint32_t frames = 0;
 
     /* Creates buffer to store the audio data */
     buf = malloc (fragmentSize); 
     if (buf == NULL) { printf("Could not reserve memory for audio data.\n"); exit (1); /* very unusual case */ }
 
+    /* a stall of more than 200 ms restarts the schedule instead of bursting */
+    if ((pacer = pace_create (PSW_DEVICE_RATE, 200)) == NULL) {
+        exit (1);
+    }
+
     /* opens file in read-only mode */
     if ((file = open (fileName, O_RDONLY)) < 0) {
         printf("File could not be opened, error %s", strerror(errno));
@@ -326,8 +785,18 @@ void play (int descSnd, const char * fileName, int fragmentSize)
         if (bytesRead != fragmentSize)
             break; /* reached end of file */
 
+        while (pace_wait (pacer, frames) < 0) {
+            /* interrupted by a signal */
+            if (finishRequested)
+                finish();
+        }
+        frames += fragmentSize / (PSW_DEVICE_CHANNELS * PSW_DEVICE_BYTES_PER_SAMPLE);
+
         bytesRead = write (descSnd, buf, fragmentSize); 
         if (bytesRead!= fragmentSize)
-            printf ("Played a different number of bytes than expected (recorded %d bytes, expected %d)\n", bytesRead, fragmentSize);
+            alog (ALOG_WARNING, "Played a different number of bytes than expected (recorded %lld bytes, expected %lld)\n", bytesRead, fragmentSize, 0);
     }
+    pace_print (pacer, "Playback");
+    pace_destroy (pacer);
+    close (file);
 };
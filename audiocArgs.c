@@ -7,6 +7,8 @@
 #include <string.h> 
 #include <arpa/inet.h>
 #include "audiocArgs.h"
+#include "payloadTable.h"
+#include "alignedMemory.h"
 
 
 /*=====================================================================*/
@@ -30,7 +32,7 @@ void args_print_audioc (int multicastIp, unsigned int ssrc, int port, int packet
 static void _printHelp (void)
 {
     printf ("\naudioc v1.0");
-    printf ("\naudioc  MULTICAST_ADDR  LOCAL_SSRC  [-pLOCAL_RTP_PORT] [-lPACKET_DURATION] [-yPAYLOAD] [-kACCUMULATED_TIME] [-vVOL] [-c]\n");
+    printf ("\naudioc  MULTICAST_ADDR  LOCAL_SSRC  [-pLOCAL_RTP_PORT] [-lPACKET_DURATION] [-yPAYLOAD] [-kACCUMULATED_TIME] [-vVOL] [-c] [-wWORKERS] [-W] [-M] [-aBANDWIDTH] [-xLOSS] [-g] [-KKEY] [-tTTL] [-L] [-IINTERFACE] [-BKBYTES] [-FFILE] [-R] [-UFILE] [-P[RATE]] [-C] [-SSOURCE]... [-XSOURCE]... [-GGROUP]... [-ASSRC]... [-DSSRC]...\n");
 }
 
 
@@ -48,7 +50,7 @@ static void _defaultValues (int *port, int *vol, int *packetDuration, int *verbo
 
 
 /*=====================================================================*/
-int args_capture_audioc(int argc, char * argv[], struct in_addr *multicastIp, unsigned int *ssrc, int *port, int *vol, int *packetDuration, int *verbose, int *payload, int *bufferingTime)
+int args_capture_audioc(int argc, char * argv[], struct in_addr *multicastIp, unsigned int *ssrc, int *port, int *vol, int *packetDuration, int *verbose, int *payload, int *bufferingTime, struct audiocOptions *options)
 {
     int index;
     char car;
@@ -57,6 +59,9 @@ int args_capture_audioc(int argc, char * argv[], struct in_addr *multicastIp, un
 
     /*set default values */
     _defaultValues (port, vol, packetDuration, verbose, payload, bufferingTime);
+    memset (options, 0, sizeof (struct audiocOptions));
+    options->maxLoss = 5 * 256 / 100;
+    easy_default_config (&options->socket);
 
     if (argc < 3 )
     { 
@@ -122,9 +127,9 @@ int args_capture_audioc(int argc, char * argv[], struct in_addr *multicastIp, un
                         printf ("\n-y must be followed by a number\n");
                         exit (1); /* error */
                     }
-                    if (  ! ( ((*payload) == PCMU) || ( (*payload) == L16_1)  ))
+                    if (payload_lookup (*payload) == NULL)
                     {	    
-                        printf ("\nUnrecognized payload number. Must be either 11 or 100.\n");
+                        printf ("\nUnrecognized payload number. Must be 100 (PCMU), 8 (PCMA), 10/11 (L16 stereo/mono, 44100 Hz) or 97/96 (L16 stereo/mono, 48000 Hz).\n");
                         exit (1); /* error */
                     }
                     break;
@@ -143,6 +148,178 @@ int args_capture_audioc(int argc, char * argv[], struct in_addr *multicastIp, un
                     }
                     break;
 
+                case 'w': /* Receiving threads */
+                    if ( sscanf (++argv[index],"%d", &options->workers) != 1)
+                    { 
+                        printf ("\n-w must be followed by a number\n");
+                        return(EXIT_FAILURE);
+                    }
+                    if (  ! ( (options->workers >= 0) && (options->workers <= 64) ))
+                    {	    
+                        printf ("\nThe number of workers (-w) must be in the range [0..64]\n");
+                        return(EXIT_FAILURE);
+                    }
+                    break;
+
+                case 'W': /* SSRC steering among workers */
+                    options->steerBySsrc = 1;
+                    break;
+
+                case 'M': /* Buffers locked in memory */
+                    options->memFlags = AMEM_LOCK | AMEM_HUGE;
+                    break;
+
+                case 'a': /* Adaptive payload, bandwidth ceiling */
+                    if ( sscanf (++argv[index],"%d", &options->maxBandwidth) != 1 || options->maxBandwidth <= 0)
+                    { 
+                        printf ("\n-a must be followed by a number of kbit/s greater than 0\n");
+                        return(EXIT_FAILURE);
+                    }
+                    options->maxBandwidth *= 1000;
+                    break;
+
+                case 'x': /* Adaptive payload, loss ceiling */
+                    if ( sscanf (++argv[index],"%d", &options->maxLoss) != 1)
+                    { 
+                        printf ("\n-x must be followed by a number\n");
+                        return(EXIT_FAILURE);
+                    }
+                    if (  ! ( (options->maxLoss >= 0) && (options->maxLoss <= 100) ))
+                    {	    
+                        printf ("\nThe loss ceiling (-x) must be a percentage in the range [0..100]\n");
+                        return(EXIT_FAILURE);
+                    }
+                    options->maxLoss = options->maxLoss * 256 / 100;
+                    break;
+
+                case 'g': /* Automatic gain control */
+                    options->agc = 1;
+                    break;
+
+                case 'K': /* SRTP master key and salt */
+                    if (srtp_parse_key (++argv[index], options->srtpMaster) < 0)
+                    { 
+                        printf ("\n-K must be followed by %d hexadecimal digits (master key and master salt)\n", 2 * SRTP_MASTER_BYTES);
+                        return(EXIT_FAILURE);
+                    }
+                    options->srtp = 1;
+                    break;
+
+                case 't': /* Multicast TTL */
+                    if ( sscanf (++argv[index],"%d", &options->socket.ttl) != 1 || options->socket.ttl < 1 || options->socket.ttl > 255)
+                    { 
+                        printf ("\n-t must be followed by a TTL in the range [1..255]\n");
+                        return(EXIT_FAILURE);
+                    }
+                    break;
+
+                case 'L': /* Multicast sent is not looped back */
+                    options->socket.loop = 0;
+                    break;
+
+                case 'I': /* Multicast interface */
+                    if (strlen (++argv[index]) == 0 || strlen (argv[index]) >= sizeof (options->socket.interface))
+                    { 
+                        printf ("\n-I must be followed by the name of an interface\n");
+                        return(EXIT_FAILURE);
+                    }
+                    strcpy (options->socket.interface, argv[index]);
+                    break;
+
+                case 'S': /* Source-specific multicast: only this source (repeated: include list) */
+                case 'X': /* Every source but this one (repeated: exclude list) */
+                {
+                    int filter = (car == 'S') ? EASY_INCLUDE : EASY_EXCLUDE;
+                    if (strlen (++argv[index]) == 0 || strlen (argv[index]) >= INET6_ADDRSTRLEN || options->socket.sources == EASY_MAX_SOURCES)
+                    { 
+                        printf ("\n-%c must be followed by a source address, %d at most\n", car, EASY_MAX_SOURCES);
+                        return(EXIT_FAILURE);
+                    }
+                    if (options->socket.filter != EASY_ANY_SOURCE && options->socket.filter != filter)
+                    { 
+                        printf ("\n-S and -X cannot be used together\n");
+                        return(EXIT_FAILURE);
+                    }
+                    options->socket.filter = filter;
+                    strcpy (options->socket.source[options->socket.sources++], argv[index]);
+                    break;
+                }
+
+                case 'G': /* Another group received by the same socket */
+                    if (strlen (++argv[index]) == 0 || strlen (argv[index]) >= INET6_ADDRSTRLEN || options->socket.groups == EASY_MAX_GROUPS)
+                    { 
+                        printf ("\n-G must be followed by a multicast address, %d at most\n", EASY_MAX_GROUPS);
+                        return(EXIT_FAILURE);
+                    }
+                    strcpy (options->socket.group[options->socket.groups++], argv[index]);
+                    break;
+
+                case 'A': /* Only this SSRC is received (repeated: allow list) */
+                case 'D': /* Every SSRC but this one (repeated: deny list) */
+                {
+                    int filter = (car == 'A') ? RFLT_ALLOW : RFLT_DENY;
+                    char *end;
+                    unsigned long ssrc = strtoul (++argv[index], &end, 0);
+                    if (strlen (argv[index]) == 0 || *end != '\0' || ssrc > 0xffffffffUL || options->ssrcs == RFLT_MAX_SSRCS)
+                    { 
+                        printf ("\n-%c must be followed by an SSRC (decimal, or hexadecimal with 0x), %d at most\n", car, RFLT_MAX_SSRCS);
+                        return(EXIT_FAILURE);
+                    }
+                    if (options->ssrcFilter != RFLT_ANY_SSRC && options->ssrcFilter != filter)
+                    { 
+                        printf ("\n-A and -D cannot be used together\n");
+                        return(EXIT_FAILURE);
+                    }
+                    options->ssrcFilter = filter;
+                    options->ssrc[options->ssrcs++] = (u_int32) ssrc;
+                    break;
+                }
+
+                case 'B': /* Socket buffers */
+                    if ( sscanf (++argv[index],"%d", &options->socket.rcvBuf) != 1 || options->socket.rcvBuf <= 0 || options->socket.rcvBuf > 1024 * 1024)
+                    { 
+                        printf ("\n-B must be followed by a number of KB in the range [1..1048576]\n");
+                        return(EXIT_FAILURE);
+                    }
+                    options->socket.rcvBuf *= 1024;
+                    options->socket.sndBuf = options->socket.rcvBuf;
+                    break;
+
+                case 'F': /* File streamed instead of the soundcard */
+                    if (strlen (++argv[index]) == 0)
+                    { 
+                        printf ("\n-F must be followed by the name of a WAV or raw audio file\n");
+                        return(EXIT_FAILURE);
+                    }
+                    options->file = argv[index];
+                    break;
+
+                case 'R': /* File streamed in a loop */
+                    options->loop = 1;
+                    break;
+
+                case 'P': /* Packet duration adapted to send pressure, with an optional packet rate ceiling */
+                    options->pressure = 1;
+                    if (strlen (++argv[index]) > 0 && (sscanf (argv[index], "%d", &options->maxPacketRate) != 1 || options->maxPacketRate < 1))
+                    { 
+                        printf ("\n-P can be followed by a packet rate ceiling, in packets per second\n");
+                        return(EXIT_FAILURE);
+                    }
+                    break;
+
+                case 'U': /* Unicast destinations */
+                    if (strlen (++argv[index]) == 0)
+                    { 
+                        printf ("\n-U must be followed by the name of a file of unicast destinations\n");
+                        return(EXIT_FAILURE);
+                    }
+                    options->unicast = argv[index];
+                    break;
+
+                case 'C': /* Cost of each stage per packet, with the performance counters */
+                    options->profile = 1;
+                    break;
+
                 default:
                     printf ("\nI do not understand -%c\n", car);
                     _printHelp ();
@@ -154,20 +331,30 @@ int args_capture_audioc(int argc, char * argv[], struct in_addr *multicastIp, un
         else /* There is a name */
         {
             if (numOfNames == 0) {
-                if (strlen (argv[index]) > 15) 
+                struct in6_addr multicastIp6;
+                if (strlen (argv[index]) >= INET6_ADDRSTRLEN) 
                 {
-                    printf("\nInternet address (IPv4) should not have more than 15 chars\n");
+                    printf("\nInternet address should not have more than %d chars\n", INET6_ADDRSTRLEN - 1);
                     exit (1); /* error */	
                 }
-                int res = inet_pton(AF_INET, argv[index], multicastIp);
-                if (res < 1) {
-                    printf("\nInternet address string not recognized\n");
-                    return(EXIT_FAILURE);
+                if (inet_pton(AF_INET, argv[index], multicastIp) == 1) {
+                    if (!IN_CLASSD(ntohl(multicastIp->s_addr))) {
+                        printf("\nNot a multicast address\n");
+                        return(EXIT_FAILURE);
+                    }
+                }
+                else if (inet_pton(AF_INET6, argv[index], &multicastIp6) == 1) {
+                    if (!IN6_IS_ADDR_MULTICAST(&multicastIp6)) {
+                        printf("\nNot a multicast address\n");
+                        return(EXIT_FAILURE);
+                    }
+                    multicastIp->s_addr = 0;
                 }
-                if (!IN_CLASSD(ntohl(*multicastIp))) {
-                    printf("\nNot a multicast address\n");
+                else {
+                    printf("\nInternet address string not recognized\n");
                     return(EXIT_FAILURE);
                 }
+                strcpy (options->group, argv[index]);
 
             }
             else if (numOfNames == 1) {
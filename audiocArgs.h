@@ -4,9 +4,47 @@
 
 /* Parses arguments for audioc application */
 
-/* audioc MULTICAST_ADDR  LOCAL_SSRC  [-pLOCAL_RTP_PORT] [-lPACKET_DURATION] [-yPAYLOAD] [-kACCUMULATED_TIME] [-vVOL] [-c]  */
-/* payload options, to be included in RTP packets */
-enum payload {PCMU=100,  L16_1=11};
+/* audioc MULTICAST_ADDR  LOCAL_SSRC  [-pLOCAL_RTP_PORT] [-lPACKET_DURATION] [-yPAYLOAD] [-kACCUMULATED_TIME] [-vVOL] [-c] [-wWORKERS] [-W] */
+
+#ifndef AUDIOC_ARGS_H
+#define AUDIOC_ARGS_H
+
+#include <netinet/in.h>
+#include "srtp.h"
+#include "easyUDPSockets.h"
+#include "rtpFilter.h"
+
+/* payload options, to be included in RTP packets; see payloadTable.c for their formats.
+ * PCMA and L16 at 44100 Hz use the static payload types of RFC 3551, L16 at 48000 Hz uses dynamic ones */
+enum payload {PCMU=100, PCMA=8, L16_2=10, L16_1=11, L16_1_48K=96, L16_2_48K=97};
+
+/* Options beyond the basic audioc arguments. All of them are disabled by default */
+struct audiocOptions {
+    int workers;        /* -wWORKERS: receive with WORKERS threads, one SO_REUSEPORT socket each. 0: single socket */
+    int steerBySsrc;    /* -W: with -w, each worker receives always the same SSRCs (SO_ATTACH_FILTER on each worker socket drops the SSRCs of the others) */
+    int memFlags;       /* -M: audio buffers are locked in memory (and use huge pages if large), see enum amem_flags */
+    int maxBandwidth;   /* -aKBPS: the sender adapts payload and packet duration to the RTCP reports
+                           received, under KBPS kbit/s (stored in bit/s). 0: fixed payload */
+    int maxLoss;        /* -xPERCENT: loss ceiling for -a, default 5%. Stored in 1/256 units */
+    int agc;            /* -g: automatic gain control of each stream, on top of the -v gain */
+    int srtp;           /* -KKEY: packets are SRTP (see srtp.h), with the pre-shared master key and salt */
+    unsigned char srtpMaster[SRTP_MASTER_BYTES];    /* KEY, 60 hexadecimal digits: master key then master salt */
+    char group[INET6_ADDRSTRLEN];   /* MULTICAST_ADDR as given, IPv4 or IPv6 (then the multicastIp
+                                       returned by args_capture_audioc is 0) */
+    struct easySocketConfig socket; /* -tTTL, -L (no multicast loop), -IINTERFACE, -BKBYTES (socket buffers),
+                                       -SSOURCE / -XSOURCE (source filter, repeated), -GGROUP (more groups, repeated) */
+    const char *file;   /* -FFILE: the sender streams this WAV or raw file (see audioFile.h) instead of the soundcard. NULL: soundcard */
+    int loop;           /* -R: with -F, the file is streamed again when it ends */
+    const char *unicast;    /* -UFILE: the sender sends to the unicast destinations of FILE (see fanOut.h)
+                               instead of the group. NULL: group */
+    int pressure;       /* -P[RATE]: the sender makes packets longer when the host is saturated (see sendPressure.h) */
+    int maxPacketRate;  /* RATE: packet rate ceiling of -P, packets/s. 0: only CPU and socket backlog */
+    int profile;        /* -C: cost per packet of each stage, printed on SIGUSR2 and at the end (see stageProfiler.h) */
+    int ssrcFilter;     /* -ASSRC (repeated): the receiver only accepts these SSRCs; -DSSRC: all but these.
+                           See enum rflt_ssrc_mode; the kernel drops the rest (see rtpFilter.h) */
+    int ssrcs;
+    u_int32 ssrc[RFLT_MAX_SSRCS];
+};
 
 /* Parses arguments from command line 
  * Returns  EXIT_FAILURE if it finds an error when parsing the args. In this
@@ -26,12 +64,12 @@ int  args_capture_audioc ( int argc, char *argv[],
 	int *payload,       /* Returns the requested payload for the communication. 
                                This is the payload to include in RTP packets (see enum payload). 
                                */
-	int *bufferingTime  /* Returns the buffering time requested before starting playout.
+	int *bufferingTime, /* Returns the buffering time requested before starting playout.
                                Time measured in ms. */
+	struct audiocOptions *options /* Returns the additional options, see struct audiocOptions */
 	);
 
 /* prints current values, can be used for debugging */
 void  args_print_audioc (int multicastIpStr, unsigned int ssrc, int port, int packetDuration, int payload, int bufferingTime, int vol, int verbose);
 
-
-
+#endif /* AUDIOC_ARGS_H */
@@ -0,0 +1,502 @@
+/*
+audiocServer [-sCONTROL_SOCKET] [-mMAX_SOURCES] [-kACCUMULATED_TIME] [-M] [-KKEY] [-c] [-C]
+
+Receives many RTP sessions (multicast group/port pairs) in a single process
+and a single thread, using epoll. Each session has its own sockets (RTP and
+RTCP), per-source state and jitter buffers, and sends its own RTCP receiver
+reports (see rtpSession.h). The timers of all the sessions are in a timer
+wheel (see timerWheel.h), which sets the timeout of epoll_wait.
+
+Sessions are added and removed at run time through a UNIX stream socket
+(default /tmp/audiocServer.sock), with one text command per line:
+    add GROUP PORT [PAYLOAD [PACKET_DURATION]]   PAYLOAD see enum payload (default 100), PACKET_DURATION in ms (default 20)
+    del GROUP PORT
+    list                                        one line per session
+    profile                                     cost per packet of the reception (with -C, see stageProfiler.h)
+    quit                                        closes the control connection
+Each command is answered with 'OK' or 'ERROR <reason>' in the last line.
+For example:
+    echo "add 225.0.1.29 5004" | socat - UNIX-CONNECT:/tmp/audiocServer.sock
+
+-sCONTROL_SOCKET    path of the control socket
+-mMAX_SOURCES       maximum number of sources per session, default 8
+-kACCUMULATED_TIME  ms of audio stored for each source, default 100
+-M                  jitter buffers are prefaulted and locked in memory when created, with huge pages if large
+-KKEY               all sessions receive SRTP (see srtp.h) with this pre-shared master key and salt, 60 hexadecimal digits
+-c                  verbose, prints a line for each command received
+-C                  measures the cost per packet of the reception with the performance counters,
+                    for the 'profile' command and the end
+
+To compile, execute
+gcc -Wall -Wextra -O2 -o audiocServer rtpSource.c jitterBuffer.c alignedMemory.c rtcp.c rtpSession.c payloadTable.c sampleConvert.c srtp.c stageProfiler.c rtpFilter.c timerWheel.c audiocServer.c
+(add -maes -msha -msse4.1 to use the instructions of the CPU for SRTP)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "audiocArgs.h" /* enum payload */
+#include "rtpSession.h"
+#include "payloadTable.h"
+#include "alignedMemory.h"
+#include "srtp.h"
+#include "stageProfiler.h"
+#include "timerWheel.h"
+
+#define MAX_EVENTS 256
+#define CONTROL_LINE_SIZE 256
+
+/* tags stored in epoll data.ptr, to tell control endpoints from sessions.
+ * Session endpoints are recognized because they are not one of these */
+enum controlType {CONTROL_LISTEN = 100, CONTROL_CLIENT = 101};
+
+struct controlEndpoint {
+    int type;                   /* enum controlType; must be the first field */
+    int sockId;
+    int length;                 /* bytes pending in 'line' (clients only) */
+    char line[CONTROL_LINE_SIZE];
+};
+
+/* all the sessions, unordered */
+static struct rtpSession **sessions = NULL;
+static int numberOfSessions = 0;
+static int sessionsCapacity = 0;
+
+static int epollId;
+static int maxSources = 8;
+static int bufferingTime = 100;
+static int memFlags = AMEM_DEFAULT;
+static int verbose = 0;
+static unsigned char srtpMaster[SRTP_MASTER_BYTES];
+static int useSrtp = 0;
+static void *profiler = NULL;   /* with -C */
+static void *wheel;             /* timers of the sessions */
+
+static volatile sig_atomic_t finish = 0;
+
+static void signalHandler (int sigNum __attribute__ ((unused)))
+{
+    finish = 1;
+}
+
+
+static long long _nowMs (void)
+{
+    struct timespec now;
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    return (long long) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+
+static int _findSession (struct in_addr group, int port)
+{
+    int i;
+    for (i = 0; i < numberOfSessions; i++) {
+        if (sess_matches (sessions[i], group, port)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+static int _epollAdd (int sockId, void *ptr)
+{
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = ptr;
+    return epoll_ctl (epollId, EPOLL_CTL_ADD, sockId, &event);
+}
+
+
+/* parses GROUP PORT from a command; returns 0 if both are valid */
+static int _parseAddress (const char *groupStr, const char *portStr, struct in_addr *group, int *port, char *reply, int size)
+{
+    if (groupStr == NULL || portStr == NULL) {
+        snprintf (reply, size, "ERROR expected GROUP PORT\n");
+        return -1;
+    }
+    if (inet_pton (AF_INET, groupStr, group) < 1 || !IN_CLASSD (ntohl (group->s_addr))) {
+        snprintf (reply, size, "ERROR %s is not a multicast address\n", groupStr);
+        return -1;
+    }
+    if (sscanf (portStr, "%d", port) != 1 || *port < 1024 || *port > 65534 || (*port & 1)) {
+        snprintf (reply, size, "ERROR port must be even, in the range [1024..65534]\n");
+        return -1;
+    }
+    return 0;
+}
+
+
+static void _addSession (char *args, char *reply, int size)
+{
+    char *groupStr = strtok (args, " \t");
+    char *portStr = strtok (NULL, " \t");
+    char *payloadStr = strtok (NULL, " \t");
+    char *durationStr = strtok (NULL, " \t");
+    struct in_addr group;
+    int port, payload = PCMU, packetDuration = 20;
+    struct rtpSession *s;
+
+    if (_parseAddress (groupStr, portStr, &group, &port, reply, size) < 0) {
+        return;
+    }
+    if (payloadStr != NULL && (sscanf (payloadStr, "%d", &payload) != 1 || payload_lookup (payload) == NULL)) {
+        snprintf (reply, size, "ERROR unrecognized payload number. Must be 100 (PCMU), 8 (PCMA), 10/11 (L16 stereo/mono, 44100 Hz) or 97/96 (L16 stereo/mono, 48000 Hz).\n");
+        return;
+    }
+    if (durationStr != NULL && (sscanf (durationStr, "%d", &packetDuration) != 1 || packetDuration <= 0)) {
+        snprintf (reply, size, "ERROR packet duration must be greater than 0\n");
+        return;
+    }
+    if (_findSession (group, port) >= 0) {
+        snprintf (reply, size, "ERROR session already exists\n");
+        return;
+    }
+    if (numberOfSessions == sessionsCapacity) {
+        int newCapacity = sessionsCapacity ? 2 * sessionsCapacity : 64;
+        struct rtpSession **newSessions = realloc (sessions, newCapacity * sizeof (struct rtpSession *));
+        if (newSessions == NULL) {
+            snprintf (reply, size, "ERROR out of memory\n");
+            return;
+        }
+        sessions = newSessions;
+        sessionsCapacity = newCapacity;
+    }
+    if ((s = sess_create (group, port, payload, packetDuration, bufferingTime / packetDuration, maxSources, memFlags,
+            useSrtp ? srtpMaster : NULL, wheel)) == NULL) {
+        snprintf (reply, size, "ERROR could not create session\n");
+        return;
+    }
+    if (_epollAdd (sess_fd (s, SESS_RTP), sess_endpoint (s, SESS_RTP)) < 0
+            || _epollAdd (sess_fd (s, SESS_RTCP), sess_endpoint (s, SESS_RTCP)) < 0) {
+        snprintf (reply, size, "ERROR epoll_ctl: %s\n", strerror (errno));
+        sess_destroy (s);
+        return;
+    }
+    sessions[numberOfSessions++] = s;
+    snprintf (reply, size, "OK\n");
+}
+
+
+static void _delSession (char *args, char *reply, int size)
+{
+    char *groupStr = strtok (args, " \t");
+    char *portStr = strtok (NULL, " \t");
+    struct in_addr group;
+    int port, index;
+
+    if (_parseAddress (groupStr, portStr, &group, &port, reply, size) < 0) {
+        return;
+    }
+    if ((index = _findSession (group, port)) < 0) {
+        snprintf (reply, size, "ERROR no such session\n");
+        return;
+    }
+    /* closing the sockets removes them from the epoll set */
+    sess_destroy (sessions[index]);
+    sessions[index] = sessions[--numberOfSessions];
+    snprintf (reply, size, "OK\n");
+}
+
+
+static void _listSessions (int sockId)
+{
+    char line[512];
+    int i;
+
+    for (i = 0; i < numberOfSessions; i++) {
+        sess_describe (sessions[i], line, sizeof (line));
+        if (write (sockId, line, strlen (line)) < 0) {
+            return;
+        }
+    }
+}
+
+
+/* executes one command line; returns -1 if the connection must be closed */
+static int _command (struct controlEndpoint *client, char *line)
+{
+    char reply[256];
+    char *command = strtok (line, " \t\r");
+    char *args = strtok (NULL, "\r");
+    char empty[] = "";
+
+    if (verbose) {
+        printf ("Command: %s %s\n", command ? command : "", args ? args : "");
+    }
+    if (command == NULL) {
+        return 0;
+    }
+    if (args == NULL) {
+        args = empty;
+    }
+    if (strcmp (command, "add") == 0) {
+        _addSession (args, reply, sizeof (reply));
+    } else if (strcmp (command, "del") == 0) {
+        _delSession (args, reply, sizeof (reply));
+    } else if (strcmp (command, "list") == 0) {
+        _listSessions (client->sockId);
+        snprintf (reply, sizeof (reply), "OK %d sessions\n", numberOfSessions);
+    } else if (strcmp (command, "profile") == 0) {
+        if (profiler == NULL) {
+            snprintf (reply, sizeof (reply), "ERROR not profiling, start with -C\n");
+        } else {
+            char line[512];
+            prof_describe (profiler, PROF_RECEIVE, line, sizeof (line));
+            if (write (client->sockId, line, strlen (line)) < 0) {
+                return -1;
+            }
+            snprintf (reply, sizeof (reply), "OK\n");
+        }
+    } else if (strcmp (command, "quit") == 0) {
+        return -1;
+    } else {
+        snprintf (reply, sizeof (reply), "ERROR unknown command '%s'\n", command);
+    }
+    if (write (client->sockId, reply, strlen (reply)) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+
+static void _closeClient (struct controlEndpoint *client)
+{
+    close (client->sockId);
+    free (client);
+}
+
+
+/* reads from a control connection and executes the complete lines received */
+static void _controlClient (struct controlEndpoint *client)
+{
+    int bytesRead = read (client->sockId, client->line + client->length, CONTROL_LINE_SIZE - 1 - client->length);
+    char *newline;
+
+    if (bytesRead <= 0) {
+        _closeClient (client);
+        return;
+    }
+    client->length += bytesRead;
+    client->line[client->length] = '\0';
+
+    while ((newline = strchr (client->line, '\n')) != NULL) {
+        int consumed = newline - client->line + 1;
+        *newline = '\0';
+        if (_command (client, client->line) < 0) {
+            _closeClient (client);
+            return;
+        }
+        memmove (client->line, client->line + consumed, client->length - consumed + 1);
+        client->length -= consumed;
+    }
+    if (client->length == CONTROL_LINE_SIZE - 1) {
+        /* line too long, discarded */
+        client->length = 0;
+    }
+}
+
+
+static void _controlAccept (struct controlEndpoint *listener)
+{
+    struct controlEndpoint *client;
+    int sockId;
+
+    if ((sockId = accept (listener->sockId, NULL, NULL)) < 0) {
+        return;
+    }
+    if ((client = calloc (1, sizeof (struct controlEndpoint))) == NULL) {
+        close (sockId);
+        return;
+    }
+    client->type = CONTROL_CLIENT;
+    client->sockId = sockId;
+    if (_epollAdd (sockId, client) < 0) {
+        _closeClient (client);
+    }
+}
+
+
+static int _openControlSocket (const char *path)
+{
+    struct sockaddr_un localAddr;
+    int sockId;
+
+    if (strlen (path) >= sizeof (localAddr.sun_path)) {
+        printf ("Control socket path too long\n");
+        return -1;
+    }
+    if ((sockId = socket (AF_UNIX, SOCK_STREAM, 0)) < 0) {
+        printf ("socket error: %s\n", strerror (errno));
+        return -1;
+    }
+    memset (&localAddr, 0, sizeof (localAddr));
+    localAddr.sun_family = AF_UNIX;
+    strcpy (localAddr.sun_path, path);
+    unlink (path);
+    if (bind (sockId, (struct sockaddr *) &localAddr, sizeof (localAddr)) < 0 || listen (sockId, 16) < 0) {
+        printf ("Error binding control socket %s: %s\n", path, strerror (errno));
+        close (sockId);
+        return -1;
+    }
+    return sockId;
+}
+
+
+/* each session uses two descriptors; raises the soft limit up to the hard limit */
+static void _raiseFileLimit (void)
+{
+    struct rlimit limit;
+    if (getrlimit (RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit (RLIMIT_NOFILE, &limit);
+    }
+}
+
+
+int main (int argc, char *argv[])
+{
+    struct sigaction sigInfo;
+    struct epoll_event events[MAX_EVENTS];
+    struct controlEndpoint listener;
+    const char *controlPath = "/tmp/audiocServer.sock";
+    int index;
+
+    sigInfo.sa_handler = signalHandler;
+    sigInfo.sa_flags = 0;
+    sigemptyset (&sigInfo.sa_mask);
+    if ((sigaction (SIGINT, &sigInfo, NULL)) < 0 || (sigaction (SIGTERM, &sigInfo, NULL)) < 0) {
+        printf ("Error installing signal, error: %s", strerror (errno));
+        exit (1);
+    }
+    signal (SIGPIPE, SIG_IGN); /* control clients may close before the reply */
+
+    for (index = 1; index < argc; index++) {
+        if (argv[index][0] != '-') {
+            printf ("\nUnexpected argument %s\n", argv[index]);
+            exit (1);
+        }
+        switch (argv[index][1]) {
+            case 's': controlPath = argv[index] + 2; break;
+            case 'm':
+                if (sscanf (argv[index] + 2, "%d", &maxSources) != 1 || maxSources < 1) {
+                    printf ("\n-m must be followed by a number greater than 0\n");
+                    exit (1);
+                }
+                break;
+            case 'k':
+                if (sscanf (argv[index] + 2, "%d", &bufferingTime) != 1 || bufferingTime < 0) {
+                    printf ("\n-k must be followed by a number equal or greater than 0\n");
+                    exit (1);
+                }
+                break;
+            case 'M': memFlags = AMEM_LOCK | AMEM_HUGE; break;
+            case 'K':
+                if (srtp_parse_key (argv[index] + 2, srtpMaster) < 0) {
+                    printf ("\n-K must be followed by %d hexadecimal digits (master key and master salt)\n", 2 * SRTP_MASTER_BYTES);
+                    exit (1);
+                }
+                useSrtp = 1;
+                break;
+            case 'c': verbose = 1; break;
+            case 'C':
+                if ((profiler = prof_create ()) == NULL) {
+                    exit (1);
+                }
+                break;
+            default:
+                printf ("\nI do not understand -%c\n", argv[index][1]);
+                printf ("audiocServer [-sCONTROL_SOCKET] [-mMAX_SOURCES] [-kACCUMULATED_TIME] [-M] [-KKEY] [-c] [-C]\n");
+                exit (1);
+        }
+    }
+
+    _raiseFileLimit ();
+    srandom (time (NULL) ^ getpid ());
+
+    if ((epollId = epoll_create1 (0)) < 0) {
+        printf ("epoll_create1 error: %s\n", strerror (errno));
+        exit (1);
+    }
+    listener.type = CONTROL_LISTEN;
+    if ((listener.sockId = _openControlSocket (controlPath)) < 0 || _epollAdd (listener.sockId, &listener) < 0) {
+        exit (1);
+    }
+    printf ("audiocServer listening for commands in %s\n", controlPath);
+
+    if ((wheel = twheel_create (_nowMs ())) == NULL) {
+        exit (1);
+    }
+    while (!finish)
+    {
+        int ready = epoll_wait (epollId, events, MAX_EVENTS, twheel_timeout (wheel, _nowMs ()));
+        int i;
+
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            printf ("epoll_wait error: %s\n", strerror (errno));
+            break;
+        }
+        /* first, so that the timers the events start count from now */
+        twheel_advance (wheel, _nowMs ());
+
+        /* sessions first: control commands may destroy sessions which have events in this same batch */
+        for (i = 0; i < ready; i++) {
+            void *ptr = events[i].data.ptr;
+            int type = *(int *) ptr;
+
+            if (type == CONTROL_LISTEN || type == CONTROL_CLIENT) {
+                continue;
+            } else if (sess_endpoint_type (ptr) == SESS_RTP) {
+                prof_begin (profiler, PROF_RECEIVE);
+                prof_end (profiler, PROF_RECEIVE, sess_receive_rtp (sess_from_endpoint (ptr)));
+            } else {
+                sess_receive_rtcp (sess_from_endpoint (ptr));
+            }
+        }
+        for (i = 0; i < ready; i++) {
+            void *ptr = events[i].data.ptr;
+            int type = *(int *) ptr;
+
+            if (type == CONTROL_LISTEN) {
+                _controlAccept (ptr);
+            } else if (type == CONTROL_CLIENT) {
+                _controlClient (ptr);
+            }
+        }
+
+    }
+
+    printf ("\naudiocServer was requested to finish, closing %d sessions\n", numberOfSessions);
+    for (index = 0; index < numberOfSessions; index++) {
+        char line[512];
+        sess_describe (sessions[index], line, sizeof (line));
+        printf ("%s", line);
+        sess_destroy (sessions[index]);
+    }
+    free (sessions);
+    twheel_destroy (wheel);
+    if (profiler != NULL) {
+        prof_print (profiler);
+        prof_destroy (profiler);
+    }
+    close (listener.sockId);
+    unlink (controlPath);
+    close (epollId);
+    return 0;
+}
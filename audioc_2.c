@@ -18,7 +18,31 @@ RATE sampling rate in Hz
 
 default values:  8 bits, vol 90, sampling rate 8000, 1 channel, 4096 bytes per block 
 
-gcc -Wall -Wextra -o audioc_2 audiocArgs.c circularBuffer.c configureSndcard.c easyUDPSockets_2.c audioc_2.c
+gcc -Wall -Wextra -o audioc_2 audiocArgs.c circularBuffer.c configureSndcard.c easyUDPSockets.c payloadTable.c sampleConvert.c reframer.c alignedMemory.c payloadSwitch.c rtpSource.c jitterBuffer.c shardedReceiver.c gainControl.c srtp.c pacer.c stageProfiler.c asyncLog.c rtpFilter.c audioc_2.c -lpthread -lm
+
+Received audio is played, and also stored in a file.
+The soundcard is configured once (see PSW_DEVICE_* in payloadSwitch.h): when the
+payload type of the packets received changes, the new payload is played without
+reopening it.
+The volume -v is a digital gain applied to the audio received (VOL / 100), not
+the mixer of the soundcard; -g adds automatic gain control (see gainControl.h).
+With -KKEY, only SRTP packets (see srtp.h) authenticated with that key are
+played; add -maes -msha -msse4.1 to the compilation to use the instructions of
+the CPU for AES and SHA-1.
+With -SSOURCE (repeated for more sources), only the packets sent by those
+sources are received (source-specific multicast); with -XSOURCE, every source
+but those. The filter is applied by the kernel, see easyUDPSockets.h. -GGROUP
+(repeated) receives other groups, with the same port, in the same socket.
+Datagrams which are not RTP version 2 with a payload type of the table are
+dropped by the kernel (see rtpFilter.h), and so are the SSRCs not given with
+-ASSRC (repeated), or the ones given with -DSSRC.
+With -wWORKERS, reception is done by WORKERS threads (see shardedReceiver.h) instead of 
+playing the received data.
+With -C, the cost per packet of reception, decoding and playout is measured with
+the performance counters (see stageProfiler.h), and printed on SIGUSR2
+(kill -USR2 PID) and at the end. Not with -w.
+Messages of the receiving loop are written by a background thread (see asyncLog.h);
+with -c, a dot is shown for each fragment played.
 */
 
 #include <stdbool.h>
@@ -33,7 +57,17 @@ gcc -Wall -Wextra -o audioc_2 audiocArgs.c circularBuffer.c configureSndcard.c e
 #include "audiocArgs.h"
 #include "circularBuffer.h"
 #include "configureSndcard.h"
-#include "easyUDPSockets_2.h"
+#include "easyUDPSockets.h"
+#include "shardedReceiver.h"
+#include "payloadTable.h"
+#include "reframer.h"
+#include "payloadSwitch.h"
+#include "gainControl.h"
+#include "srtp.h"
+#include "pacer.h"
+#include "stageProfiler.h"
+#include "asyncLog.h"
+#include "rtpFilter.h"
 
 void record (int descSnd, const char *fileName, int fragmentSize);
 void play (int descSnd, const char *fileName, int fragmentSize);
@@ -41,47 +75,147 @@ void play (int descSnd, const char *fileName, int fragmentSize);
 
 const int BITS_PER_BYTE = 8;
 const float MILI_PER_SEC = 1000.0;
+#define SRTP_RECEIVER_STREAMS 16  /* SSRCs whose SRTP state receive keeps; a new one replaces the one used least recently */
 const char file_audio[] = "prueba.txt";
 
 /* only declare here variables which are used inside the signal handler */
 char *buf = NULL;
 char *fileName = NULL;     /* Memory is allocated by audioSimpleArgs, remember to free it */
-
-/* activated by Ctrl-C */
+unsigned char *packet = NULL;
+struct easySocket *rtpSocket = NULL;
+void *reframer = NULL;
+void *payloadSwitch = NULL;
+void *receiver = NULL;     /* sharded receiver, when -w is used */
+void *gain = NULL;
+void *srtp = NULL;
+void *profiler = NULL;     /* with -C */
+volatile sig_atomic_t finishRequested = 0;
+volatile sig_atomic_t profileRequested = 0;
+
+/* activated by Ctrl-C: the loops call finish (receiveSharded stops the workers), out of the signal handler */
 void signalHandler (int sigNum __attribute__ ((unused)))  /* __attribute__ ((unused))   -> this indicates gcc not to show an 'unused parameter' warning about sigNum: is not used, but the function must be declared with this parameter */
 {
+    finishRequested = 1;
+}
+
+/* Frees everything and exits, after Ctrl-C */
+void finish(void)
+{
+    alog_stop();
     printf ("\naudioSimple was requested to finish\n");
     if (buf) free(buf);
     if (fileName) free(fileName);
+    if (packet) free(packet);
+    if (reframer) refr_destroy(reframer);
+    if (payloadSwitch) psw_destroy(payloadSwitch);
+    if (gain) gain_destroy(gain);
+    if (srtp) srtp_destroy(srtp);
+    if (rtpSocket) easy_close(rtpSocket);
+    if (profiler) { prof_print(profiler); prof_destroy(profiler); }
     exit (0);
 }
 
+/* activated by SIGUSR2: the stage costs are printed by receive */
+void profileHandler (int sigNum __attribute__ ((unused)))
+{
+    profileRequested = 1;
+}
+
 
-void receive(int fragmentSize){
+/* Plays the audio of each RTP packet received, obtained by the payload
+ * switch (starting with 'payload', and following the payload type of the
+ * packets), in fragments of 'fragmentSize' bytes, whatever the packet
+ * duration is. The audio decoded is multiplied by vol / 100 (and
+ * options->agc) before it is played. With options->srtp, packets which are
+ * not authenticated are discarded. With options->profile, the cost of each
+ * stage is measured (see stageProfiler.h). Packets are received from options->group:port,
+ * with the socket options of options->socket. The fragments played are also stored in file_audio */
+void receive(int descSnd, int fragmentSize, int payload, int packetDuration, int port, int vol, const struct audiocOptions *options){
 
     int file;
     int bytesRead;
+    int length;
+    int audioLength;
+    unsigned char *fragment;
 
-    if(easy_init_2() < 0){
-        printf("easy_init_2");
+    if ((rtpSocket = easy_open(options->group, port, EASY_RECEIVE, &options->socket)) == NULL) {
         exit(1);
     }
+    /* only RTP of the payload table, and the SSRCs of -A / -D, are queued in the socket */
+    {
+        void *filter = rflt_create();
+        if (filter == NULL || rflt_set_ssrcs(filter, options->ssrcFilter, options->ssrc, options->ssrcs) < 0
+                || rflt_attach(filter, easy_fd(rtpSocket)) < 0) {
+            exit(1);
+        }
+        rflt_destroy(filter);
+    }
 
-    buf = malloc (fragmentSize);
+    packet = malloc (MAXBUF);
+    payloadSwitch = psw_create (payload, packetDuration, MAXBUF, options->memFlags);
+    if (payloadSwitch == NULL) {
+        exit (1);
+    }
+    reframer = refr_create (psw_max_device_bytes (payloadSwitch), fragmentSize, options->memFlags);
+    if (packet == NULL || reframer == NULL) {
+        printf("Could not reserve memory for audio data.\n");
+        exit (1);
+    }
+    gain = gain_create (PSW_DEVICE_RATE, PSW_DEVICE_CHANNELS, GAIN_LOOK_AHEAD_MS, options->memFlags);
+    if (gain == NULL) {
+        exit (1);
+    }
+    gain_set (gain, vol / 100.0f);
+    gain_agc (gain, options->agc);
+    if (options->srtp && (srtp = srtp_create (options->srtpMaster, SRTP_RECEIVER_STREAMS)) == NULL) {
+        exit (1);
+    }
 
     /* opens file for writing */
     if ((file = open  (file_audio, O_CREAT | O_WRONLY | O_TRUNC, S_IRWXU)) < 0) {
         printf("Error creating file for writing, error: %s", strerror(errno));
         exit(1);
     }
+    if (options->profile && (profiler = prof_create()) == NULL) {
+        exit(1);
+    }
 
     while (1) 
     { /* until Ctrl-C */
-        if(easy_receive_2(buf) < 0){
-            printf("easy_receive_2");
+        if (profileRequested && profiler != NULL) {
+            profileRequested = 0;
+            prof_print(profiler);
+        }
+        prof_begin(profiler, PROF_RECEIVE);
+        if((length = easy_receive(rtpSocket, packet, MAXBUF)) < 0){
+            if (finishRequested)
+                finish();
             exit(1);
         }
-        bytesRead = write (file, buf, fragmentSize);
+        if (srtp != NULL && (length = srtp_unprotect(srtp, packet, length)) < 0) {
+            prof_end(profiler, PROF_RECEIVE, 0);
+            continue; /* not authenticated, or replayed */
+        }
+        prof_end(profiler, PROF_RECEIVE, 1);
+        prof_begin(profiler, PROF_DECODE);
+        if ((audioLength = psw_depacketize(payloadSwitch, refr_pointer_to_write(reframer), packet, length)) < 0) {
+            prof_end(profiler, PROF_DECODE, 0);
+            continue; /* not RTP, or unknown payload */
+        }
+        gain_process(gain, (int16_t *) refr_pointer_to_write(reframer), audioLength / (PSW_DEVICE_CHANNELS * PSW_DEVICE_BYTES_PER_SAMPLE));
+        refr_written(reframer, audioLength);
+        prof_end(profiler, PROF_DECODE, 1);
+
+        /* all the complete fragments are played, so there is always room for the next packet */
+        while ((fragment = refr_pointer_to_read(reframer)) != NULL) {
+            prof_begin(profiler, PROF_PLAYOUT);
+            bytesRead = write (descSnd, fragment, fragmentSize);
+            prof_end(profiler, PROF_PLAYOUT, 1);
+            if (bytesRead != fragmentSize)
+                alog (ALOG_WARNING, "Played a different number of bytes than expected (played %lld bytes, expected %lld)\n", bytesRead, fragmentSize, 0);
+            alog (ALOG_DEBUG, ".", 0, 0, 0);
+            bytesRead = write (file, fragment, fragmentSize);
+        }
         // if (bytesRead!= fragmentSize){
         //     printf("Written in file a different number of bytes than expected"); 
         //     exit(1);
@@ -92,6 +226,41 @@ void receive(int fragmentSize){
 }
 
 
+/* Receives with options->workers threads until Ctrl-C, then prints the statistics of each worker */
+void receiveSharded(int multicastIp, int port, const struct audiocOptions *options, int rate, int numberOfBlocks, int fragmentSize){
+
+    struct in_addr group;
+    group.s_addr = multicastIp;
+
+    /* the workers have their own IPv4 sockets */
+    if (multicastIp == 0) {
+        printf("%s: -w only receives IPv4 groups\n", options->group);
+        exit(1);
+    }
+    if (options->socket.filter != EASY_ANY_SOURCE || options->socket.groups > 0 || options->ssrcFilter != RFLT_ANY_SSRC) {
+        printf("-w receives one group from any source: -S, -X, -G, -A and -D cannot be used\n");
+        exit(1);
+    }
+
+    receiver = shard_start(group, port, options->workers, options->steerBySsrc, rate, numberOfBlocks, fragmentSize, options->memFlags,
+            options->srtp ? options->srtpMaster : NULL);
+    if (receiver == NULL) {
+        printf("shard_start");
+        exit(1);
+    }
+    printf("Receiving with %d workers%s\n", options->workers, options->steerBySsrc ? ", steering by SSRC" : "");
+
+    while (!finishRequested) {
+        pause(); /* until Ctrl-C */
+    }
+
+    shard_stop(receiver);
+    shard_print_stats(receiver);
+    shard_destroy(receiver);
+    finish();
+}
+
+
 void main(int argc, char *argv[])
 {
     struct sigaction sigInfo; /* signal conf */
@@ -107,6 +276,7 @@ void main(int argc, char *argv[])
     // int audioSimpleOperation;       /* record, play */
     int descriptorSnd;
     int requestedFragmentSize;
+    int frameSize;      /* bytes of packetDuration ms of audio, in the soundcard format */
 
     /****************************************
     new variables
@@ -126,7 +296,9 @@ void main(int argc, char *argv[])
                                */
     int bufferingTime;  /* Returns the buffering time requested before starting playout.
                                Time measured in ms. */
+    struct audiocOptions options; /* Returns the additional options */
 
+    const struct payloadDesc *desc;
     int numberOfBlocks;
 
     float aux1;
@@ -140,6 +312,12 @@ void main(int argc, char *argv[])
         printf("Error installing signal, error: %s", strerror(errno)); 
         exit(1);
     }
+    sigInfo.sa_handler = profileHandler;
+    sigInfo.sa_flags = SA_RESTART;   /* the socket keeps waiting */
+    if ((sigaction (SIGUSR2, &sigInfo, NULL)) < 0) {
+        printf("Error installing signal, error: %s", strerror(errno)); 
+        exit(1);
+    }
 
     /****************************************
     old capture args
@@ -158,27 +336,27 @@ void main(int argc, char *argv[])
      ***************************************/
 
     /* obtain values from the command line - or default values otherwise */
-    if (-1 == args_capture_audioc(argc, argv, &multicastIp, &ssrc, 
-            &port, &vol, &packetDuration, &verbose, &payload, &bufferingTime))
+    if (EXIT_FAILURE == args_capture_audioc(argc, argv, (struct in_addr *) &multicastIp, &ssrc, 
+            &port, &vol, &packetDuration, &verbose, &payload, &bufferingTime, &options))
     { exit(1);  /* there was an error parsing the arguments, the error type 
                    is printed by the args_capture function */
     };
+    /* messages of the hot loops; -c adds the ones of each fragment */
+    alog_start(verbose ? ALOG_DEBUG : ALOG_INFO, STDOUT_FILENO);
 
     /****************************************
     get BITS_PER_BYTE, channelNumber, rate, requestedFragmentSize
      ***************************************/
-    channelNumber = 1;
-
-    if(payload == PCMU){
-        rate = 8000;
-        sndCardFormat = U8;
-    }else if(payload == L16_1){
-        rate = 44100;
-        sndCardFormat = S16_LE;
+    if ((desc = payload_lookup(payload)) == NULL) {
+        printf("Unrecognized payload number %d\n", payload);
+        exit(1);
     }
-    aux1 = ((float) packetDuration / MILI_PER_SEC) * (float) rate;
-    aux2 = (channelNumber * sndCardFormat / BITS_PER_BYTE);
-    requestedFragmentSize = (int) aux1 * aux2;
+    /* the soundcard format does not depend on the payload, which can change */
+    channelNumber = PSW_DEVICE_CHANNELS;
+    rate = PSW_DEVICE_RATE;
+    sndCardFormat = PSW_DEVICE_FORMAT;
+    frameSize = psw_device_frame_bytes(packetDuration);
+    requestedFragmentSize = frameSize; /* the soundcard may configure a different one */
     // printf("%d\n", (int) aux1);
     // printf("%d\n", aux2);
     // printf("%d\n", requestedFragmentSize);
@@ -187,7 +365,6 @@ void main(int argc, char *argv[])
 
      * Also configures fragment size */
     configSndcard (&descriptorSnd, &sndCardFormat, &channelNumber, &rate, &requestedFragmentSize); 
-    vol = configVol (channelNumber, descriptorSnd, vol);
     printf("%d\n", requestedFragmentSize);
 
     /****************************************
@@ -197,7 +374,7 @@ void main(int argc, char *argv[])
     aux1 = ((float) bufferingTime / MILI_PER_SEC) * (float) rate;
     aux2 = (channelNumber * sndCardFormat / BITS_PER_BYTE);
     int buffer_size_bytes = (int) aux1 * aux2;
-    numberOfBlocks = (int)((float) buffer_size_bytes / (float) requestedFragmentSize);
+    numberOfBlocks = (int)((float) buffer_size_bytes / (float) frameSize);
     printf("%d\n", numberOfBlocks);
 
     /****************************************
@@ -234,10 +411,14 @@ void main(int argc, char *argv[])
     //void * buffer = cbuf_create_buffer (numberOfBlocks, requestedFragmentSize);
 
     /****************************************
-    receive and store in file
+    receive, play and store in file
      ***************************************/
 
-    receive(requestedFragmentSize);
+    if (options.workers > 0) {
+        /* jitter buffers store payloads as received, of any payload of the table */
+        receiveSharded(multicastIp, port, &options, desc->rate, numberOfBlocks, payload_max_frame_payload_bytes(packetDuration));
+    }
+    receive(descriptorSnd, requestedFragmentSize, payload, packetDuration, port, vol, &options);
 
 
 
@@ -278,9 +459,11 @@ void record (int descSnd, const char * fileName, int fragmentSize)
     while (1) 
     { /* until Ctrl-C */
         bytesRead = read (descSnd, buf, fragmentSize); 
+        if (finishRequested)
+            finish();
         if (bytesRead!= fragmentSize)
-            printf ("Recorded a different number of bytes than expected (recorded %d bytes, expected %d)\n", bytesRead, fragmentSize);
-        printf (".");fflush (stdout);
+            alog (ALOG_WARNING, "Recorded a different number of bytes than expected (recorded %lld bytes, expected %lld)\n", bytesRead, fragmentSize, 0);
+        alog (ALOG_DEBUG, ".", 0, 0, 0);
 
         bytesRead = write (file, buf, fragmentSize);
         if (bytesRead!= fragmentSize)
@@ -289,18 +472,28 @@ void record (int descSnd, const char * fileName, int fragmentSize)
 }
 
 /* This function opens an existing file 'fileName'. It reads 'fragmentSize'
- * bytes and sends them to the soundcard, for playback
+ * bytes and sends them to the soundcard, for playback, each one at the time
+ * given by the audio before it (the file is in the PSW_DEVICE_* format), so
+ * that a descriptor which does not block (e.g. a file or a pipe) does not
+ * get the whole file at once. The send-time error is printed at the end.
  * If an error is found in the configuration of the soundcard, the process 
  * is stopped and an error message reported. */
 void play (int descSnd, const char * fileName, int fragmentSize)
 {
     int file;
     int bytesRead;
+    void *pacer;
+    uint32_t frames = 0;
 
     /* Creates buffer to store the audio data */
     buf = malloc (fragmentSize); 
     if (buf == NULL) { printf("Could not reserve memory for audio data.\n"); exit (1); /* very unusual case */ }
 
+    /* a stall of more than 200 ms restarts the schedule instead of bursting */
+    if ((pacer = pace_create (PSW_DEVICE_RATE, 200)) == NULL) {
+        exit (1);
+    }
+
     /* opens file in read-only mode */
     if ((file = open (fileName, O_RDONLY)) < 0) {
         printf("File could not be opened, error %s", strerror(errno));
@@ -317,8 +510,18 @@ void play (int descSnd, const char * fileName, int fragmentSize)
         if (bytesRead != fragmentSize)
             break; /* reached end of file */
 
+        while (pace_wait (pacer, frames) < 0) {
+            /* interrupted by a signal */
+            if (finishRequested)
+                finish();
+        }
+        frames += fragmentSize / (PSW_DEVICE_CHANNELS * PSW_DEVICE_BYTES_PER_SAMPLE);
+
         bytesRead = write (descSnd, buf, fragmentSize); 
         if (bytesRead!= fragmentSize)
-            printf ("Played a different number of bytes than expected (recorded %d bytes, expected %d)\n", bytesRead, fragmentSize);
+            alog (ALOG_WARNING, "Played a different number of bytes than expected (recorded %lld bytes, expected %lld)\n", bytesRead, fragmentSize, 0);
     }
+    pace_print (pacer, "Playback");
+    pace_destroy (pacer);
+    close (file);
 };
@@ -8,21 +8,35 @@
 #include <sys/types.h>
 
 #include "circularBuffer.h"
+#include "alignedMemory.h"
+
+/* blocks start after a header of AMEM_ALIGN bytes, so they are aligned */
+#define CBUF_HEADER AMEM_ALIGN
+
+/* address of block 'index' */
+#define CBUF_BLOCK(buffer, index) ((buffer) + CBUF_HEADER + (index) * (*(int *) ((buffer) + 5 * sizeof (int))))
 
 
 void *cbuf_create_buffer (int numberOfBlocks, int blockSize)
+{
+    return cbuf_create_aligned (numberOfBlocks, blockSize, AMEM_DEFAULT);
+}
+
+
+void *cbuf_create_aligned (int numberOfBlocks, int blockSize, int flags)
 {
     void *buffer;
     int *pointerToInt;
 
-    /* Reserve space for 5 integers at the beginning, to store 
+    /* Reserve a header at the beginning, with 6 integers to store 
        - number of blocks of the buffer
        - size of each block
        - index (0 to [numberOfBlocks - 1]) pointing to the first spare block
        - index pointing to the first full block
-       - number of filled blocks  */
+       - number of filled blocks
+       - distance between blocks: the size rounded up to AMEM_ALIGN  */
 
-    if ( (buffer= malloc (numberOfBlocks * blockSize  + 5 * sizeof (int)) )== NULL) 
+    if ( (buffer= amem_alloc (numberOfBlocks * AMEM_ROUND (blockSize) + CBUF_HEADER, flags) )== NULL) 
     {
         printf ("Error reserving memory in circularBuffer\n");
         return (NULL);
@@ -36,6 +50,7 @@ void *cbuf_create_buffer (int numberOfBlocks, int blockSize)
     *(pointerToInt + 2) = 0; 
     *(pointerToInt + 3) = 0; 
     *(pointerToInt + 4) = 0; 
+    *(pointerToInt + 5) = AMEM_ROUND (blockSize); 
 
     return buffer;
 }
@@ -43,17 +58,16 @@ void *cbuf_create_buffer (int numberOfBlocks, int blockSize)
 
 void *cbuf_pointer_to_write(void * buffer)
 {
-    int *ptrNextFreeBlock, *ptrBlockNumber, *ptrBlockSize; 
+    int *ptrNextFreeBlock, *ptrBlockNumber; 
     int *ptrFullBlockNmb;
     int *returnPtr;
 
     ptrBlockNumber = (int *) buffer;
-    ptrBlockSize = (int *) (buffer + 1 * sizeof (int));
     ptrNextFreeBlock = (int *) (buffer + 2 * sizeof (int));
     /* ptrNextFullBlock is not used */
     ptrFullBlockNmb = (int *) (buffer + 4 * sizeof (int));
 
-    returnPtr = buffer + 5 * sizeof (int) + (* ptrNextFreeBlock) * (* ptrBlockSize);
+    returnPtr = CBUF_BLOCK (buffer, * ptrNextFreeBlock);
 
     if ( (*ptrFullBlockNmb) == (* ptrBlockNumber) )
     { /* buffer is full*/
@@ -81,17 +95,16 @@ int cbuf_has_block (void *buffer)
 
 void *cbuf_pointer_to_read(void *buffer)
 {
-    int *ptrNextFullBlock, *ptrBlockNumber, *ptrBlockSize; 
+    int *ptrNextFullBlock, *ptrBlockNumber; 
     int *ptrFullBlockNmb;
     int *returnPtr;
 
     ptrBlockNumber = (int *) buffer;
-    ptrBlockSize = (int *) (buffer + 1 * sizeof (int));
     /* ptrNextFreeBlock is not used */
     ptrNextFullBlock = (int *) (buffer + 3 * sizeof (int));
     ptrFullBlockNmb = (int *) (buffer + 4 * sizeof (int));
 
-    returnPtr = buffer + 5 * sizeof (int) + (* ptrNextFullBlock) * (* ptrBlockSize);
+    returnPtr = CBUF_BLOCK (buffer, * ptrNextFullBlock);
 
     if ( (*ptrFullBlockNmb) == 0)
     { /* circular buffer is empty */
@@ -106,9 +119,97 @@ void *cbuf_pointer_to_read(void *buffer)
 }
 
 
+/* Fills 'span' with up to 'maxBlocks' blocks from index 'first', 'available' blocks at most */
+static int _cbuf_span (void *buffer, int first, int available, int maxBlocks, struct cbuf_span *span)
+{
+    int blockNumber = *((int *) buffer);
+    int count = (available < maxBlocks) ? available : maxBlocks;
+
+    if (count < 0) {
+        count = 0;
+    }
+    span->segment[0] = span->segment[1] = NULL;
+    span->blocks[0] = span->blocks[1] = 0;
+    span->stride = *((int *) (buffer + 5 * sizeof (int)));
+    if (count == 0) {
+        return 0;
+    }
+    span->segment[0] = CBUF_BLOCK (buffer, first);
+    if (first + count <= blockNumber) {
+        span->blocks[0] = count;
+    } else { /* wraps around the end of the buffer */
+        span->blocks[0] = blockNumber - first;
+        span->segment[1] = CBUF_BLOCK (buffer, 0);
+        span->blocks[1] = count - span->blocks[0];
+    }
+    return count;
+}
+
+
+int cbuf_peek_write (void *buffer, int maxBlocks, struct cbuf_span *span)
+{
+    int *ptrBlockNumber = (int *) buffer;
+    int *ptrNextFreeBlock = (int *) (buffer + 2 * sizeof (int));
+    int *ptrFullBlockNmb = (int *) (buffer + 4 * sizeof (int));
+
+    return _cbuf_span (buffer, *ptrNextFreeBlock, (*ptrBlockNumber) - (*ptrFullBlockNmb), maxBlocks, span);
+}
+
+
+int cbuf_commit_write (void *buffer, int blocks)
+{
+    int *ptrBlockNumber = (int *) buffer;
+    int *ptrNextFreeBlock = (int *) (buffer + 2 * sizeof (int));
+    int *ptrFullBlockNmb = (int *) (buffer + 4 * sizeof (int));
+
+    if (blocks > (*ptrBlockNumber) - (*ptrFullBlockNmb)) {
+        blocks = (*ptrBlockNumber) - (*ptrFullBlockNmb);
+    }
+    if (blocks <= 0) {
+        return 0;
+    }
+    (* ptrNextFreeBlock) = ((* ptrNextFreeBlock) + blocks) % (* ptrBlockNumber);
+    (*ptrFullBlockNmb) = (*ptrFullBlockNmb) + blocks;
+    return blocks;
+}
+
+
+int cbuf_peek_read (void *buffer, int maxBlocks, struct cbuf_span *span)
+{
+    int *ptrNextFullBlock = (int *) (buffer + 3 * sizeof (int));
+    int *ptrFullBlockNmb = (int *) (buffer + 4 * sizeof (int));
+
+    return _cbuf_span (buffer, *ptrNextFullBlock, *ptrFullBlockNmb, maxBlocks, span);
+}
+
+
+int cbuf_commit_read (void *buffer, int blocks)
+{
+    int *ptrBlockNumber = (int *) buffer;
+    int *ptrNextFullBlock = (int *) (buffer + 3 * sizeof (int));
+    int *ptrFullBlockNmb = (int *) (buffer + 4 * sizeof (int));
+
+    if (blocks > (*ptrFullBlockNmb)) {
+        blocks = (*ptrFullBlockNmb);
+    }
+    if (blocks <= 0) {
+        return 0;
+    }
+    (* ptrNextFullBlock) = ((* ptrNextFullBlock) + blocks) % (* ptrBlockNumber);
+    (*ptrFullBlockNmb) = (*ptrFullBlockNmb) - blocks;
+    return blocks;
+}
+
+
+int cbuf_block_size (void *buffer)
+{
+    return *((int *) (buffer + 1 * sizeof (int)));
+}
+
+
 void cbuf_destroy_buffer (void *buffer)
 {
-    free (buffer);
+    amem_free (buffer);
 }
 
 
@@ -117,9 +218,11 @@ void cbuf_destroy_buffer (void *buffer)
 
 /* #include "circularBuffer.h" 
 void _cbuf_test_buffer(void);  
+void _cbuf_test_spans(void);
 void main (void) 
 {
     _cbuf_test_buffer();
+    _cbuf_test_spans();
 } */
 
 
@@ -216,3 +319,100 @@ void _cbuf_test_buffer(void)
 
     printf("Tests PASSED (number of tests: %d)\n", tests);
 }
+
+/* TEST vectors for the span functions (peek/commit).
+ * Written blocks are filled with consecutive integers, which are checked when read */
+void _cbuf_test_spans(void) 
+{
+    enum test_vector_pos {OPERATION, ARGUMENT, RETURN, FIRST_SEGMENT, FIRST_INDEX}; /* Test vector components */
+    enum operations {PEEK_WRITE, COMMIT_WRITE, PEEK_READ, COMMIT_READ};
+
+    int buffer_blocks = 5; /* test_vector2 assumes that buffer_blocks=5 */
+    int test_vector2[][5] = {
+        /* Each line contains 
+         *  Operation to execute, 
+         *  maxBlocks (PEEK) or blocks (COMMIT) argument, 
+         *  Expected return value, 
+         *  Expected blocks in the first segment (PEEK; the rest must be in the second one), 
+         *  Expected index of the first block (PEEK with blocks) */
+        {PEEK_READ,    4, 0, 0, 0}, /* buffer empty */
+        {COMMIT_READ,  1, 0, 0, 0}, /* nothing to commit */
+        {PEEK_WRITE,   3, 3, 3, 0},
+        {COMMIT_WRITE, 2, 2, 0, 0}, /* only 2 of the 3 blocks peeked are used */
+        {PEEK_WRITE,  10, 3, 3, 2}, /* 3 empty blocks remain */
+        {COMMIT_WRITE, 3, 3, 0, 0}, /* buffer full */
+        {PEEK_WRITE,   1, 0, 0, 0},
+        {COMMIT_WRITE, 1, 0, 0, 0},
+        {PEEK_READ,    3, 3, 3, 0},
+        {COMMIT_READ,  3, 3, 0, 0},
+        {PEEK_WRITE,   5, 3, 3, 0}, /* 3 empty blocks, wrapping around: 0, 1, 2 */
+        {COMMIT_WRITE, 2, 2, 0, 0},
+        {PEEK_READ,    5, 4, 2, 3}, /* blocks 3, 4 and then 0, 1 */
+        {COMMIT_READ,  1, 1, 0, 0},
+        {PEEK_READ,    5, 3, 1, 4}, /* block 4 and then 0, 1 */
+        {COMMIT_READ, 10, 3, 0, 0}, /* commit is limited to the blocks with data */
+        {PEEK_READ,    5, 0, 0, 0}, /* buffer empty */
+        {PEEK_WRITE,   5, 5, 3, 2}, /* blocks 2, 3, 4 and then 0, 1 */
+        /* you can add more tests here */
+    };
+
+    void *buffer;
+    struct cbuf_span span = {0};
+    int written = 0, read = 0; /* integers written/read */
+    int result, segment, block;
+    buffer = cbuf_create_buffer(buffer_blocks, sizeof(int));
+
+    int tests = sizeof(test_vector2)/(5*sizeof(int)); /* number of tests in test_vector2) */
+
+    int test; /* current test number */    
+    for (test=0; test < tests; test++) {
+        int *line = test_vector2[test];
+        int peek = (line[OPERATION] == PEEK_WRITE || line[OPERATION] == PEEK_READ);
+
+        switch (line[OPERATION]) {
+            case PEEK_WRITE: result = cbuf_peek_write(buffer, line[ARGUMENT], &span); break;
+            case PEEK_READ: result = cbuf_peek_read(buffer, line[ARGUMENT], &span); break;
+            case COMMIT_WRITE:
+                /* fills the blocks of the last span before committing them */
+                for (block = 0; block < line[ARGUMENT] && block < span.blocks[0] + span.blocks[1]; block++) {
+                    segment = (block < span.blocks[0]) ? 0 : 1;
+                    *(int *) (span.segment[segment] + (block - segment * span.blocks[0]) * span.stride) = written + block;
+                }
+                result = cbuf_commit_write(buffer, line[ARGUMENT]);
+                written += result;
+                break;
+            default:
+                result = cbuf_commit_read(buffer, line[ARGUMENT]);
+                read += result;
+                break;
+        }
+
+        if (result != line[RETURN]) {
+            printf("_cbuf_test_spans RETURN error at test number %d; expected %d, returned %d\n", test, line[RETURN], result);
+            cbuf_destroy_buffer(buffer);
+            exit(1);
+        }
+        if (!peek) {
+            continue;
+        }
+        if (span.blocks[0] != line[FIRST_SEGMENT] || span.blocks[0] + span.blocks[1] != result
+                || (result > 0 && span.segment[0] != CBUF_BLOCK (buffer, line[FIRST_INDEX]))
+                || (span.blocks[1] > 0 && span.segment[1] != CBUF_BLOCK (buffer, 0))) {
+            printf("_cbuf_test_spans SPAN error at test number %d\n", test);
+            cbuf_destroy_buffer(buffer);
+            exit(1);
+        }
+        /* data peeked for reading must be the next integers written */
+        for (block = 0; line[OPERATION] == PEEK_READ && block < result; block++) {
+            segment = (block < span.blocks[0]) ? 0 : 1;
+            if (*(int *) (span.segment[segment] + (block - segment * span.blocks[0]) * span.stride) != read + block) {
+                printf("_cbuf_test_spans DATA error at test number %d\n", test);
+                cbuf_destroy_buffer(buffer);
+                exit(1);
+            }
+        }
+    }
+    cbuf_destroy_buffer(buffer);
+
+    printf("Span tests PASSED (number of tests: %d)\n", tests);
+}
@@ -24,6 +24,12 @@ void *cbuf_create_buffer (
         );
 
 
+/* Same as cbuf_create_buffer, with the allocation options of 'flags' (see
+ * enum amem_flags in alignedMemory.h): prefaulted, locked, huge pages.
+ * In both functions each block starts at an AMEM_ALIGN-byte boundary. */
+void *cbuf_create_aligned (int numberOfBlocks, int blockSize, int flags);
+
+
 /* Takes buffer pointer created by cbuf_create_buffer.
  * Returns a pointer to the first ("empty") available block to write on it, 
  * or NULL if there are no blocks (be sure that this 
@@ -47,6 +53,47 @@ void *cbuf_pointer_to_read (void *buffer);
 int cbuf_has_block (void *buffer);
 
 
+/* Consecutive blocks of the buffer, as returned by cbuf_peek_write and
+ * cbuf_peek_read: 'blocks[0]' blocks starting at 'segment[0]', followed (when
+ * they wrap around the end of the buffer) by 'blocks[1]' blocks starting at
+ * 'segment[1]'. Unused segments have NULL and 0 blocks.
+ * In a segment, block i starts at segment + i * stride; stride is the block
+ * size rounded up to the block alignment. */
+struct cbuf_span {
+    void *segment[2];
+    int blocks[2];
+    int stride;
+};
+
+
+/* Takes buffer pointer created by cbuf_create_buffer.
+ * Describes in 'span' up to 'maxBlocks' empty blocks, in order, to write on
+ * them (e.g. with one readv or recvmmsg). Returns the number of blocks in 'span'.
+ * It DOES NOT move the pointer; cbuf_commit_write does. */
+int cbuf_peek_write (void *buffer, int maxBlocks, struct cbuf_span *span);
+
+
+/* Marks as written the first 'blocks' blocks returned by the last cbuf_peek_write.
+ * Returns the number of blocks committed (never more than the empty blocks). */
+int cbuf_commit_write (void *buffer, int blocks);
+
+
+/* Takes buffer pointer created by cbuf_create_buffer.
+ * Describes in 'span' up to 'maxBlocks' blocks with data, in order, to read
+ * them (e.g. with one writev or sendmmsg). Returns the number of blocks in 'span'.
+ * It DOES NOT move the pointer; cbuf_commit_read does. */
+int cbuf_peek_read (void *buffer, int maxBlocks, struct cbuf_span *span);
+
+
+/* Marks as read the first 'blocks' blocks returned by the last cbuf_peek_read.
+ * Returns the number of blocks committed (never more than the blocks with data). */
+int cbuf_commit_read (void *buffer, int blocks);
+
+
+/* Returns the size in bytes of each block, as requested in cbuf_create_buffer */
+int cbuf_block_size (void *buffer);
+
+
 /* Frees memory of the buffer. 
  * Must be executed before exiting from the process */
 void cbuf_destroy_buffer (void *buffer);
@@ -0,0 +1,344 @@
+/*******************************************************/
+/* easyUDPSockets.c */
+/*******************************************************/
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "easyUDPSockets.h"
+
+struct easySocket {
+    int sockId;
+    int family;                 /* AF_INET or AF_INET6 */
+    unsigned int ifindex;       /* 0: any interface */
+    struct sockaddr_storage group;          /* destination of easy_send */
+    socklen_t groupLength;
+    struct sockaddr_storage lastSender;     /* source of the last datagram, for easy_reply */
+    socklen_t lastSenderLength;
+};
+
+
+/*=====================================================================*/
+/* Sets the buffer 'option' (SO_RCVBUF or SO_SNDBUF) to 'bytes', forcing it over the system limit if allowed */
+static void _setBuffer (int sockId, int option, int forceOption, int bytes, const char *name)
+{
+    int obtained;
+    socklen_t length = sizeof (obtained);
+
+    if (bytes <= 0) {
+        return;
+    }
+    if (setsockopt (sockId, SOL_SOCKET, forceOption, &bytes, sizeof (bytes)) < 0
+            && setsockopt (sockId, SOL_SOCKET, option, &bytes, sizeof (bytes)) < 0) {
+        printf ("setsockopt(%s) failed: %s\n", name, strerror (errno));
+        return;
+    }
+    /* the kernel reports twice the size requested (it includes its bookkeeping) */
+    if (getsockopt (sockId, SOL_SOCKET, option, &obtained, &length) == 0 && obtained / 2 < bytes) {
+        printf ("%s is %d bytes, lower than the %d requested (see /proc/sys/net/core/%s)\n",
+                name, obtained / 2, bytes, option == SO_RCVBUF ? "rmem_max" : "wmem_max");
+    }
+}
+
+
+/* Fills 'address' with the numeric 'text' of 'family' and 'port'. Returns 0, or -1 if it is not one */
+static int _address (const char *text, int family, int port, struct sockaddr_storage *address)
+{
+    memset (address, 0, sizeof (struct sockaddr_storage));
+    address->ss_family = family;
+    if (family == AF_INET) {
+        ((struct sockaddr_in *) address)->sin_port = htons (port);
+        return (inet_pton (AF_INET, text, &((struct sockaddr_in *) address)->sin_addr) == 1) ? 0 : -1;
+    }
+    ((struct sockaddr_in6 *) address)->sin6_port = htons (port);
+    return (inet_pton (AF_INET6, text, &((struct sockaddr_in6 *) address)->sin6_addr) == 1) ? 0 : -1;
+}
+
+
+/* Joins 'group' with the source filter of 'config' */
+static int _join (struct easySocket *s, const struct sockaddr_storage *group, const char *name, const struct easySocketConfig *config)
+{
+    int level = (s->family == AF_INET) ? IPPROTO_IP : IPPROTO_IPV6;
+    struct group_req groupReq;
+    struct group_source_req sourceReq;
+    int i;
+
+    /* exclude mode: the group, then a block per source; include mode: a join per source */
+    if (config->filter != EASY_INCLUDE) {
+        memset (&groupReq, 0, sizeof (groupReq));
+        groupReq.gr_interface = s->ifindex;
+        memcpy (&groupReq.gr_group, group, sizeof (struct sockaddr_storage));
+        if (setsockopt (s->sockId, level, MCAST_JOIN_GROUP, &groupReq, sizeof (groupReq)) < 0) {
+            printf ("setsockopt(MCAST_JOIN_GROUP) %s failed: %s\n", name, strerror (errno));
+            return -1;
+        }
+    }
+    for (i = 0; config->filter != EASY_ANY_SOURCE && i < config->sources; i++) {
+        memset (&sourceReq, 0, sizeof (sourceReq));
+        sourceReq.gsr_interface = s->ifindex;
+        memcpy (&sourceReq.gsr_group, group, sizeof (struct sockaddr_storage));
+        if (_address (config->source[i], s->family, 0, &sourceReq.gsr_source) < 0) {
+            printf ("Source %s is not an address of the family of %s\n", config->source[i], name);
+            return -1;
+        }
+        if (setsockopt (s->sockId, level, (config->filter == EASY_INCLUDE) ? MCAST_JOIN_SOURCE_GROUP : MCAST_BLOCK_SOURCE,
+                &sourceReq, sizeof (sourceReq)) < 0) {
+            printf ("setsockopt(%s) %s %s failed: %s\n", (config->filter == EASY_INCLUDE) ? "MCAST_JOIN_SOURCE_GROUP" : "MCAST_BLOCK_SOURCE",
+                    name, config->source[i], strerror (errno));
+            return -1;
+        }
+    }
+    return 0;
+}
+
+
+/* Joins the group of the socket and the ones of 'config' */
+static int _joinGroups (struct easySocket *s, const char *group, const struct easySocketConfig *config)
+{
+    struct sockaddr_storage other;
+    int i;
+
+    if (config->filter != EASY_ANY_SOURCE && (config->sources < 1 || config->sources > EASY_MAX_SOURCES)) {
+        printf ("Invalid source filter: %d sources\n", config->sources);
+        return -1;
+    }
+    if (_join (s, &s->group, group, config) < 0) {
+        return -1;
+    }
+    for (i = 0; i < config->groups && i < EASY_MAX_GROUPS; i++) {
+        if (_address (config->group[i], s->family, 0, &other) < 0) {
+            printf ("Group %s is not an address of the family of %s\n", config->group[i], group);
+            return -1;
+        }
+        if (s->family == AF_INET6) {
+            ((struct sockaddr_in6 *) &other)->sin6_scope_id = s->ifindex;
+        }
+        if (_join (s, &other, config->group[i], config) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+
+static int _configureIPv4 (struct easySocket *s, int mode, const struct easySocketConfig *config)
+{
+    struct sockaddr_in *group = (struct sockaddr_in *) &s->group;
+    struct ip_mreqn mreq;
+    unsigned char ttl = (unsigned char) config->ttl;
+    unsigned char loop = (unsigned char) config->loop;
+
+    memset (&mreq, 0, sizeof (mreq));
+    mreq.imr_multiaddr = group->sin_addr;
+    mreq.imr_address.s_addr = htonl (INADDR_ANY);
+    mreq.imr_ifindex = (int) s->ifindex;
+
+    if (mode & EASY_SEND) {
+        if (config->ttl > 0 && setsockopt (s->sockId, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof (ttl)) < 0) {
+            printf ("setsockopt(IP_MULTICAST_TTL) failed: %s\n", strerror (errno));
+            return -1;
+        }
+        if (setsockopt (s->sockId, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof (loop)) < 0) {
+            printf ("setsockopt(IP_MULTICAST_LOOP) failed: %s\n", strerror (errno));
+            return -1;
+        }
+        if (s->ifindex != 0 && setsockopt (s->sockId, IPPROTO_IP, IP_MULTICAST_IF, &mreq, sizeof (mreq)) < 0) {
+            printf ("setsockopt(IP_MULTICAST_IF) failed: %s\n", strerror (errno));
+            return -1;
+        }
+    }
+    return 0;
+}
+
+
+static int _configureIPv6 (struct easySocket *s, int mode, const struct easySocketConfig *config)
+{
+    unsigned int loop = (unsigned int) config->loop;
+
+    if (mode & EASY_SEND) {
+        if (config->ttl > 0 && setsockopt (s->sockId, IPPROTO_IPV6, IPV6_MULTICAST_HOPS, &config->ttl, sizeof (config->ttl)) < 0) {
+            printf ("setsockopt(IPV6_MULTICAST_HOPS) failed: %s\n", strerror (errno));
+            return -1;
+        }
+        if (setsockopt (s->sockId, IPPROTO_IPV6, IPV6_MULTICAST_LOOP, &loop, sizeof (loop)) < 0) {
+            printf ("setsockopt(IPV6_MULTICAST_LOOP) failed: %s\n", strerror (errno));
+            return -1;
+        }
+        if (s->ifindex != 0 && setsockopt (s->sockId, IPPROTO_IPV6, IPV6_MULTICAST_IF, &s->ifindex, sizeof (s->ifindex)) < 0) {
+            printf ("setsockopt(IPV6_MULTICAST_IF) failed: %s\n", strerror (errno));
+            return -1;
+        }
+    }
+    return 0;
+}
+
+
+/*=====================================================================*/
+void easy_default_config (struct easySocketConfig *config)
+{
+    memset (config, 0, sizeof (struct easySocketConfig));
+    config->loop = 1;
+}
+
+
+struct easySocket *easy_open (const char *group, int port, int mode, const struct easySocketConfig *config)
+{
+    struct easySocketConfig defaults;
+    struct easySocket *s;
+    struct sockaddr_storage local;
+    int enable = 1;
+    int wildcard;
+    int result;
+
+    if (config == NULL) {
+        easy_default_config (&defaults);
+        config = &defaults;
+    }
+    if (port <= 0 || port > 65535 || (mode & EASY_SEND_RECEIVE) == 0) {
+        printf ("Invalid socket parameters: port %d, mode %d\n", port, mode);
+        return NULL;
+    }
+    if ((s = calloc (1, sizeof (struct easySocket))) == NULL) {
+        printf ("Error reserving memory in easyUDPSockets\n");
+        return NULL;
+    }
+    s->sockId = -1;
+
+    /* group and local addresses: to receive one group, the socket is bound to it, so
+     * that it does not get the datagrams of other groups with the same port */
+    wildcard = !(mode & EASY_RECEIVE) || config->groups > 0;
+    if (_address (group, AF_INET, port, &s->group) == 0) {
+        struct sockaddr_in *g = (struct sockaddr_in *) &s->group;
+        s->family = AF_INET;
+        _address (wildcard ? "0.0.0.0" : group, AF_INET, port, &local);
+        s->groupLength = sizeof (struct sockaddr_in);
+        result = IN_MULTICAST (ntohl (g->sin_addr.s_addr));
+    } else if (_address (group, AF_INET6, port, &s->group) == 0) {
+        struct sockaddr_in6 *g = (struct sockaddr_in6 *) &s->group;
+        s->family = AF_INET6;
+        _address (wildcard ? "::" : group, AF_INET6, port, &local);
+        s->groupLength = sizeof (struct sockaddr_in6);
+        result = IN6_IS_ADDR_MULTICAST (&g->sin6_addr);
+    } else {
+        result = 0;
+    }
+    if (!result) {
+        printf ("%s is not an IPv4 or IPv6 multicast address\n", group);
+        easy_close (s);
+        return NULL;
+    }
+    if (config->interface[0] != '\0' && (s->ifindex = if_nametoindex (config->interface)) == 0) {
+        printf ("Unknown interface %s\n", config->interface);
+        easy_close (s);
+        return NULL;
+    }
+    if (s->family == AF_INET6) {
+        /* link-local groups need the interface in the address */
+        ((struct sockaddr_in6 *) &s->group)->sin6_scope_id = s->ifindex;
+        ((struct sockaddr_in6 *) &local)->sin6_scope_id = s->ifindex;
+    }
+
+    if ((s->sockId = socket (s->family, SOCK_DGRAM, 0)) < 0) {
+        printf ("socket error: %s\n", strerror (errno));
+        easy_close (s);
+        return NULL;
+    }
+    /* multiple instances (e.g. a sender and a receiver) can bind to the same group/port */
+    if (setsockopt (s->sockId, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof (enable)) < 0) {
+        printf ("setsockopt(SO_REUSEADDR) failed: %s\n", strerror (errno));
+        easy_close (s);
+        return NULL;
+    }
+    if (s->family == AF_INET6) {
+        setsockopt (s->sockId, IPPROTO_IPV6, IPV6_V6ONLY, &enable, sizeof (enable));
+    }
+    if (wildcard && (mode & EASY_RECEIVE)) {
+        /* only the groups joined by this socket, not the ones joined by others on the same port */
+        int disable = 0;
+        setsockopt (s->sockId, (s->family == AF_INET) ? IPPROTO_IP : IPPROTO_IPV6,
+                (s->family == AF_INET) ? IP_MULTICAST_ALL : IPV6_MULTICAST_ALL, &disable, sizeof (disable));
+    }
+    _setBuffer (s->sockId, SO_RCVBUF, SO_RCVBUFFORCE, config->rcvBuf, "SO_RCVBUF");
+    _setBuffer (s->sockId, SO_SNDBUF, SO_SNDBUFFORCE, config->sndBuf, "SO_SNDBUF");
+
+    if (bind (s->sockId, (struct sockaddr *) &local, s->groupLength) < 0) {
+        printf ("bind error: %s\n", strerror (errno));
+        easy_close (s);
+        return NULL;
+    }
+    result = (s->family == AF_INET) ? _configureIPv4 (s, mode, config) : _configureIPv6 (s, mode, config);
+    if (result == 0 && (mode & EASY_RECEIVE)) {
+        result = _joinGroups (s, group, config);
+    }
+    if (result < 0) {
+        easy_close (s);
+        return NULL;
+    }
+    return s;
+}
+
+
+int easy_fd (const struct easySocket *s)
+{
+    return s->sockId;
+}
+
+
+int easy_send (struct easySocket *s, const void *message, int length)
+{
+    int result = sendto (s->sockId, message, length, 0, (struct sockaddr *) &s->group, s->groupLength);
+
+    if (result < 0) {
+        printf ("sendto error: %s\n", strerror (errno));
+    }
+    return result;
+}
+
+
+int easy_receive (struct easySocket *s, void *buff, int size)
+{
+    int result;
+
+    s->lastSenderLength = sizeof (s->lastSender);
+    if ((result = recvfrom (s->sockId, buff, size, 0, (struct sockaddr *) &s->lastSender, &s->lastSenderLength)) < 0) {
+        /* a signal is not an error: the caller decides whether to go on */
+        if (errno != EINTR) {
+            printf ("recvfrom error: %s\n", strerror (errno));
+        }
+        s->lastSenderLength = 0;
+    }
+    return result;
+}
+
+
+int easy_reply (struct easySocket *s, const void *message, int length)
+{
+    int result;
+
+    if (s->lastSenderLength == 0) {
+        printf ("easy_reply: nothing was received\n");
+        return -1;
+    }
+    if ((result = sendto (s->sockId, message, length, 0, (struct sockaddr *) &s->lastSender, s->lastSenderLength)) < 0) {
+        printf ("sendto error: %s\n", strerror (errno));
+    }
+    return result;
+}
+
+
+void easy_close (struct easySocket *s)
+{
+    if (s->sockId >= 0) {
+        /* the memberships (and source filters) of the socket are dropped with it */
+        close (s->sockId);
+    }
+    free (s);
+}
@@ -0,0 +1,97 @@
+/*******************************************************/
+/* easyUDPSockets.h */
+/*******************************************************/
+
+/* UDP sockets for one multicast group and port, IPv4 or IPv6.
+ * All the state of a socket is in its struct easySocket, created by
+ * easy_open: a process can open as many as it needs (one per session, or a
+ * sender and a receiver of the same group).
+ * The local port is always the port of the group, both to send and to receive
+ * (symmetric RTP, RFC 4961). An EASY_SEND socket is bound to the wildcard
+ * address, so easy_receive on it gets the unicast answers of the receivers
+ * (easy_reply). A socket which receives one group is bound to the group
+ * address: it gets only what is sent to the group (its own datagrams too,
+ * with loop), never a unicast answer.
+ * To receive, the groups are joined with the protocol-independent
+ * MCAST_JOIN_GROUP, or MCAST_JOIN_SOURCE_GROUP for source-specific multicast
+ * (SSM, RFC 4607): the kernel (and the routers, with IGMPv3 / MLDv2) drops
+ * the datagrams of the sources not wanted, so the process does not even wake
+ * up for them. The same source filter applies to every group of the socket.
+ * Restrictions
+ * - Use each struct easySocket from one thread at a time.
+ */
+
+#ifndef EASY_UDP_SOCKETS_H
+#define EASY_UDP_SOCKETS_H
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#define MAXBUF 65536 /* enough for any UDP datagram */
+#define EASY_MAX_SOURCES 16     /* addresses of the source filter */
+#define EASY_MAX_GROUPS 8       /* groups received besides the one of easy_open */
+
+/* What the socket is used for, in easy_open */
+enum easy_mode {
+    EASY_SEND = 1,              /* easy_send to the group */
+    EASY_RECEIVE = 2,           /* the group is joined, easy_receive gets what is sent to it */
+    EASY_SEND_RECEIVE = 3       /* both; being bound to the group, easy_reply of a peer does not reach it */
+};
+
+/* Source filter of the groups received */
+enum easy_filter {
+    EASY_ANY_SOURCE,            /* every source (any-source multicast) */
+    EASY_INCLUDE,               /* only the sources listed (SSM) */
+    EASY_EXCLUDE                /* every source but the ones listed */
+};
+
+/* Options of the socket. easy_default_config sets each of them to the value
+ * which leaves the system default */
+struct easySocketConfig {
+    int ttl;                    /* multicast TTL (hop limit in IPv6); 0: system default, 1 */
+    int loop;                   /* 1: multicast sent is also received by the local host (default); 0: not */
+    char interface[16];         /* name of the interface for multicast (e.g. "eth0"); "": chosen by the routes */
+    int rcvBuf;                 /* SO_RCVBUF, bytes; 0: system default */
+    int sndBuf;                 /* SO_SNDBUF, bytes; 0: system default */
+    int filter;                 /* enum easy_filter, to receive */
+    int sources;                /* addresses in 'source', at least 1 unless EASY_ANY_SOURCE */
+    char source[EASY_MAX_SOURCES][INET6_ADDRSTRLEN];    /* numeric, of the family of the group */
+    int groups;                 /* addresses in 'group' */
+    char group[EASY_MAX_GROUPS][INET6_ADDRSTRLEN];      /* also joined to receive, of the family and port
+                                                           of the group; the socket is bound to the wildcard */
+};
+
+struct easySocket;
+
+/* Fills 'config' with the default values */
+void easy_default_config (struct easySocketConfig *config);
+
+/* Opens a socket for 'group' (numeric IPv4 or IPv6 multicast address) and
+ * 'port', used as 'mode' (enum easy_mode); 'config' can be NULL for the
+ * defaults. To receive, the groups of 'config' are joined as well, with its
+ * source filter. Buffer sizes larger than the system limit are forced if the
+ * process has CAP_NET_ADMIN; otherwise a message shows the size obtained.
+ * Returns NULL on error (a message is printed). */
+struct easySocket *easy_open (const char *group, int port, int mode, const struct easySocketConfig *config);
+
+/* Socket descriptor, e.g. for poll or epoll */
+int easy_fd (const struct easySocket *s);
+
+/* Sends 'length' bytes of 'message' to the group. Returns the bytes sent or -1 */
+int easy_send (struct easySocket *s, const void *message, int length);
+
+/* Receives one datagram sent to the group (blocking) in 'buff', of 'size'
+ * bytes; longer datagrams are truncated. Returns its length or -1 (with
+ * errno EINTR, and no message, if the wait was interrupted by a signal) */
+int easy_receive (struct easySocket *s, void *buff, int size);
+
+/* Sends 'length' bytes of 'message' (unicast) to the sender of the last
+ * datagram received, which gets it if it sent with an EASY_SEND socket.
+ * Returns the bytes sent or -1 */
+int easy_reply (struct easySocket *s, const void *message, int length);
+
+/* Leaves the groups, closes the socket and frees its memory */
+void easy_close (struct easySocket *s);
+
+#endif /* EASY_UDP_SOCKETS_H */
@@ -1,14 +0,0 @@
-/*******************************************************/
-/* easyUDPSockets_1.h */
-/*******************************************************/
-
-//#define PORT 5000
-//#define GROUP "225.0.1.29"
-#define MAXBUF 256
-
-int easy_init_1(void);
-
-int easy_send_1(char * message);
-
-int easy_receive_1(char * buff);
-
@@ -0,0 +1,230 @@
+/* echoCanceller.c */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "echoCanceller.h"
+#include "alignedMemory.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#define STEP 0.5f               /* NLMS step size, (0..2) */
+#define REGULARIZATION 100.0f   /* per tap, added to the reference energy (int16 units) */
+#define GEIGEL 0.5f             /* double talk if |captured| > GEIGEL * max |played| */
+#define HOLD_MS 30              /* adaptation stays stopped after double talk */
+
+struct echoCanceller {
+    int taps;                   /* multiple of 8 */
+    float *weight;              /* weight[k]: echo of the sample played k samples ago */
+    float *history;             /* 2 * taps: each sample is stored twice, so that the
+                                   last 'taps' samples are contiguous from 'position' */
+    int position;               /* newest sample, history[position] is 0 samples ago */
+    float energy;               /* sum of the squares of the last 'taps' samples */
+    int hold;                   /* samples until adaptation restarts */
+    int holdSamples;
+    int16_t *fifo;              /* reference played, waiting for its captured samples */
+    int fifoSize;
+    int fifoRead;
+    int fifoCount;
+};
+
+
+/*=====================================================================*/
+/* sum of a[i] * b[i] */
+static float _dot (const float *a, const float *b, int n)
+{
+    int i = 0;
+    float sum = 0.0f;
+
+#if defined(__AVX2__)
+    __m256 acc8 = _mm256_setzero_ps ();
+    for (; i + 8 <= n; i += 8) {
+        acc8 = _mm256_add_ps (acc8, _mm256_mul_ps (_mm256_loadu_ps (a + i), _mm256_loadu_ps (b + i)));
+    }
+    {
+        float lanes[8];
+        int k;
+        _mm256_storeu_ps (lanes, acc8);
+        for (k = 0; k < 8; k++) {
+            sum += lanes[k];
+        }
+    }
+#elif defined(__SSE2__)
+    __m128 acc0 = _mm_setzero_ps ();
+    __m128 acc1 = _mm_setzero_ps ();
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm_add_ps (acc0, _mm_mul_ps (_mm_loadu_ps (a + i), _mm_loadu_ps (b + i)));
+        acc1 = _mm_add_ps (acc1, _mm_mul_ps (_mm_loadu_ps (a + i + 4), _mm_loadu_ps (b + i + 4)));
+    }
+    {
+        float lanes[4];
+        int k;
+        _mm_storeu_ps (lanes, _mm_add_ps (acc0, acc1));
+        for (k = 0; k < 4; k++) {
+            sum += lanes[k];
+        }
+    }
+#endif
+    for (; i < n; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+
+/* a[i] += g * b[i]; 'a' aligned to AMEM_ALIGN, 'n' multiple of 8 */
+static void _axpy (float *a, float g, const float *b, int n)
+{
+    int i = 0;
+
+#if defined(__AVX2__)
+    __m256 g8 = _mm256_set1_ps (g);
+    for (; i + 8 <= n; i += 8) {
+        _mm256_store_ps (a + i, _mm256_add_ps (_mm256_load_ps (a + i), _mm256_mul_ps (g8, _mm256_loadu_ps (b + i))));
+    }
+#elif defined(__SSE2__)
+    __m128 g4 = _mm_set1_ps (g);
+    for (; i + 4 <= n; i += 4) {
+        _mm_store_ps (a + i, _mm_add_ps (_mm_load_ps (a + i), _mm_mul_ps (g4, _mm_loadu_ps (b + i))));
+    }
+#endif
+    for (; i < n; i++) {
+        a[i] += g * b[i];
+    }
+}
+
+
+/* highest |x[i]| */
+static float _peak (const float *x, int n)
+{
+    float peak = 0.0f;
+    int i;
+
+    for (i = 0; i < n; i++) {
+        float v = x[i] < 0 ? -x[i] : x[i];
+        if (v > peak) {
+            peak = v;
+        }
+    }
+    return peak;
+}
+
+
+/*=====================================================================*/
+void *aec_create (int rate, int tailMs, int flags)
+{
+    struct echoCanceller *ec;
+
+    if (rate <= 0 || tailMs <= 0) {
+        printf ("Invalid echo canceller parameters: rate %d, tail %d ms\n", rate, tailMs);
+        return NULL;
+    }
+    if ((ec = calloc (1, sizeof (struct echoCanceller))) == NULL) {
+        printf ("Error reserving memory in echoCanceller\n");
+        return NULL;
+    }
+    ec->taps = (int) (((long) rate * tailMs / 1000 + 7) & ~7L);
+    ec->holdSamples = rate * HOLD_MS / 1000;
+    ec->fifoSize = rate / 2;
+    ec->weight = amem_alloc (ec->taps * sizeof (float), flags);
+    ec->history = amem_alloc (2 * ec->taps * sizeof (float), flags);
+    ec->fifo = malloc (ec->fifoSize * sizeof (int16_t));
+    if (ec->weight == NULL || ec->history == NULL || ec->fifo == NULL) {
+        printf ("Error reserving memory in echoCanceller\n");
+        aec_destroy (ec);
+        return NULL;
+    }
+    /* no echo estimated, nothing played */
+    memset (ec->weight, 0, ec->taps * sizeof (float));
+    memset (ec->history, 0, 2 * ec->taps * sizeof (float));
+    return ec;
+}
+
+
+void aec_playout (void *echoCanceller, const int16_t *played, int samples)
+{
+    struct echoCanceller *ec = echoCanceller;
+    int i;
+
+    for (i = 0; i < samples; i++) {
+        if (ec->fifoCount == ec->fifoSize) {
+            /* nothing captured for too long: the oldest sample is discarded */
+            ec->fifoRead = (ec->fifoRead + 1) % ec->fifoSize;
+            ec->fifoCount--;
+        }
+        ec->fifo[(ec->fifoRead + ec->fifoCount) % ec->fifoSize] = played[i];
+        ec->fifoCount++;
+    }
+}
+
+
+void aec_process (void *echoCanceller, int16_t *captured, int samples)
+{
+    struct echoCanceller *ec = echoCanceller;
+    int taps = ec->taps;
+    float peak;
+    int i;
+
+    /* recomputed for each call, so that rounding errors do not accumulate */
+    ec->energy = _dot (ec->history + ec->position, ec->history + ec->position, taps);
+    peak = _peak (ec->history + ec->position, taps);
+
+    for (i = 0; i < samples; i++) {
+        float reference = 0.0f;
+        float *x;
+        float near = captured[i];
+        float error;
+
+        if (ec->fifoCount > 0) {
+            reference = ec->fifo[ec->fifoRead];
+            ec->fifoRead = (ec->fifoRead + 1) % ec->fifoSize;
+            ec->fifoCount--;
+        }
+        /* the oldest sample leaves the window, the new one enters it */
+        ec->position = (ec->position == 0) ? taps - 1 : ec->position - 1;
+        x = ec->history + ec->position;
+        ec->energy += reference * reference - x[0] * x[0];
+        if (ec->energy < 0.0f) {
+            ec->energy = 0.0f;
+        }
+        x[0] = x[taps] = reference;
+        if (reference > peak || -reference > peak) {
+            peak = reference < 0 ? -reference : reference;
+        }
+
+        error = near - _dot (ec->weight, x, taps);
+
+        if (near > GEIGEL * peak || -near > GEIGEL * peak) {
+            ec->hold = ec->holdSamples;
+        }
+        if (ec->hold > 0) {
+            ec->hold--;
+        } else {
+            _axpy (ec->weight, STEP * error / (ec->energy + REGULARIZATION * taps), x, taps);
+        }
+
+        if (error > 32767.0f) {
+            error = 32767.0f;
+        } else if (error < -32768.0f) {
+            error = -32768.0f;
+        }
+        captured[i] = (int16_t) error;
+    }
+}
+
+
+void aec_destroy (void *echoCanceller)
+{
+    struct echoCanceller *ec = echoCanceller;
+
+    amem_free (ec->weight);
+    amem_free (ec->history);
+    free (ec->fifo);
+    free (ec);
+}
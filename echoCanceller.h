@@ -0,0 +1,43 @@
+/* echoCanceller.h */
+
+/* Acoustic echo canceller for full-duplex operation: removes from the
+ * captured audio the echo of the audio played, using the played samples as
+ * reference. It is an NLMS adaptive filter of the length of the echo tail,
+ * in the time domain; its inner loops (filter and update, one dot product
+ * and one a*x+y each per sample) use SSE (AVX if compiled with -mavx2).
+ * Adaptation stops during double talk (Geigel detector: captured level over
+ * half the highest level played in the tail), so that the near end does not
+ * spoil the filter.
+ *
+ * For each period, the samples played are given with aec_playout, and the
+ * samples captured with aec_process, in the same order they were written to
+ * and read from the soundcard. The delay between them (buffering in the
+ * device) must be shorter than the tail.
+ * Audio is mono, 16 bits in host order.
+ * Restrictions
+ * - Use only in single-thread code, as circularBuffer.
+ */
+
+#ifndef ECHO_CANCELLER_H
+#define ECHO_CANCELLER_H
+
+#include <stdint.h>
+
+/* Returns a pointer which represents the canceller, to be used by the rest
+ * of functions, for audio at 'rate' Hz and echoes up to 'tailMs' ms long.
+ * 'flags' are the enum amem_flags for the filter memory.
+ * On error, memory could not be allocated, returns NULL. */
+void *aec_create (int rate, int tailMs, int flags);
+
+/* Adds 'samples' samples played to the reference. The reference waits (up to
+ * half a second) for the captured samples of the same period */
+void aec_playout (void *echoCanceller, const int16_t *played, int samples);
+
+/* Removes the echo from 'samples' captured samples, in place. Each captured
+ * sample takes one reference sample (silence if there is none) */
+void aec_process (void *echoCanceller, int16_t *captured, int samples);
+
+/* Frees memory of the canceller */
+void aec_destroy (void *echoCanceller);
+
+#endif /* ECHO_CANCELLER_H */
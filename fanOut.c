@@ -0,0 +1,435 @@
+/* fanOut.c */
+
+#define _GNU_SOURCE /* sendmmsg */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "fanOut.h"
+
+#define LINE_LENGTH 256
+
+struct destination {
+    struct sockaddr_storage addr;
+    socklen_t length;
+    char name[INET6_ADDRSTRLEN + 8];    /* address and port, for the statistics */
+    unsigned long long packets;
+    unsigned long long bytes;
+    unsigned long long errors;
+    int lastError;              /* errno of the last error, 0 if none */
+};
+
+struct packetBuffer {
+    unsigned char *data;
+    int refs;                   /* messages queued which point to it */
+};
+
+struct fanOut {
+    int sockId;
+    int numberOfDestinations;
+    struct destination *destinations;
+    struct packetBuffer pool[FAN_POOL];
+    int building;               /* buffer returned by the last fan_packet, -1 if none */
+    int pending;
+    struct mmsghdr msgs[FAN_BATCH];
+    struct iovec iovecs[FAN_BATCH];
+    int owner[FAN_BATCH];       /* buffer of each message */
+    int target[FAN_BATCH];      /* destination of each message */
+};
+
+
+/*=====================================================================*/
+/* Parses 'address' and 'port' into 'd'. Returns 0, or -1 if it is not an address */
+static int _parseDestination (struct destination *d, const char *address, int port)
+{
+    struct sockaddr_in *a4 = (struct sockaddr_in *) &d->addr;
+    struct sockaddr_in6 *a6 = (struct sockaddr_in6 *) &d->addr;
+
+    memset (d, 0, sizeof (struct destination));
+    if (inet_pton (AF_INET, address, &a4->sin_addr) == 1) {
+        a4->sin_family = AF_INET;
+        a4->sin_port = htons (port);
+        d->length = sizeof (struct sockaddr_in);
+        snprintf (d->name, sizeof (d->name), "%s:%d", address, port);
+    } else if (inet_pton (AF_INET6, address, &a6->sin6_addr) == 1) {
+        a6->sin6_family = AF_INET6;
+        a6->sin6_port = htons (port);
+        d->length = sizeof (struct sockaddr_in6);
+        snprintf (d->name, sizeof (d->name), "[%s]:%d", address, port);
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+
+/* Reads the destinations of 'fileName' in f->destinations. Returns 0 or -1 */
+static int _readDestinations (struct fanOut *f, const char *fileName, int defaultPort)
+{
+    FILE *file;
+    char line[LINE_LENGTH];
+    int allocated = 0;
+    int lineNumber = 0;
+
+    if ((file = fopen (fileName, "r")) == NULL) {
+        printf ("File %s could not be opened, error %s\n", fileName, strerror (errno));
+        return -1;
+    }
+    while (fgets (line, sizeof (line), file) != NULL) {
+        char address[INET6_ADDRSTRLEN];
+        int port = defaultPort;
+        int fields;
+
+        lineNumber++;
+        fields = sscanf (line, "%45s %d", address, &port);
+        if (fields < 1 || address[0] == '#') {
+            continue;
+        }
+        if (f->numberOfDestinations == allocated) {
+            struct destination *more;
+            allocated = (allocated == 0) ? 64 : 2 * allocated;
+            if ((more = realloc (f->destinations, allocated * sizeof (struct destination))) == NULL) {
+                printf ("Error reserving memory in fanOut\n");
+                fclose (file);
+                return -1;
+            }
+            f->destinations = more;
+        }
+        if (port < 1 || port > 65535 || _parseDestination (&f->destinations[f->numberOfDestinations], address, port) < 0) {
+            printf ("%s, line %d: '%s' is not an IPv4 or IPv6 address and port\n", fileName, lineNumber, address);
+            fclose (file);
+            return -1;
+        }
+        f->numberOfDestinations++;
+    }
+    fclose (file);
+    if (f->numberOfDestinations == 0) {
+        printf ("%s has no destinations\n", fileName);
+        return -1;
+    }
+    return 0;
+}
+
+
+/* IPv4 destinations are sent by an IPv6 socket as IPv4-mapped addresses */
+static void _mapToIPv6 (struct destination *d)
+{
+    struct sockaddr_in a4 = *(struct sockaddr_in *) &d->addr;
+    struct sockaddr_in6 *a6 = (struct sockaddr_in6 *) &d->addr;
+
+    memset (a6, 0, sizeof (struct sockaddr_in6));
+    a6->sin6_family = AF_INET6;
+    a6->sin6_port = a4.sin_port;
+    a6->sin6_addr.s6_addr[10] = 0xff;
+    a6->sin6_addr.s6_addr[11] = 0xff;
+    memcpy (&a6->sin6_addr.s6_addr[12], &a4.sin_addr, 4);
+    d->length = sizeof (struct sockaddr_in6);
+}
+
+
+/* Sends the messages queued; each message sent, or failed, releases its buffer */
+static int _sendQueue (struct fanOut *f)
+{
+    int sent = 0;
+    int result, k;
+
+    while (sent < f->pending) {
+        result = sendmmsg (f->sockId, f->msgs + sent, f->pending - sent, 0);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EBADF || errno == ENOTSOCK) {
+                printf ("sendmmsg error: %s\n", strerror (errno));
+                return -1;
+            }
+            /* the first message failed (e.g. no route to that destination): the rest are sent */
+            f->destinations[f->target[sent]].errors++;
+            f->destinations[f->target[sent]].lastError = errno;
+            f->pool[f->owner[sent]].refs--;
+            sent++;
+            continue;
+        }
+        for (k = sent; k < sent + result; k++) {
+            struct destination *d = &f->destinations[f->target[k]];
+            d->packets++;
+            d->bytes += f->iovecs[k].iov_len;
+            f->pool[f->owner[k]].refs--;
+        }
+        sent += result;
+    }
+    f->pending = 0;
+    return 0;
+}
+
+
+/*=====================================================================*/
+void *fan_create (const char *fileName, int port, int maxPacketBytes, const struct easySocketConfig *config)
+{
+    struct fanOut *f;
+    struct sockaddr_storage local;
+    int family = AF_INET;
+    int enable = 1, disable = 0;
+    int i;
+
+    if ((f = calloc (1, sizeof (struct fanOut))) == NULL) {
+        printf ("Error reserving memory in fanOut\n");
+        return NULL;
+    }
+    f->sockId = -1;
+    f->building = -1;
+    if (_readDestinations (f, fileName, port) < 0) {
+        fan_destroy (f);
+        return NULL;
+    }
+    for (i = 0; i < FAN_POOL; i++) {
+        if ((f->pool[i].data = malloc (maxPacketBytes)) == NULL) {
+            printf ("Error reserving memory in fanOut\n");
+            fan_destroy (f);
+            return NULL;
+        }
+    }
+    for (i = 0; i < FAN_BATCH; i++) {
+        f->msgs[i].msg_hdr.msg_iov = &f->iovecs[i];
+        f->msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    /* one socket for all: IPv6 (dual stack) if any destination is IPv6 */
+    for (i = 0; i < f->numberOfDestinations; i++) {
+        if (f->destinations[i].addr.ss_family == AF_INET6) {
+            family = AF_INET6;
+        }
+    }
+    if (family == AF_INET6) {
+        for (i = 0; i < f->numberOfDestinations; i++) {
+            if (f->destinations[i].addr.ss_family == AF_INET) {
+                _mapToIPv6 (&f->destinations[i]);
+            }
+        }
+    }
+    if ((f->sockId = socket (family, SOCK_DGRAM, 0)) < 0) {
+        printf ("socket error: %s\n", strerror (errno));
+        fan_destroy (f);
+        return NULL;
+    }
+    setsockopt (f->sockId, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof (enable));
+    memset (&local, 0, sizeof (local));
+    if (family == AF_INET6) {
+        setsockopt (f->sockId, IPPROTO_IPV6, IPV6_V6ONLY, &disable, sizeof (disable));
+        ((struct sockaddr_in6 *) &local)->sin6_family = AF_INET6;
+        ((struct sockaddr_in6 *) &local)->sin6_port = htons (port);
+        ((struct sockaddr_in6 *) &local)->sin6_addr = in6addr_any;
+    } else {
+        ((struct sockaddr_in *) &local)->sin_family = AF_INET;
+        ((struct sockaddr_in *) &local)->sin_port = htons (port);
+        ((struct sockaddr_in *) &local)->sin_addr.s_addr = htonl (INADDR_ANY);
+    }
+    /* the source port is the RTP port, as the multicast sender (symmetric RTP) */
+    if (bind (f->sockId, (struct sockaddr *) &local,
+            family == AF_INET6 ? sizeof (struct sockaddr_in6) : sizeof (struct sockaddr_in)) < 0) {
+        printf ("bind error: %s\n", strerror (errno));
+        fan_destroy (f);
+        return NULL;
+    }
+    if (config != NULL && config->sndBuf > 0
+            && setsockopt (f->sockId, SOL_SOCKET, SO_SNDBUFFORCE, &config->sndBuf, sizeof (config->sndBuf)) < 0
+            && setsockopt (f->sockId, SOL_SOCKET, SO_SNDBUF, &config->sndBuf, sizeof (config->sndBuf)) < 0) {
+        printf ("setsockopt(SO_SNDBUF) failed: %s\n", strerror (errno));
+    }
+    return f;
+}
+
+
+int fan_destinations (const void *fan)
+{
+    const struct fanOut *f = fan;
+    return f->numberOfDestinations;
+}
+
+
+int fan_fd (const void *fan)
+{
+    const struct fanOut *f = fan;
+    return f->sockId;
+}
+
+
+unsigned char *fan_packet (void *fan)
+{
+    struct fanOut *f = fan;
+    int i;
+
+    for (i = 0; i < FAN_POOL; i++) {
+        if (f->pool[i].refs == 0 && i != f->building) {
+            f->building = i;
+            return f->pool[i].data;
+        }
+    }
+    /* every buffer has messages pending: once sent, all of them are free */
+    _sendQueue (f);
+    f->building = (f->building + 1) % FAN_POOL;
+    return f->pool[f->building].data;
+}
+
+
+int fan_send (void *fan, unsigned char *packet, int length)
+{
+    struct fanOut *f = fan;
+    int b = f->building;
+    int i;
+
+    if (b < 0 || packet != f->pool[b].data) {
+        printf ("fan_send: the packet was not obtained from fan_packet\n");
+        return -1;
+    }
+    f->pool[b].refs += f->numberOfDestinations;
+    f->building = -1;
+    for (i = 0; i < f->numberOfDestinations; i++) {
+        struct mmsghdr *m = &f->msgs[f->pending];
+        m->msg_hdr.msg_name = &f->destinations[i].addr;
+        m->msg_hdr.msg_namelen = f->destinations[i].length;
+        f->iovecs[f->pending].iov_base = packet;
+        f->iovecs[f->pending].iov_len = length;
+        f->owner[f->pending] = b;
+        f->target[f->pending] = i;
+        if (++f->pending == FAN_BATCH && _sendQueue (f) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+
+int fan_flush (void *fan)
+{
+    return _sendQueue (fan);
+}
+
+
+void fan_print_stats (const void *fan)
+{
+    const struct fanOut *f = fan;
+    int i;
+
+    for (i = 0; i < f->numberOfDestinations; i++) {
+        const struct destination *d = &f->destinations[i];
+        printf ("%-48s packets %llu, bytes %llu, errors %llu%s%s\n", d->name, d->packets, d->bytes, d->errors,
+                d->lastError ? ", last: " : "", d->lastError ? strerror (d->lastError) : "");
+    }
+}
+
+
+void fan_destroy (void *fan)
+{
+    struct fanOut *f = fan;
+    int i;
+
+    if (f->sockId >= 0) {
+        _sendQueue (f);
+        close (f->sockId);
+    }
+    for (i = 0; i < FAN_POOL; i++) {
+        free (f->pool[i].data);
+    }
+    free (f->destinations);
+    free (f);
+}
+
+
+/* TEST for fanOut functions.
+ * To execute it, use following code  */
+
+/* #include "fanOut.h"
+void _fan_test_send(void);
+void main (void)
+{
+    _fan_test_send();
+} */
+
+
+void _fan_test_send (void)
+{
+    const char *name = "/tmp/_fan_test.txt";
+    const int receivers = 3;
+    const int packets = 3 * FAN_POOL;   /* buffers are reused */
+    int sock[3];
+    int port[3];
+    FILE *file;
+    void *f;
+    int i, r, errors = 0;
+
+    /* receivers in 127.0.0.1, in ports chosen by the system */
+    file = fopen (name, "w");
+    fprintf (file, "# test destinations\n\n");
+    for (r = 0; r < receivers; r++) {
+        struct sockaddr_in a;
+        socklen_t length = sizeof (a);
+        memset (&a, 0, sizeof (a));
+        a.sin_family = AF_INET;
+        a.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+        sock[r] = socket (AF_INET, SOCK_DGRAM, 0);
+        bind (sock[r], (struct sockaddr *) &a, sizeof (a));
+        getsockname (sock[r], (struct sockaddr *) &a, &length);
+        port[r] = ntohs (a.sin_port);
+        fprintf (file, "127.0.0.1 %d\n", port[r]);
+    }
+    fclose (file);
+
+    if ((f = fan_create (name, 0, 64, NULL)) == NULL) {
+        exit (1);
+    }
+    /* 1: destinations read */
+    if (fan_destinations (f) != receivers) {
+        printf ("_fan_test_send: %d destinations, expected %d\n", fan_destinations (f), receivers);
+        errors++;
+    }
+    /* packets of i + 1 bytes, with value i; flushed every 5 packets */
+    for (i = 0; i < packets; i++) {
+        unsigned char *p = fan_packet (f);
+        memset (p, i, i + 1);
+        fan_send (f, p, i + 1);
+        if (i % 5 == 4) {
+            fan_flush (f);
+        }
+    }
+    fan_flush (f);
+
+    /* 2: every receiver gets every packet, in order and unmodified */
+    for (r = 0; r < receivers; r++) {
+        for (i = 0; i < packets; i++) {
+            unsigned char buffer[64];
+            int length = recv (sock[r], buffer, sizeof (buffer), MSG_DONTWAIT);
+            if (length != i + 1 || buffer[0] != i || buffer[length - 1] != i) {
+                printf ("_fan_test_send: receiver %d, packet %d has %d bytes, value %d\n", r, i, length, length > 0 ? buffer[0] : -1);
+                errors++;
+                break;
+            }
+        }
+        close (sock[r]);
+    }
+
+    /* 3: statistics */
+    {
+        const struct fanOut *fo = f;
+        for (r = 0; r < receivers; r++) {
+            if (fo->destinations[r].packets != (unsigned long long) packets || fo->destinations[r].errors != 0) {
+                printf ("_fan_test_send: destination %d counted %llu packets\n", r, fo->destinations[r].packets);
+                errors++;
+            }
+        }
+    }
+    fan_destroy (f);
+    unlink (name);
+
+    if (errors > 0) {
+        exit (1);
+    }
+    printf ("Tests PASSED (number of tests: 3)\n");
+}
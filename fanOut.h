@@ -0,0 +1,60 @@
+/* fanOut.h */
+
+/* Unicast fan-out: the same RTP stream sent to a list of unicast
+ * destinations, for networks without multicast routing.
+ * Each packet is built once, in a buffer obtained from fan_packet, and
+ * fan_send queues one message per destination pointing to that buffer: the
+ * packet is never copied nor encoded per destination. The messages are sent
+ * with sendmmsg, FAN_BATCH at a time, whenever the queue is full and in
+ * fan_flush; a buffer has a reference for each message pending, and returns
+ * to the pool of FAN_POOL buffers when all of them have been sent. So the
+ * packets of a whole fragment can be queued and sent in a few system calls.
+ * Every destination keeps its counters of packets, bytes and errors.
+ *
+ * The destination file has a line per destination: an IPv4 or IPv6
+ * address, and optionally a port after a space (the default port
+ * otherwise); empty lines and lines starting with # are ignored.
+ * Restrictions
+ * - Use only in single-thread code, as circularBuffer.
+ */
+
+#ifndef FAN_OUT_H
+#define FAN_OUT_H
+
+#include "easyUDPSockets.h"
+
+#define FAN_BATCH 256           /* messages per sendmmsg call (at most UIO_MAXIOV) */
+#define FAN_POOL 16             /* packets which can be pending at the same time */
+
+/* Reads the destinations of 'fileName' and opens the socket, bound to
+ * 'port' (also the default port of the destinations), with the buffer sizes
+ * of 'config' (can be NULL). Packets are of 'maxPacketBytes' bytes at most.
+ * Returns a pointer which represents the fan-out, to be used by the rest of
+ * functions, or NULL on error (a message is printed). */
+void *fan_create (const char *fileName, int port, int maxPacketBytes, const struct easySocketConfig *config);
+
+/* Number of destinations */
+int fan_destinations (const void *fan);
+
+/* Socket descriptor, e.g. to measure its send queue */
+int fan_fd (const void *fan);
+
+/* Buffer of maxPacketBytes bytes in which the next packet is built. If
+ * all the buffers are pending, the queue is flushed first */
+unsigned char *fan_packet (void *fan);
+
+/* Queues the 'length' bytes of 'packet', the buffer returned by the last
+ * fan_packet, for every destination. The buffer must not be modified
+ * afterwards. Returns 0, or -1 if the socket failed (a message is printed) */
+int fan_send (void *fan, unsigned char *packet, int length);
+
+/* Sends all the messages queued. Returns 0, or -1 if the socket failed */
+int fan_flush (void *fan);
+
+/* Prints a line per destination with its packets, bytes and errors */
+void fan_print_stats (const void *fan);
+
+/* Flushes the queue, closes the socket and frees memory */
+void fan_destroy (void *fan);
+
+#endif /* FAN_OUT_H */
@@ -0,0 +1,309 @@
+/* gainControl.c */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "gainControl.h"
+#include "alignedMemory.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define CHUNK 1024              /* frames processed in each pass */
+#define AGC_MIN 0.25f           /* -12 dB */
+#define AGC_MAX 16.0f           /* +24 dB */
+#define AGC_MS 500              /* time constant of the level measured by AGC */
+#define RELEASE_MS 200          /* time constant of the gain going up */
+
+struct gainControl {
+    int channels;
+    int lookAhead;              /* frames, multiple of GAIN_BLOCK */
+    float manual;
+    int agc;
+    float level;                /* mean square of the stream, for AGC; 0 until measured */
+    float agcGain;
+    float current;              /* gain at the end of the last block */
+    float levelCoef;            /* per block */
+    float releaseCoef;
+    int16_t *work;              /* lookAhead frames pending, then the frames of a chunk */
+};
+
+
+/*=====================================================================*/
+/* highest |x[i]| */
+static int _peak (const int16_t *x, int n)
+{
+    int i = 0;
+    int high = 0, low = 0;
+
+#if defined(__SSE2__)
+    __m128i vhigh = _mm_setzero_si128 ();
+    __m128i vlow = _mm_setzero_si128 ();
+    for (; i + 8 <= n; i += 8) {
+        __m128i v = _mm_loadu_si128 ((const __m128i *) (x + i));
+        vhigh = _mm_max_epi16 (vhigh, v);
+        vlow = _mm_min_epi16 (vlow, v);
+    }
+    {
+        int16_t h[8], l[8];
+        int k;
+        _mm_storeu_si128 ((__m128i *) h, vhigh);
+        _mm_storeu_si128 ((__m128i *) l, vlow);
+        for (k = 0; k < 8; k++) {
+            if (h[k] > high) high = h[k];
+            if (l[k] < low) low = l[k];
+        }
+    }
+#endif
+    for (; i < n; i++) {
+        if (x[i] > high) high = x[i];
+        if (x[i] < low) low = x[i];
+    }
+    return (high > -low) ? high : -low;
+}
+
+
+static float _meanSquare (const int16_t *x, int n)
+{
+    long long sum = 0;
+    int i;
+
+    for (i = 0; i < n; i++) {
+        sum += (int) x[i] * x[i];
+    }
+    return (float) sum / n;
+}
+
+
+/* x[i] *= gain, with gain going linearly from g0 (excluded) to g1, saturated */
+static void _applyRamp_scalar (int16_t *x, int n, float g0, float g1)
+{
+    float step = (g1 - g0) / n;
+    int i;
+
+    for (i = 0; i < n; i++) {
+        float v = x[i] * (g0 + step * (i + 1));
+        x[i] = (int16_t) (v > 32767.0f ? 32767 : (v < -32768.0f ? -32768 : (int) lrintf (v)));
+    }
+}
+
+
+static void _applyRamp (int16_t *x, int n, float g0, float g1)
+{
+    float step = (g1 - g0) / n;
+    int i = 0;
+
+#if defined(__SSE2__)
+    __m128 gain = _mm_setr_ps (g0 + step, g0 + 2 * step, g0 + 3 * step, g0 + 4 * step);
+    __m128 step4 = _mm_set1_ps (4 * step);
+    for (; i + 8 <= n; i += 8) {
+        __m128i v = _mm_loadu_si128 ((const __m128i *) (x + i));
+        /* sign extension of the 16-bit samples to 32 bits */
+        __m128i lo = _mm_srai_epi32 (_mm_unpacklo_epi16 (v, v), 16);
+        __m128i hi = _mm_srai_epi32 (_mm_unpackhi_epi16 (v, v), 16);
+        __m128 flo = _mm_mul_ps (_mm_cvtepi32_ps (lo), gain);
+        gain = _mm_add_ps (gain, step4);
+        __m128 fhi = _mm_mul_ps (_mm_cvtepi32_ps (hi), gain);
+        gain = _mm_add_ps (gain, step4);
+        /* packs saturates to [-32768, 32767] */
+        _mm_storeu_si128 ((__m128i *) (x + i), _mm_packs_epi32 (_mm_cvtps_epi32 (flo), _mm_cvtps_epi32 (fhi)));
+    }
+#endif
+    _applyRamp_scalar (x + i, n - i, g0 + step * i, g1);
+}
+
+
+/*=====================================================================*/
+void *gain_create (int rate, int channels, int lookAheadMs, int flags)
+{
+    struct gainControl *g;
+
+    if (rate <= 0 || channels <= 0 || lookAheadMs < 0) {
+        printf ("Invalid gain parameters: rate %d, %d channels, look-ahead %d ms\n", rate, channels, lookAheadMs);
+        return NULL;
+    }
+    if ((g = calloc (1, sizeof (struct gainControl))) == NULL) {
+        printf ("Error reserving memory in gainControl\n");
+        return NULL;
+    }
+    g->channels = channels;
+    g->lookAhead = (rate * lookAheadMs / 1000 + GAIN_BLOCK - 1) / GAIN_BLOCK * GAIN_BLOCK;
+    if (g->lookAhead < GAIN_BLOCK) {
+        g->lookAhead = GAIN_BLOCK; /* the limiter needs to see the next block */
+    }
+    g->manual = 1.0f;
+    g->agcGain = 1.0f;
+    g->current = 1.0f;
+    g->levelCoef = expf (-(float) GAIN_BLOCK * 1000 / (AGC_MS * (float) rate));
+    g->releaseCoef = 1.0f - expf (-(float) GAIN_BLOCK * 1000 / (RELEASE_MS * (float) rate));
+    if ((g->work = amem_alloc ((size_t) (g->lookAhead + CHUNK) * channels * sizeof (int16_t), flags)) == NULL) {
+        printf ("Error reserving memory in gainControl\n");
+        free (g);
+        return NULL;
+    }
+    /* the look-ahead starts as silence */
+    memset (g->work, 0, (size_t) g->lookAhead * channels * sizeof (int16_t));
+    return g;
+}
+
+
+void gain_set (void *gainControl, float gain)
+{
+    ((struct gainControl *) gainControl)->manual = gain < 0.0f ? 0.0f : gain;
+}
+
+
+void gain_agc (void *gainControl, int enable)
+{
+    struct gainControl *g = gainControl;
+
+    g->agc = enable;
+    if (!enable) {
+        g->agcGain = 1.0f;
+    }
+}
+
+
+void gain_process (void *gainControl, int16_t *samples, int frames)
+{
+    struct gainControl *g = gainControl;
+    int ch = g->channels;
+    int L = g->lookAhead;
+
+    while (frames > 0) {
+        int n = frames < CHUNK ? frames : CHUNK;
+        int b;
+
+        memcpy (g->work + L * ch, samples, (size_t) n * ch * sizeof (int16_t));
+
+        for (b = 0; b < n; b += GAIN_BLOCK) {
+            int m = (n - b < GAIN_BLOCK) ? n - b : GAIN_BLOCK;
+            int peak = _peak (g->work + b * ch, (m + L) * ch);
+            float target;
+
+            if (g->agc) {
+                /* level of the frames entering the look-ahead */
+                float meanSquare = _meanSquare (g->work + (b + L) * ch, m * ch);
+                if (meanSquare > (float) GAIN_AGC_GATE * GAIN_AGC_GATE) {
+                    if (g->level == 0.0f) {
+                        g->level = meanSquare;
+                    }
+                    g->level = g->levelCoef * g->level + (1.0f - g->levelCoef) * meanSquare;
+                    g->agcGain = GAIN_AGC_TARGET / sqrtf (g->level);
+                    if (g->agcGain < AGC_MIN) g->agcGain = AGC_MIN;
+                    if (g->agcGain > AGC_MAX) g->agcGain = AGC_MAX;
+                }
+            }
+            target = g->manual * g->agcGain;
+            if (peak * target > GAIN_LIMIT) {
+                target = (float) GAIN_LIMIT / peak;  /* down at once, before the peak arrives */
+            } else if (target > g->current) {
+                target = g->current + (target - g->current) * g->releaseCoef;
+            }
+            _applyRamp (g->work + b * ch, m * ch, g->current, target);
+            g->current = target;
+        }
+
+        memcpy (samples, g->work, (size_t) n * ch * sizeof (int16_t));
+        memmove (g->work, g->work + n * ch, (size_t) L * ch * sizeof (int16_t));
+        samples += n * ch;
+        frames -= n;
+    }
+}
+
+
+void gain_destroy (void *gainControl)
+{
+    struct gainControl *g = gainControl;
+
+    amem_free (g->work);
+    free (g);
+}
+
+
+/* TEST for gain functions.
+ * To execute it, use following code  */
+
+/* #include "gainControl.h"
+void _gain_test_control(void);
+void main (void)
+{
+    _gain_test_control();
+} */
+
+
+void _gain_test_control (void)
+{
+    int rate = 8000;
+    int frames = 3 * rate;      /* 3 s, mono */
+    int16_t *x = malloc (frames * sizeof (int16_t));
+    int16_t *ref = malloc (frames * sizeof (int16_t));
+    void *g;
+    double sum;
+    int i, errors = 0;
+
+    if (x == NULL || ref == NULL) {
+        exit (1);
+    }
+
+    /* 1: SSE2 ramp is the same as the scalar one (rounding apart) */
+    for (i = 0; i < 1000; i++) {
+        x[i] = ref[i] = (int16_t) (random () - RAND_MAX / 2);
+    }
+    _applyRamp (x, 1000, 0.5f, 3.0f);
+    _applyRamp_scalar (ref, 1000, 0.5f, 3.0f);
+    for (i = 0; i < 1000; i++) {
+        if (x[i] - ref[i] > 1 || ref[i] - x[i] > 1) {
+            printf ("_gain_test_control: ramp sample %d is %d, expected %d\n", i, x[i], ref[i]);
+            errors++;
+            break;
+        }
+    }
+
+    /* 2: limiter: with gain 4, a full scale burst after silence does not go over GAIN_LIMIT */
+    if ((g = gain_create (rate, 1, 5, AMEM_DEFAULT)) == NULL) {
+        exit (1);
+    }
+    gain_set (g, 4.0f);
+    for (i = 0; i < frames; i++) {
+        x[i] = (i > rate && i < 2 * rate) ? ((i / 10) % 2 ? 32767 : -32768) : (i % 7) * 10;
+    }
+    gain_process (g, x, frames);
+    for (i = 0; i < frames; i++) {
+        if (x[i] > GAIN_LIMIT || x[i] < -GAIN_LIMIT) {
+            printf ("_gain_test_control: limiter let %d pass at sample %d\n", x[i], i);
+            errors++;
+            break;
+        }
+    }
+    gain_destroy (g);
+
+    /* 3: AGC brings a square wave of -40 dBFS to GAIN_AGC_TARGET within 3 dB */
+    if ((g = gain_create (rate, 1, 5, AMEM_DEFAULT)) == NULL) {
+        exit (1);
+    }
+    gain_agc (g, 1);
+    for (i = 0; i < frames; i++) {
+        x[i] = (i / 20) % 2 ? 328 : -328;
+    }
+    gain_process (g, x, frames);
+    for (sum = 0.0, i = 2 * rate; i < frames; i++) {
+        sum += (double) x[i] * x[i];
+    }
+    sum = sqrt (sum / rate);
+    if (sum < GAIN_AGC_TARGET / 1.41 || sum > GAIN_AGC_TARGET * 1.41) {
+        printf ("_gain_test_control: AGC level %.0f, expected %d\n", sum, GAIN_AGC_TARGET);
+        errors++;
+    }
+    gain_destroy (g);
+
+    free (x);
+    free (ref);
+    if (errors > 0) {
+        exit (1);
+    }
+    printf ("Tests PASSED (number of tests: 3)\n");
+}
@@ -0,0 +1,51 @@
+/* gainControl.h */
+
+/* Gain stage in the sample path, one for each stream (e.g. each source
+ * received, after decoding and before mixing or playout; or the audio
+ * captured, before encoding). It replaces the mixer volume of the soundcard,
+ * which depends on the device, with:
+ * - a digital gain, set by the user (e.g. from -v)
+ * - optionally, automatic gain control (AGC): the RMS level of the stream is
+ *   brought to GAIN_AGC_TARGET, so that quiet and loud talkers are balanced.
+ *   Audio under GAIN_AGC_GATE (silence, noise) does not change the gain.
+ * - a look-ahead limiter: the output is delayed by the look-ahead, and the
+ *   gain is lowered before a peak arrives so that it never goes over
+ *   GAIN_LIMIT. Gain changes are ramps, without steps (clicks).
+ * The gain is applied to blocks of GAIN_BLOCK frames with SSE2.
+ * Audio is 16 bits in host order, 'channels' interleaved.
+ * Restrictions
+ * - Use only in single-thread code, as circularBuffer.
+ */
+
+#ifndef GAIN_CONTROL_H
+#define GAIN_CONTROL_H
+
+#include <stdint.h>
+
+#define GAIN_BLOCK 64           /* frames with the same target gain */
+#define GAIN_LIMIT 29204        /* -1 dBFS */
+#define GAIN_AGC_TARGET 3277    /* RMS, -20 dBFS */
+#define GAIN_AGC_GATE 104       /* RMS, -50 dBFS */
+#define GAIN_LOOK_AHEAD_MS 5    /* suggested look-ahead of the limiter */
+
+/* Returns a pointer which represents the gain stage, to be used by the rest
+ * of functions, for audio at 'rate' Hz with 'channels' channels. Output is
+ * delayed 'lookAheadMs' ms (at least GAIN_BLOCK frames). The gain is 1 and
+ * AGC is off. 'flags' are the enum amem_flags for its buffer.
+ * On error, memory could not be allocated, returns NULL. */
+void *gain_create (int rate, int channels, int lookAheadMs, int flags);
+
+/* Sets the digital gain (linear, 1.0 leaves the level as it is) */
+void gain_set (void *gainControl, float gain);
+
+/* Turns AGC on (1) or off (0) */
+void gain_agc (void *gainControl, int enable);
+
+/* Applies the gain to 'frames' frames, in place. The frames returned are the
+ * ones given lookAheadMs ms before (silence at the beginning) */
+void gain_process (void *gainControl, int16_t *samples, int frames);
+
+/* Frees memory of the gain stage */
+void gain_destroy (void *gainControl);
+
+#endif /* GAIN_CONTROL_H */
@@ -0,0 +1,314 @@
+/* jitterBuffer.c */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "jitterBuffer.h"
+#include "alignedMemory.h"
+
+struct slot {
+    u_int32 ts;
+    int length;
+    u_int16 seq;
+    int used;
+};
+
+/* Packets in the buffer have sequence numbers in [head, head + slots) */
+struct jitterBuffer {
+    int slots;                  /* power of 2 */
+    int maxPayload;
+    int stride;                 /* distance between payloads in the arena, maxPayload aligned */
+    int started;                /* 0 until the first packet is inserted */
+    u_int16 head;               /* next sequence number to extract */
+    int count;
+    u_int32 overflows;
+    u_int32 skipped;
+    struct slot *slot;
+    unsigned char *arena;       /* slots * stride bytes, payload of slot i at i * stride */
+};
+
+
+/*=====================================================================*/
+void *jbuf_create (int slots, int maxPayload, int flags)
+{
+    struct jitterBuffer *jb;
+    int size = 1;
+
+    if (slots < 1 || slots > 32768 || maxPayload < 1) {
+        printf ("Invalid jitter buffer size: %d slots of %d bytes\n", slots, maxPayload);
+        return NULL;
+    }
+    while (size < slots) {
+        size <<= 1;
+    }
+    if ((jb = calloc (1, sizeof (struct jitterBuffer))) == NULL) {
+        printf ("Error reserving memory in jitterBuffer\n");
+        return NULL;
+    }
+    jb->slots = size;
+    jb->maxPayload = maxPayload;
+    jb->stride = AMEM_ROUND (maxPayload);
+    jb->slot = calloc (size, sizeof (struct slot));
+    jb->arena = amem_alloc ((size_t) size * jb->stride, flags);
+    if (jb->slot == NULL || jb->arena == NULL) {
+        printf ("Error reserving memory in jitterBuffer\n");
+        jbuf_destroy (jb);
+        return NULL;
+    }
+    return jb;
+}
+
+
+/* Moves the head 'steps' sequence numbers forward, discarding the packets in between */
+static void _advance (struct jitterBuffer *jb, int steps)
+{
+    int i;
+
+    if (steps >= jb->slots) {
+        /* all the packets stored are discarded */
+        for (i = 0; i < jb->slots; i++) {
+            jb->slot[i].used = 0;
+        }
+        jb->overflows += jb->count;
+        jb->count = 0;
+    } else {
+        for (i = 0; i < steps; i++) {
+            struct slot *s = &jb->slot[(u_int16) (jb->head + i) & (jb->slots - 1)];
+            if (s->used) {
+                s->used = 0;
+                jb->count--;
+                jb->overflows++;
+            }
+        }
+    }
+    jb->head += steps;
+}
+
+
+int jbuf_insert (void *jitterBuffer, u_int16 seq, u_int32 ts, const void *payload, int length)
+{
+    struct jitterBuffer *jb = jitterBuffer;
+    struct slot *s;
+    int distance;
+
+    if (!jb->started) {
+        jb->head = seq;
+        jb->started = 1;
+    }
+    distance = (int16_t) (seq - jb->head);
+    if (distance < 0) {
+        return JBUF_LATE;
+    }
+    if (distance >= jb->slots) {
+        _advance (jb, distance - jb->slots + 1);
+    }
+
+    s = &jb->slot[seq & (jb->slots - 1)];
+    if (s->used) {
+        return JBUF_DUPLICATE; /* in the window, the slot can only hold this seq */
+    }
+    if (length > jb->maxPayload) {
+        length = jb->maxPayload;
+    }
+    memcpy (jb->arena + (size_t) (seq & (jb->slots - 1)) * jb->stride, payload, length);
+    s->seq = seq;
+    s->ts = ts;
+    s->length = length;
+    s->used = 1;
+    jb->count++;
+    return JBUF_STORED;
+}
+
+
+/* Removes the packet at the head, which must be stored */
+static const void *_pop (struct jitterBuffer *jb, int *length, u_int16 *seq, u_int32 *ts)
+{
+    int index = jb->head & (jb->slots - 1);
+    struct slot *s = &jb->slot[index];
+
+    s->used = 0;
+    jb->count--;
+    jb->head++;
+    if (length != NULL) *length = s->length;
+    if (seq != NULL) *seq = s->seq;
+    if (ts != NULL) *ts = s->ts;
+    return jb->arena + (size_t) index * jb->stride;
+}
+
+
+/* Number of sequence numbers from the head to the first packet stored; the buffer must not be empty */
+static int _gap (const struct jitterBuffer *jb)
+{
+    int gap = 0;
+
+    while (!jb->slot[(u_int16) (jb->head + gap) & (jb->slots - 1)].used) {
+        gap++;
+    }
+    return gap;
+}
+
+
+const void *jbuf_extract (void *jitterBuffer, u_int32 playoutTs, int *length, u_int16 *seq, u_int32 *ts)
+{
+    struct jitterBuffer *jb = jitterBuffer;
+    int gap;
+
+    if (jb->count == 0) {
+        return NULL;
+    }
+    gap = _gap (jb);
+    if ((int32_t) (jb->slot[(u_int16) (jb->head + gap) & (jb->slots - 1)].ts - playoutTs) > 0) {
+        return NULL; /* not due yet: missing packets before it may still arrive */
+    }
+    jb->head += gap;
+    jb->skipped += gap;
+    return _pop (jb, length, seq, ts);
+}
+
+
+const void *jbuf_extract_next (void *jitterBuffer, int *length, u_int16 *seq, u_int32 *ts)
+{
+    struct jitterBuffer *jb = jitterBuffer;
+    int gap;
+
+    if (jb->count == 0) {
+        return NULL;
+    }
+    gap = _gap (jb);
+    jb->head += gap;
+    jb->skipped += gap;
+    return _pop (jb, length, seq, ts);
+}
+
+
+void jbuf_reset (void *jitterBuffer)
+{
+    struct jitterBuffer *jb = jitterBuffer;
+    int i;
+
+    for (i = 0; i < jb->slots; i++) {
+        jb->slot[i].used = 0;
+    }
+    jb->count = 0;
+    jb->started = 0;
+}
+
+
+int jbuf_count (void *jitterBuffer)
+{
+    return ((struct jitterBuffer *) jitterBuffer)->count;
+}
+
+
+u_int32 jbuf_overflows (void *jitterBuffer)
+{
+    return ((struct jitterBuffer *) jitterBuffer)->overflows;
+}
+
+
+u_int32 jbuf_skipped (void *jitterBuffer)
+{
+    return ((struct jitterBuffer *) jitterBuffer)->skipped;
+}
+
+
+void jbuf_destroy (void *jitterBuffer)
+{
+    struct jitterBuffer *jb = jitterBuffer;
+
+    free (jb->slot);
+    amem_free (jb->arena);
+    free (jb);
+}
+
+
+/* TEST vectors for jbuf functions.
+ * To execute them, use following code  */
+
+/* #include "jitterBuffer.h"
+void _jbuf_test_buffer(void);
+void main (void)
+{
+    _jbuf_test_buffer();
+} */
+
+
+void _jbuf_test_buffer (void)
+{
+    enum test_vector_pos {OPERATION, SEQ, TS, RETURN}; /* Test vector components */
+    enum operations {INSERT, EXTRACT, EXTRACT_NEXT};
+
+    int buffer_slots = 4; /* test_vector assumes that buffer_slots=4 */
+    int test_vector[][4] = {
+        /* Each line contains
+         *  Operation to execute,
+         *  Sequence number (INSERT) or expected sequence number (EXTRACT*),
+         *  Timestamp (INSERT) or playout timestamp (EXTRACT),
+         *  Expected return (INSERT: enum jbuf_result; EXTRACT*: 1 packet, 0 NULL) */
+        {EXTRACT,      0,       0, 0},   /* empty */
+        {INSERT,   65534,     100, JBUF_STORED},
+        {INSERT,       0,     120, JBUF_STORED},   /* 65535 is missing; wraps around */
+        {INSERT,   65535,     110, JBUF_STORED},   /* reordered */
+        {INSERT,   65535,     110, JBUF_DUPLICATE},
+        {EXTRACT,  65534,      99, 0},   /* not due */
+        {EXTRACT,  65534,     100, 1},
+        {INSERT,   65534,     100, JBUF_LATE},
+        {EXTRACT,  65535,     200, 1},
+        {INSERT,       2,     140, JBUF_STORED},   /* 1 is missing */
+        {EXTRACT,      0,     120, 1},
+        {EXTRACT,      2,     130, 0},   /* 2 is not due: 1 may still arrive */
+        {EXTRACT,      2,     140, 1},   /* 1 skipped */
+        {INSERT,       1,     130, JBUF_LATE},
+        {INSERT,       3,     150, JBUF_STORED},
+        {INSERT,       8,     200, JBUF_STORED},   /* too far: 3 is discarded, head moves to 5 */
+        {INSERT,       4,     160, JBUF_LATE},
+        {EXTRACT_NEXT, 8,       0, 1},
+        {EXTRACT_NEXT, 0,       0, 0},   /* empty */
+        /* you can add more tests here */
+    };
+
+    void *jb = jbuf_create (buffer_slots, sizeof (int), AMEM_DEFAULT);
+    int tests = sizeof (test_vector) / (4 * sizeof (int));
+    int test;
+
+    if (jb == NULL) {
+        exit (1);
+    }
+    for (test = 0; test < tests; test++) {
+        int *line = test_vector[test];
+        const int *payload;
+        int length;
+        u_int16 seq;
+
+        if (line[OPERATION] == INSERT) {
+            int result = jbuf_insert (jb, line[SEQ], line[TS], &line[SEQ], sizeof (int));
+            if (result != line[RETURN]) {
+                printf ("_jbuf_test_buffer RETURN error at test number %d; expected %d, returned %d\n", test, line[RETURN], result);
+                jbuf_destroy (jb);
+                exit (1);
+            }
+            continue;
+        }
+        if (line[OPERATION] == EXTRACT) {
+            payload = jbuf_extract (jb, line[TS], &length, &seq, NULL);
+        } else {
+            payload = jbuf_extract_next (jb, &length, &seq, NULL);
+        }
+        if ((payload != NULL) != line[RETURN]
+                || (payload != NULL && (seq != line[SEQ] || *payload != line[SEQ] || length != sizeof (int)))) {
+            printf ("_jbuf_test_buffer EXTRACT error at test number %d\n", test);
+            jbuf_destroy (jb);
+            exit (1);
+        }
+    }
+    if (jbuf_skipped (jb) != 4 || jbuf_overflows (jb) != 1) {
+        /* skipped: 1, and 5, 6, 7 before 8. overflows: 3 */
+        printf ("_jbuf_test_buffer COUNTERS error: skipped %u, overflows %u\n", jbuf_skipped (jb), jbuf_overflows (jb));
+        jbuf_destroy (jb);
+        exit (1);
+    }
+    jbuf_destroy (jb);
+
+    printf ("Tests PASSED (number of tests: %d)\n", tests);
+}
@@ -0,0 +1,64 @@
+/* jitterBuffer.h */
+
+/* Jitter buffer for the packets of one RTP source.
+ * Packets are stored in slots indexed by sequence number (modulo the number
+ * of slots), so a reordered packet goes directly to its place: insertion is
+ * O(1), and duplicates are detected in the same step. Packets are extracted
+ * in sequence order, when their timestamp is due for playout.
+ * Payloads are copied to an arena reserved at creation, one region of
+ * maxPayload bytes per slot, aligned (see alignedMemory.h): nothing is
+ * allocated per packet.
+ * Restrictions
+ * - Use only in single-thread code, as circularBuffer.
+ */
+
+#ifndef JITTER_BUFFER_H
+#define JITTER_BUFFER_H
+
+#include "rtp.h"
+
+/* Results of jbuf_insert */
+enum jbuf_result {
+    JBUF_STORED = 0,
+    JBUF_DUPLICATE = -1,        /* the packet is already in the buffer */
+    JBUF_LATE = -2              /* the packet is older than the last one extracted */
+};
+
+/* Returns a pointer which represents the jitter buffer, to be used by the
+ * rest of functions. It has room for 'slots' packets (rounded up to a power
+ * of 2) of up to 'maxPayload' bytes. 'flags' are the enum amem_flags for the arena.
+ * On error, memory could not be allocated, returns NULL. */
+void *jbuf_create (int slots, int maxPayload, int flags);
+
+/* Stores a copy of the payload of packet 'seq', with timestamp 'ts'.
+ * Payloads longer than maxPayload are truncated. If 'seq' is too far ahead to
+ * fit in the buffer, the oldest packets are discarded to make room (see
+ * jbuf_overflows). Returns an enum jbuf_result value. */
+int jbuf_insert (void *jitterBuffer, u_int16 seq, u_int32 ts, const void *payload, int length);
+
+/* Returns the payload of the next packet, in sequence order, if its timestamp
+ * is not after 'playoutTs'; NULL otherwise. Missing packets before it are
+ * skipped (see jbuf_skipped). 'length', 'seq' and 'ts' (if not NULL) return
+ * the data of the packet. The payload is valid until the next jbuf_insert. */
+const void *jbuf_extract (void *jitterBuffer, u_int32 playoutTs, int *length, u_int16 *seq, u_int32 *ts);
+
+/* Same as jbuf_extract, whatever the timestamp of the next packet is */
+const void *jbuf_extract_next (void *jitterBuffer, int *length, u_int16 *seq, u_int32 *ts);
+
+/* Discards the packets stored (they are not counted as overflows); the
+ * next packet inserted sets the sequence number to extract, as the first one
+ * did. For a sender which restarted its sequence numbers */
+void jbuf_reset (void *jitterBuffer);
+
+/* Number of packets stored */
+int jbuf_count (void *jitterBuffer);
+
+/* Packets discarded to make room for newer ones, and sequence numbers skipped
+ * at extraction because the packet had not arrived */
+u_int32 jbuf_overflows (void *jitterBuffer);
+u_int32 jbuf_skipped (void *jitterBuffer);
+
+/* Frees memory of the jitter buffer */
+void jbuf_destroy (void *jitterBuffer);
+
+#endif /* JITTER_BUFFER_H */
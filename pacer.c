@@ -0,0 +1,220 @@
+/* pacer.c */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <time.h>
+
+#include "pacer.h"
+
+#define NS_PER_SEC 1000000000LL
+#define BINS (PACE_HISTOGRAM_MS * 1000 / PACE_RESOLUTION_US)
+
+struct pacer {
+    int clockRate;
+    long long resyncNs;         /* 0: never */
+    int started;
+    uint32_t lastTimestamp;
+    long long units;            /* timestamp units since the start, unwrapped */
+    long long startNs;
+    unsigned long long frames;
+    unsigned long long late;
+    unsigned long long resyncs;
+    long long maxErrorNs;
+    unsigned int histogram[BINS + 1];  /* last bin: over PACE_HISTOGRAM_MS */
+};
+
+
+/*=====================================================================*/
+static long long _nowNs (void)
+{
+    struct timespec t;
+    clock_gettime (CLOCK_MONOTONIC, &t);
+    return t.tv_sec * NS_PER_SEC + t.tv_nsec;
+}
+
+
+static void _record (struct pacer *p, long long errorNs)
+{
+    long long bin = errorNs / (PACE_RESOLUTION_US * 1000);
+
+    p->histogram[bin < BINS ? bin : BINS]++;
+    if (errorNs > p->maxErrorNs) {
+        p->maxErrorNs = errorNs;
+    }
+    p->frames++;
+}
+
+
+/*=====================================================================*/
+void *pace_create (int clockRate, int resyncMs)
+{
+    struct pacer *p;
+
+    if ((p = calloc (1, sizeof (struct pacer))) == NULL) {
+        printf ("Error reserving memory in pacer\n");
+        return NULL;
+    }
+    p->clockRate = clockRate;
+    p->resyncNs = (long long) resyncMs * 1000000;
+    return p;
+}
+
+
+int pace_wait (void *pacer, uint32_t timestamp)
+{
+    struct pacer *p = pacer;
+    long long deadlineNs, nowNs;
+    struct timespec deadline;
+    int32_t step;
+
+    if (!p->started) {
+        /* the first frame is the start: it is on time */
+        p->started = 1;
+        p->startNs = _nowNs ();
+        p->lastTimestamp = timestamp;
+        _record (p, 0);
+        return 0;
+    }
+    /* signed difference, so that timestamps may wrap (or go back a little) */
+    step = (int32_t) (timestamp - p->lastTimestamp);
+    p->units += step;
+    p->lastTimestamp = timestamp;
+
+    /* split so that units * NS_PER_SEC does not overflow in long runs */
+    deadlineNs = p->startNs + (p->units / p->clockRate) * NS_PER_SEC
+            + (p->units % p->clockRate) * NS_PER_SEC / p->clockRate;
+
+    nowNs = _nowNs ();
+    if (nowNs >= deadlineNs) {
+        _record (p, nowNs - deadlineNs);
+        p->late++;
+        if (p->resyncNs > 0 && nowNs - deadlineNs > p->resyncNs) {
+            /* this frame is the new start of the schedule */
+            p->startNs += nowNs - deadlineNs;
+            p->resyncs++;
+        }
+        return 1;
+    }
+
+    deadline.tv_sec = deadlineNs / NS_PER_SEC;
+    deadline.tv_nsec = deadlineNs % NS_PER_SEC;
+    if (clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR) {
+        /* the next call computes the same deadline */
+        p->units -= step;
+        return -1;
+    }
+    _record (p, _nowNs () - deadlineNs);
+    return 0;
+}
+
+
+long pace_percentile (const void *pacer, double fraction)
+{
+    const struct pacer *p = pacer;
+    unsigned long long target = (unsigned long long) (fraction * p->frames);
+    unsigned long long count = 0;
+    int bin;
+
+    if (p->frames == 0) {
+        return 0;
+    }
+    if (target >= p->frames) {
+        target = p->frames - 1;
+    }
+    for (bin = 0; bin < BINS; bin++) {
+        count += p->histogram[bin];
+        if (count > target) {
+            /* upper edge of the bin, or the maximum if it is in this bin */
+            long edge = (long) (bin + 1) * PACE_RESOLUTION_US * 1000;
+            return (edge < p->maxErrorNs) ? edge : (long) p->maxErrorNs;
+        }
+    }
+    return (long) p->maxErrorNs;
+}
+
+
+void pace_print (const void *pacer, const char *name)
+{
+    const struct pacer *p = pacer;
+
+    printf ("%s: %llu frames paced, %llu late, %llu resynchronized; send error p50 %.3f ms, p90 %.3f ms, p99 %.3f ms, p99.9 %.3f ms, max %.3f ms\n",
+            name, p->frames, p->late, p->resyncs,
+            pace_percentile (p, 0.5) / 1e6, pace_percentile (p, 0.9) / 1e6,
+            pace_percentile (p, 0.99) / 1e6, pace_percentile (p, 0.999) / 1e6,
+            p->maxErrorNs / 1e6);
+}
+
+
+void pace_destroy (void *pacer)
+{
+    free (pacer);
+}
+
+
+/* TEST for pacer functions.
+ * To execute it, use following code  */
+
+/* #include "pacer.h"
+void _pace_test_schedule(void);
+void main (void)
+{
+    _pace_test_schedule();
+} */
+
+
+void _pace_test_schedule (void)
+{
+    void *p;
+    uint32_t ts = 0xFFFFFFFFu - 40;     /* wraps in the middle */
+    long long start, elapsed;
+    int i, errors = 0;
+    struct timespec pause = { 0, 50 * 1000000L };
+
+    /* 1: 100 frames of 1 ms, with work between them which must not add up */
+    p = pace_create (1000, 0);
+    start = _nowNs ();
+    for (i = 0; i < 100; i++) {
+        struct timespec work = { 0, 300 * 1000L };
+        pace_wait (p, ts);
+        ts++;
+        nanosleep (&work, NULL);
+    }
+    elapsed = _nowNs () - start;
+    /* the first frame is at the start: 99 ms, plus the work after the last one */
+    if (elapsed < 99000000LL || elapsed > 105000000LL) {
+        printf ("_pace_test_schedule: 100 frames took %.3f ms, expected 99.3\n", elapsed / 1e6);
+        errors++;
+    }
+
+    /* 2: the percentiles are ordered and bounded by the maximum */
+    if (pace_percentile (p, 0.5) > pace_percentile (p, 0.99) || pace_percentile (p, 0.999) > pace_percentile (p, 1.0)
+            || pace_percentile (p, 0.5) <= 0) {
+        printf ("_pace_test_schedule: percentiles not ordered\n");
+        errors++;
+    }
+    pace_destroy (p);
+
+    /* 3: 50 ms behind, with resyncMs 10: one late frame, then paced from it */
+    p = pace_create (1000, 10);
+    pace_wait (p, 0);
+    nanosleep (&pause, NULL);
+    if (pace_wait (p, 1) != 1) {
+        printf ("_pace_test_schedule: frame 50 ms behind is not late\n");
+        errors++;
+    }
+    start = _nowNs ();
+    pace_wait (p, 2);
+    pace_wait (p, 11);
+    elapsed = _nowNs () - start;
+    if (elapsed < 9000000LL || elapsed > 13000000LL) {
+        printf ("_pace_test_schedule: after resync, 10 ms took %.3f ms\n", elapsed / 1e6);
+        errors++;
+    }
+    pace_destroy (p);
+
+    if (errors > 0) {
+        exit (1);
+    }
+    printf ("Tests PASSED (number of tests: 3)\n");
+}
@@ -0,0 +1,53 @@
+/* pacer.h */
+
+/* Send pacing for sources which do not block (files, synthetic audio): each
+ * frame is released at its absolute deadline, derived from its RTP timestamp
+ *     deadline = start + (timestamp - first timestamp) / clockRate
+ * and slept with clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME), so that
+ * the schedule does not drift whatever the time spent between frames.
+ * The first pace_wait sets the start. A source which falls more than
+ * 'resyncMs' behind its schedule (e.g. the process was stopped) restarts the
+ * schedule from the current time instead of sending the backlog in a burst.
+ *
+ * The send-time error (how late the pacer returned after each deadline) is
+ * kept in a histogram with PACE_RESOLUTION_US bins up to PACE_HISTOGRAM_MS,
+ * for pace_percentile and pace_print.
+ * Restrictions
+ * - Use only in single-thread code, as circularBuffer.
+ */
+
+#ifndef PACER_H
+#define PACER_H
+
+#include <stdint.h>
+
+#define PACE_RESOLUTION_US 1    /* width of each bin of the error histogram */
+#define PACE_HISTOGRAM_MS 20    /* errors over this are counted in the last bin */
+
+/* Returns a pointer which represents the pacer, to be used by the rest of
+ * functions, for timestamps of 'clockRate' units per second (the RTP clock of
+ * the payload, or e.g. 1000 for ms ticks). 'resyncMs' 0 never restarts the
+ * schedule: late frames are released at once, until the schedule is caught up.
+ * On error, memory could not be allocated, returns NULL. */
+void *pace_create (int clockRate, int resyncMs);
+
+/* Sleeps until the deadline of the frame with 'timestamp' (32-bit RTP
+ * arithmetic: it may wrap). Returns 0 at the deadline, 1 if the deadline had
+ * already passed (the frame is late, it is not slept), or -1 if the sleep was
+ * interrupted by a signal (the error is not recorded: call it again to keep
+ * waiting) */
+int pace_wait (void *pacer, uint32_t timestamp);
+
+/* Send-time error not exceeded by 'fraction' (0..1) of the frames, in ns.
+ * Frames over PACE_HISTOGRAM_MS return the maximum error observed */
+long pace_percentile (const void *pacer, double fraction);
+
+/* Prints one line with the frames paced, late and resynchronized, and the
+ * 50, 90, 99, 99.9 percentiles and maximum of the send-time error, preceded
+ * by 'name' */
+void pace_print (const void *pacer, const char *name);
+
+/* Frees memory of the pacer */
+void pace_destroy (void *pacer);
+
+#endif /* PACER_H */
@@ -0,0 +1,330 @@
+/* packetRing.c */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <linux/if_packet.h>
+#include <linux/if_ether.h>
+#include <linux/filter.h>
+
+#include "packetRing.h"
+
+#define FRAME_SIZE 2048         /* only for the frame count the kernel checks: TPACKET_V3 packs datagrams */
+
+struct packetRing {
+    int sockId;
+    unsigned char *map;
+    int blockSize;
+    int blocks;
+    int current;                /* next block to read */
+    unsigned long long packets;
+    unsigned long long drops;
+};
+
+
+/*=====================================================================*/
+/* Keeps UDP over IPv4 (not the fragments after the first) or IPv6 (UDP as
+ * the first next header). A packet socket of type SOCK_DGRAM sees the
+ * datagram from the network header */
+static int _attachUdpFilter (int sockId)
+{
+    struct sock_filter udp[] = {
+        { BPF_LD | BPF_B | BPF_ABS, 0, 0, 0 },          /* A = version, IHL */
+        { BPF_ALU | BPF_RSH | BPF_K, 0, 0, 4 },
+        { BPF_JMP | BPF_JEQ | BPF_K, 0, 4, 4 },         /* IPv4, or to the IPv6 test */
+        { BPF_LD | BPF_H | BPF_ABS, 0, 0, 6 },          /* fragment offset */
+        { BPF_JMP | BPF_JSET | BPF_K, 6, 0, 0x1fff },   /* later fragment: drop */
+        { BPF_LD | BPF_B | BPF_ABS, 0, 0, 9 },          /* protocol */
+        { BPF_JMP | BPF_JEQ | BPF_K, 3, 4, IPPROTO_UDP },
+        { BPF_JMP | BPF_JEQ | BPF_K, 0, 3, 6 },         /* IPv6 */
+        { BPF_LD | BPF_B | BPF_ABS, 0, 0, 6 },          /* next header */
+        { BPF_JMP | BPF_JEQ | BPF_K, 0, 1, IPPROTO_UDP },
+        { BPF_RET | BPF_K, 0, 0, 0xffffffff },          /* accept */
+        { BPF_RET | BPF_K, 0, 0, 0 },                   /* drop */
+    };
+    struct sock_fprog program;
+
+    program.len = sizeof (udp) / sizeof (udp[0]);
+    program.filter = udp;
+    if (setsockopt (sockId, SOL_SOCKET, SO_ATTACH_FILTER, &program, sizeof (program)) < 0) {
+        printf ("setsockopt(SO_ATTACH_FILTER) failed, error: %s\n", strerror (errno));
+        return -1;
+    }
+    return 0;
+}
+
+
+/* Fills 'd' with the UDP datagram of the 'length' bytes of 'packet', from
+ * the network header. Returns 0, or -1 if it is not a whole UDP datagram */
+static int _parse (const unsigned char *packet, int length, struct pringDatagram *d)
+{
+    const unsigned char *udp;
+    int header, udpLength;
+
+    if (length < 1) {
+        return -1;
+    }
+    if ((packet[0] >> 4) == 4) {
+        header = (packet[0] & 0x0f) * 4;
+        if (length < header + 8 || header < 20 || packet[9] != IPPROTO_UDP) {
+            return -1;
+        }
+        d->family = AF_INET;
+        d->source = packet + 12;
+        d->destination = packet + 16;
+    } else if ((packet[0] >> 4) == 6) {
+        header = 40;
+        if (length < header + 8 || packet[6] != IPPROTO_UDP) {
+            return -1;
+        }
+        d->family = AF_INET6;
+        d->source = packet + 8;
+        d->destination = packet + 24;
+    } else {
+        return -1;
+    }
+    udp = packet + header;
+    d->sourcePort = (udp[0] << 8) | udp[1];
+    d->destinationPort = (udp[2] << 8) | udp[3];
+    udpLength = (udp[4] << 8) | udp[5];
+    if (udpLength < 8 || udpLength > length - header) {
+        return -1;      /* truncated */
+    }
+    d->payload = udp + 8;
+    d->length = udpLength - 8;
+    return 0;
+}
+
+
+/*=====================================================================*/
+void *pring_open (const char *interface, int blockSize, int blocks)
+{
+    struct packetRing *r;
+    struct tpacket_req3 req;
+    struct sockaddr_ll local;
+    int version = TPACKET_V3;
+
+    if (blockSize < FRAME_SIZE || blockSize % getpagesize () != 0 || blocks < 1) {
+        printf ("Invalid ring: %d blocks of %d bytes (a multiple of %d)\n", blocks, blockSize, getpagesize ());
+        return NULL;
+    }
+    if ((r = calloc (1, sizeof (struct packetRing))) == NULL) {
+        printf ("Error reserving memory in packetRing\n");
+        return NULL;
+    }
+    r->map = MAP_FAILED;
+    r->blockSize = blockSize;
+    r->blocks = blocks;
+
+    memset (&local, 0, sizeof (local));
+    local.sll_family = AF_PACKET;
+    local.sll_protocol = htons (ETH_P_ALL);
+    if (interface != NULL && interface[0] != '\0' && (local.sll_ifindex = if_nametoindex (interface)) == 0) {
+        printf ("Unknown interface %s\n", interface);
+        pring_close (r);
+        return NULL;
+    }
+    /* protocol 0: nothing is captured until the ring and the filter are ready, in bind */
+    if ((r->sockId = socket (AF_PACKET, SOCK_DGRAM, 0)) < 0) {
+        printf ("socket(AF_PACKET) error: %s%s\n", strerror (errno), (errno == EPERM) ? " (CAP_NET_RAW is needed)" : "");
+        free (r);
+        return NULL;
+    }
+    if (setsockopt (r->sockId, SOL_PACKET, PACKET_VERSION, &version, sizeof (version)) < 0) {
+        printf ("setsockopt(PACKET_VERSION) failed: %s\n", strerror (errno));
+        pring_close (r);
+        return NULL;
+    }
+    memset (&req, 0, sizeof (req));
+    req.tp_block_size = blockSize;
+    req.tp_block_nr = blocks;
+    req.tp_frame_size = FRAME_SIZE;
+    req.tp_frame_nr = (blockSize / FRAME_SIZE) * blocks;
+    req.tp_retire_blk_tov = PRING_RETIRE_MS;
+    if (setsockopt (r->sockId, SOL_PACKET, PACKET_RX_RING, &req, sizeof (req)) < 0) {
+        printf ("setsockopt(PACKET_RX_RING) failed: %s\n", strerror (errno));
+        pring_close (r);
+        return NULL;
+    }
+    if ((r->map = mmap (NULL, (size_t) blockSize * blocks, PROT_READ | PROT_WRITE, MAP_SHARED, r->sockId, 0)) == MAP_FAILED) {
+        printf ("mmap of the packet ring failed: %s\n", strerror (errno));
+        pring_close (r);
+        return NULL;
+    }
+    if (_attachUdpFilter (r->sockId) < 0) {
+        pring_close (r);
+        return NULL;
+    }
+    if (bind (r->sockId, (struct sockaddr *) &local, sizeof (local)) < 0) {
+        printf ("bind(AF_PACKET) error: %s\n", strerror (errno));
+        pring_close (r);
+        return NULL;
+    }
+    return r;
+}
+
+
+int pring_next_block (void *ring, int timeoutMs, PRING_HANDLER *handler, void *context)
+{
+    struct packetRing *r = ring;
+    struct tpacket_block_desc *block = (struct tpacket_block_desc *) (r->map + (size_t) r->current * r->blockSize);
+    const struct tpacket3_hdr *packet;
+    struct pringDatagram d;
+    unsigned int i, count = 0;
+
+    if (!(__atomic_load_n (&block->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER)) {
+        struct pollfd p = { r->sockId, POLLIN | POLLERR, 0 };
+        if (poll (&p, 1, timeoutMs) < 0 && errno != EINTR) {
+            printf ("poll error: %s\n", strerror (errno));
+            return -1;
+        }
+        if (!(__atomic_load_n (&block->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER)) {
+            return 0;
+        }
+    }
+
+    packet = (const struct tpacket3_hdr *) ((unsigned char *) block + block->hdr.bh1.offset_to_first_pkt);
+    for (i = 0; i < block->hdr.bh1.num_pkts; i++) {
+        const struct sockaddr_ll *link = (const struct sockaddr_ll *) ((const unsigned char *) packet + TPACKET_ALIGN (sizeof (struct tpacket3_hdr)));
+        if (link->sll_pkttype != PACKET_OUTGOING
+                && _parse ((const unsigned char *) packet + packet->tp_net, packet->tp_snaplen, &d) == 0) {
+            d.time.tv_sec = packet->tp_sec;
+            d.time.tv_nsec = packet->tp_nsec;
+            handler (context, &d);
+            count++;
+        }
+        packet = (const struct tpacket3_hdr *) ((const unsigned char *) packet + packet->tp_next_offset);
+    }
+
+    /* back to the kernel, after everything was read */
+    __atomic_store_n (&block->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+    r->current = (r->current + 1) % r->blocks;
+    return count;
+}
+
+
+void pring_stats (void *ring, unsigned long long *packets, unsigned long long *drops)
+{
+    struct packetRing *r = ring;
+    struct tpacket_stats_v3 stats;
+    socklen_t length = sizeof (stats);
+
+    /* the kernel resets its counters when they are read */
+    if (getsockopt (r->sockId, SOL_PACKET, PACKET_STATISTICS, &stats, &length) == 0) {
+        r->packets += stats.tp_packets;
+        r->drops += stats.tp_drops;
+    }
+    *packets = r->packets;
+    *drops = r->drops;
+}
+
+
+void pring_close (void *ring)
+{
+    struct packetRing *r = ring;
+
+    if (r->map != MAP_FAILED) {
+        munmap (r->map, (size_t) r->blockSize * r->blocks);
+    }
+    if (r->sockId >= 0) {
+        close (r->sockId);
+    }
+    free (r);
+}
+
+
+/* TEST for packetRing functions.
+ * To execute it (as root, or with CAP_NET_RAW), use following code  */
+
+/* #include "packetRing.h"
+void _pring_test_loopback(void);
+void main (void)
+{
+    _pring_test_loopback();
+} */
+
+
+#define TEST_DATAGRAMS 1000
+
+struct testCount {
+    int port;
+    int datagrams;
+    int wrong;
+};
+
+static void _testHandler (void *context, const struct pringDatagram *d)
+{
+    struct testCount *c = context;
+
+    if (d->family != AF_INET || d->destinationPort != c->port) {
+        return;     /* other traffic of the host */
+    }
+    /* each payload is its number, once */
+    if (d->length != sizeof (int) || memcmp (d->payload, &c->datagrams, sizeof (int)) != 0) {
+        c->wrong++;
+    }
+    c->datagrams++;
+}
+
+
+void _pring_test_loopback (void)
+{
+    struct sockaddr_in address;
+    socklen_t length = sizeof (address);
+    struct testCount count = { 0, 0, 0 };
+    void *r = pring_open ("lo", 1 << 16, 8);
+    int in, out, i, tries, errors = 0;
+    unsigned long long packets, drops;
+
+    if (r == NULL) {
+        exit (1);
+    }
+    /* a socket bound to a port, so that the datagrams are not answered with ICMP */
+    in = socket (AF_INET, SOCK_DGRAM, 0);
+    out = socket (AF_INET, SOCK_DGRAM, 0);
+    memset (&address, 0, sizeof (address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+    if (in < 0 || out < 0 || bind (in, (struct sockaddr *) &address, sizeof (address)) < 0
+            || getsockname (in, (struct sockaddr *) &address, &length) < 0) {
+        printf ("_pring_test_loopback: cannot open the loopback sockets\n");
+        exit (1);
+    }
+    count.port = ntohs (address.sin_port);
+
+    /* 1: every datagram, once (not the outgoing copy), in order, in place */
+    for (i = 0; i < TEST_DATAGRAMS; i++) {
+        sendto (out, &i, sizeof (i), 0, (struct sockaddr *) &address, sizeof (address));
+    }
+    for (tries = 0; tries < 100 && count.datagrams < TEST_DATAGRAMS; tries++) {
+        if (pring_next_block (r, 20, _testHandler, &count) < 0) {
+            exit (1);
+        }
+    }
+    if (count.datagrams != TEST_DATAGRAMS || count.wrong != 0) {
+        printf ("_pring_test_loopback: %d datagrams captured (%d wrong) of %d\n", count.datagrams, count.wrong, TEST_DATAGRAMS);
+        errors++;
+    }
+
+    /* 2: the kernel counts what it accepted */
+    pring_stats (r, &packets, &drops);
+    if (packets < TEST_DATAGRAMS) {
+        printf ("_pring_test_loopback: the kernel counts %llu packets, %llu drops\n", packets, drops);
+        errors++;
+    }
+    close (in);
+    close (out);
+    pring_close (r);
+
+    if (errors > 0) {
+        exit (1);
+    }
+    printf ("Tests PASSED (number of tests: 2)\n");
+}
@@ -0,0 +1,65 @@
+/* packetRing.h */
+
+/* Passive capture of UDP datagrams with a memory-mapped AF_PACKET ring
+ * (PACKET_MMAP, TPACKET_V3): the kernel writes the datagrams of an
+ * interface (or of all of them) in blocks of a ring shared with the process,
+ * and the process reads each block in place, with one poll for many
+ * datagrams and no copy. No group is joined and no port is bound: the
+ * traffic is observed as it crosses the interface, so the groups must be
+ * received by the host for another reason (another process joined them,
+ * or the switch floods them).
+ * A classic BPF filter on the socket keeps only UDP over IPv4 (first
+ * fragments) and IPv6 (without extension headers). Datagrams sent by the
+ * host are seen once: the copy being sent (PACKET_OUTGOING) is skipped, the
+ * local delivery (loopback, multicast loop) is not.
+ * A block is returned to the kernel when it is full or PRING_RETIRE_MS after
+ * its first datagram; if all the blocks are in the process, the kernel drops
+ * (see pring_stats).
+ * Requires CAP_NET_RAW.
+ * Restrictions
+ * - Use only in single-thread code, as circularBuffer.
+ */
+
+#ifndef PACKET_RING_H
+#define PACKET_RING_H
+
+#include <time.h>
+
+#define PRING_BLOCK_SIZE (1 << 20)  /* bytes, a multiple of the page size */
+#define PRING_BLOCKS 32
+#define PRING_RETIRE_MS 10
+
+/* A datagram captured, valid only during the call to the handler: it points into the ring */
+struct pringDatagram {
+    int family;                         /* AF_INET or AF_INET6 */
+    const unsigned char *source;        /* address, 4 or 16 bytes in network order */
+    const unsigned char *destination;
+    int sourcePort;
+    int destinationPort;
+    const unsigned char *payload;       /* UDP payload */
+    int length;                         /* bytes of payload */
+    struct timespec time;               /* when the kernel received it (CLOCK_REALTIME) */
+};
+
+typedef void PRING_HANDLER (void *context, const struct pringDatagram *datagram);
+
+/* Opens the ring for 'interface' (name; NULL or "" for all the interfaces),
+ * of 'blocks' blocks of 'blockSize' bytes. Returns a pointer which represents
+ * the ring, to be used by the rest of functions, or NULL on error (a message
+ * is printed). */
+void *pring_open (const char *interface, int blockSize, int blocks);
+
+/* Waits up to 'timeoutMs' for the next block, calls 'handler' with
+ * 'context' for each UDP datagram in it, and returns the block to the kernel.
+ * Returns the datagrams of the block, 0 if no block was filled in time (or
+ * the wait was interrupted by a signal), -1 on error */
+int pring_next_block (void *ring, int timeoutMs, PRING_HANDLER *handler, void *context);
+
+/* Packets accepted by the filter and packets dropped because the ring was
+ * full, since the ring was opened */
+void pring_stats (void *ring, unsigned long long *packets, unsigned long long *drops);
+
+/* Unmaps the ring and closes the socket */
+void pring_close (void *ring);
+
+#endif /* PACKET_RING_H */
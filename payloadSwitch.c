@@ -0,0 +1,430 @@
+/* payloadSwitch.c */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "payloadSwitch.h"
+#include "sampleConvert.h"
+#include "alignedMemory.h"
+#include "asyncLog.h"
+#include "audiocArgs.h"         /* enum payload */
+#include "configureSndcard.h"   /* enum formats */
+
+/* Linear interpolation between consecutive input frames. 'position' is the
+ * position of the next output frame, 16.16 fixed point, in the input of the
+ * current call preceded by the last frame of the previous call (position
+ * 1.0 is the first frame of the current call) */
+struct resampler {
+    uint32_t step;              /* input frames per output frame, 16.16 */
+    int64_t position;
+    int16_t last[2];            /* last frame of the previous call */
+};
+
+/* Preallocated state of each payload of the table */
+struct codecState {
+    const struct payloadDesc *desc;
+    struct resampler toCodec;   /* device rate -> payload rate, sending */
+    struct resampler toDevice;  /* payload rate -> device rate, receiving */
+};
+
+struct payloadSwitch {
+    int count;                  /* payloads in the table */
+    struct codecState *codec;   /* one for each payload of the table */
+    struct codecState *current;
+    int deviceFrames;           /* frames sent in each packet, at the device rate */
+    int maxDeviceFrames;        /* for the packet duration given to psw_create */
+    int maxPayload;
+    int maxPacket;
+    int maxDevice;
+    int16_t *bufferA;           /* intermediate conversions, bufferSamples samples each */
+    int16_t *bufferB;
+};
+
+
+/*=====================================================================*/
+static void _resetResampler (struct resampler *r, int inRate, int outRate)
+{
+    r->step = (uint32_t) (((uint64_t) inRate << 16) / outRate);
+    r->position = 1 << 16;
+    r->last[0] = r->last[1] = 0;
+}
+
+
+/* Converts 'frames' frames of 'channels' interleaved samples. Returns the
+ * number of frames written in 'out' */
+static int _resample (struct resampler *r, int16_t *out, const int16_t *in, int frames, int channels)
+{
+    int64_t end = (int64_t) frames << 16;
+    int written = 0;
+    int c;
+
+    if (frames <= 0) {
+        return 0;
+    }
+    while (r->position < end) {
+        int index = (int) (r->position >> 16);
+        int32_t fraction = (int32_t) (r->position & 0xffff);
+
+        for (c = 0; c < channels; c++) {
+            int32_t a = (index == 0) ? r->last[c] : in[(index - 1) * channels + c];
+            int32_t b = in[index * channels + c];
+            out[written * channels + c] = (int16_t) (a + (int32_t) (((int64_t) (b - a) * fraction) >> 16));
+        }
+        written++;
+        r->position += r->step;
+    }
+    r->position -= end;
+    for (c = 0; c < channels; c++) {
+        r->last[c] = in[(frames - 1) * channels + c];
+    }
+    return written;
+}
+
+
+/* Average of both channels of 'frames' stereo frames */
+static void _downmix (int16_t *mono, const int16_t *stereo, int frames)
+{
+    int i;
+
+    for (i = 0; i < frames; i++) {
+        mono[i] = (int16_t) (((int32_t) stereo[2 * i] + stereo[2 * i + 1]) >> 1);
+    }
+}
+
+
+static void _s16ToU8 (unsigned char *dst, const int16_t *src, int samples)
+{
+    int i;
+
+    for (i = 0; i < samples; i++) {
+        dst[i] = (unsigned char) ((src[i] >> 8) + 128);
+    }
+}
+
+
+static void _u8ToS16 (int16_t *dst, const unsigned char *src, int samples)
+{
+    int i;
+
+    for (i = 0; i < samples; i++) {
+        dst[i] = (int16_t) ((src[i] - 128) << 8);
+    }
+}
+
+
+static void _selectCodec (struct payloadSwitch *sw, struct codecState *codec)
+{
+    if (codec == sw->current) {
+        return;
+    }
+    /* the last frames kept are from a previous use of this payload */
+    _resetResampler (&codec->toCodec, PSW_DEVICE_RATE, codec->desc->rate);
+    _resetResampler (&codec->toDevice, codec->desc->rate, PSW_DEVICE_RATE);
+    sw->current = codec;
+}
+
+
+static struct codecState *_findCodec (struct payloadSwitch *sw, int payload)
+{
+    int i;
+
+    for (i = 0; i < sw->count; i++) {
+        if (sw->codec[i].desc->payload == payload) {
+            return &sw->codec[i];
+        }
+    }
+    return NULL;
+}
+
+
+/*=====================================================================*/
+int psw_device_frame_bytes (int packetDuration)
+{
+    return (int) ((long) PSW_DEVICE_RATE * packetDuration / 1000) * PSW_DEVICE_CHANNELS * PSW_DEVICE_BYTES_PER_SAMPLE;
+}
+
+
+void *psw_create (int payload, int packetDuration, int maxPayload, int flags)
+{
+    struct payloadSwitch *sw;
+    const struct payloadDesc *table;
+    size_t bufferSamples;
+    int upsampling = 1;         /* device rate / lowest rate of the table, rounded up */
+    int i;
+
+    if (packetDuration <= 0 || maxPayload <= 0) {
+        printf ("Invalid payload switch sizes: packet duration %d, payload %d bytes\n", packetDuration, maxPayload);
+        return NULL;
+    }
+    if ((sw = calloc (1, sizeof (struct payloadSwitch))) == NULL) {
+        printf ("Error reserving memory in payloadSwitch\n");
+        return NULL;
+    }
+    table = payload_table (&sw->count);
+    if ((sw->codec = calloc (sw->count, sizeof (struct codecState))) == NULL) {
+        printf ("Error reserving memory in payloadSwitch\n");
+        psw_destroy (sw);
+        return NULL;
+    }
+    sw->deviceFrames = psw_device_frame_bytes (packetDuration) / (PSW_DEVICE_CHANNELS * PSW_DEVICE_BYTES_PER_SAMPLE);
+    sw->maxDeviceFrames = sw->deviceFrames;
+    sw->maxPayload = maxPayload;
+    for (i = 0; i < sw->count; i++) {
+        int packet = RTP_HEADER_SIZE + payload_frame_payload_bytes (&table[i], packetDuration) + 16;
+
+        sw->codec[i].desc = &table[i];
+        if (packet > sw->maxPacket) {
+            sw->maxPacket = packet;
+        }
+        if ((PSW_DEVICE_RATE + table[i].rate - 1) / table[i].rate > upsampling) {
+            upsampling = (PSW_DEVICE_RATE + table[i].rate - 1) / table[i].rate;
+        }
+    }
+    /* a payload of maxPayload bytes has at most maxPayload samples (1 byte per sample) */
+    sw->maxDevice = (maxPayload * upsampling + 1) * PSW_DEVICE_CHANNELS * PSW_DEVICE_BYTES_PER_SAMPLE;
+    bufferSamples = (size_t) maxPayload * upsampling + 2;
+    if (bufferSamples < (size_t) sw->deviceFrames * PSW_DEVICE_CHANNELS + 2) {
+        bufferSamples = (size_t) sw->deviceFrames * PSW_DEVICE_CHANNELS + 2;
+    }
+    sw->bufferA = amem_alloc (bufferSamples * sizeof (int16_t), flags);
+    sw->bufferB = amem_alloc (bufferSamples * sizeof (int16_t), flags);
+    if (sw->bufferA == NULL || sw->bufferB == NULL) {
+        printf ("Error reserving memory in payloadSwitch\n");
+        psw_destroy (sw);
+        return NULL;
+    }
+    if (psw_select (sw, payload) < 0) {
+        printf ("Unrecognized payload number %d\n", payload);
+        psw_destroy (sw);
+        return NULL;
+    }
+    return sw;
+}
+
+
+const struct payloadDesc *psw_current (void *payloadSwitch)
+{
+    return ((struct payloadSwitch *) payloadSwitch)->current->desc;
+}
+
+
+int psw_select (void *payloadSwitch, int payload)
+{
+    struct payloadSwitch *sw = payloadSwitch;
+    struct codecState *codec;
+
+    if ((codec = _findCodec (sw, payload)) == NULL) {
+        return -1;
+    }
+    _selectCodec (sw, codec);
+    return 0;
+}
+
+
+int psw_set_packet_duration (void *payloadSwitch, int packetDuration)
+{
+    struct payloadSwitch *sw = payloadSwitch;
+    int frames = psw_device_frame_bytes (packetDuration) / (PSW_DEVICE_CHANNELS * PSW_DEVICE_BYTES_PER_SAMPLE);
+
+    if (frames <= 0 || frames > sw->maxDeviceFrames) {
+        return -1;
+    }
+    sw->deviceFrames = frames;
+    return 0;
+}
+
+
+int psw_select_next (void *payloadSwitch)
+{
+    struct payloadSwitch *sw = payloadSwitch;
+    int next = (int) (sw->current - sw->codec) + 1;
+
+    _selectCodec (sw, &sw->codec[next % sw->count]);
+    return sw->current->desc->payload;
+}
+
+
+int psw_packetize (void *payloadSwitch, unsigned char *packet, const void *deviceFrame,
+        u_int16 seq, u_int32 ts, u_int32 ssrc, int *samples)
+{
+    struct payloadSwitch *sw = payloadSwitch;
+    struct codecState *codec = sw->current;
+    const struct payloadDesc *desc = codec->desc;
+    const int16_t *audio = deviceFrame;
+    const void *codecAudio;
+
+    if (desc->channels == 1) {
+        _downmix (sw->bufferA, audio, sw->deviceFrames);
+        audio = sw->bufferA;
+    }
+    if (desc->rate != PSW_DEVICE_RATE) {
+        *samples = _resample (&codec->toCodec, sw->bufferB, audio, sw->deviceFrames, desc->channels);
+        audio = sw->bufferB;
+    } else {
+        *samples = sw->deviceFrames;
+    }
+    codecAudio = audio;
+    if (desc->sndCardFormat == U8) {
+        _s16ToU8 ((unsigned char *) sw->bufferA, audio, *samples * desc->channels);
+        codecAudio = sw->bufferA;
+    }
+    return desc->packetize (packet, codecAudio, *samples, seq, ts, ssrc);
+}
+
+
+int psw_depacketize (void *payloadSwitch, void *deviceAudio, const unsigned char *packet, int length)
+{
+    struct payloadSwitch *sw = payloadSwitch;
+    struct codecState *codec;
+    const struct payloadDesc *desc;
+    const rtp_hdr_t *hdr = (const rtp_hdr_t *) packet;
+    int16_t *audio;
+    int16_t *other;             /* the buffer not used by 'audio' */
+    int headerLength;
+    int frames;
+
+    if ((headerLength = payload_header_length (packet, &length)) < 0) {
+        return -1;
+    }
+    if (length - headerLength > sw->maxPayload) {
+        length = headerLength + sw->maxPayload;
+    }
+    if ((codec = _findCodec (sw, hdr->pt)) == NULL) {
+        return -1;
+    }
+    if (codec != sw->current) {
+        /* records hold integers only: the payload number, not its name */
+        alog (ALOG_INFO, "\nPayload changed to %lld\n", codec->desc->payload, 0, 0);
+        _selectCodec (sw, codec);
+    }
+    desc = codec->desc;
+
+    frames = desc->depacketize (sw->bufferA, packet + headerLength, length - headerLength)
+        / (desc->channels * desc->bytesPerSample);
+    audio = sw->bufferA;
+    other = sw->bufferB;
+    if (desc->sndCardFormat == U8) {
+        _u8ToS16 (sw->bufferB, (unsigned char *) sw->bufferA, frames * desc->channels);
+        audio = sw->bufferB;
+        other = sw->bufferA;
+    }
+    if (desc->rate != PSW_DEVICE_RATE) {
+        frames = _resample (&codec->toDevice, other, audio, frames, desc->channels);
+        audio = other;
+    }
+    if (desc->channels == 1) {
+        conv_interleave16 (deviceAudio, audio, audio, frames);
+    } else {
+        memcpy (deviceAudio, audio, (size_t) frames * 2 * sizeof (int16_t));
+    }
+    return frames * PSW_DEVICE_CHANNELS * PSW_DEVICE_BYTES_PER_SAMPLE;
+}
+
+
+int psw_max_packet_bytes (void *payloadSwitch)
+{
+    return ((struct payloadSwitch *) payloadSwitch)->maxPacket;
+}
+
+
+int psw_max_device_bytes (void *payloadSwitch)
+{
+    return ((struct payloadSwitch *) payloadSwitch)->maxDevice;
+}
+
+
+void psw_destroy (void *payloadSwitch)
+{
+    struct payloadSwitch *sw = payloadSwitch;
+
+    free (sw->codec);
+    amem_free (sw->bufferA);
+    amem_free (sw->bufferB);
+    free (sw);
+}
+
+
+/* TEST vectors for psw functions.
+ * To execute them, use following code  */
+
+/* #include "payloadSwitch.h"
+void _psw_test_switch(void);
+void main (void)
+{
+    _psw_test_switch();
+} */
+
+
+void _psw_test_switch (void)
+{
+    /* Each line: payload selected in the sender (the receiver follows the
+     * packets), and expected samples in the packet for 20 ms */
+    int test_vector[][2] = {
+        {L16_2_48K, 960},
+        {PCMU,      160},
+        {L16_1,     882},
+        {PCMA,      160},
+        {L16_1_48K, 960},
+        {L16_2_48K, 960},
+        /* you can add more tests here */
+    };
+    int tests = sizeof (test_vector) / (2 * sizeof (int));
+    int packetDuration = 20;
+    int deviceBytes = psw_device_frame_bytes (packetDuration);
+    void *sender = psw_create (L16_2_48K, packetDuration, 65536, AMEM_DEFAULT);
+    void *receiver = psw_create (PCMU, packetDuration, 65536, AMEM_DEFAULT);
+    int16_t *frame = malloc (deviceBytes);
+    int16_t *played = NULL;
+    unsigned char *packet = NULL;
+    int test, i;
+
+    if (sender == NULL || receiver == NULL || frame == NULL
+            || (packet = malloc (psw_max_packet_bytes (sender))) == NULL
+            || (played = malloc (psw_max_device_bytes (receiver))) == NULL) {
+        exit (1);
+    }
+    /* constant level: every conversion keeps it (except the precision of U8 and A-law) */
+    for (i = 0; i < deviceBytes / 2; i++) {
+        frame[i] = 4096;
+    }
+
+    for (test = 0; test < tests; test++) {
+        int samples, length, bytes, frames;
+
+        if (psw_select (sender, test_vector[test][0]) < 0) {
+            printf ("_psw_test_switch error at test number %d: payload not selected\n", test);
+            exit (1);
+        }
+        /* the first frame after a change starts from silence; check the second one */
+        psw_packetize (sender, packet, frame, test, 0, 0, &samples);
+        length = psw_packetize (sender, packet, frame, test, 0, 0, &samples);
+        psw_depacketize (receiver, played, packet, length);
+        bytes = psw_depacketize (receiver, played, packet, length);
+        frames = bytes / (PSW_DEVICE_CHANNELS * PSW_DEVICE_BYTES_PER_SAMPLE);
+
+        if (samples != test_vector[test][1] || psw_current (receiver)->payload != test_vector[test][0]
+                || frames < deviceBytes / 4 - 1 || frames > deviceBytes / 4 + 1) {
+            printf ("_psw_test_switch error at test number %d: %d samples sent, %d frames played\n", test, samples, frames);
+            exit (1);
+        }
+        for (i = 0; i < frames * PSW_DEVICE_CHANNELS; i++) {
+            if (played[i] < 4096 - 128 || played[i] > 4096 + 128) {
+                printf ("_psw_test_switch error at test number %d: sample %d is %d\n", test, i, played[i]);
+                exit (1);
+            }
+        }
+    }
+    if (psw_select (sender, 1) != -1 || psw_select_next (sender) != PCMU) {
+        printf ("_psw_test_switch error selecting payloads\n");
+        exit (1);
+    }
+    psw_destroy (sender);
+    psw_destroy (receiver);
+    free (frame);
+    free (packet);
+    free (played);
+
+    printf ("Tests PASSED (number of tests: %d)\n", tests);
+}
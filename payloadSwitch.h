@@ -0,0 +1,79 @@
+/* payloadSwitch.h */
+
+/* Changes of payload in the middle of a stream, without reconfiguring the
+ * soundcard. The soundcard is opened once with a fixed format (PSW_DEVICE_*)
+ * and the audio of each payload is converted from/to it: channels (mono is
+ * the average of both channels, and is duplicated for playout), sampling rate
+ * (linear interpolation) and sample format (U8 for PCMU).
+ * The state of every payload of the table (see payloadTable.h) and the
+ * buffers for the conversions are reserved by psw_create, so a change costs
+ * nothing but selecting another descriptor: no allocation, and no silence
+ * while the device is reopened.
+ * Restrictions
+ * - Use only in single-thread code, as circularBuffer.
+ * - Rates are converted without anti-aliasing filter, which is enough for the
+ *   rates of the table (the lowest one is used for speech).
+ */
+
+#ifndef PAYLOAD_SWITCH_H
+#define PAYLOAD_SWITCH_H
+
+#include "rtp.h"
+#include "payloadTable.h"
+
+/* Format of the soundcard, whatever the payload is */
+#define PSW_DEVICE_RATE 48000
+#define PSW_DEVICE_CHANNELS 2
+#define PSW_DEVICE_FORMAT S16_LE        /* see enum formats */
+#define PSW_DEVICE_BYTES_PER_SAMPLE 2
+
+/* Bytes, in the soundcard format, of 'packetDuration' ms of audio */
+int psw_device_frame_bytes (int packetDuration);
+
+/* Returns a pointer which represents the switch, to be used by the rest of
+ * functions, with 'payload' selected. Frames sent have 'packetDuration' ms
+ * (the maximum for psw_set_packet_duration); payloads received have up to
+ * 'maxPayload' bytes. 'flags' are the enum amem_flags for its buffers.
+ * On error (unknown payload, or memory could not be allocated) a message is
+ * printed and NULL is returned. */
+void *psw_create (int payload, int packetDuration, int maxPayload, int flags);
+
+/* Selected payload descriptor */
+const struct payloadDesc *psw_current (void *payloadSwitch);
+
+/* Selects 'payload' for the next packets. Returns 0, or -1 if the payload is
+ * not in the table (the selection does not change) */
+int psw_select (void *payloadSwitch, int payload);
+
+/* Changes the duration of the frames given to psw_packetize. Returns 0, or -1
+ * if 'packetDuration' is greater than the one given to psw_create */
+int psw_set_packet_duration (void *payloadSwitch, int packetDuration);
+
+/* Selects the payload which follows the current one in the table (the first
+ * one after the last). Returns the payload selected */
+int psw_select_next (void *payloadSwitch);
+
+/* Builds in 'packet' an RTP packet with the selected payload, for a frame of
+ * the current packet duration read from the soundcard. 'packet' must have
+ * room for psw_max_packet_bytes bytes. Returns the length of the packet; 'samples'
+ * returns the samples (per channel) sent, to advance the RTP timestamp */
+int psw_packetize (void *payloadSwitch, unsigned char *packet, const void *deviceFrame,
+        u_int16 seq, u_int32 ts, u_int32 ssrc, int *samples);
+
+/* Writes in 'deviceAudio' the soundcard samples of the RTP packet of
+ * 'length' bytes. If the payload type of the packet is not the selected one,
+ * it is selected (and logged with alog). 'deviceAudio' must have room for psw_max_device_bytes bytes.
+ * Returns the number of bytes written, or -1 if the packet is not RTP or its
+ * payload is not in the table */
+int psw_depacketize (void *payloadSwitch, void *deviceAudio, const unsigned char *packet, int length);
+
+/* Maximum length of a packet built by psw_packetize */
+int psw_max_packet_bytes (void *payloadSwitch);
+
+/* Maximum number of bytes written by psw_depacketize */
+int psw_max_device_bytes (void *payloadSwitch);
+
+/* Frees memory of the switch */
+void psw_destroy (void *payloadSwitch);
+
+#endif /* PAYLOAD_SWITCH_H */
@@ -0,0 +1,184 @@
+/* payloadTable.c */
+
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#include "payloadTable.h"
+#include "sampleConvert.h"
+#include "audiocArgs.h"         /* enum payload */
+#include "configureSndcard.h"   /* enum formats */
+
+
+static inline void _putHeader (unsigned char *packet, int payload, u_int16 seq, u_int32 ts, u_int32 ssrc)
+{
+    rtp_hdr_t *hdr = (rtp_hdr_t *) packet;
+
+    hdr->version = RTP_VERSION;
+    hdr->p = 0;
+    hdr->x = 0;
+    hdr->cc = 0;
+    hdr->m = 0;
+    hdr->pt = payload;
+    hdr->seq = htons (seq);
+    hdr->ts = htonl (ts);
+    hdr->ssrc = htonl (ssrc);
+}
+
+
+/* sample conversions between soundcard and payload formats, for 'samples' samples
+ * (all channels). Encoders return the payload bytes, decoders the soundcard bytes */
+static inline int _rawEncode (unsigned char *payload, const void *audio, int samples)
+{
+    memcpy (payload, audio, samples);
+    return samples;
+}
+
+static inline int _rawDecode (void *audio, const unsigned char *payload, int samples)
+{
+    memcpy (audio, payload, samples);
+    return samples;
+}
+
+/* S16_LE from the soundcard, big endian in L16 */
+static inline int _l16Encode (unsigned char *payload, const void *audio, int samples)
+{
+    conv_swap16 (payload, audio, samples);
+    return samples * 2;
+}
+
+static inline int _l16Decode (void *audio, const unsigned char *payload, int samples)
+{
+    conv_swap16 (audio, payload, samples);
+    return samples * 2;
+}
+
+static inline int _alawEncode (unsigned char *payload, const void *audio, int samples)
+{
+    conv_alaw_encode (payload, audio, samples);
+    return samples;
+}
+
+static inline int _alawDecode (void *audio, const unsigned char *payload, int samples)
+{
+    conv_alaw_decode (audio, payload, samples);
+    return samples * 2;
+}
+
+
+/* Generates NAME_packetize and NAME_depacketize for a payload with
+ * PAYLOAD_BYTES bytes per sample. ENCODE/DECODE convert soundcard samples to
+ * payload and back */
+#define PAYLOAD_FUNCTIONS(NAME, PT, CHANNELS, PAYLOAD_BYTES, ENCODE, DECODE)                     \
+    static int NAME##_packetize (unsigned char *packet, const void *audio, int samples,         \
+            u_int16 seq, u_int32 ts, u_int32 ssrc)                                              \
+    {                                                                                           \
+        _putHeader (packet, PT, seq, ts, ssrc);                                                 \
+        return RTP_HEADER_SIZE + ENCODE (packet + RTP_HEADER_SIZE, audio, samples * (CHANNELS)); \
+    }                                                                                           \
+    static int NAME##_depacketize (void *audio, const unsigned char *payload, int length)       \
+    {                                                                                           \
+        return DECODE (audio, payload, length / ((CHANNELS) * (PAYLOAD_BYTES)) * (CHANNELS));   \
+    }
+
+/* Generates a descriptor for a payload, whose functions were generated by PAYLOAD_FUNCTIONS */
+#define PAYLOAD_DESC(NAME, PT, RATE, CHANNELS, FORMAT, BYTES_PER_SAMPLE, PAYLOAD_BYTES) \
+    { PT, #NAME, RATE, CHANNELS, FORMAT, BYTES_PER_SAMPLE, PAYLOAD_BYTES, NAME##_packetize, NAME##_depacketize }
+
+
+/* PCMU: as stated for this lab, 8-bit unsigned samples from the soundcard are sent as they are */
+PAYLOAD_FUNCTIONS (PCMU, PCMU, 1, 1, _rawEncode, _rawDecode)
+PAYLOAD_FUNCTIONS (PCMA, PCMA, 1, 1, _alawEncode, _alawDecode)
+PAYLOAD_FUNCTIONS (L16_2, L16_2, 2, 2, _l16Encode, _l16Decode)
+PAYLOAD_FUNCTIONS (L16_1, L16_1, 1, 2, _l16Encode, _l16Decode)
+PAYLOAD_FUNCTIONS (L16_1_48K, L16_1_48K, 1, 2, _l16Encode, _l16Decode)
+PAYLOAD_FUNCTIONS (L16_2_48K, L16_2_48K, 2, 2, _l16Encode, _l16Decode)
+
+static const struct payloadDesc payloads[] = {
+    /*            name       payload    rate   ch format  bytes, in soundcard / in payload */
+    PAYLOAD_DESC (PCMU,      PCMU,      8000,  1, U8,     1, 1),
+    PAYLOAD_DESC (PCMA,      PCMA,      8000,  1, S16_LE, 2, 1),
+    PAYLOAD_DESC (L16_2,     L16_2,     44100, 2, S16_LE, 2, 2),
+    PAYLOAD_DESC (L16_1,     L16_1,     44100, 1, S16_LE, 2, 2),
+    PAYLOAD_DESC (L16_1_48K, L16_1_48K, 48000, 1, S16_LE, 2, 2),
+    PAYLOAD_DESC (L16_2_48K, L16_2_48K, 48000, 2, S16_LE, 2, 2),
+};
+
+
+/*=====================================================================*/
+const struct payloadDesc *payload_lookup (int payload)
+{
+    unsigned int i;
+
+    for (i = 0; i < sizeof (payloads) / sizeof (payloads[0]); i++) {
+        if (payloads[i].payload == payload) {
+            return &payloads[i];
+        }
+    }
+    return NULL;
+}
+
+
+const struct payloadDesc *payload_table (int *count)
+{
+    *count = sizeof (payloads) / sizeof (payloads[0]);
+    return payloads;
+}
+
+
+int payload_frame_samples (const struct payloadDesc *desc, int packetDuration)
+{
+    return (int) ((long) desc->rate * packetDuration / 1000);
+}
+
+
+int payload_frame_bytes (const struct payloadDesc *desc, int packetDuration)
+{
+    return payload_frame_samples (desc, packetDuration) * desc->channels * desc->bytesPerSample;
+}
+
+
+int payload_frame_payload_bytes (const struct payloadDesc *desc, int packetDuration)
+{
+    return payload_frame_samples (desc, packetDuration) * desc->channels * desc->payloadBytesPerSample;
+}
+
+
+int payload_max_frame_payload_bytes (int packetDuration)
+{
+    unsigned int i;
+    int bytes, max = 0;
+
+    for (i = 0; i < sizeof (payloads) / sizeof (payloads[0]); i++) {
+        if ((bytes = payload_frame_payload_bytes (&payloads[i], packetDuration)) > max) {
+            max = bytes;
+        }
+    }
+    return max;
+}
+
+
+int payload_header_length (const unsigned char *packet, int *length)
+{
+    const rtp_hdr_t *hdr = (const rtp_hdr_t *) packet;
+    int headerLength;
+
+    if (*length < RTP_HEADER_SIZE || hdr->version != RTP_VERSION) {
+        return -1;
+    }
+    headerLength = RTP_HEADER_SIZE + hdr->cc * 4;
+    if (hdr->x) {
+        /* header extension: 16 bits profile, 16 bits length in 32-bit words */
+        if (*length < headerLength + 4) {
+            return -1;
+        }
+        headerLength += 4 + 4 * ((packet[headerLength + 2] << 8) | packet[headerLength + 3]);
+    }
+    if (hdr->p) {
+        *length -= packet[*length - 1];
+    }
+    if (*length < headerLength) {
+        return -1;
+    }
+    return headerLength;
+}
@@ -0,0 +1,67 @@
+/* payloadTable.h */
+
+/* Descriptors of the payloads audioc can send and receive.
+ * Each descriptor has the audio format used with the soundcard for that
+ * payload, and the functions which build an RTP packet from a frame of audio
+ * (packetize) and obtain the audio from the payload of a packet (depacketize).
+ * These functions are generated for each payload by a macro in
+ * payloadTable.c, so that the conversion is inlined with constant parameters:
+ * the per-frame path calls them through the descriptor and has no branches
+ * on the payload type.
+ *
+ * Adding a codec means adding its PAYLOAD_FUNCTIONS and PAYLOAD_DESC lines
+ * in payloadTable.c.
+ */
+
+#ifndef PAYLOAD_TABLE_H
+#define PAYLOAD_TABLE_H
+
+#include "rtp.h"
+
+#define RTP_HEADER_SIZE 12      /* without CSRCs, see rtp_hdr_t */
+
+/* Builds in 'packet' the RTP header and the payload for 'samples' samples (per
+ * channel) of audio read from the soundcard. Returns the length of the packet */
+typedef int PACKETIZE_FUNC (unsigned char *packet, const void *audio, int samples,
+        u_int16 seq, u_int32 ts, u_int32 ssrc);
+
+/* Writes in 'audio' the soundcard samples for a payload of 'length' bytes;
+ * 'audio' must have room for length / payloadBytesPerSample * bytesPerSample bytes.
+ * Returns the number of bytes written */
+typedef int DEPACKETIZE_FUNC (void *audio, const unsigned char *payload, int length);
+
+struct payloadDesc {
+    int payload;                /* RTP payload type, see enum payload */
+    const char *name;
+    int rate;                   /* sampling rate, Hz (also the RTP clock rate) */
+    int channels;
+    int sndCardFormat;          /* see enum formats */
+    int bytesPerSample;         /* per channel, in the soundcard format */
+    int payloadBytesPerSample;  /* per channel, in the RTP payload */
+    PACKETIZE_FUNC *packetize;
+    DEPACKETIZE_FUNC *depacketize;
+};
+
+/* Returns the descriptor of 'payload', or NULL if the payload is not supported */
+const struct payloadDesc *payload_lookup (int payload);
+
+/* Returns the table of descriptors; 'count' returns the number of them */
+const struct payloadDesc *payload_table (int *count);
+
+/* Number of samples (per channel) in 'packetDuration' ms of audio */
+int payload_frame_samples (const struct payloadDesc *desc, int packetDuration);
+
+/* Number of bytes, in the soundcard format, of 'packetDuration' ms of audio */
+int payload_frame_bytes (const struct payloadDesc *desc, int packetDuration);
+
+/* Number of bytes of the RTP payload for 'packetDuration' ms of audio */
+int payload_frame_payload_bytes (const struct payloadDesc *desc, int packetDuration);
+
+/* Largest payload_frame_payload_bytes of the table */
+int payload_max_frame_payload_bytes (int packetDuration);
+
+/* Length of the RTP header of 'packet' (including CSRCs and extension), or -1
+ * if 'length' bytes are not a valid RTP packet. Padding is removed from 'length' */
+int payload_header_length (const unsigned char *packet, int *length);
+
+#endif /* PAYLOAD_TABLE_H */
@@ -0,0 +1,182 @@
+/* reframer.c */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "reframer.h"
+#include "alignedMemory.h"
+
+/* Linear buffer: data is in [start, end). Before each write, the incomplete
+ * block left at 'start' (less than blockSize bytes) is moved to the beginning,
+ * so that there is always room for maxChunkSize bytes after it, and each
+ * block is contiguous. */
+struct reframer {
+    int maxChunkSize;
+    int maxBlockSize;           /* blockSize given to refr_create */
+    int blockSize;
+    int start;
+    int end;
+    unsigned char *data;        /* maxChunkSize + blockSize bytes */
+};
+
+
+/*=====================================================================*/
+void *refr_create (int maxChunkSize, int blockSize, int flags)
+{
+    struct reframer *r;
+
+    if (maxChunkSize <= 0 || blockSize <= 0) {
+        printf ("Invalid reframer sizes: chunks %d, blocks %d\n", maxChunkSize, blockSize);
+        return NULL;
+    }
+    if ((r = malloc (sizeof (struct reframer))) == NULL) {
+        return NULL;
+    }
+    if ((r->data = amem_alloc ((size_t) maxChunkSize + blockSize, flags)) == NULL) {
+        free (r);
+        return NULL;
+    }
+    r->maxChunkSize = maxChunkSize;
+    r->maxBlockSize = r->blockSize = blockSize;
+    r->start = r->end = 0;
+    return r;
+}
+
+
+void *refr_pointer_to_write (void *reframer)
+{
+    struct reframer *r = reframer;
+
+    if (r->end - r->start >= r->blockSize) {
+        return NULL; /* complete blocks not read yet */
+    }
+    if (r->start > 0) {
+        memmove (r->data, r->data + r->start, r->end - r->start);
+        r->end -= r->start;
+        r->start = 0;
+    }
+    return r->data + r->end;
+}
+
+
+void refr_written (void *reframer, int bytes)
+{
+    struct reframer *r = reframer;
+
+    r->end += bytes;
+}
+
+
+void *refr_pointer_to_read (void *reframer)
+{
+    struct reframer *r = reframer;
+    void *block;
+
+    if (r->end - r->start < r->blockSize) {
+        return NULL;
+    }
+    block = r->data + r->start;
+    r->start += r->blockSize;
+    return block;
+}
+
+
+int refr_set_block_size (void *reframer, int blockSize)
+{
+    struct reframer *r = reframer;
+
+    if (blockSize <= 0 || blockSize > r->maxBlockSize) {
+        return -1;
+    }
+    r->blockSize = blockSize;
+    return 0;
+}
+
+
+int refr_pending (void *reframer)
+{
+    struct reframer *r = reframer;
+
+    return r->end - r->start;
+}
+
+
+void refr_destroy (void *reframer)
+{
+    struct reframer *r = reframer;
+
+    amem_free (r->data);
+    free (r);
+}
+
+
+/* TEST for refr functions: device fragments to packet frames and back.
+ * To execute it, use following code  */
+
+/* #include "reframer.h"
+void _refr_test_reframer(void);
+void main (void)
+{
+    _refr_test_reframer();
+} */
+
+
+/* Writes 'total' bytes of a counting sequence in chunks of 'chunk' bytes and
+ * checks that they are read back, in order, in blocks of 'block' bytes */
+static int _refr_test_sizes (int chunk, int block, int total)
+{
+    void *r = refr_create (chunk, block, AMEM_DEFAULT);
+    unsigned char *p;
+    int written = 0, read = 0;
+    int errors = 0;
+    int i;
+
+    if (r == NULL) {
+        printf ("_refr_test_reframer: refr_create failed\n");
+        return 1;
+    }
+    while (written < total) {
+        if ((p = refr_pointer_to_write (r)) == NULL) {
+            printf ("_refr_test_reframer: no room to write with chunk %d, block %d\n", chunk, block);
+            errors++;
+            break;
+        }
+        for (i = 0; i < chunk; i++) {
+            p[i] = (unsigned char) (written + i);
+        }
+        refr_written (r, chunk);
+        written += chunk;
+        while ((p = refr_pointer_to_read (r)) != NULL) {
+            for (i = 0; i < block; i++) {
+                if (p[i] != (unsigned char) (read + i)) {
+                    errors++;
+                }
+            }
+            read += block;
+        }
+    }
+    if (read != written - written % block || refr_pending (r) != written % block) {
+        printf ("_refr_test_reframer: read %d of %d bytes with chunk %d, block %d\n", read, written, chunk, block);
+        errors++;
+    }
+    refr_destroy (r);
+    return errors;
+}
+
+
+void _refr_test_reframer (void)
+{
+    int errors = 0;
+
+    errors += _refr_test_sizes (128, 160, 16000);      /* 8000 Hz U8, -l20, fragment rounded to 128 */
+    errors += _refr_test_sizes (160, 128, 16000);      /* the inverse, for playout */
+    errors += _refr_test_sizes (2048, 1764, 176400);   /* 44100 Hz S16 */
+    errors += _refr_test_sizes (1764, 1764, 17640);
+    errors += _refr_test_sizes (1, 7, 1000);
+    if (errors > 0) {
+        printf ("_refr_test_reframer: %d errors\n", errors);
+    } else {
+        printf ("_refr_test_reframer: OK\n");
+    }
+}
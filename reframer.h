@@ -0,0 +1,44 @@
+/* reframer.h */
+
+/* Converts a stream of chunks of any size (up to a maximum) into blocks of a
+ * fixed size: e.g. soundcard fragments into frames of exactly packetDuration
+ * ms for RTP packets, or received frames into soundcard fragments for playout.
+ * All the memory is reserved by refr_create; data is copied once, when it is
+ * written (e.g. by read()) in the pointer returned by refr_pointer_to_write.
+ * Restrictions
+ * - Use only in single-thread code, as circularBuffer.
+ */
+
+#ifndef REFRAMER_H
+#define REFRAMER_H
+
+/* Returns a pointer which represents the reframer, to be used by the rest of
+ * functions. Chunks are at most 'maxChunkSize' bytes; blocks are 'blockSize' bytes.
+ * 'flags' are the enum amem_flags for its memory (see alignedMemory.h).
+ * On error, memory could not be allocated, returns NULL. */
+void *refr_create (int maxChunkSize, int blockSize, int flags);
+
+/* Returns a pointer where up to maxChunkSize bytes can be written, or NULL if
+ * there is no room for them: the complete blocks must be read first.
+ * The bytes are not in the reframer until refr_written is called. */
+void *refr_pointer_to_write (void *reframer);
+
+/* Adds 'bytes' bytes written in the last pointer returned by refr_pointer_to_write */
+void refr_written (void *reframer, int bytes);
+
+/* Returns a pointer to the next complete block, or NULL if there is none.
+ * Moves to the following block; the block is valid until the next call to
+ * refr_pointer_to_write. */
+void *refr_pointer_to_read (void *reframer);
+
+/* Changes the size of the next blocks; the bytes stored are kept. Returns 0,
+ * or -1 if 'blockSize' is greater than the one given to refr_create */
+int refr_set_block_size (void *reframer, int blockSize);
+
+/* Number of bytes stored and not read yet */
+int refr_pending (void *reframer);
+
+/* Frees memory of the reframer */
+void refr_destroy (void *reframer);
+
+#endif /* REFRAMER_H */
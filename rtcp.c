@@ -0,0 +1,277 @@
+/* rtcp.c */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "rtcp.h"
+
+
+static void _put16 (unsigned char *p, u_int32 value)
+{
+    p[0] = (value >> 8) & 0xff;
+    p[1] = value & 0xff;
+}
+
+static void _put32 (unsigned char *p, u_int32 value)
+{
+    p[0] = (value >> 24) & 0xff;
+    p[1] = (value >> 16) & 0xff;
+    p[2] = (value >> 8) & 0xff;
+    p[3] = value & 0xff;
+}
+
+static u_int32 _get16 (const unsigned char *p)
+{
+    return ((u_int32) p[0] << 8) | p[1];
+}
+
+static u_int32 _get32 (const unsigned char *p)
+{
+    return ((u_int32) p[0] << 24) | ((u_int32) p[1] << 16) | ((u_int32) p[2] << 8) | p[3];
+}
+
+/* first word of each RTCP packet: version, padding 0, count, type, length in 32-bit words minus one */
+static void _putCommon (unsigned char *p, int count, int type, int lengthBytes)
+{
+    p[0] = (RTP_VERSION << 6) | (count & 0x1f);
+    p[1] = type;
+    _put16 (p + 2, lengthBytes / 4 - 1);
+}
+
+
+u_int32 rtcp_now_65536 (void)
+{
+    struct timespec now;
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    return (u_int32) (((unsigned long long) now.tv_sec << 16) + (((unsigned long long) now.tv_nsec << 16) / 1000000000ULL));
+}
+
+
+/*=====================================================================*/
+/* RFC 3550, A.3 */
+static void _putReportBlock (unsigned char *p, struct rtpSource *src, u_int32 now)
+{
+    source *s = &src->state;
+    u_int32 expected = rtps_expected (s);
+    u_int32 expectedInterval = expected - s->expected_prior;
+    u_int32 receivedInterval = s->received - s->received_prior;
+    int lostInterval = (int) (expectedInterval - receivedInterval);
+    int fraction;
+
+    s->expected_prior = expected;
+    s->received_prior = s->received;
+    if (expectedInterval == 0 || lostInterval <= 0) {
+        fraction = 0;
+    } else {
+        fraction = (lostInterval << 8) / expectedInterval;
+    }
+
+    _put32 (p, src->ssrc);
+    _put32 (p + 4, ((u_int32) fraction << 24) | ((u_int32) rtps_lost (s) & 0xffffff));
+    _put32 (p + 8, s->cycles + s->max_seq);
+    _put32 (p + 12, s->jitter >> 4);
+    _put32 (p + 16, src->lsr);
+    _put32 (p + 20, src->lsr ? now - src->lsrArrival : 0);
+}
+
+
+static int _putSdes (unsigned char *p, int size, u_int32 localSsrc, const char *cname)
+{
+    int cnameLength = strlen (cname);
+    int length;
+
+    if (cnameLength > 255) {
+        cnameLength = 255;
+    }
+    /* header, SSRC, CNAME item, END item, padded to 32 bits */
+    length = (4 + 4 + 2 + cnameLength + 1 + 3) & ~3;
+    if (length > size) {
+        return -1;
+    }
+    memset (p, 0, length);
+    _putCommon (p, 1, RTCP_SDES, length);
+    _put32 (p + 4, localSsrc);
+    p[8] = RTCP_SDES_CNAME;
+    p[9] = cnameLength;
+    memcpy (p + 10, cname, cnameLength);
+    return length;
+}
+
+
+int rtcp_build_rr (unsigned char *buffer, int size, u_int32 localSsrc,
+        struct rtpSourceTable *table, const char *cname)
+{
+    u_int32 now = rtcp_now_65536 ();
+    int offset = 0;
+    int slot = 0;
+    int capacity = rtps_capacity (table);
+    int sdesLength;
+
+    do {
+        /* one RR packet with up to RTCP_MAX_REPORTS blocks */
+        unsigned char *rr = buffer + offset;
+        int count = 0;
+
+        if (offset + 8 > size) {
+            return -1;
+        }
+        _put32 (rr + 4, localSsrc);
+        while (slot < capacity && count < RTCP_MAX_REPORTS && offset + 8 + (count + 1) * 24 <= size) {
+            struct rtpSource *src = rtps_get (table, slot);
+            slot++;
+            if (src == NULL || src->state.probation) {
+                continue;
+            }
+            _putReportBlock (rr + 8 + count * 24, src, now);
+            count++;
+        }
+        _putCommon (rr, count, RTCP_RR, 8 + count * 24);
+        offset += 8 + count * 24;
+        if (count < RTCP_MAX_REPORTS) {
+            break; /* no more sources, or no more room */
+        }
+    } while (slot < capacity);
+
+    if ((sdesLength = _putSdes (buffer + offset, size - offset, localSsrc, cname)) < 0) {
+        return -1;
+    }
+    return offset + sdesLength;
+}
+
+
+int rtcp_build_bye (unsigned char *buffer, int size, u_int32 localSsrc)
+{
+    if (size < 16) {
+        return -1;
+    }
+    _putCommon (buffer, 0, RTCP_RR, 8);
+    _put32 (buffer + 4, localSsrc);
+    _putCommon (buffer + 8, 1, RTCP_BYE, 8);
+    _put32 (buffer + 12, localSsrc);
+    return 16;
+}
+
+
+/*=====================================================================*/
+static void _parseReportBlocks (const unsigned char *p, int count, u_int32 reporter, u_int32 localSsrc, struct rtcpReceived *out)
+{
+    int i;
+
+    for (i = 0; i < count; i++, p += 24) {
+        struct rtcpReport *r;
+        int lost;
+
+        if (_get32 (p) != localSsrc || out->reports == RTCP_MAX_REPORTS) {
+            continue;
+        }
+        r = &out->report[out->reports++];
+        r->reporter = reporter;
+        r->fractionLost = p[4];
+        lost = (int) (_get32 (p + 4) & 0xffffff);
+        if (lost & 0x800000) {
+            lost -= 0x1000000; /* sign extension of 24 bits */
+        }
+        r->cumulativeLost = lost;
+        r->highestSeq = _get32 (p + 8);
+        r->jitter = _get32 (p + 12);
+        r->lsr = _get32 (p + 16);
+        r->dlsr = _get32 (p + 20);
+    }
+}
+
+
+static void _parseSdes (const unsigned char *base, const unsigned char *end, int count, struct rtpSourceTable *table)
+{
+    const unsigned char *p = base;
+    int chunk;
+
+    for (chunk = 0; chunk < count && p + 4 <= end; chunk++) {
+        struct rtpSource *src = rtps_find (table, _get32 (p));
+        p += 4;
+        /* items until END (type 0), then padding to the next 32-bit boundary */
+        while (p < end && *p != RTCP_SDES_END) {
+            int type, length;
+            if (p + 2 > end || p + 2 + p[1] > end) {
+                return;
+            }
+            type = p[0];
+            length = p[1];
+            if (src != NULL && (type == RTCP_SDES_CNAME || type == RTCP_SDES_TOOL)) {
+                char *dest = (type == RTCP_SDES_CNAME) ? src->state.CNAME : src->state.TOOL;
+                if (length > MAX_LEN_SDES_ITEM - 1) {
+                    length = MAX_LEN_SDES_ITEM - 1;
+                }
+                memcpy (dest, p + 2, length);
+                dest[length] = '\0';
+            }
+            p += 2 + p[1];
+        }
+        /* END byte plus padding, chunks are aligned to 32 bits from the start of the packet */
+        p = base + (((p - base) + 1 + 3) & ~3);
+    }
+}
+
+
+int rtcp_parse (const unsigned char *packet, int length, u_int32 localSsrc,
+        struct rtpSourceTable *table, struct rtcpReceived *out)
+{
+    const unsigned char *p = packet;
+    const unsigned char *end = packet + length;
+
+    out->reports = 0;
+    out->byes = 0;
+
+    /* first packet of a compound must be SR or RR, without padding */
+    if (length < 8 || (p[0] >> 6) != RTP_VERSION || (p[0] & 0x20) || (p[1] != RTCP_SR && p[1] != RTCP_RR)) {
+        return -1;
+    }
+
+    while (p + 4 <= end) {
+        int count = p[0] & 0x1f;
+        int type = p[1];
+        int packetLength = (_get16 (p + 2) + 1) * 4;
+        const unsigned char *next = p + packetLength;
+        struct rtpSource *src;
+        int i;
+
+        if ((p[0] >> 6) != RTP_VERSION || next > end) {
+            return -1;
+        }
+        switch (type) {
+            case RTCP_SR:
+                if (packetLength < 28 + count * 24) {
+                    return -1;
+                }
+                if (table != NULL && (src = rtps_find (table, _get32 (p + 4))) != NULL) {
+                    /* middle 32 bits of the NTP timestamp */
+                    src->lsr = (_get32 (p + 8) << 16) | (_get32 (p + 12) >> 16);
+                    src->lsrArrival = rtcp_now_65536 ();
+                }
+                _parseReportBlocks (p + 28, count, _get32 (p + 4), localSsrc, out);
+                break;
+            case RTCP_RR:
+                if (packetLength < 8 + count * 24) {
+                    return -1;
+                }
+                _parseReportBlocks (p + 8, count, _get32 (p + 4), localSsrc, out);
+                break;
+            case RTCP_SDES:
+                if (table == NULL) {
+                    break;
+                }
+                _parseSdes (p + 4, next, count, table);
+                break;
+            case RTCP_BYE:
+                for (i = 0; i < count && p + 8 + i * 4 <= next && out->byes < RTCP_MAX_BYE; i++) {
+                    out->bye[out->byes++] = _get32 (p + 4 + i * 4);
+                }
+                break;
+            default:
+                break; /* APP and unknown types are ignored */
+        }
+        p = next;
+    }
+    return 0;
+}
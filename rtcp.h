@@ -0,0 +1,64 @@
+/* rtcp.h */
+
+/* Builds and parses RTCP compound packets (RFC 3550, section 6).
+ * Packets are serialized byte by byte in network order; the bit fields of
+ * the structures in rtp.h are not used because their layout depends on the
+ * compiler. Information about remote sources (SR timestamps, SDES items) is
+ * stored in their entry of a source table (see rtpSource.h). */
+
+#ifndef RTCP_H
+#define RTCP_H
+
+#include "rtp.h"
+#include "rtpSource.h"
+
+#define RTCP_MAX_PACKET 1500
+#define RTCP_MAX_REPORTS 31     /* report blocks in a single SR/RR */
+#define RTCP_MAX_BYE 31
+
+/* report block about one of our own streams, received in an SR or RR */
+struct rtcpReport {
+    u_int32 reporter;           /* SSRC of the receiver sending the report */
+    int fractionLost;           /* fraction lost since the previous report, in 1/256 units */
+    int cumulativeLost;
+    u_int32 highestSeq;         /* extended highest sequence number received */
+    u_int32 jitter;             /* interarrival jitter, RTP timestamp units */
+    u_int32 lsr;
+    u_int32 dlsr;
+};
+
+/* information extracted by rtcp_parse which is not stored in the source table */
+struct rtcpReceived {
+    int reports;
+    struct rtcpReport report[RTCP_MAX_REPORTS];
+    int byes;
+    u_int32 bye[RTCP_MAX_BYE];  /* SSRCs leaving the session */
+};
+
+/* Current time in 1/65536 s units, the unit of the DLSR field (monotonic clock) */
+u_int32 rtcp_now_65536 (void);
+
+/* Builds a compound packet with RR packets (one report block per source of
+ * 'table' which is not on probation; several RR packets if there are more than
+ * RTCP_MAX_REPORTS sources) followed by an SDES packet with 'cname'.
+ * Updates the interval counters of the sources (expected_prior, received_prior).
+ * Returns the length of the compound packet, or -1 if 'size' is too small. */
+int rtcp_build_rr (unsigned char *buffer, int size, u_int32 localSsrc,
+        struct rtpSourceTable *table, const char *cname);
+
+/* Builds a BYE packet for 'localSsrc' (preceded by an empty RR, as required for compound packets).
+ * Returns the length of the packet */
+int rtcp_build_bye (unsigned char *buffer, int size, u_int32 localSsrc);
+
+/* Parses a compound packet.
+ * - SR: stores the NTP timestamp (LSR) and its arrival time in the source entry of the sender
+ * - SR/RR: report blocks about 'localSsrc' are returned in 'out'
+ * - SDES: CNAME and TOOL are stored in the source entry
+ * - BYE: SSRCs are returned in 'out'
+ * Sources that are not in 'table' are ignored (they are created only by RTP packets).
+ * 'table' may be NULL, e.g. in a sender which only needs the reports.
+ * Returns 0, or -1 if the packet is not a valid compound packet. */
+int rtcp_parse (const unsigned char *packet, int length, u_int32 localSsrc,
+        struct rtpSourceTable *table, struct rtcpReceived *out);
+
+#endif /* RTCP_H */
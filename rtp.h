@@ -4,6 +4,9 @@
 
 /* Modified for use in UC3M lab */
 
+#ifndef RTP_H
+#define RTP_H
+
 #include "types.h"   /* changed from <sys/types.h> by Akira 12/27/01 */
 #include "sysdep.h"
 
@@ -204,3 +207,5 @@ typedef struct {
   char CNAME[MAX_LEN_SDES_ITEM]; /* stores the last CNAME value advertised by the peer. Must be a '\0' terminated string. */
   char TOOL[MAX_LEN_SDES_ITEM]; /* stores the last TOOL value advertised by the peer. Must be a '\0' terminated string. */
 } source;
+
+#endif /* RTP_H */
@@ -0,0 +1,212 @@
+/* rtpFilter.c */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/socket.h>
+
+#include "rtpFilter.h"
+#include "payloadTable.h"
+#include "audiocArgs.h"     /* enum payload */
+
+/* offsets from the UDP header */
+#define UDP_HEADER 8
+#define RTP_FIRST_BYTE (UDP_HEADER + 0)     /* V, P, X, CC */
+#define RTP_SECOND_BYTE (UDP_HEADER + 1)    /* M, PT */
+#define RTP_SSRC (UDP_HEADER + 8)
+
+#define ACCEPT 0xffffffff       /* return value: the whole datagram */
+#define DROP 0
+
+struct rtpFilter {
+    int mode;                   /* enum rflt_ssrc_mode */
+    int count;
+    u_int32 ssrc[RFLT_MAX_SSRCS];
+};
+
+
+/*=====================================================================*/
+void *rflt_create (void)
+{
+    struct rtpFilter *f;
+
+    if ((f = calloc (1, sizeof (struct rtpFilter))) == NULL) {
+        printf ("Error reserving memory in rtpFilter\n");
+        return NULL;
+    }
+    f->mode = RFLT_ANY_SSRC;
+    return f;
+}
+
+
+int rflt_set_ssrcs (void *filter, int mode, const u_int32 *ssrcs, int count)
+{
+    struct rtpFilter *f = filter;
+
+    if (count < 0 || count > RFLT_MAX_SSRCS) {
+        printf ("rtpFilter: %d SSRCs, %d at most\n", count, RFLT_MAX_SSRCS);
+        return -1;
+    }
+    f->mode = (count > 0) ? mode : RFLT_ANY_SSRC;
+    f->count = (mode == RFLT_ANY_SSRC) ? 0 : count;
+    memcpy (f->ssrc, ssrcs, f->count * sizeof (u_int32));
+    return 0;
+}
+
+
+/* Jumps are relative to the next instruction, and at most 255 ahead: the
+ * chains of comparisons jump over the rest of the chain and one instruction */
+int rflt_compile (const void *filter, struct sock_filter *program, int size)
+{
+    const struct rtpFilter *f = filter;
+    const struct payloadDesc *table;
+    int payloads, i, n = 0;
+
+    table = payload_table (&payloads);
+    if (payloads + f->count + 10 > size || payloads + f->count + 10 > 255) {
+        return -1;
+    }
+
+    /* version 2 */
+    program[n++] = (struct sock_filter) { BPF_LD | BPF_B | BPF_ABS, 0, 0, RTP_FIRST_BYTE };
+    program[n++] = (struct sock_filter) { BPF_ALU | BPF_AND | BPF_K, 0, 0, 0xc0 };
+    program[n++] = (struct sock_filter) { BPF_JMP | BPF_JEQ | BPF_K, 1, 0, RTP_VERSION << 6 };
+    program[n++] = (struct sock_filter) { BPF_RET | BPF_K, 0, 0, DROP };
+
+    /* payload type of the table: to the SSRC, after the drop which ends the chain */
+    program[n++] = (struct sock_filter) { BPF_LD | BPF_B | BPF_ABS, 0, 0, RTP_SECOND_BYTE };
+    program[n++] = (struct sock_filter) { BPF_ALU | BPF_AND | BPF_K, 0, 0, 0x7f };
+    for (i = 0; i < payloads; i++) {
+        program[n++] = (struct sock_filter) { BPF_JMP | BPF_JEQ | BPF_K, payloads - i, 0, table[i].payload };
+    }
+    program[n++] = (struct sock_filter) { BPF_RET | BPF_K, 0, 0, DROP };
+
+    /* the SSRC is loaded even without a list: a datagram shorter than the
+     * fixed header fails the load, and is dropped */
+    program[n++] = (struct sock_filter) { BPF_LD | BPF_W | BPF_ABS, 0, 0, RTP_SSRC };
+    for (i = 0; i < f->count; i++) {
+        program[n++] = (struct sock_filter) { BPF_JMP | BPF_JEQ | BPF_K, f->count - i, 0, f->ssrc[i] };
+    }
+    /* not in the list, then in the list */
+    program[n++] = (struct sock_filter) { BPF_RET | BPF_K, 0, 0, (f->mode == RFLT_ALLOW) ? DROP : ACCEPT };
+    program[n++] = (struct sock_filter) { BPF_RET | BPF_K, 0, 0, (f->mode == RFLT_DENY) ? DROP : ACCEPT };
+    return n;
+}
+
+
+int rflt_attach (const void *filter, int sockId)
+{
+    struct sock_filter instructions[RFLT_MAX_INSTRUCTIONS];
+    struct sock_fprog program;
+    int length;
+
+    if ((length = rflt_compile (filter, instructions, RFLT_MAX_INSTRUCTIONS)) < 0) {
+        printf ("rtpFilter: the program does not fit in %d instructions\n", RFLT_MAX_INSTRUCTIONS);
+        return -1;
+    }
+    program.len = length;
+    program.filter = instructions;
+    if (setsockopt (sockId, SOL_SOCKET, SO_ATTACH_FILTER, &program, sizeof (program)) < 0) {
+        printf ("setsockopt(SO_ATTACH_FILTER) failed, error: %s\n", strerror (errno));
+        return -1;
+    }
+    return 0;
+}
+
+
+void rflt_destroy (void *filter)
+{
+    free (filter);
+}
+
+
+/* TEST for rtpFilter functions.
+ * To execute it, use following code  */
+
+/* #include "rtpFilter.h"
+void _rflt_test_socket(void);
+void main (void)
+{
+    _rflt_test_socket();
+} */
+
+
+#include <unistd.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+/* Sends a datagram of 'length' bytes with the first bytes of an RTP header
+ * from 'out' to 'in', and returns 1 if 'in' received it */
+static int _testPass (int out, int in, const struct sockaddr_in *to, int first, int pt, u_int32 ssrc, int length)
+{
+    unsigned char packet[64], buffer[64];
+    u_int32 ssrcNet = htonl (ssrc);
+
+    memset (packet, 0, sizeof (packet));
+    packet[0] = first;
+    packet[1] = pt;
+    memcpy (packet + 8, &ssrcNet, sizeof (ssrcNet));
+    sendto (out, packet, length, 0, (const struct sockaddr *) to, sizeof (*to));
+    /* loopback delivers before sendto returns */
+    return recv (in, buffer, sizeof (buffer), MSG_DONTWAIT) == length;
+}
+
+
+void _rflt_test_socket (void)
+{
+    /* Each line is a datagram: first byte, payload type, SSRC, length, SSRC list
+     * (0: none, 1: allow {7, 9}, 2: deny {7, 9}), expected to be received */
+    const struct { int first, pt; u_int32 ssrc; int length, list, received; } lines[] = {
+        { 0x80, PCMA, 1, 32, 0, 1 },            /* version 2, payload of the table */
+        { 0x80, 0x80 | PCMU, 1, 32, 0, 1 },     /* marker bit */
+        { 0x90, L16_1, 1, 32, 0, 1 },           /* extension bit */
+        { 0x40, PCMA, 1, 32, 0, 0 },            /* version 1 */
+        { 0x80, 0, 1, 32, 0, 0 },               /* payload type 0 is not in the table */
+        { 0x80, PCMA, 1, 11, 0, 0 },            /* shorter than the fixed header */
+        { 0x80, PCMA, 7, 32, 1, 1 },
+        { 0x80, PCMA, 9, 32, 1, 1 },
+        { 0x80, PCMA, 8, 32, 1, 0 },
+        { 0x80, PCMA, 7, 32, 2, 0 },
+        { 0x80, PCMA, 8, 32, 2, 1 },
+        { 0x80, 0, 8, 32, 2, 0 },
+    };
+    const u_int32 list[] = { 7, 9 };
+    struct sockaddr_in address;
+    socklen_t length = sizeof (address);
+    void *f = rflt_create ();
+    int in, out, test, current = -1, errors = 0;
+
+    in = socket (AF_INET, SOCK_DGRAM, 0);
+    out = socket (AF_INET, SOCK_DGRAM, 0);
+    memset (&address, 0, sizeof (address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+    if (in < 0 || out < 0 || bind (in, (struct sockaddr *) &address, sizeof (address)) < 0
+            || getsockname (in, (struct sockaddr *) &address, &length) < 0) {
+        printf ("_rflt_test_socket: cannot open the loopback sockets\n");
+        exit (1);
+    }
+    for (test = 0; test < (int) (sizeof (lines) / sizeof (lines[0])); test++) {
+        if (lines[test].list != current) {
+            /* the program is replaced in the socket */
+            current = lines[test].list;
+            rflt_set_ssrcs (f, (current == 1) ? RFLT_ALLOW : RFLT_DENY, list, (current == 0) ? 0 : 2);
+            if (rflt_attach (f, in) < 0) {
+                exit (1);
+            }
+        }
+        if (_testPass (out, in, &address, lines[test].first, lines[test].pt, lines[test].ssrc, lines[test].length) != lines[test].received) {
+            printf ("_rflt_test_socket error at test number %d: %s\n", test, lines[test].received ? "dropped" : "received");
+            errors++;
+        }
+    }
+    close (in);
+    close (out);
+    rflt_destroy (f);
+
+    if (errors > 0) {
+        exit (1);
+    }
+    printf ("Tests PASSED (number of tests: %d)\n", test);
+}
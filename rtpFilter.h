@@ -0,0 +1,53 @@
+/* rtpFilter.h */
+
+/* Classic BPF program for an RTP receiving socket (SO_ATTACH_FILTER), run
+ * by the kernel before a datagram is queued: what it drops is neither
+ * copied to user space nor counted in the socket buffer, nor does it wake
+ * up the receiver. It accepts only datagrams with
+ * - RTP version 2 and at least a fixed header (12 bytes)
+ * - one of the payload types of the payload table (see payloadTable.h)
+ * - an SSRC of the allow list, or not of the deny list, if there is one
+ * The lists can be changed at any time: rflt_attach replaces the program
+ * of the socket atomically.
+ * As the program of shardedReceiver, it sees the datagram from the UDP
+ * header, so it works for IPv4 and IPv6. SRTP headers are in clear, so it
+ * also filters SRTP.
+ */
+
+#ifndef RTP_FILTER_H
+#define RTP_FILTER_H
+
+#include <linux/filter.h>
+#include "rtp.h"
+
+#define RFLT_MAX_SSRCS 64
+#define RFLT_MAX_INSTRUCTIONS 128   /* longest program, enough for the payload table and RFLT_MAX_SSRCS */
+
+enum rflt_ssrc_mode {
+    RFLT_ANY_SSRC,              /* no SSRC list */
+    RFLT_ALLOW,                 /* only the SSRCs listed */
+    RFLT_DENY                   /* every SSRC but the ones listed */
+};
+
+/* Returns a pointer which represents the filter, to be used by the rest of
+ * functions, accepting the payload types of the table from any SSRC.
+ * On error, memory could not be allocated, returns NULL. */
+void *rflt_create (void);
+
+/* Replaces the SSRC list with the 'count' SSRCs of 'ssrcs', as 'mode'
+ * (enum rflt_ssrc_mode; with no SSRCs, RFLT_ANY_SSRC). Returns 0, or -1 if
+ * there are more than RFLT_MAX_SSRCS. rflt_attach applies it */
+int rflt_set_ssrcs (void *filter, int mode, const u_int32 *ssrcs, int count);
+
+/* Writes the program in 'program', of 'size' instructions.
+ * Returns its length, or -1 if it does not fit */
+int rflt_compile (const void *filter, struct sock_filter *program, int size);
+
+/* Compiles the program and attaches it to 'sockId', replacing the one it
+ * had. Returns 0, or -1 on error (a message is printed) */
+int rflt_attach (const void *filter, int sockId);
+
+/* Frees memory of the filter (the program attached stays in the socket) */
+void rflt_destroy (void *filter);
+
+#endif /* RTP_FILTER_H */
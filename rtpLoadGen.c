@@ -0,0 +1,460 @@
+/*
+rtpLoadGen MULTICAST_ADDR [-pPORT] [-nSENDERS] [-yPAYLOAD] [-lPACKET_DURATION] [-jJITTER] [-xLOSS] [-rREORDER] [-sRAMP_STEP] [-iRAMP_INTERVAL] [-dDURATION] [-bBATCH] [-KKEY] [-c]
+
+Synthetic RTP load generator. Emulates SENDERS concurrent RTP sources, each one
+with its own SSRC, sequence number and timestamp space, sending to the
+multicast group/port in which audioc listens. Everything runs in one process:
+senders are scheduled in a timer wheel with 1 ms ticks, and all the packets
+due in a tick are sent with a single sendmmsg call (in groups of BATCH).
+Ticks are paced at absolute deadlines (see pacer.h); the percentiles of their
+send-time error are printed at the end.
+
+Examples on how the program can be started:
+./rtpLoadGen 225.0.1.29 -n50
+./rtpLoadGen 225.0.1.29 -n400 -y11 -l20 -j5 -x1 -r1
+./rtpLoadGen 225.0.1.29 -n1000 -s50 -i5     (starts with 50 senders, adds 50 every 5 s)
+
+-pPORT          destination port, default 5004
+-nSENDERS       number of (maximum) simultaneous senders, default 1
+-yPAYLOAD       one of the payloads in payloadTable.c: 100 (PCMU), 8 (PCMA), 10/11 (L16 stereo/mono, 44100 Hz)
+                or 97/96 (L16 stereo/mono, 48000 Hz); default 100
+-lPACKET_DURATION   ms of audio in each packet, default 20
+-jJITTER        maximum random delay (ms) added to the nominal send time of each packet, default 0
+-xLOSS          percentage of packets that are not sent (sequence number is consumed), default 0
+-rREORDER       percentage of packets that are sent after the following one, default 0
+-sRAMP_STEP     start with RAMP_STEP senders and add RAMP_STEP every RAMP_INTERVAL s
+-iRAMP_INTERVAL seconds between ramp steps, default 10
+-dDURATION      seconds to run, default 0 (until Ctrl-C)
+-bBATCH         maximum number of packets in each sendmmsg call, default 64
+-KKEY           packets are sent as SRTP (see srtp.h) with this pre-shared master key and salt, 60 hexadecimal digits
+-c              prints a line per second with the current load
+
+To compile, execute
+gcc -Wall -Wextra -O2 -o rtpLoadGen payloadTable.c sampleConvert.c srtp.c pacer.c rtpLoadGen.c
+(add -maes -msha -msse4.1 to use the instructions of the CPU for SRTP)
+*/
+
+#define _GNU_SOURCE /* sendmmsg */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "audiocArgs.h" /* enum payload */
+#include "payloadTable.h"
+#include "srtp.h"
+#include "pacer.h"
+
+#define WHEEL_SLOTS 4096        /* 1 ms ticks, must be a power of 2 and larger than PACKET_DURATION + JITTER */
+#define MAX_BATCH 1024
+#define NS_PER_SEC 1000000000L
+
+/* state of each emulated sender */
+struct sender {
+    u_int32 ssrc;
+    u_int16 seq;
+    u_int32 ts;
+    long nominalTick;       /* tick in which the next packet should be sent without jitter */
+    int next;               /* next sender in the same wheel slot, -1 ends the list */
+    int current;            /* which of the two packet buffers is used for the next packet */
+    int held;               /* buffer holding a packet delayed to emulate reordering, -1 if none */
+    unsigned char *packet[2];
+};
+
+/* packets waiting to be sent with a single sendmmsg call */
+struct batch {
+    int sockId;
+    int size;               /* maximum number of packets per call */
+    int pending;
+    unsigned long long sent;
+    unsigned long long sendErrors;
+    struct mmsghdr msgs[MAX_BATCH];
+    struct iovec iovecs[MAX_BATCH]; /* iov_len is fixed, iov_base points to the sender packet buffer */
+};
+
+static volatile sig_atomic_t finish = 0;
+
+static void signalHandler (int sigNum __attribute__ ((unused)))
+{
+    finish = 1;
+}
+
+
+static void _printHelp (void)
+{
+    printf ("\nrtpLoadGen v1.0");
+    printf ("\nrtpLoadGen MULTICAST_ADDR [-pPORT] [-nSENDERS] [-yPAYLOAD] [-lPACKET_DURATION] [-jJITTER] [-xLOSS] [-rREORDER] [-sRAMP_STEP] [-iRAMP_INTERVAL] [-dDURATION] [-bBATCH] [-KKEY] [-c]\n");
+}
+
+
+/* parses an integer option value in [min..max]; exits if it is not valid */
+static int _intArg (const char *value, char option, int min, int max)
+{
+    int result;
+    if (sscanf (value, "%d", &result) != 1) {
+        printf ("\n-%c must be followed by a number\n", option);
+        exit (1);
+    }
+    if (result < min || result > max) {
+        printf ("\n-%c must be in the range [%d..%d]\n", option, min, max);
+        exit (1);
+    }
+    return result;
+}
+
+
+static long _nowNs (void)
+{
+    struct timespec t;
+    clock_gettime (CLOCK_MONOTONIC, &t);
+    return t.tv_sec * NS_PER_SEC + t.tv_nsec;
+}
+
+
+/* inserts sender 'index' in the slot corresponding to 'tick' */
+static void _wheelInsert (int *wheel, struct sender *senders, int index, long tick)
+{
+    int slot = tick & (WHEEL_SLOTS - 1);
+    senders[index].next = wheel[slot];
+    wheel[slot] = index;
+}
+
+
+static void _batchFlush (struct batch *out)
+{
+    int result;
+    if (out->pending == 0) {
+        return;
+    }
+    result = sendmmsg (out->sockId, out->msgs, out->pending, 0);
+    if (result < 0) {
+        out->sendErrors += out->pending;
+    } else {
+        out->sent += result;
+        out->sendErrors += out->pending - result;
+    }
+    out->pending = 0;
+}
+
+
+/* packet memory must not change until the batch is flushed (at most, at the end of the tick) */
+static void _batchQueue (struct batch *out, unsigned char *packet)
+{
+    out->iovecs[out->pending].iov_base = packet;
+    out->pending++;
+    if (out->pending == out->size) {
+        _batchFlush (out);
+    }
+}
+
+
+int main (int argc, char *argv[])
+{
+    struct sigaction sigInfo;
+    struct in_addr multicastIp;
+    struct sockaddr_in remoteSAddr;
+    int port = 5004, numberOfSenders = 1, payload = PCMU, packetDuration = 20;
+    int jitter = 0, loss = 0, reorder = 0, rampStep = 0, rampInterval = 10;
+    int duration = 0, batch = 64, verbose = 0;
+    int useSrtp = 0;
+    unsigned char srtpMaster[SRTP_MASTER_BYTES];
+    void *srtp = NULL;
+    void *pacer = NULL;
+    unsigned char *plainPayload = NULL;     /* payload of every packet, before SRTP */
+    int numOfNames = 0;
+    int index;
+
+    const struct payloadDesc *desc = NULL;
+    int sockId, samplesPerPacket, payloadSize, packetSize, wireSize;
+    int wheel[WHEEL_SLOTS];
+    struct sender *senders;
+    struct batch out;
+    int active, i;
+    long startNs, tick, lastTick, nextRampTick, nextReportTick, endTick, nextTick;
+
+    /* statistics */
+    unsigned long long lost = 0, reordered = 0;
+    unsigned long long sentLastReport = 0;
+
+    /* we configure the signal */
+    sigInfo.sa_handler = signalHandler;
+    sigInfo.sa_flags = 0;
+    sigemptyset (&sigInfo.sa_mask);
+    if ((sigaction (SIGINT, &sigInfo, NULL)) < 0) {
+        printf ("Error installing signal, error: %s", strerror (errno));
+        exit (1);
+    }
+
+    /* obtain values from the command line */
+    for (index = 1; index < argc; index++)
+    {
+        if (*argv[index] == '-')
+        {
+            char car = argv[index][1];
+            const char *value = argv[index] + 2;
+            switch (car) {
+                case 'p': port = _intArg (value, car, 1024, 65535); break;
+                case 'n': numberOfSenders = _intArg (value, car, 1, 1000000); break;
+                case 'y':
+                    payload = _intArg (value, car, 0, 127);
+                    if (payload_lookup (payload) == NULL) {
+                        printf ("\nUnrecognized payload number %d.\n", payload);
+                        exit (1);
+                    }
+                    break;
+                case 'l': packetDuration = _intArg (value, car, 1, 1000); break;
+                case 'j': jitter = _intArg (value, car, 0, 1000); break;
+                case 'x': loss = _intArg (value, car, 0, 100); break;
+                case 'r': reorder = _intArg (value, car, 0, 100); break;
+                case 's': rampStep = _intArg (value, car, 1, 1000000); break;
+                case 'i': rampInterval = _intArg (value, car, 1, 3600); break;
+                case 'd': duration = _intArg (value, car, 0, 86400 * 365); break;
+                case 'b': batch = _intArg (value, car, 1, MAX_BATCH); break;
+                case 'K':
+                    if (srtp_parse_key (value, srtpMaster) < 0) {
+                        printf ("\n-K must be followed by %d hexadecimal digits (master key and master salt)\n", 2 * SRTP_MASTER_BYTES);
+                        exit (1);
+                    }
+                    useSrtp = 1;
+                    break;
+                case 'c': verbose = 1; break;
+                default:
+                    printf ("\nI do not understand -%c\n", car);
+                    _printHelp ();
+                    exit (1);
+            }
+        }
+        else
+        {
+            if (numOfNames > 0) {
+                printf ("\nToo many fixed parameters - only MULTICAST_ADDR was expected\n");
+                _printHelp ();
+                exit (1);
+            }
+            if (inet_pton (AF_INET, argv[index], &multicastIp) < 1) {
+                printf ("\nInternet address string not recognized\n");
+                exit (1);
+            }
+            if (!IN_CLASSD (ntohl (multicastIp.s_addr))) {
+                printf ("\nNot a multicast address\n");
+                exit (1);
+            }
+            numOfNames++;
+        }
+    }
+    if (numOfNames != 1) {
+        printf ("\nNeed the multicast address.\n");
+        _printHelp ();
+        exit (1);
+    }
+    if (packetDuration + jitter >= WHEEL_SLOTS) {
+        printf ("\nPACKET_DURATION + JITTER must be lower than %d ms\n", WHEEL_SLOTS);
+        exit (1);
+    }
+
+    desc = payload_lookup (payload);
+    samplesPerPacket = payload_frame_samples (desc, packetDuration);
+    payloadSize = payload_frame_payload_bytes (desc, packetDuration);
+    packetSize = RTP_HEADER_SIZE + payloadSize;
+    wireSize = packetSize + (useSrtp ? SRTP_AUTH_TAG_BYTES : 0);
+
+    /* socket connected to the group, so that sendmmsg does not need msg_name */
+    if ((sockId = socket (AF_INET, SOCK_DGRAM, 0)) < 0) {
+        printf ("socket error: %s\n", strerror (errno));
+        exit (1);
+    }
+    int sndBuf = 4 * 1024 * 1024;
+    if (setsockopt (sockId, SOL_SOCKET, SO_SNDBUF, &sndBuf, sizeof (sndBuf)) < 0) {
+        printf ("setsockopt(SO_SNDBUF) failed: %s\n", strerror (errno));
+    }
+    unsigned char loop = 1; /* local receivers must see the traffic */
+    if (setsockopt (sockId, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof (loop)) < 0) {
+        printf ("setsockopt(IP_MULTICAST_LOOP) failed: %s\n", strerror (errno));
+    }
+    memset (&remoteSAddr, 0, sizeof (remoteSAddr));
+    remoteSAddr.sin_family = AF_INET;
+    remoteSAddr.sin_port = htons (port);
+    remoteSAddr.sin_addr = multicastIp;
+    if (connect (sockId, (struct sockaddr *) &remoteSAddr, sizeof (remoteSAddr)) < 0) {
+        printf ("connect error: %s\n", strerror (errno));
+        exit (1);
+    }
+
+    /* senders: all packet memory is reserved here, nothing is allocated while sending */
+    if ((senders = calloc (numberOfSenders, sizeof (struct sender))) == NULL) {
+        printf ("Could not reserve memory for senders.\n");
+        exit (1);
+    }
+    unsigned char *packetMemory = malloc ((size_t) numberOfSenders * 2 * wireSize);
+    unsigned char *silence = malloc (payload_frame_bytes (desc, packetDuration));
+    if (packetMemory == NULL || silence == NULL) {
+        printf ("Could not reserve memory for packets.\n");
+        exit (1);
+    }
+
+    /* silence, in the soundcard format: midpoint for 8-bit (unsigned) samples, 0 for 16-bit */
+    memset (silence, (desc->bytesPerSample == 1) ? 0x80 : 0, payload_frame_bytes (desc, packetDuration));
+
+    srandom (time (NULL) ^ getpid ());
+    u_int32 baseSsrc = random ();
+    for (i = 0; i < numberOfSenders; i++) {
+        int b;
+        senders[i].ssrc = baseSsrc + i; /* distinct SSRCs */
+        senders[i].seq = random ();
+        senders[i].ts = random ();
+        senders[i].held = -1;
+        for (b = 0; b < 2; b++) {
+            /* seq and ts are written when each packet is sent */
+            senders[i].packet[b] = packetMemory + ((size_t) i * 2 + b) * wireSize;
+            desc->packetize (senders[i].packet[b], silence, samplesPerPacket, 0, 0, senders[i].ssrc);
+        }
+    }
+    free (silence);
+    if (useSrtp) {
+        /* SRTP encrypts the buffers in place: the payload is restored before each packet */
+        if ((srtp = srtp_create (srtpMaster, numberOfSenders)) == NULL || (plainPayload = malloc (payloadSize)) == NULL) {
+            printf ("Could not reserve memory for SRTP.\n");
+            exit (1);
+        }
+        memcpy (plainPayload, senders[0].packet[0] + RTP_HEADER_SIZE, payloadSize);
+    }
+    for (i = 0; i < WHEEL_SLOTS; i++) {
+        wheel[i] = -1;
+    }
+    /* ticks as timestamps of a 1000 Hz clock; late ticks are caught up, not skipped */
+    if ((pacer = pace_create (1000, 0)) == NULL) {
+        exit (1);
+    }
+
+    memset (&out, 0, sizeof (out));
+    out.sockId = sockId;
+    out.size = batch;
+    for (i = 0; i < batch; i++) {
+        out.iovecs[i].iov_len = wireSize;
+        out.msgs[i].msg_hdr.msg_iov = &out.iovecs[i];
+        out.msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    printf ("Sending to %s:%d, %d senders, payload %d, %d ms (%d bytes per packet%s)\n", inet_ntoa (multicastIp), port, numberOfSenders, payload, packetDuration, wireSize, useSrtp ? ", SRTP" : "");
+
+    /* first senders start in a random phase inside the first packet duration */
+    active = (rampStep > 0 && rampStep < numberOfSenders) ? rampStep : numberOfSenders;
+    for (i = 0; i < active; i++) {
+        senders[i].nominalTick = random () % packetDuration;
+        _wheelInsert (wheel, senders, i, senders[i].nominalTick);
+    }
+
+    startNs = _nowNs ();
+    lastTick = -1;
+    nextRampTick = (long) rampInterval * 1000;
+    nextReportTick = 1000;
+    endTick = (duration > 0) ? (long) duration * 1000 : -1;
+
+    while (!finish)
+    {
+        /* sleeps until the next tick, with an absolute deadline so that the schedule does not drift */
+        tick = lastTick + 1;
+        if (pace_wait (pacer, (uint32_t) tick) < 0) {
+            continue;   /* interrupted by a signal */
+        }
+        lastTick = tick;
+
+        if (endTick >= 0 && tick >= endTick) {
+            break;
+        }
+
+        /* ramp: new senders start in a random phase of the next packet duration */
+        if (rampStep > 0 && active < numberOfSenders && tick >= nextRampTick) {
+            int newActive = active + rampStep;
+            if (newActive > numberOfSenders) {
+                newActive = numberOfSenders;
+            }
+            for (i = active; i < newActive; i++) {
+                senders[i].nominalTick = tick + 1 + random () % packetDuration;
+                _wheelInsert (wheel, senders, i, senders[i].nominalTick);
+            }
+            active = newActive;
+            nextRampTick += (long) rampInterval * 1000;
+            printf ("Active senders: %d\n", active); fflush (stdout);
+        }
+
+        /* all senders due in this tick */
+        int slot = tick & (WHEEL_SLOTS - 1);
+        int current = wheel[slot];
+        wheel[slot] = -1;
+        while (current != -1)
+        {
+            struct sender *s = &senders[current];
+            int nextInSlot = s->next;
+            int b = s->current;
+            rtp_hdr_t *hdr = (rtp_hdr_t *) s->packet[b];
+
+            hdr->seq = htons (s->seq);
+            hdr->ts = htonl (s->ts);
+            s->seq++;
+            s->ts += samplesPerPacket;
+
+            if (loss > 0 && random () % 100 < loss) {
+                lost++;
+            } else {
+                if (srtp != NULL) {
+                    memcpy (s->packet[b] + RTP_HEADER_SIZE, plainPayload, payloadSize);
+                    srtp_protect (srtp, s->packet[b], packetSize);
+                }
+                if (reorder > 0 && s->held < 0 && random () % 100 < reorder) {
+                    s->held = b;        /* sent after the next packet of this sender */
+                    s->current = 1 - b;
+                    reordered++;
+                    b = -1;
+                } else {
+                    _batchQueue (&out, s->packet[b]);
+                }
+            }
+            if (b >= 0 && s->held >= 0) {
+                /* a held packet goes out after the following one, or replaces it if that one is lost */
+                _batchQueue (&out, s->packet[s->held]);
+                s->held = -1;
+            }
+
+            /* next packet: nominal schedule plus a random delay to emulate jitter. With
+             * jitter over packetDuration it may fall in a tick already passed (this packet
+             * was late): it goes in the next one, not a turn of the wheel later */
+            s->nominalTick += packetDuration;
+            nextTick = s->nominalTick + (jitter > 0 ? random () % (jitter + 1) : 0);
+            _wheelInsert (wheel, senders, current, (nextTick > tick) ? nextTick : tick + 1);
+            current = nextInSlot;
+        }
+
+        _batchFlush (&out);
+
+        if (verbose && tick >= nextReportTick) {
+            printf ("t=%lds active %d, %llu packets/s, sent %llu, lost %llu, reordered %llu, send errors %llu, tick error p99 %.3f ms\n",
+                    tick / 1000, active, out.sent - sentLastReport, out.sent, lost, reordered, out.sendErrors, pace_percentile (pacer, 0.99) / 1e6);
+            fflush (stdout);
+            sentLastReport = out.sent;
+            nextReportTick += 1000;
+        }
+    }
+
+    printf ("\nrtpLoadGen finished after %.3f s\n", (double) (_nowNs () - startNs) / NS_PER_SEC);
+    printf ("Active senders %d, packets sent %llu, lost (emulated) %llu, reordered %llu, send errors %llu\n", active, out.sent, lost, reordered, out.sendErrors);
+    pace_print (pacer, "Ticks");
+    pace_destroy (pacer);
+
+    close (sockId);
+    if (srtp != NULL) {
+        srtp_destroy (srtp);
+        free (plainPayload);
+    }
+    free (packetMemory);
+    free (senders);
+    return 0;
+}
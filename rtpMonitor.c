@@ -0,0 +1,486 @@
+/*
+rtpMonitor [-iINTERFACE] [-fFILE] [-wDIRECTORY] [-rREPORT_INTERVAL] [-mMAX_SOURCES] [-dDURATION] [ADDR/PORT...]
+
+Passive RTP monitor. Observes the RTP streams sent to the configured
+addresses (multicast groups, or unicast) and ports as they cross an interface,
+without joining the groups or binding the ports: datagrams are read from a
+memory-mapped AF_PACKET ring (see packetRing.h), in blocks, without copying
+them. One process watches hundreds of streams at the cost of a poll per block.
+The groups are not joined, so their traffic must already reach the host
+(another receiver on the host joined them, the switch floods them, or they are
+sent by the host itself, as in loopback tests).
+
+For each stream, its sources are followed as a receiver would (sequence
+numbers, losses and interarrival jitter, see rtpSource.h), and a line is
+printed for each stream with traffic every REPORT_INTERVAL s, and for all the
+streams at the end (Ctrl-C). With -w, each stream is also recorded, as
+received, in DIRECTORY/ADDR_PORT.rtpdump (rtpdump format of rtptools, to be
+played with rtpplay).
+
+Examples on how the program can be started:
+sudo ./rtpMonitor 225.0.1.29/5004
+sudo ./rtpMonitor -ilo -fstreams.txt -w/tmp -r5
+
+-iINTERFACE         interface observed, default all of them
+-fFILE              adds the streams of FILE, one per line: ADDR [PORT] (default port 5004, # starts a comment)
+-wDIRECTORY         records each stream in DIRECTORY
+-rREPORT_INTERVAL   seconds between reports, default 10 (0: only at the end)
+-mMAX_SOURCES       maximum number of sources followed per stream, default 8
+-dDURATION          seconds to run, default 0 (until Ctrl-C)
+ADDR/PORT           a stream, IPv4 or IPv6 address (default port 5004)
+
+Requires CAP_NET_RAW (run it as root, or setcap cap_net_raw+ep rtpMonitor).
+
+To compile, execute
+gcc -Wall -Wextra -O2 -o rtpMonitor rtpSource.c jitterBuffer.c alignedMemory.c payloadTable.c sampleConvert.c packetRing.c rtpMonitor.c
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "rtp.h"
+#include "rtpSource.h"
+#include "payloadTable.h"
+#include "alignedMemory.h"
+#include "packetRing.h"
+
+#define MAX_STREAMS 4096
+#define HASH_SLOTS (2 * MAX_STREAMS)    /* power of 2, at most half full */
+#define STORED_BYTES 16                 /* of payload per source: the monitor keeps no audio */
+#define DEFAULT_PORT 5004
+#define DEFAULT_RATE 8000               /* RTP clock for payload types out of the table */
+#define DUMP_BUFFER (1 << 16)
+#define LINE_LENGTH 256
+#define NS_PER_SEC 1000000000L
+
+struct stream {
+    int family;                         /* AF_INET or AF_INET6 */
+    unsigned char address[16];
+    int port;
+    char name[INET6_ADDRSTRLEN + 8];    /* address and port, for the reports */
+    struct rtpSourceTable *sources;
+    int rate;                           /* RTP clock, from the payload type of the first packet; 0 before it */
+    unsigned long long packets;
+    unsigned long long bytes;
+    unsigned long long packetsReported; /* at the last report */
+    unsigned long long invalid;         /* not RTP */
+    unsigned long long full;            /* from sources over MAX_SOURCES */
+    FILE *dump;                         /* rtpdump file, NULL without -w */
+    struct timespec dumpStart;
+};
+
+struct monitor {
+    struct stream *streams;
+    int numberOfStreams;
+    int slot[HASH_SLOTS];               /* index in 'streams', -1 if empty */
+    int maxSources;
+    const char *directory;              /* for the rtpdump files, NULL if not recorded */
+    unsigned long long other;           /* UDP datagrams of other addresses or ports */
+};
+
+static volatile sig_atomic_t finish = 0;
+
+static void signalHandler (int sigNum __attribute__ ((unused)))
+{
+    finish = 1;
+}
+
+
+static void _printHelp (void)
+{
+    printf ("\nrtpMonitor v1.0");
+    printf ("\nrtpMonitor [-iINTERFACE] [-fFILE] [-wDIRECTORY] [-rREPORT_INTERVAL] [-mMAX_SOURCES] [-dDURATION] [ADDR/PORT...]\n");
+}
+
+
+/* parses an integer option value in [min..max]; exits if it is not valid */
+static int _intArg (const char *value, char option, int min, int max)
+{
+    int result;
+    if (sscanf (value, "%d", &result) != 1) {
+        printf ("\n-%c must be followed by a number\n", option);
+        exit (1);
+    }
+    if (result < min || result > max) {
+        printf ("\n-%c must be in the range [%d..%d]\n", option, min, max);
+        exit (1);
+    }
+    return result;
+}
+
+
+static long _nowNs (void)
+{
+    struct timespec t;
+    clock_gettime (CLOCK_MONOTONIC, &t);
+    return t.tv_sec * NS_PER_SEC + t.tv_nsec;
+}
+
+
+/*=====================================================================*/
+/* Streams, by address and port */
+
+static int _hash (int family, const unsigned char *address, int port)
+{
+    unsigned int h = 2166136261u;   /* FNV-1a */
+    int i;
+
+    for (i = 0; i < ((family == AF_INET) ? 4 : 16); i++) {
+        h = (h ^ address[i]) * 16777619u;
+    }
+    h = (h ^ (port & 0xff)) * 16777619u;
+    h = (h ^ (port >> 8)) * 16777619u;
+    return h & (HASH_SLOTS - 1);
+}
+
+
+static struct stream *_findStream (struct monitor *m, int family, const unsigned char *address, int port)
+{
+    int slot = _hash (family, address, port);
+
+    while (m->slot[slot] >= 0) {
+        struct stream *s = &m->streams[m->slot[slot]];
+        if (s->port == port && s->family == family
+                && memcmp (s->address, address, (family == AF_INET) ? 4 : 16) == 0) {
+            return s;
+        }
+        slot = (slot + 1) & (HASH_SLOTS - 1);
+    }
+    return NULL;
+}
+
+
+/* Adds the stream 'text' (ADDR) and 'port'. Returns 0, or -1 if it is not valid */
+static int _addStream (struct monitor *m, const char *text, int port)
+{
+    struct stream *s;
+    unsigned char address[16];
+    int family, slot;
+
+    if (inet_pton (AF_INET, text, address) == 1) {
+        family = AF_INET;
+    } else if (inet_pton (AF_INET6, text, address) == 1) {
+        family = AF_INET6;
+    } else {
+        printf ("'%s' is not an IPv4 or IPv6 address\n", text);
+        return -1;
+    }
+    if (port < 1 || port > 65535) {
+        printf ("Port %d of %s is not valid\n", port, text);
+        return -1;
+    }
+    if (_findStream (m, family, address, port) != NULL) {
+        return 0;   /* repeated */
+    }
+    if (m->numberOfStreams == MAX_STREAMS) {
+        printf ("Too many streams, %d at most\n", MAX_STREAMS);
+        return -1;
+    }
+    s = &m->streams[m->numberOfStreams];
+    memset (s, 0, sizeof (struct stream));
+    s->family = family;
+    memcpy (s->address, address, (family == AF_INET) ? 4 : 16);
+    s->port = port;
+    snprintf (s->name, sizeof (s->name), "%s/%d", text, port);
+    slot = _hash (family, address, port);
+    while (m->slot[slot] >= 0) {
+        slot = (slot + 1) & (HASH_SLOTS - 1);
+    }
+    m->slot[slot] = m->numberOfStreams++;
+    return 0;
+}
+
+
+/* ADDR/PORT, or ADDR. The last '/' separates the port, as IPv6 addresses have ':' */
+static int _addStreamArg (struct monitor *m, const char *arg)
+{
+    char text[INET6_ADDRSTRLEN];
+    const char *slash = strrchr (arg, '/');
+    int port = DEFAULT_PORT;
+    size_t length = (slash != NULL) ? (size_t) (slash - arg) : strlen (arg);
+
+    if (length >= sizeof (text) || (slash != NULL && sscanf (slash + 1, "%d", &port) != 1)) {
+        printf ("'%s' is not ADDR/PORT\n", arg);
+        return -1;
+    }
+    memcpy (text, arg, length);
+    text[length] = '\0';
+    return _addStream (m, text, port);
+}
+
+
+/* Same format as the destinations of fanOut: ADDR [PORT] */
+static int _readStreams (struct monitor *m, const char *fileName)
+{
+    FILE *file;
+    char line[LINE_LENGTH];
+    int lineNumber = 0;
+
+    if ((file = fopen (fileName, "r")) == NULL) {
+        printf ("File %s could not be opened, error %s\n", fileName, strerror (errno));
+        return -1;
+    }
+    while (fgets (line, sizeof (line), file) != NULL) {
+        char address[INET6_ADDRSTRLEN];
+        int port = DEFAULT_PORT;
+
+        lineNumber++;
+        if (sscanf (line, "%45s %d", address, &port) < 1 || address[0] == '#') {
+            continue;
+        }
+        if (_addStream (m, address, port) < 0) {
+            printf ("%s, line %d\n", fileName, lineNumber);
+            fclose (file);
+            return -1;
+        }
+    }
+    fclose (file);
+    return 0;
+}
+
+
+/*=====================================================================*/
+/* Recorder, rtpdump format: a text line, a file header and, for each
+ * packet, a packet header and the packet. Everything in network order */
+
+static void _put16 (unsigned char *p, unsigned int value)
+{
+    p[0] = value >> 8;
+    p[1] = value;
+}
+
+static void _put32 (unsigned char *p, u_int32 value)
+{
+    p[0] = value >> 24;
+    p[1] = value >> 16;
+    p[2] = value >> 8;
+    p[3] = value;
+}
+
+
+static FILE *_openDump (const struct monitor *m, struct stream *s, const struct timespec *start)
+{
+    char fileName[FILENAME_MAX];
+    char address[INET6_ADDRSTRLEN];
+    unsigned char header[16];
+    FILE *file;
+
+    inet_ntop (s->family, s->address, address, sizeof (address));
+    snprintf (fileName, sizeof (fileName), "%s/%s_%d.rtpdump", m->directory, address, s->port);
+    if ((file = fopen (fileName, "w")) == NULL) {
+        printf ("File %s could not be opened, error %s; %s is not recorded\n", fileName, strerror (errno), s->name);
+        return NULL;
+    }
+    setvbuf (file, NULL, _IOFBF, DUMP_BUFFER);
+    fprintf (file, "#!rtpplay1.0 %s/%d\n", address, s->port);
+    /* start time, source address (0 for IPv6) and port */
+    _put32 (header, start->tv_sec);
+    _put32 (header + 4, start->tv_nsec / 1000);
+    if (s->family == AF_INET) {
+        memcpy (header + 8, s->address, 4);
+    } else {
+        memset (header + 8, 0, 4);
+    }
+    _put16 (header + 12, s->port);
+    _put16 (header + 14, 0);
+    fwrite (header, sizeof (header), 1, file);
+    s->dumpStart = *start;
+    return file;
+}
+
+
+static void _dumpPacket (struct stream *s, const struct pringDatagram *d)
+{
+    unsigned char header[8];
+    long offsetMs = (d->time.tv_sec - s->dumpStart.tv_sec) * 1000 + (d->time.tv_nsec - s->dumpStart.tv_nsec) / 1000000;
+
+    /* length of header and packet, length of the packet, ms since the start */
+    _put16 (header, sizeof (header) + d->length);
+    _put16 (header + 2, d->length);
+    _put32 (header + 4, offsetMs);
+    fwrite (header, sizeof (header), 1, s->dump);
+    fwrite (d->payload, d->length, 1, s->dump);
+}
+
+
+/*=====================================================================*/
+/* Called by pring_next_block for each datagram of a block, which is read in the ring */
+static void _capture (void *context, const struct pringDatagram *d)
+{
+    struct monitor *m = context;
+    struct stream *s = _findStream (m, d->family, d->destination, d->destinationPort);
+    u_int32 arrival;
+
+    if (s == NULL) {
+        m->other++;
+        return;
+    }
+    s->packets++;
+    s->bytes += d->length;
+    if (s->rate == 0) {
+        const struct payloadDesc *desc = (d->length > 1) ? payload_lookup (d->payload[1] & 0x7f) : NULL;
+        s->rate = (desc != NULL) ? desc->rate : DEFAULT_RATE;
+        if (m->directory != NULL) {
+            s->dump = _openDump (m, s, &d->time);
+        }
+    }
+    /* arrival in RTP units, from the time the kernel received it */
+    arrival = (u_int32) ((unsigned long long) d->time.tv_sec * s->rate + (unsigned long long) d->time.tv_nsec * s->rate / NS_PER_SEC);
+    switch (rtps_receive (s->sources, d->payload, d->length, arrival, NULL)) {
+        case RTPS_INVALID: s->invalid++; break;
+        case RTPS_TABLE_FULL: s->full++; break;
+        default: break;
+    }
+    if (s->dump != NULL) {
+        _dumpPacket (s, d);
+    }
+}
+
+
+/* A line per stream, only the streams with new packets unless 'all' */
+static void _report (struct monitor *m, void *ring, int all)
+{
+    unsigned long long packets, drops;
+    int i, slot;
+
+    for (i = 0; i < m->numberOfStreams; i++) {
+        struct stream *s = &m->streams[i];
+        long long lost = 0;
+        u_int32 jitter = 0;
+        if (!all && s->packets == s->packetsReported) {
+            continue;
+        }
+        for (slot = 0; slot < rtps_capacity (s->sources); slot++) {
+            struct rtpSource *src = rtps_get (s->sources, slot);
+            if (src != NULL) {
+                lost += rtps_lost (&src->state);
+                if (src->state.jitter > jitter) {
+                    jitter = src->state.jitter;
+                }
+            }
+        }
+        /* jitter is kept x16 (RFC 3550, A.8) */
+        printf ("%s: %d sources, %llu packets (%llu new), %llu bytes, %lld lost, max jitter %.2f ms, %llu not RTP, %llu without room\n",
+                s->name, rtps_count (s->sources), s->packets, s->packets - s->packetsReported, s->bytes, lost,
+                (s->rate > 0) ? (jitter >> 4) * 1000.0 / s->rate : 0.0, s->invalid, s->full);
+        s->packetsReported = s->packets;
+    }
+    pring_stats (ring, &packets, &drops);
+    printf ("ring: %llu packets captured (both copies on loopback), %llu dropped by the kernel (ring full), %llu datagrams of other streams\n", packets, drops, m->other);
+    fflush (stdout);
+}
+
+
+int main (int argc, char *argv[])
+{
+    struct sigaction sigInfo;
+    struct monitor m;
+    const char *interface = NULL;
+    int reportInterval = 10, duration = 0;
+    void *ring;
+    long nextReportNs, endNs;
+    int index, i;
+
+    memset (&m, 0, sizeof (m));
+    m.maxSources = 8;
+    for (i = 0; i < HASH_SLOTS; i++) {
+        m.slot[i] = -1;
+    }
+    if ((m.streams = malloc (MAX_STREAMS * sizeof (struct stream))) == NULL) {
+        printf ("Error reserving memory\n");
+        exit (1);
+    }
+
+    /* we configure the signal */
+    sigInfo.sa_handler = signalHandler;
+    sigInfo.sa_flags = 0;
+    sigemptyset (&sigInfo.sa_mask);
+    if ((sigaction (SIGINT, &sigInfo, NULL)) < 0) {
+        printf ("Error installing signal, error: %s", strerror (errno));
+        exit (1);
+    }
+
+    /* obtain values from the command line */
+    for (index = 1; index < argc; index++)
+    {
+        if (*argv[index] == '-')
+        {
+            char car = argv[index][1];
+            const char *value = argv[index] + 2;
+            switch (car) {
+                case 'i': interface = value; break;
+                case 'f':
+                    if (_readStreams (&m, value) < 0) {
+                        exit (1);
+                    }
+                    break;
+                case 'w': m.directory = value; break;
+                case 'r': reportInterval = _intArg (value, car, 0, 86400); break;
+                case 'm': m.maxSources = _intArg (value, car, 1, 100000); break;
+                case 'd': duration = _intArg (value, car, 0, 86400 * 365); break;
+                default:
+                    printf ("\nI do not understand -%c\n", car);
+                    _printHelp ();
+                    exit (1);
+            }
+        }
+        else if (_addStreamArg (&m, argv[index]) < 0)
+        {
+            exit (1);
+        }
+    }
+    if (m.numberOfStreams == 0) {
+        printf ("\nNeed at least a stream (ADDR/PORT, or -fFILE).\n");
+        _printHelp ();
+        exit (1);
+    }
+    for (i = 0; i < m.numberOfStreams; i++) {
+        if ((m.streams[i].sources = rtps_create_table (m.maxSources, 1, STORED_BYTES, AMEM_DEFAULT)) == NULL) {
+            printf ("Error reserving memory for the sources of %s\n", m.streams[i].name);
+            exit (1);
+        }
+    }
+
+    if ((ring = pring_open (interface, PRING_BLOCK_SIZE, PRING_BLOCKS)) == NULL) {
+        exit (1);
+    }
+    printf ("Monitoring %d streams on %s\n", m.numberOfStreams, (interface != NULL) ? interface : "all the interfaces");
+    fflush (stdout);
+
+    nextReportNs = _nowNs () + reportInterval * NS_PER_SEC;
+    endNs = (duration > 0) ? _nowNs () + duration * NS_PER_SEC : 0;
+    while (!finish) {
+        long now;
+        if (pring_next_block (ring, 100, _capture, &m) < 0) {
+            break;
+        }
+        now = _nowNs ();
+        if (reportInterval > 0 && now >= nextReportNs) {
+            _report (&m, ring, 0);
+            nextReportNs += reportInterval * NS_PER_SEC;
+        }
+        if (endNs > 0 && now >= endNs) {
+            break;
+        }
+    }
+
+    printf ("\n");
+    _report (&m, ring, 1);
+    pring_close (ring);
+    for (i = 0; i < m.numberOfStreams; i++) {
+        if (m.streams[i].dump != NULL) {
+            fclose (m.streams[i].dump);
+        }
+        rtps_destroy_table (m.streams[i].sources);
+    }
+    free (m.streams);
+    return 0;
+}
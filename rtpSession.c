@@ -0,0 +1,449 @@
+/* rtpSession.c */
+
+#define _GNU_SOURCE /* recvmmsg */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "rtpSession.h"
+#include "rtpSource.h"
+#include "rtcp.h"
+#include "payloadTable.h"
+#include "srtp.h"
+#include "rtpFilter.h"
+#include "timerWheel.h"
+
+#define RECV_BATCH 32
+#define RECV_BUFFER_SIZE 8192
+
+struct endpointTag {
+    enum sess_endpoint type;
+    struct rtpSession *session;
+};
+
+struct rtpSession {
+    struct endpointTag endpoints[2];
+    int sockId[2];
+    struct in_addr group;
+    int port;
+    int payload;
+    int rate;
+    u_int32 localSsrc;
+    struct rtpSourceTable *sources;
+    void *srtp;                     /* NULL: RTP in clear */
+    void *filter;                   /* program of the RTP socket */
+    int maxSources;
+    int locked;                     /* the filter only accepts the sources of the table, which is full */
+    struct sockaddr_in rtcpDestination;
+    void *wheel;
+    struct twheelTimer reportTimer;
+    struct twheelTimer checkTimer;  /* pending while there are sources */
+
+    /* statistics */
+    unsigned long long datagrams;
+    unsigned long long stored;
+    unsigned long long invalid;
+    unsigned long long discarded;
+    unsigned long long tableFull;
+    unsigned long long rejected;    /* not authenticated or replayed (SRTP) */
+    unsigned long long rtcpPackets;
+    unsigned long long reportsSent;
+    unsigned long long byes;
+    unsigned long long timeouts;
+};
+
+/* receive buffers, shared by all the sessions (single thread) */
+static unsigned char recvBuffers[RECV_BATCH][RECV_BUFFER_SIZE];
+static struct mmsghdr recvMsgs[RECV_BATCH];
+static struct iovec recvIovecs[RECV_BATCH];
+static int recvBuffersReady = 0;
+static char cname[MAX_LEN_SDES_ITEM] = "";
+
+
+static void _prepareShared (void)
+{
+    int i;
+    char host[64];
+
+    if (recvBuffersReady) {
+        return;
+    }
+    for (i = 0; i < RECV_BATCH; i++) {
+        recvIovecs[i].iov_base = recvBuffers[i];
+        recvIovecs[i].iov_len = RECV_BUFFER_SIZE;
+        recvMsgs[i].msg_hdr.msg_iov = &recvIovecs[i];
+        recvMsgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    if (gethostname (host, sizeof (host)) < 0) {
+        strcpy (host, "localhost");
+    }
+    host[sizeof (host) - 1] = '\0';
+    snprintf (cname, sizeof (cname), "audioc@%s", host);
+    recvBuffersReady = 1;
+}
+
+
+static int _openSocket (struct in_addr group, int port)
+{
+    struct sockaddr_in localSAddr;
+    struct ip_mreq mreq;
+    int sockId;
+    int enable = 1;
+
+    if ((sockId = socket (AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0)) < 0) {
+        printf ("socket error: %s\n", strerror (errno));
+        return -1;
+    }
+    /* multiple instances can bind to the same multicast address/port */
+    if (setsockopt (sockId, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof (int)) < 0) {
+        printf ("setsockopt(SO_REUSEADDR) failed\n");
+        close (sockId);
+        return -1;
+    }
+    memset (&localSAddr, 0, sizeof (localSAddr));
+    localSAddr.sin_family = AF_INET;
+    localSAddr.sin_port = htons (port);
+    localSAddr.sin_addr = group;
+    if (bind (sockId, (struct sockaddr *) &localSAddr, sizeof (struct sockaddr_in)) < 0) {
+        printf ("bind error: %s\n", strerror (errno));
+        close (sockId);
+        return -1;
+    }
+    mreq.imr_multiaddr = group;
+    mreq.imr_interface.s_addr = htonl (INADDR_ANY);
+    if (setsockopt (sockId, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof (mreq)) < 0) {
+        printf ("setsockopt(IP_ADD_MEMBERSHIP) error: %s\n", strerror (errno));
+        close (sockId);
+        return -1;
+    }
+    return sockId;
+}
+
+
+/* When the table is full, the packets of new sources are dropped by the
+ * kernel instead of being received to find out there is no room for them;
+ * when a source leaves, every SSRC is accepted again */
+static void _updateFilter (struct rtpSession *session)
+{
+    u_int32 ssrcs[RFLT_MAX_SSRCS];
+    int full = rtps_count (session->sources) >= session->maxSources;
+    int i, n = 0;
+
+    if (full == session->locked || session->maxSources > RFLT_MAX_SSRCS) {
+        return;
+    }
+    for (i = 0; full && i < rtps_capacity (session->sources); i++) {
+        struct rtpSource *src = rtps_get (session->sources, i);
+        if (src != NULL) {
+            ssrcs[n++] = src->ssrc;
+        }
+    }
+    rflt_set_ssrcs (session->filter, RFLT_ALLOW, ssrcs, n);
+    if (rflt_attach (session->filter, session->sockId[SESS_RTP]) == 0) {
+        session->locked = full;
+    }
+}
+
+
+static u_int32 _arrivalRtpUnits (int rate)
+{
+    struct timespec now;
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    return (u_int32) ((unsigned long long) now.tv_sec * rate + (unsigned long long) now.tv_nsec * rate / 1000000000ULL);
+}
+
+
+/* Timer of the receiver reports. Runs while there are sources, with a
+ * random interval in [0.5, 1.5] * SESS_RTCP_INTERVAL_MS, as RFC 3550 recommends */
+static void _reportDue (void *context, long long nowMs)
+{
+    struct rtpSession *session = context;
+    unsigned char packet[RTCP_MAX_PACKET];
+    int length;
+
+    if (rtps_count (session->sources) == 0) {
+        return; /* nothing to report; idle sessions do not generate traffic */
+    }
+    twheel_add (session->wheel, &session->reportTimer, nowMs + SESS_RTCP_INTERVAL_MS / 2 + random () % SESS_RTCP_INTERVAL_MS);
+    if ((length = rtcp_build_rr (packet, sizeof (packet), session->localSsrc, session->sources, cname)) < 0) {
+        return;
+    }
+    if (sendto (session->sockId[SESS_RTCP], packet, length, 0,
+                (struct sockaddr *) &session->rtcpDestination, sizeof (session->rtcpDestination)) < 0) {
+        printf ("sendto error: %s\n", strerror (errno));
+        return;
+    }
+    session->reportsSent++;
+}
+
+
+/* Timer of the checks of the sources: removes the ones which sent BYE, and
+ * the ones silent for SESS_TIMEOUT_CHECKS checks. Runs while there are sources */
+static void _checkSources (void *context, long long nowMs)
+{
+    struct rtpSession *session = context;
+    u_int32 leaving[RFLT_MAX_SSRCS];
+    int i, n;
+
+    for (i = 0; i < rtps_capacity (session->sources); i++) {
+        struct rtpSource *src = rtps_get (session->sources, i);
+        if (src == NULL) {
+            continue;
+        }
+        if (src->state.received != src->receivedChecked) {
+            src->receivedChecked = src->state.received;
+            src->silentChecks = 0;
+        } else if (++src->silentChecks == SESS_TIMEOUT_CHECKS) {
+            session->timeouts++;
+        }
+    }
+    /* removing moves entries of the table, so they are removed after each pass */
+    do {
+        n = 0;
+        for (i = 0; i < rtps_capacity (session->sources) && n < RFLT_MAX_SSRCS; i++) {
+            struct rtpSource *src = rtps_get (session->sources, i);
+            if (src != NULL && (src->bye || src->silentChecks >= SESS_TIMEOUT_CHECKS)) {
+                leaving[n++] = src->ssrc;
+            }
+        }
+        for (i = 0; i < n; i++) {
+            rtps_remove (session->sources, leaving[i]);
+            if (session->srtp != NULL) {
+                srtp_remove (session->srtp, leaving[i]);
+            }
+        }
+    } while (n == RFLT_MAX_SSRCS);
+    _updateFilter (session);
+    if (rtps_count (session->sources) > 0) {
+        twheel_add (session->wheel, &session->checkTimer, nowMs + SESS_RTCP_INTERVAL_MS);
+    }
+}
+
+
+/* When the first source arrives: the first report after a random fraction of
+ * the interval, so that sessions started together do not report together */
+static void _startTimers (struct rtpSession *session)
+{
+    long long nowMs = twheel_now (session->wheel);
+
+    twheel_add (session->wheel, &session->checkTimer, nowMs + SESS_RTCP_INTERVAL_MS);
+    if (!twheel_pending (&session->reportTimer)) {
+        twheel_add (session->wheel, &session->reportTimer, nowMs + random () % SESS_RTCP_INTERVAL_MS);
+    }
+}
+
+
+/*=====================================================================*/
+struct rtpSession *sess_create (struct in_addr group, int port, int payload, int packetDuration,
+        int numberOfBlocks, int maxSources, int memFlags, const unsigned char *srtpMaster, void *wheel)
+{
+    struct rtpSession *s;
+    const struct payloadDesc *desc;
+    int blockSize;
+
+    _prepareShared ();
+
+    if ((desc = payload_lookup (payload)) == NULL) {
+        printf ("Unrecognized payload number %d\n", payload);
+        return NULL;
+    }
+
+    if ((s = calloc (1, sizeof (struct rtpSession))) == NULL) {
+        printf ("Error reserving memory in rtpSession\n");
+        return NULL;
+    }
+    s->group = group;
+    s->port = port;
+    s->payload = payload;
+    s->maxSources = maxSources;
+    s->rate = desc->rate;
+    s->localSsrc = random ();
+    s->sockId[SESS_RTP] = s->sockId[SESS_RTCP] = -1;
+    s->endpoints[SESS_RTP].type = SESS_RTP;
+    s->endpoints[SESS_RTP].session = s;
+    s->endpoints[SESS_RTCP].type = SESS_RTCP;
+    s->endpoints[SESS_RTCP].session = s;
+    s->wheel = wheel;
+    twheel_init_timer (&s->reportTimer, _reportDue, s);
+    twheel_init_timer (&s->checkTimer, _checkSources, s);
+
+    blockSize = payload_frame_payload_bytes (desc, packetDuration); /* payloads are stored as received */
+    if (numberOfBlocks < 1) {
+        numberOfBlocks = 1;
+    }
+    if ((s->sources = rtps_create_table (maxSources, numberOfBlocks, blockSize, memFlags)) == NULL) {
+        sess_destroy (s);
+        return NULL;
+    }
+    if (srtpMaster != NULL && (s->srtp = srtp_create (srtpMaster, maxSources)) == NULL) {
+        sess_destroy (s);
+        return NULL;
+    }
+    if ((s->sockId[SESS_RTP] = _openSocket (group, port)) < 0
+            || (s->sockId[SESS_RTCP] = _openSocket (group, port + 1)) < 0) {
+        sess_destroy (s);
+        return NULL;
+    }
+    if ((s->filter = rflt_create ()) == NULL || rflt_attach (s->filter, s->sockId[SESS_RTP]) < 0) {
+        sess_destroy (s);
+        return NULL;
+    }
+
+    s->rtcpDestination.sin_family = AF_INET;
+    s->rtcpDestination.sin_port = htons (port + 1);
+    s->rtcpDestination.sin_addr = group;
+    return s;
+}
+
+
+int sess_fd (const struct rtpSession *session, enum sess_endpoint endpoint)
+{
+    return session->sockId[endpoint];
+}
+
+
+void *sess_endpoint (struct rtpSession *session, enum sess_endpoint endpoint)
+{
+    return &session->endpoints[endpoint];
+}
+
+
+struct rtpSession *sess_from_endpoint (void *endpoint)
+{
+    return ((struct endpointTag *) endpoint)->session;
+}
+
+
+enum sess_endpoint sess_endpoint_type (void *endpoint)
+{
+    return ((struct endpointTag *) endpoint)->type;
+}
+
+
+int sess_receive_rtp (struct rtpSession *session)
+{
+    int total = 0;
+    int received;
+    int i;
+
+    do {
+        u_int32 arrival;
+
+        received = recvmmsg (session->sockId[SESS_RTP], recvMsgs, RECV_BATCH, MSG_DONTWAIT, NULL);
+        if (received < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                break;
+            }
+            printf ("recvmmsg error: %s\n", strerror (errno));
+            return -1;
+        }
+        arrival = _arrivalRtpUnits (session->rate);
+        for (i = 0; i < received; i++) {
+            int length = recvMsgs[i].msg_len;
+            if (session->srtp != NULL && (length = srtp_unprotect (session->srtp, recvBuffers[i], length)) < 0) {
+                session->rejected++;
+                continue;
+            }
+            switch (rtps_receive (session->sources, recvBuffers[i], length, arrival, NULL)) {
+                case RTPS_STORED: session->stored++; break;
+                case RTPS_INVALID: session->invalid++; break;
+                case RTPS_TABLE_FULL: session->tableFull++; break;
+                default: session->discarded++; break;
+            }
+        }
+        session->datagrams += received;
+        total += received;
+    } while (received == RECV_BATCH);
+    _updateFilter (session);
+    if (!twheel_pending (&session->checkTimer) && rtps_count (session->sources) > 0) {
+        _startTimers (session);
+    }
+
+    return total;
+}
+
+
+int sess_receive_rtcp (struct rtpSession *session)
+{
+    struct rtcpReceived info;
+    int total = 0;
+    int length;
+    int i;
+
+    while ((length = recv (session->sockId[SESS_RTCP], recvBuffers[0], RECV_BUFFER_SIZE, MSG_DONTWAIT)) >= 0) {
+        total++;
+        session->rtcpPackets++;
+        if (rtcp_parse (recvBuffers[0], length, session->localSsrc, session->sources, &info) < 0) {
+            continue;
+        }
+        for (i = 0; i < info.byes; i++) {
+            struct rtpSource *src = rtps_find (session->sources, info.bye[i]);
+            if (src != NULL && !src->bye) {
+                src->bye = 1;
+                session->byes++;
+            }
+        }
+    }
+    if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        printf ("recv error: %s\n", strerror (errno));
+        return -1;
+    }
+    return total;
+}
+
+
+int sess_matches (const struct rtpSession *session, struct in_addr group, int port)
+{
+    return session->group.s_addr == group.s_addr && session->port == port;
+}
+
+
+void sess_describe (const struct rtpSession *session, char *line, int size)
+{
+    char groupStr[INET_ADDRSTRLEN];
+
+    inet_ntop (AF_INET, &session->group, groupStr, sizeof (groupStr));
+    snprintf (line, size, "%s %d payload %d ssrc %x: %d sources, %llu datagrams, %llu stored, %llu invalid, %llu discarded, %llu without room, %llu rejected by SRTP, %llu rtcp, %llu reports sent, %llu byes, %llu timeouts\n",
+            groupStr, session->port, session->payload, session->localSsrc, rtps_count (session->sources),
+            session->datagrams, session->stored, session->invalid, session->discarded, session->tableFull,
+            session->rejected, session->rtcpPackets, session->reportsSent, session->byes, session->timeouts);
+}
+
+
+void sess_destroy (struct rtpSession *session)
+{
+    unsigned char packet[16];
+    int length;
+
+    twheel_cancel (session->wheel, &session->reportTimer);
+    twheel_cancel (session->wheel, &session->checkTimer);
+    if (session->sockId[SESS_RTCP] >= 0 && session->reportsSent > 0) {
+        length = rtcp_build_bye (packet, sizeof (packet), session->localSsrc);
+        sendto (session->sockId[SESS_RTCP], packet, length, 0,
+                (struct sockaddr *) &session->rtcpDestination, sizeof (session->rtcpDestination));
+    }
+    if (session->sockId[SESS_RTP] >= 0) {
+        close (session->sockId[SESS_RTP]);
+    }
+    if (session->sockId[SESS_RTCP] >= 0) {
+        close (session->sockId[SESS_RTCP]);
+    }
+    if (session->sources != NULL) {
+        rtps_destroy_table (session->sources);
+    }
+    if (session->srtp != NULL) {
+        srtp_destroy (session->srtp);
+    }
+    if (session->filter != NULL) {
+        rflt_destroy (session->filter);
+    }
+    free (session);
+}
@@ -0,0 +1,72 @@
+/* rtpSession.h */
+
+/* An RTP reception session: one multicast group and port, with its RTP
+ * socket (PORT) and RTCP socket (PORT + 1), the state and jitter buffers of
+ * the sources received in it (see rtpSource.h), and periodic RTCP receiver
+ * reports.
+ * Sockets are non-blocking, to be driven by an event loop (see audiocServer.c).
+ * Reports, and the checks which remove the sources that left, are timers of a
+ * timer wheel (see timerWheel.h) shared by all the sessions of the loop;
+ * they run only while the session has sources, so idle sessions cost nothing.
+ * Restrictions
+ * - All sessions must be used from the same thread: they share the receive buffers.
+ */
+
+#ifndef RTP_SESSION_H
+#define RTP_SESSION_H
+
+#include <netinet/in.h>
+#include "rtp.h"
+
+#define SESS_RTCP_INTERVAL_MS 5000  /* mean interval between receiver reports, and between checks of the sources */
+#define SESS_TIMEOUT_CHECKS 5       /* a source silent for this many checks has left (RFC 3550, 6.3.5) */
+
+/* what a socket of a session is used for; the event loop gets it back from sess_endpoint_type */
+enum sess_endpoint {SESS_RTP = 0, SESS_RTCP = 1};
+
+struct rtpSession;
+
+/* Creates a session for group:port (RTCP in port + 1), joining the group in both sockets.
+ * 'payload' (see enum payload) determines the RTP clock rate and, with
+ * 'packetDuration' (ms), the size of each jitter buffer block; each source
+ * gets 'numberOfBlocks' blocks, allocated with 'memFlags' (see enum amem_flags).
+ * Up to 'maxSources' sources are accepted. The RTP socket has a filter (see
+ * rtpFilter.h) which drops in the kernel what is not RTP of the payload
+ * table, and, while the table is full, the SSRCs which are not in it (so
+ * they are not counted as without room).
+ * With 'srtpMaster' (SRTP_MASTER_BYTES, see srtp.h), RTP packets are SRTP and
+ * those not authenticated are discarded; NULL receives RTP in clear. RTCP is
+ * always in clear.
+ * The timers of the session are started in 'wheel' (see timerWheel.h), which
+ * the event loop must advance.
+ * Returns NULL on error (a message is printed). */
+struct rtpSession *sess_create (struct in_addr group, int port, int payload, int packetDuration,
+        int numberOfBlocks, int maxSources, int memFlags, const unsigned char *srtpMaster, void *wheel);
+
+/* Socket descriptors of the session */
+int sess_fd (const struct rtpSession *session, enum sess_endpoint endpoint);
+
+/* Pointer to be stored in the event loop for each socket (e.g. epoll_event.data.ptr).
+ * sess_from_endpoint and sess_endpoint_type recover the session and the socket type from it */
+void *sess_endpoint (struct rtpSession *session, enum sess_endpoint endpoint);
+struct rtpSession *sess_from_endpoint (void *endpoint);
+enum sess_endpoint sess_endpoint_type (void *endpoint);
+
+/* Reads all the datagrams available in the RTP socket. Returns the number of datagrams, -1 on error */
+int sess_receive_rtp (struct rtpSession *session);
+
+/* Reads all the RTCP packets available. Sources sending BYE are removed at
+ * the next check, so that their late packets are not taken for a new
+ * source. Returns the number of packets, -1 on error */
+int sess_receive_rtcp (struct rtpSession *session);
+
+/* Compares the session address with group:port */
+int sess_matches (const struct rtpSession *session, struct in_addr group, int port);
+
+/* Writes a one-line description of the session (address, sources, counters) in 'line' */
+void sess_describe (const struct rtpSession *session, char *line, int size);
+
+/* Sends BYE, stops the timers, closes the sockets and frees all the memory of the session */
+void sess_destroy (struct rtpSession *session);
+
+#endif /* RTP_SESSION_H */
@@ -0,0 +1,391 @@
+/* rtpSource.c */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#include "rtpSource.h"
+#include "jitterBuffer.h"
+#include "payloadTable.h"
+
+#define MAX_DROPOUT 3000
+#define MAX_MISORDER 100
+#define MIN_SEQUENTIAL 2
+
+struct rtpSourceTable {
+    int capacity;               /* number of slots, power of 2, at least twice maxSources */
+    int maxSources;
+    int count;
+    int numberOfBlocks;         /* jitter buffer configuration for new sources */
+    int blockSize;
+    int memFlags;
+    struct rtpSource *slots;
+};
+
+
+/*=====================================================================*/
+/* RFC 3550, A.1 */
+void rtps_init_seq (source *s, u_int16 seq)
+{
+    s->base_seq = seq;
+    s->max_seq = seq;
+    s->bad_seq = RTP_SEQ_MOD + 1;   /* so seq == bad_seq is false */
+    s->cycles = 0;
+    s->received = 0;
+    s->received_prior = 0;
+    s->expected_prior = 0;
+}
+
+
+int rtps_update_seq (source *s, u_int16 seq)
+{
+    u_int16 udelta = seq - s->max_seq;
+
+    /* Source is not valid until MIN_SEQUENTIAL packets with
+     * sequential sequence numbers have been received. */
+    if (s->probation) {
+        /* packet is in sequence */
+        if (seq == (u_int16) (s->max_seq + 1)) {
+            s->probation--;
+            s->max_seq = seq;
+            if (s->probation == 0) {
+                rtps_init_seq (s, seq);
+                s->received++;
+                return RTPS_SEQ_VALID;
+            }
+        } else {
+            s->probation = MIN_SEQUENTIAL - 1;
+            s->max_seq = seq;
+        }
+        return RTPS_SEQ_DISCARD;
+    } else if (udelta < MAX_DROPOUT) {
+        /* in order, with permissible gap */
+        if (seq < s->max_seq) {
+            /* Sequence number wrapped - count another 64K cycle. */
+            s->cycles += RTP_SEQ_MOD;
+        }
+        s->max_seq = seq;
+    } else if (udelta <= RTP_SEQ_MOD - MAX_MISORDER) {
+        /* the sequence number made a very large jump */
+        if (seq == s->bad_seq) {
+            /* Two sequential packets -- assume that the other side
+             * restarted without telling us so just re-sync
+             * (i.e., pretend this was the first packet). */
+            rtps_init_seq (s, seq);
+            s->received++;
+            return RTPS_SEQ_RESYNC;
+        } else {
+            s->bad_seq = (seq + 1) & (RTP_SEQ_MOD - 1);
+            return RTPS_SEQ_DISCARD;
+        }
+    } else {
+        /* duplicate or reordered packet */
+    }
+    s->received++;
+    return RTPS_SEQ_VALID;
+}
+
+
+/*=====================================================================*/
+/* RFC 3550, A.8. The jitter is stored scaled by 16 (integer version of the
+ * estimator); the value to be reported in RTCP is (jitter >> 4) */
+void rtps_update_jitter (source *s, u_int32 rtpTs, u_int32 arrival)
+{
+    int transit = arrival - rtpTs;
+    int d;
+
+    if (s->received <= 1) {
+        /* first valid packet, there is no previous transit time */
+        s->transit = transit;
+        return;
+    }
+    d = transit - (int) s->transit;
+    s->transit = transit;
+    if (d < 0) {
+        d = -d;
+    }
+    s->jitter += d - ((s->jitter + 8) >> 4);
+}
+
+
+u_int32 rtps_expected (const source *s)
+{
+    u_int32 extendedMax = s->cycles + s->max_seq;
+    return extendedMax - s->base_seq + 1;
+}
+
+
+int rtps_lost (const source *s)
+{
+    int lost = (int) (rtps_expected (s) - s->received);
+
+    /* clamp at 24 bits, as transmitted in RTCP reports */
+    if (lost > 0x7fffff) {
+        lost = 0x7fffff;
+    } else if (lost < -0x800000) {
+        lost = -0x800000;
+    }
+    return lost;
+}
+
+
+/*=====================================================================*/
+static int _slotOf (const struct rtpSourceTable *table, u_int32 ssrc)
+{
+    /* multiplicative hashing, SSRCs are random but may be consecutive (e.g. rtpLoadGen) */
+    return (int) ((ssrc * 2654435761u) & (u_int32) (table->capacity - 1));
+}
+
+
+struct rtpSourceTable *rtps_create_table (int maxSources, int numberOfBlocks, int blockSize, int memFlags)
+{
+    struct rtpSourceTable *table;
+    int capacity = 1;
+
+    while (capacity < 2 * maxSources) {
+        capacity <<= 1;
+    }
+
+    if ((table = malloc (sizeof (struct rtpSourceTable))) == NULL) {
+        printf ("Error reserving memory in rtpSource\n");
+        return NULL;
+    }
+    if ((table->slots = calloc (capacity, sizeof (struct rtpSource))) == NULL) {
+        printf ("Error reserving memory in rtpSource\n");
+        free (table);
+        return NULL;
+    }
+    table->capacity = capacity;
+    table->maxSources = maxSources;
+    table->count = 0;
+    table->numberOfBlocks = numberOfBlocks;
+    table->blockSize = blockSize;
+    table->memFlags = memFlags;
+    return table;
+}
+
+
+struct rtpSource *rtps_find (struct rtpSourceTable *table, u_int32 ssrc)
+{
+    int slot = _slotOf (table, ssrc);
+
+    while (table->slots[slot].inUse) {
+        if (table->slots[slot].ssrc == ssrc) {
+            return &table->slots[slot];
+        }
+        slot = (slot + 1) & (table->capacity - 1);
+    }
+    return NULL;
+}
+
+
+struct rtpSource *rtps_lookup (struct rtpSourceTable *table, u_int32 ssrc, u_int16 seq)
+{
+    int slot = _slotOf (table, ssrc);
+    struct rtpSource *src;
+
+    while (table->slots[slot].inUse) {
+        if (table->slots[slot].ssrc == ssrc) {
+            return &table->slots[slot];
+        }
+        slot = (slot + 1) & (table->capacity - 1);
+    }
+
+    /* new source */
+    if (table->count == table->maxSources) {
+        return NULL;
+    }
+    src = &table->slots[slot];
+    memset (src, 0, sizeof (struct rtpSource));
+    if ((src->jitterBuffer = jbuf_create (table->numberOfBlocks, table->blockSize, table->memFlags)) == NULL) {
+        return NULL;
+    }
+    src->ssrc = ssrc;
+    src->inUse = 1;
+    rtps_init_seq (&src->state, seq);
+    src->state.max_seq = seq - 1;
+    src->state.probation = MIN_SEQUENTIAL;
+    table->count++;
+    return src;
+}
+
+
+void rtps_remove (struct rtpSourceTable *table, u_int32 ssrc)
+{
+    int mask = table->capacity - 1;
+    int hole, slot;
+    struct rtpSource *src = rtps_find (table, ssrc);
+
+    if (src == NULL) {
+        return;
+    }
+    jbuf_destroy (src->jitterBuffer);
+    hole = src - table->slots;
+    src->inUse = 0;
+    table->count--;
+
+    /* backward shift: moves up the entries of the same probe sequence, so that lookups do not stop at the hole */
+    slot = (hole + 1) & mask;
+    while (table->slots[slot].inUse) {
+        int home = _slotOf (table, table->slots[slot].ssrc);
+        /* the entry can fill the hole if its home slot is not in (hole, slot] */
+        if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+            table->slots[hole] = table->slots[slot];
+            table->slots[slot].inUse = 0;
+            hole = slot;
+        }
+        slot = (slot + 1) & mask;
+    }
+}
+
+
+int rtps_store (struct rtpSource *src, u_int16 seq, u_int32 ts, const void *payload, int length)
+{
+    return jbuf_insert (src->jitterBuffer, seq, ts, payload, length);
+}
+
+
+int rtps_receive (struct rtpSourceTable *table, const unsigned char *packet, int length,
+        u_int32 arrival, struct rtpSource **srcOut)
+{
+    const rtp_hdr_t *hdr = (const rtp_hdr_t *) packet;
+    struct rtpSource *src;
+    int headerLength;
+    u_int16 seq;
+
+    if (srcOut != NULL) {
+        *srcOut = NULL;
+    }
+    if ((headerLength = payload_header_length (packet, &length)) < 0) {
+        return RTPS_INVALID;
+    }
+
+    seq = ntohs (hdr->seq);
+    if ((src = rtps_lookup (table, ntohl (hdr->ssrc), seq)) == NULL) {
+        return RTPS_TABLE_FULL;
+    }
+    if (srcOut != NULL) {
+        *srcOut = src;
+    }
+    switch (rtps_update_seq (&src->state, seq)) {
+        case RTPS_SEQ_DISCARD: return RTPS_DISCARDED;
+        case RTPS_SEQ_RESYNC:
+            /* the packets stored are of the old sequence, and the new one would be late after them */
+            jbuf_reset (src->jitterBuffer);
+            break;
+        default: break;
+    }
+    rtps_update_jitter (&src->state, ntohl (hdr->ts), arrival);
+    switch (rtps_store (src, seq, ntohl (hdr->ts), packet + headerLength, length - headerLength)) {
+        case JBUF_DUPLICATE: return RTPS_DUPLICATE;
+        case JBUF_LATE: return RTPS_LATE;
+        default: return RTPS_STORED;
+    }
+}
+
+
+int rtps_capacity (const struct rtpSourceTable *table)
+{
+    return table->capacity;
+}
+
+
+struct rtpSource *rtps_get (struct rtpSourceTable *table, int slot)
+{
+    return table->slots[slot].inUse ? &table->slots[slot] : NULL;
+}
+
+
+int rtps_count (const struct rtpSourceTable *table)
+{
+    return table->count;
+}
+
+
+void rtps_destroy_table (struct rtpSourceTable *table)
+{
+    int slot;
+
+    for (slot = 0; slot < table->capacity; slot++) {
+        if (table->slots[slot].inUse) {
+            jbuf_destroy (table->slots[slot].jitterBuffer);
+        }
+    }
+    free (table->slots);
+    free (table);
+}
+
+
+/* TEST vectors for rtps functions.
+ * To execute them, use following code  */
+
+/* #include "rtpSource.h"
+void _rtps_test_restart(void);
+void main (void)
+{
+    _rtps_test_restart();
+} */
+
+
+#include "alignedMemory.h"
+
+void _rtps_test_restart (void)
+{
+    enum test_vector_pos {SEQ, RETURN}; /* Test vector components */
+
+    int test_vector[][2] = {
+        /* Each line contains the sequence number of a packet of the same
+         * source, and the expected enum rtps_result */
+        {5000,  RTPS_DISCARDED},    /* new source, on probation */
+        {5001,  RTPS_STORED},
+        {5002,  RTPS_STORED},
+        {5003,  RTPS_STORED},
+        {5003,  RTPS_DUPLICATE},
+        {5004,  RTPS_STORED},
+        {100,   RTPS_DISCARDED},    /* very large jump: waits for the next one */
+        {101,   RTPS_STORED},       /* sequential: the sender restarted, not late */
+        {102,   RTPS_STORED},
+        {5005,  RTPS_DISCARDED},    /* the old sequence is a jump now */
+        {103,   RTPS_STORED},
+        /* you can add more tests here */
+    };
+
+    struct rtpSourceTable *table = rtps_create_table (4, 8, sizeof (int), AMEM_DEFAULT);
+    int tests = sizeof (test_vector) / (2 * sizeof (int));
+    unsigned char packet[RTP_HEADER_SIZE + sizeof (int)];
+    rtp_hdr_t *hdr = (rtp_hdr_t *) packet;
+    struct rtpSource *src;
+    u_int16 seq;
+    int test, length;
+
+    if (table == NULL) {
+        exit (1);
+    }
+    memset (packet, 0, sizeof (packet));
+    hdr->version = RTP_VERSION;
+    hdr->ssrc = htonl (1234);
+    for (test = 0; test < tests; test++) {
+        int result;
+        hdr->seq = htons (test_vector[test][SEQ]);
+        hdr->ts = htonl (160 * test);
+        memcpy (packet + RTP_HEADER_SIZE, &test_vector[test][SEQ], sizeof (int));
+        result = rtps_receive (table, packet, sizeof (packet), 0, NULL);
+        if (result != test_vector[test][RETURN]) {
+            printf ("_rtps_test_restart RETURN error at test number %d; expected %d, returned %d\n", test, test_vector[test][RETURN], result);
+            rtps_destroy_table (table);
+            exit (1);
+        }
+    }
+
+    /* only the packets since the restart are in the jitter buffer */
+    src = rtps_find (table, 1234);
+    if (jbuf_count (src->jitterBuffer) != 3 || jbuf_extract_next (src->jitterBuffer, &length, &seq, NULL) == NULL || seq != 101
+            || src->state.received != 3) {
+        printf ("_rtps_test_restart error: %d packets stored, %u received since the restart\n", jbuf_count (src->jitterBuffer), src->state.received);
+        rtps_destroy_table (table);
+        exit (1);
+    }
+    rtps_destroy_table (table);
+    printf ("Tests PASSED (number of tests: %d)\n", tests + 1);
+}
@@ -0,0 +1,111 @@
+/* rtpSource.h */
+
+/* Per-source (SSRC) reception state.
+ * Sequence number validation and interarrival jitter follow RFC 3550,
+ * appendix A.1 and A.8, using the 'source' structure defined in rtp.h.
+ *
+ * Sources are kept in a table (open addressing, indexed by SSRC). Each entry
+ * owns a jitter buffer (see jitterBuffer.h) with the payload of the last
+ * packets received from that source, indexed by sequence number.
+ * Restrictions
+ * - A table must be used by a single thread. Different threads can own
+ *   different tables at the same time.
+ */
+
+#ifndef RTP_SOURCE_H
+#define RTP_SOURCE_H
+
+#include "rtp.h"
+
+struct rtpSource {
+    u_int32 ssrc;
+    int inUse;
+    source state;               /* sequence numbers, counters and jitter */
+    void *jitterBuffer;         /* see jitterBuffer.h */
+    u_int32 lsr;                /* middle 32 bits of the NTP timestamp of the last SR received */
+    u_int32 lsrArrival;         /* arrival time of that SR, 1/65536 s units (see rtcp_now_65536) */
+    u_int32 receivedChecked;    /* state.received at the last check for timeouts (see rtpSession.c) */
+    int silentChecks;           /* consecutive checks without packets */
+    int bye;                    /* BYE received, removed at the next check */
+};
+
+struct rtpSourceTable;
+
+
+/* Initializes the sequence number state of 's' with the first sequence number received */
+void rtps_init_seq (source *s, u_int16 seq);
+
+/* Results of rtps_update_seq */
+enum rtps_seq_result {
+    RTPS_SEQ_DISCARD = 0,       /* the source is still on probation, or the packet must be discarded */
+    RTPS_SEQ_VALID = 1,         /* in sequence, or within the misorder/dropout margins */
+    RTPS_SEQ_RESYNC = 2         /* valid, but the sender restarted: the sequence numbers start again from it */
+};
+
+/* Updates the sequence number state of 's' with a new packet.
+ * Returns an enum rtps_seq_result value. */
+int rtps_update_seq (source *s, u_int16 seq);
+
+/* Updates the interarrival jitter estimation of 's'.
+ * 'arrival' is the arrival time of the packet expressed in RTP timestamp units */
+void rtps_update_jitter (source *s, u_int32 rtpTs, u_int32 arrival);
+
+/* Number of packets expected, and lost, since the source was first received */
+u_int32 rtps_expected (const source *s);
+int rtps_lost (const source *s);
+
+
+/* Creates a table for up to 'maxSources' sources. Each new source gets a
+ * jitter buffer of 'numberOfBlocks' packets (rounded up to a power of 2) of
+ * up to 'blockSize' bytes of payload, allocated with 'memFlags' (see enum amem_flags).
+ * Returns NULL if memory could not be allocated. */
+struct rtpSourceTable *rtps_create_table (int maxSources, int numberOfBlocks, int blockSize, int memFlags);
+
+/* Returns the entry for 'ssrc', creating it (with its jitter buffer) if it
+ * was not in the table. 'seq' is the sequence number of the packet that is
+ * being processed, used to initialize a new source.
+ * Returns NULL if the table is full or the jitter buffer could not be allocated. */
+struct rtpSource *rtps_lookup (struct rtpSourceTable *table, u_int32 ssrc, u_int16 seq);
+
+/* Returns the entry for 'ssrc', or NULL if it is not in the table. Does not create it. */
+struct rtpSource *rtps_find (struct rtpSourceTable *table, u_int32 ssrc);
+
+/* Removes 'ssrc' from the table, freeing its jitter buffer. Does nothing if it is not in the table */
+void rtps_remove (struct rtpSourceTable *table, u_int32 ssrc);
+
+/* Stores 'length' bytes of payload of packet 'seq' (timestamp 'ts') in the
+ * jitter buffer of 'src', in its place by sequence number. If the packet is
+ * too far ahead, the oldest packets are discarded (see jbuf_overflows).
+ * Payloads longer than the block size are truncated. Returns an enum jbuf_result value */
+int rtps_store (struct rtpSource *src, u_int16 seq, u_int32 ts, const void *payload, int length);
+
+/* Results of rtps_receive */
+enum rtps_result {
+    RTPS_STORED = 0,            /* valid packet, payload stored in the jitter buffer of its source */
+    RTPS_INVALID = -1,          /* not an RTP packet (too short, bad version, bad padding/extension) */
+    RTPS_TABLE_FULL = -2,       /* new source, but there is no room for it */
+    RTPS_DISCARDED = -3,        /* source on probation, or sequence number out of the valid margins */
+    RTPS_DUPLICATE = -4,        /* the packet was already in the jitter buffer */
+    RTPS_LATE = -5              /* older than the packets already extracted from the jitter buffer */
+};
+
+/* Processes one received RTP packet: parses the header, finds (or creates)
+ * its source, updates sequence and jitter state, and stores the payload.
+ * 'arrival' is the arrival time in RTP timestamp units.
+ * If 'srcOut' is not NULL, it returns the source of the packet (NULL for
+ * RTPS_INVALID and RTPS_TABLE_FULL). Returns an enum rtps_result value. */
+int rtps_receive (struct rtpSourceTable *table, const unsigned char *packet, int length,
+        u_int32 arrival, struct rtpSource **srcOut);
+
+/* Iteration over the table: slots are numbered from 0 to rtps_capacity()-1,
+ * rtps_get returns NULL for empty slots */
+int rtps_capacity (const struct rtpSourceTable *table);
+struct rtpSource *rtps_get (struct rtpSourceTable *table, int slot);
+
+/* Number of sources in the table */
+int rtps_count (const struct rtpSourceTable *table);
+
+/* Frees the table and the jitter buffers of all its sources */
+void rtps_destroy_table (struct rtpSourceTable *table);
+
+#endif /* RTP_SOURCE_H */
@@ -0,0 +1,165 @@
+/* sampleConvert.c */
+
+#include "sampleConvert.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+
+/*=====================================================================*/
+void conv_swap16_scalar (void *dst, const void *src, int samples)
+{
+    const uint16_t *in = src;
+    uint16_t *out = dst;
+    int i;
+
+    for (i = 0; i < samples; i++) {
+        out[i] = (uint16_t) ((in[i] << 8) | (in[i] >> 8));
+    }
+}
+
+
+void conv_swap16 (void *dst, const void *src, int samples)
+{
+    const unsigned char *in = src;
+    unsigned char *out = dst;
+    int i = 0;
+
+#if defined(__AVX2__)
+    for (; i + 16 <= samples; i += 16) {
+        __m256i v = _mm256_loadu_si256 ((const __m256i *) (in + 2 * i));
+        v = _mm256_or_si256 (_mm256_slli_epi16 (v, 8), _mm256_srli_epi16 (v, 8));
+        _mm256_storeu_si256 ((__m256i *) (out + 2 * i), v);
+    }
+#endif
+#if defined(__SSE2__)
+    for (; i + 8 <= samples; i += 8) {
+        __m128i v = _mm_loadu_si128 ((const __m128i *) (in + 2 * i));
+        v = _mm_or_si128 (_mm_slli_epi16 (v, 8), _mm_srli_epi16 (v, 8));
+        _mm_storeu_si128 ((__m128i *) (out + 2 * i), v);
+    }
+#endif
+    conv_swap16_scalar (out + 2 * i, in + 2 * i, samples - i);
+}
+
+
+/*=====================================================================*/
+void conv_interleave16_scalar (int16_t *dst, const int16_t *left, const int16_t *right, int frames)
+{
+    int i;
+
+    for (i = 0; i < frames; i++) {
+        dst[2 * i] = left[i];
+        dst[2 * i + 1] = right[i];
+    }
+}
+
+
+void conv_interleave16 (int16_t *dst, const int16_t *left, const int16_t *right, int frames)
+{
+    int i = 0;
+
+#if defined(__SSE2__)
+    for (; i + 8 <= frames; i += 8) {
+        __m128i l = _mm_loadu_si128 ((const __m128i *) (left + i));
+        __m128i r = _mm_loadu_si128 ((const __m128i *) (right + i));
+        _mm_storeu_si128 ((__m128i *) (dst + 2 * i), _mm_unpacklo_epi16 (l, r));
+        _mm_storeu_si128 ((__m128i *) (dst + 2 * i + 8), _mm_unpackhi_epi16 (l, r));
+    }
+#endif
+    conv_interleave16_scalar (dst + 2 * i, left + i, right + i, frames - i);
+}
+
+
+void conv_deinterleave16_scalar (int16_t *left, int16_t *right, const int16_t *src, int frames)
+{
+    int i;
+
+    for (i = 0; i < frames; i++) {
+        left[i] = src[2 * i];
+        right[i] = src[2 * i + 1];
+    }
+}
+
+
+void conv_deinterleave16 (int16_t *left, int16_t *right, const int16_t *src, int frames)
+{
+    int i = 0;
+
+#if defined(__SSE2__)
+    for (; i + 8 <= frames; i += 8) {
+        __m128i a = _mm_loadu_si128 ((const __m128i *) (src + 2 * i));
+        __m128i b = _mm_loadu_si128 ((const __m128i *) (src + 2 * i + 8));
+        /* each 32-bit lane is a frame: sign-extend each half and pack (no saturation happens) */
+        __m128i l = _mm_packs_epi32 (_mm_srai_epi32 (_mm_slli_epi32 (a, 16), 16),
+                _mm_srai_epi32 (_mm_slli_epi32 (b, 16), 16));
+        __m128i r = _mm_packs_epi32 (_mm_srai_epi32 (a, 16), _mm_srai_epi32 (b, 16));
+        _mm_storeu_si128 ((__m128i *) (left + i), l);
+        _mm_storeu_si128 ((__m128i *) (right + i), r);
+    }
+#endif
+    conv_deinterleave16_scalar (left + i, right + i, src + 2 * i, frames - i);
+}
+
+
+/*=====================================================================*/
+/* G.711 A-law: 13-bit magnitude, segment is the position of the highest bit */
+static inline unsigned char _linearToAlaw (int16_t sample)
+{
+    int pcm = sample >> 3;
+    int mask, seg, aval;
+
+    if (pcm >= 0) {
+        mask = 0xD5;
+    } else {
+        mask = 0x55;
+        pcm = -pcm - 1;
+    }
+    if (pcm < 0x20) {
+        aval = pcm >> 1;
+    } else {
+        seg = 31 - __builtin_clz (pcm) - 4;     /* 1..7 */
+        aval = (seg << 4) | ((pcm >> seg) & 0x0F);
+    }
+    return (unsigned char) (aval ^ mask);
+}
+
+
+static inline int16_t _alawToLinear (unsigned char aval)
+{
+    int t, seg;
+
+    aval ^= 0x55;
+    t = (aval & 0x0F) << 4;
+    seg = (aval & 0x70) >> 4;
+    if (seg == 0) {
+        t += 8;
+    } else {
+        t = (t + 0x108) << (seg - 1);
+    }
+    return (int16_t) ((aval & 0x80) ? t : -t);
+}
+
+
+void conv_alaw_encode (unsigned char *dst, const int16_t *src, int samples)
+{
+    int i;
+
+    for (i = 0; i < samples; i++) {
+        dst[i] = _linearToAlaw (src[i]);
+    }
+}
+
+
+void conv_alaw_decode (int16_t *dst, const unsigned char *src, int samples)
+{
+    int i;
+
+    for (i = 0; i < samples; i++) {
+        dst[i] = _alawToLinear (src[i]);
+    }
+}
@@ -0,0 +1,35 @@
+/* sampleConvert.h */
+
+/* Conversions of 16-bit samples between the soundcard and the RTP payloads:
+ * byte swap (S16_LE from the soundcard <-> L16, which is big endian on the
+ * network, RFC 3551 4.5.11), interleave/deinterleave of stereo frames, and
+ * G.711 A-law (PCMA).
+ * Swap and (de)interleave use SSE2 (AVX2 if compiled with -mavx2) on x86; the
+ * _scalar versions are the portable reference, used for the remaining samples
+ * and in other architectures.
+ * Pointers do not need any alignment. Source and destination may be the same
+ * buffer for conv_swap16.
+ */
+
+#ifndef SAMPLE_CONVERT_H
+#define SAMPLE_CONVERT_H
+
+#include <stdint.h>
+
+/* Swaps the bytes of 'samples' 16-bit samples */
+void conv_swap16 (void *dst, const void *src, int samples);
+void conv_swap16_scalar (void *dst, const void *src, int samples);
+
+/* Builds 'frames' stereo frames (L R L R ...) from two channels */
+void conv_interleave16 (int16_t *dst, const int16_t *left, const int16_t *right, int frames);
+void conv_interleave16_scalar (int16_t *dst, const int16_t *left, const int16_t *right, int frames);
+
+/* Splits 'frames' stereo frames in two channels */
+void conv_deinterleave16 (int16_t *left, int16_t *right, const int16_t *src, int frames);
+void conv_deinterleave16_scalar (int16_t *left, int16_t *right, const int16_t *src, int frames);
+
+/* G.711 A-law, from/to 16-bit linear samples in host order */
+void conv_alaw_encode (unsigned char *dst, const int16_t *src, int samples);
+void conv_alaw_decode (int16_t *dst, const unsigned char *src, int samples);
+
+#endif /* SAMPLE_CONVERT_H */
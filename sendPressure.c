@@ -0,0 +1,197 @@
+/* sendPressure.c */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <linux/sockios.h>
+
+#include "sendPressure.h"
+
+#define NS_PER_SEC 1000000000LL
+
+struct sendPressure {
+    int packetDuration;         /* requested, ms */
+    int step;                   /* 1..PRESS_STEPS */
+    int maxPacketRate;
+    int started;
+    long long windowStart;      /* ns */
+    long long cpuStart;         /* ns */
+    long long packets;          /* in the window */
+    double backlog;             /* highest fraction of the send buffer in the window */
+    int calm;                   /* consecutive windows in which a shorter duration would fit */
+};
+
+
+/*=====================================================================*/
+static long long _clockNs (clockid_t clock)
+{
+    struct timespec t;
+    clock_gettime (clock, &t);
+    return t.tv_sec * NS_PER_SEC + t.tv_nsec;
+}
+
+
+/*=====================================================================*/
+void *press_create (int packetDuration, int maxPacketRate)
+{
+    struct sendPressure *p;
+
+    if (packetDuration <= 0 || maxPacketRate < 0) {
+        printf ("Invalid send pressure parameters: packet duration %d, packet rate %d\n", packetDuration, maxPacketRate);
+        return NULL;
+    }
+    if ((p = calloc (1, sizeof (struct sendPressure))) == NULL) {
+        printf ("Error reserving memory in sendPressure\n");
+        return NULL;
+    }
+    p->packetDuration = packetDuration;
+    p->maxPacketRate = maxPacketRate;
+    p->step = 1;
+    return p;
+}
+
+
+int press_sample (void *pressure, int packets, int sockId)
+{
+    int backlog = 0, buffer = 0;
+    socklen_t length = sizeof (buffer);
+
+    /* both in bytes of kernel memory (the buffer size returned is twice the one set) */
+    if (ioctl (sockId, SIOCOUTQ, &backlog) < 0 || getsockopt (sockId, SOL_SOCKET, SO_SNDBUF, &buffer, &length) < 0) {
+        backlog = buffer = 0;
+    }
+    return press_update (pressure, _clockNs (CLOCK_MONOTONIC), _clockNs (CLOCK_PROCESS_CPUTIME_ID), packets, backlog, buffer);
+}
+
+
+int press_update (void *pressure, long long nowNs, long long cpuNs, int packets, int backlog, int buffer)
+{
+    struct sendPressure *p = pressure;
+    double elapsed, rate, cpu, scale;
+    int over, changed = 0;
+
+    if (!p->started) {
+        p->started = 1;
+        p->windowStart = nowNs;
+        p->cpuStart = cpuNs;
+        p->packets = 0;
+        p->backlog = 0.0;
+    }
+    p->packets += packets;
+    if (buffer > 0 && (double) backlog / buffer > p->backlog) {
+        p->backlog = (double) backlog / buffer;
+    }
+    if (nowNs - p->windowStart < (long long) PRESS_WINDOW_MS * 1000000) {
+        return 0;
+    }
+
+    elapsed = (double) (nowNs - p->windowStart);
+    rate = p->packets * 1e9 / elapsed;
+    cpu = (cpuNs - p->cpuStart) / elapsed;
+    over = (p->maxPacketRate > 0 && rate > p->maxPacketRate) || cpu > PRESS_CPU_HIGH || p->backlog > PRESS_BACKLOG_HIGH;
+
+    if (over) {
+        p->calm = 0;
+        if (p->step < PRESS_STEPS) {
+            p->step++;
+            changed = 1;
+        }
+    } else if (p->step > 1) {
+        /* what rate and CPU would be with the shorter duration */
+        scale = (double) p->step / (p->step - 1);
+        if ((p->maxPacketRate == 0 || rate * scale < p->maxPacketRate * PRESS_DOWN_MARGIN)
+                && cpu * scale < PRESS_CPU_HIGH * PRESS_DOWN_MARGIN && p->backlog < PRESS_BACKLOG_LOW) {
+            if (++p->calm >= PRESS_DOWN_HOLD) {
+                p->step--;
+                p->calm = 0;
+                changed = 1;
+            }
+        } else {
+            p->calm = 0;
+        }
+    }
+
+    p->windowStart = nowNs;
+    p->cpuStart = cpuNs;
+    p->packets = 0;
+    p->backlog = 0.0;
+    return changed;
+}
+
+
+int press_packet_duration (void *pressure)
+{
+    struct sendPressure *p = pressure;
+    return p->packetDuration * p->step;
+}
+
+
+int press_max_packet_duration (void *pressure)
+{
+    struct sendPressure *p = pressure;
+    return p->packetDuration * PRESS_STEPS;
+}
+
+
+void press_destroy (void *pressure)
+{
+    free (pressure);
+}
+
+
+/* TEST for sendPressure functions.
+ * To execute it, use following code  */
+
+/* #include "sendPressure.h"
+void _press_test_controller(void);
+void main (void)
+{
+    _press_test_controller();
+} */
+
+
+void _press_test_controller (void)
+{
+    /* Each line is a window of 1 s:
+     *  packets sent, CPU ms, backlog (% of the buffer),
+     *  expected return of press_update, expected packet duration (ms) */
+    enum {PACKETS, CPU, BACKLOG, CHANGED, DURATION};
+    const int lines[][5] = {
+        {  50, 100,  0, 0, 20 },    /* under every threshold */
+        { 150, 100,  0, 1, 40 },    /* rate over 100 packets/s */
+        {  75, 100,  0, 0, 40 },    /* 150 at 20 ms would be over again */
+        {  30, 700,  0, 1, 60 },    /* CPU over 60% */
+        {  30, 100, 60, 0, 60 },    /* backlog over 50%, but the longest already */
+        {  30, 100,  0, 0, 60 },    /* 5 calm windows: 45 packets/s at 40 ms */
+        {  30, 100,  0, 0, 60 },
+        {  30, 100,  0, 0, 60 },
+        {  30, 100,  0, 0, 60 },
+        {  30, 100,  0, 1, 40 },
+        {  40, 100,  0, 0, 40 },    /* 80 at 20 ms is not under the margin: calm restarts */
+        {  40, 100, 60, 1, 60 },    /* backlog */
+    };
+    void *p = press_create (20, 100);
+    long long now = 0, cpu = 0;
+    int test, errors = 0;
+
+    press_update (p, now, cpu, 0, 0, 1000);
+    for (test = 0; test < (int) (sizeof (lines) / sizeof (lines[0])); test++) {
+        const int *line = lines[test];
+        int changed;
+        now += NS_PER_SEC;
+        cpu += (long long) line[CPU] * 1000000;
+        changed = press_update (p, now, cpu, line[PACKETS], line[BACKLOG] * 10, 1000);
+        if (changed != line[CHANGED] || press_packet_duration (p) != line[DURATION]) {
+            printf ("_press_test_controller error at test number %d: returned %d, %d ms\n", test, changed, press_packet_duration (p));
+            errors++;
+        }
+    }
+    press_destroy (p);
+
+    if (errors > 0) {
+        exit (1);
+    }
+    printf ("Tests PASSED (number of tests: %d)\n", test);
+}
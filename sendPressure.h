@@ -0,0 +1,57 @@
+/* sendPressure.h */
+
+/* Packet duration of a sender chosen by the pressure on the host, so that a
+ * saturated sender halves (or divides by three) its packet rate and the
+ * per-packet costs with it. The durations are 1, 2 and 3 times the requested
+ * one (as the levels of adaptivePayload), and the pressure is measured every
+ * PRESS_WINDOW_MS from
+ * - the packet rate of the process, against the ceiling given
+ * - the CPU time of the process, against PRESS_CPU_HIGH of the wall time
+ * - the bytes queued in the socket not yet sent (SIOCOUTQ), against
+ *   PRESS_BACKLOG_HIGH of its buffer
+ * With hysteresis: one step longer after a window over any threshold, one
+ * step shorter after PRESS_DOWN_HOLD windows in which the shorter duration
+ * would have stayed under PRESS_DOWN_MARGIN of every threshold (rate and CPU
+ * are scaled to it) and the backlog was under PRESS_BACKLOG_LOW.
+ * Receivers need nothing: timestamps advance by the samples of each packet,
+ * whatever its duration.
+ * Restrictions
+ * - Use only in single-thread code, as circularBuffer.
+ */
+
+#ifndef SEND_PRESSURE_H
+#define SEND_PRESSURE_H
+
+#define PRESS_WINDOW_MS 1000
+#define PRESS_DOWN_HOLD 5           /* windows */
+#define PRESS_CPU_HIGH 0.6          /* fraction of a core */
+#define PRESS_BACKLOG_HIGH 0.5      /* fraction of the socket send buffer */
+#define PRESS_BACKLOG_LOW 0.1
+#define PRESS_DOWN_MARGIN 0.8
+#define PRESS_STEPS 3               /* durations: 1, 2 or 3 times the requested one */
+
+/* Returns a pointer which represents the controller, to be used by the rest
+ * of functions, starting with 'packetDuration' ms, for a packet rate ceiling
+ * of 'maxPacketRate' packets/s (0: the rate is not considered).
+ * On error, memory could not be allocated, returns NULL. */
+void *press_create (int packetDuration, int maxPacketRate);
+
+/* Counts 'packets' just sent through the socket 'sockId', and measures the
+ * pressure if a window has passed. Returns 1 if the duration changed */
+int press_sample (void *pressure, int packets, int sockId);
+
+/* As press_sample, with the measures given: 'nowNs' (monotonic), 'cpuNs'
+ * (CPU time of the process), 'packets' sent since the last call, 'backlog'
+ * bytes queued in a send buffer of 'buffer' bytes */
+int press_update (void *pressure, long long nowNs, long long cpuNs, int packets, int backlog, int buffer);
+
+/* Current packet duration, ms */
+int press_packet_duration (void *pressure);
+
+/* Longest packet duration it can choose, ms */
+int press_max_packet_duration (void *pressure);
+
+/* Frees memory of the controller */
+void press_destroy (void *pressure);
+
+#endif /* SEND_PRESSURE_H */
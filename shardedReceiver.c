@@ -0,0 +1,339 @@
+/* shardedReceiver.c */
+
+#define _GNU_SOURCE /* recvmmsg */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <linux/filter.h>
+
+#include "shardedReceiver.h"
+#include "rtpSource.h"
+#include "jitterBuffer.h"
+#include "srtp.h"
+
+#define RECV_BATCH 32           /* datagrams per recvmmsg call */
+#define RECV_BUFFER_SIZE 8192   /* maximum datagram size */
+#define RECV_TIMEOUT_MS 200     /* how often workers check if they must finish */
+
+struct worker {
+    pthread_t thread;
+    int started;
+    int index;
+    int sockId;
+    int rate;
+    volatile int *stop;
+    struct rtpSourceTable *sources;
+    void *srtp;                     /* NULL: RTP in clear */
+
+    /* statistics, read by the main thread only after the worker finished */
+    unsigned long long datagrams;
+    unsigned long long bytes;
+    unsigned long long stored;
+    unsigned long long invalid;
+    unsigned long long discarded;   /* probation, bad sequence number */
+    unsigned long long tableFull;
+    unsigned long long rejected;    /* not authenticated or replayed (SRTP) */
+    unsigned long long recvCalls;
+};
+
+struct shardedReceiver {
+    int workers;
+    volatile int stop;
+    struct worker w[SHARD_MAX_WORKERS];
+};
+
+
+/* RTP clock for the arrival time; only differences matter, so the origin is arbitrary */
+static u_int32 _arrivalRtpUnits (int rate)
+{
+    struct timespec now;
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    return (u_int32) ((unsigned long long) now.tv_sec * rate + (unsigned long long) now.tv_nsec * rate / 1000000000ULL);
+}
+
+
+/* Multicast datagrams are delivered to every socket bound to the group (the
+ * reuseport group selection only applies to unicast), so each worker socket
+ * gets a classic BPF filter that accepts only its share of the traffic:
+ * - by default, a hash of the source address and ports, so each sender stays on one worker
+ * - with steerBySsrc, SSRC % workers, so each source stays on one worker even
+ *   if many of them share the same address and port (e.g. rtpLoadGen).
+ * The filter runs in the kernel before queueing, so the other workers are not
+ * woken up. For a UDP socket filter the packet starts at the UDP header, so
+ * the SSRC is at offset 8 + 8. If a load fails (packet too short) the
+ * program returns 0, dropping the packet. */
+static int _attachShardFilter (int sockId, int index, int workers, int steerBySsrc)
+{
+    struct sock_filter bySsrc[] = {
+        { BPF_LD | BPF_W | BPF_ABS, 0, 0, 16 },                 /* A = SSRC */
+        { BPF_ALU | BPF_MOD | BPF_K, 0, 0, workers },           /* A = A % workers */
+        { BPF_JMP | BPF_JEQ | BPF_K, 0, 1, index },
+        { BPF_RET | BPF_K, 0, 0, 0xffffffff },                  /* accept */
+        { BPF_RET | BPF_K, 0, 0, 0 },                           /* drop */
+    };
+    struct sock_filter byAddress[] = {
+        { BPF_LD | BPF_W | BPF_ABS, 0, 0, SKF_NET_OFF + 12 },   /* A = IPv4 source address */
+        { BPF_MISC | BPF_TAX, 0, 0, 0 },                        /* X = A */
+        { BPF_LD | BPF_W | BPF_ABS, 0, 0, 0 },                  /* A = source port, destination port */
+        { BPF_ALU | BPF_XOR | BPF_X, 0, 0, 0 },                 /* A = A ^ X */
+        { BPF_ALU | BPF_MOD | BPF_K, 0, 0, workers },
+        { BPF_JMP | BPF_JEQ | BPF_K, 0, 1, index },
+        { BPF_RET | BPF_K, 0, 0, 0xffffffff },
+        { BPF_RET | BPF_K, 0, 0, 0 },
+    };
+    struct sock_fprog program;
+
+    if (steerBySsrc) {
+        program.len = sizeof (bySsrc) / sizeof (bySsrc[0]);
+        program.filter = bySsrc;
+    } else {
+        program.len = sizeof (byAddress) / sizeof (byAddress[0]);
+        program.filter = byAddress;
+    }
+    if (setsockopt (sockId, SOL_SOCKET, SO_ATTACH_FILTER, &program, sizeof (program)) < 0) {
+        printf ("setsockopt(SO_ATTACH_FILTER) failed, error: %s\n", strerror (errno));
+        return -1;
+    }
+    return 0;
+}
+
+
+static int _openSocket (struct in_addr multicastIp, int port, int index, int workers, int steerBySsrc)
+{
+    struct sockaddr_in localSAddr;
+    struct ip_mreq mreq;
+    struct timeval timeout;
+    int sockId;
+    int enable = 1;
+
+    if ((sockId = socket (AF_INET, SOCK_DGRAM, 0)) < 0) {
+        printf ("socket error\n");
+        return -1;
+    }
+
+    /* SO_REUSEADDR lets other audioc instances use the same group/port, SO_REUSEPORT lets all the workers bind it */
+    if (setsockopt (sockId, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof (int)) < 0) {
+        printf ("setsockopt(SO_REUSEADDR) failed\n");
+        close (sockId);
+        return -1;
+    }
+    if (setsockopt (sockId, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof (int)) < 0) {
+        printf ("setsockopt(SO_REUSEPORT) failed\n");
+        close (sockId);
+        return -1;
+    }
+
+    /* attached before bind, so no packet from other shards is ever queued */
+    if (workers > 1 && _attachShardFilter (sockId, index, workers, steerBySsrc) < 0) {
+        close (sockId);
+        return -1;
+    }
+
+    timeout.tv_sec = 0;
+    timeout.tv_usec = RECV_TIMEOUT_MS * 1000;
+    if (setsockopt (sockId, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof (timeout)) < 0) {
+        printf ("setsockopt(SO_RCVTIMEO) failed\n");
+        close (sockId);
+        return -1;
+    }
+
+    memset (&localSAddr, 0, sizeof (localSAddr));
+    localSAddr.sin_family = AF_INET;
+    localSAddr.sin_port = htons (port);
+    localSAddr.sin_addr = multicastIp;
+    if (bind (sockId, (struct sockaddr *) &localSAddr, sizeof (struct sockaddr_in)) < 0) {
+        printf ("bind error: %s\n", strerror (errno));
+        close (sockId);
+        return -1;
+    }
+
+    mreq.imr_multiaddr = multicastIp;
+    mreq.imr_interface.s_addr = htonl (INADDR_ANY);
+    if (setsockopt (sockId, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof (mreq)) < 0) {
+        printf ("setsockopt(IP_ADD_MEMBERSHIP) error: %s\n", strerror (errno));
+        close (sockId);
+        return -1;
+    }
+    return sockId;
+}
+
+
+static void *_workerLoop (void *arg)
+{
+    struct worker *w = (struct worker *) arg;
+    struct mmsghdr msgs[RECV_BATCH];
+    struct iovec iovecs[RECV_BATCH];
+    unsigned char *buffers;
+    int i;
+
+    /* receive buffers are reserved once, each worker has its own */
+    if ((buffers = malloc (RECV_BATCH * RECV_BUFFER_SIZE)) == NULL) {
+        printf ("Could not reserve memory for worker %d.\n", w->index);
+        return NULL;
+    }
+    memset (msgs, 0, sizeof (msgs));
+    for (i = 0; i < RECV_BATCH; i++) {
+        iovecs[i].iov_base = buffers + i * RECV_BUFFER_SIZE;
+        iovecs[i].iov_len = RECV_BUFFER_SIZE;
+        msgs[i].msg_hdr.msg_iov = &iovecs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    while (!*(w->stop))
+    {
+        int received = recvmmsg (w->sockId, msgs, RECV_BATCH, MSG_WAITFORONE, NULL);
+        u_int32 arrival;
+
+        if (received < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                continue; /* timeout, check w->stop */
+            }
+            printf ("recvmmsg error in worker %d: %s\n", w->index, strerror (errno));
+            break;
+        }
+        w->recvCalls++;
+
+        arrival = _arrivalRtpUnits (w->rate); /* one clock read per batch */
+        for (i = 0; i < received; i++) {
+            int length = msgs[i].msg_len;
+            int result;
+
+            w->datagrams++;
+            w->bytes += length;
+            if (w->srtp != NULL && (length = srtp_unprotect (w->srtp, iovecs[i].iov_base, length)) < 0) {
+                w->rejected++;
+                continue;
+            }
+            result = rtps_receive (w->sources, iovecs[i].iov_base, length, arrival, NULL);
+            switch (result) {
+                case RTPS_STORED: w->stored++; break;
+                case RTPS_INVALID: w->invalid++; break;
+                case RTPS_TABLE_FULL: w->tableFull++; break;
+                default: w->discarded++; break;
+            }
+        }
+    }
+
+    free (buffers);
+    return NULL;
+}
+
+
+/*=====================================================================*/
+void *shard_start (struct in_addr multicastIp, int port, int workers, int steerBySsrc,
+        int rate, int numberOfBlocks, int blockSize, int memFlags, const unsigned char *srtpMaster)
+{
+    struct shardedReceiver *r;
+    int i;
+
+    if (workers < 1 || workers > SHARD_MAX_WORKERS) {
+        printf ("Number of workers must be in the range [1..%d]\n", SHARD_MAX_WORKERS);
+        return NULL;
+    }
+    if (numberOfBlocks < 1) {
+        numberOfBlocks = 1;
+    }
+    if ((r = calloc (1, sizeof (struct shardedReceiver))) == NULL) {
+        printf ("Error reserving memory in shardedReceiver\n");
+        return NULL;
+    }
+    r->workers = workers;
+    r->stop = 0;
+
+    /* sockets are created here, so that errors are reported before any thread starts */
+    for (i = 0; i < workers; i++) {
+        struct worker *w = &r->w[i];
+        w->index = i;
+        w->rate = rate;
+        w->stop = &r->stop;
+        w->sockId = _openSocket (multicastIp, port, i, workers, steerBySsrc);
+        w->sources = rtps_create_table (SHARD_MAX_SOURCES, numberOfBlocks, blockSize, memFlags);
+        if (srtpMaster != NULL && w->sources != NULL) {
+            w->srtp = srtp_create (srtpMaster, SHARD_MAX_SOURCES);
+        }
+        if (w->sockId < 0 || w->sources == NULL || (srtpMaster != NULL && w->srtp == NULL)) {
+            r->workers = i + 1;
+            shard_destroy (r);
+            return NULL;
+        }
+    }
+
+    for (i = 0; i < workers; i++) {
+        if (pthread_create (&r->w[i].thread, NULL, _workerLoop, &r->w[i]) != 0) {
+            printf ("Could not create worker thread %d\n", i);
+            shard_stop (r);
+            shard_destroy (r);
+            return NULL;
+        }
+        r->w[i].started = 1;
+    }
+    return r;
+}
+
+
+void shard_stop (void *receiver)
+{
+    struct shardedReceiver *r = (struct shardedReceiver *) receiver;
+    int i;
+
+    r->stop = 1;
+    for (i = 0; i < r->workers; i++) {
+        if (r->w[i].started) {
+            pthread_join (r->w[i].thread, NULL);
+            r->w[i].started = 0;
+        }
+    }
+}
+
+
+void shard_print_stats (void *receiver)
+{
+    struct shardedReceiver *r = (struct shardedReceiver *) receiver;
+    int i, slot;
+
+    for (i = 0; i < r->workers; i++) {
+        struct worker *w = &r->w[i];
+        unsigned long long lost = 0, jbufDiscarded = 0;
+
+        for (slot = 0; slot < rtps_capacity (w->sources); slot++) {
+            struct rtpSource *src = rtps_get (w->sources, slot);
+            if (src != NULL) {
+                lost += rtps_lost (&src->state) > 0 ? rtps_lost (&src->state) : 0;
+                jbufDiscarded += jbuf_overflows (src->jitterBuffer);
+            }
+        }
+        printf ("Worker %d: %d sources, %llu datagrams (%llu bytes, %.1f per recvmmsg), %llu stored, %llu invalid, %llu discarded, %llu without room, %llu lost, %llu jitter buffer overflows, %llu rejected by SRTP\n",
+                i, rtps_count (w->sources), w->datagrams, w->bytes,
+                w->recvCalls ? (double) w->datagrams / w->recvCalls : 0.0,
+                w->stored, w->invalid, w->discarded, w->tableFull, lost, jbufDiscarded, w->rejected);
+    }
+}
+
+
+void shard_destroy (void *receiver)
+{
+    struct shardedReceiver *r = (struct shardedReceiver *) receiver;
+    int i;
+
+    for (i = 0; i < r->workers; i++) {
+        if (r->w[i].sockId >= 0) {
+            close (r->w[i].sockId);
+        }
+        if (r->w[i].sources != NULL) {
+            rtps_destroy_table (r->w[i].sources);
+        }
+        if (r->w[i].srtp != NULL) {
+            srtp_destroy (r->w[i].srtp);
+        }
+    }
+    free (r);
+}
@@ -0,0 +1,44 @@
+/* shardedReceiver.h */
+
+/* Multi-threaded RTP reception for one multicast group/port.
+ * Each worker thread has its own UDP socket, bound with SO_REUSEPORT to the
+ * same group and port. Since the kernel delivers each multicast datagram to
+ * every socket of the group, each socket has a classic BPF filter which keeps
+ * only the share of its worker: by default a hash of the source address and
+ * ports; when SSRC steering is requested, SSRC % workers, so that each source
+ * always lands on the same worker even if many sources share the same address
+ * and port.
+ *
+ * Each worker owns the per-source state and the jitter buffers of the sources
+ * it receives (see rtpSource.h); nothing is shared between workers.
+ */
+
+#ifndef SHARDED_RECEIVER_H
+#define SHARDED_RECEIVER_H
+
+#include <netinet/in.h>
+
+#define SHARD_MAX_WORKERS 64
+#define SHARD_MAX_SOURCES 4096  /* per worker */
+
+/* Opens one socket per worker and starts the worker threads.
+ * 'rate' is the RTP clock rate of the payload, used for jitter estimation.
+ * Each source gets a jitter buffer of 'numberOfBlocks' blocks of 'blockSize' bytes,
+ * allocated with 'memFlags' (see enum amem_flags).
+ * With 'srtpMaster' (SRTP_MASTER_BYTES, see srtp.h), packets are SRTP and each
+ * worker unprotects them with its own context; NULL receives RTP in clear.
+ * Returns a pointer which represents the receiver, or NULL on error (a message is printed). */
+void *shard_start (struct in_addr multicastIp, int port, int workers, int steerBySsrc,
+        int rate, int numberOfBlocks, int blockSize, int memFlags, const unsigned char *srtpMaster);
+
+/* Requests the workers to finish and waits for them. Statistics are kept
+ * until shard_destroy() is called */
+void shard_stop (void *receiver);
+
+/* Prints per-worker statistics. Call it after shard_stop() */
+void shard_print_stats (void *receiver);
+
+/* Frees sockets, source tables and the receiver itself */
+void shard_destroy (void *receiver);
+
+#endif /* SHARDED_RECEIVER_H */
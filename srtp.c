@@ -0,0 +1,922 @@
+/* srtp.c */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdint.h>
+
+#include "srtp.h"
+
+#if defined(__AES__)
+#include <wmmintrin.h>
+#endif
+#if defined(__SHA__) && defined(__SSE4_1__)
+#include <immintrin.h>
+#define SHA_EXTENSIONS
+#endif
+
+#define AES_ROUNDS 10
+#define AES_KEY_SCHEDULE_BYTES (16 * (AES_ROUNDS + 1))
+#define AUTH_KEY_BYTES 20
+#define RTP_HEADER_BYTES 12
+
+/* key derivation labels, RFC 3711 4.3.2 */
+#define LABEL_CIPHER 0
+#define LABEL_AUTH 1
+#define LABEL_SALT 2
+
+#define GETU32(p) (((uint32_t) (p)[0] << 24) | ((uint32_t) (p)[1] << 16) | ((uint32_t) (p)[2] << 8) | (uint32_t) (p)[3])
+#define PUTU32(p, v) ((p)[0] = (uint8_t) ((v) >> 24), (p)[1] = (uint8_t) ((v) >> 16), (p)[2] = (uint8_t) ((v) >> 8), (p)[3] = (uint8_t) (v))
+#define ROL32(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+#define ROR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+#define ROTL8(x, n) ((uint8_t) (((x) << (n)) | ((x) >> (8 - (n)))))
+
+struct srtpStream {
+    int used;
+    uint32_t ssrc;
+    uint32_t roc;               /* rollover counter */
+    uint16_t highestSeq;        /* s_l in RFC 3711 */
+    uint64_t window;            /* bit k: index (roc, highestSeq) - k was received */
+    uint64_t lastUsed;          /* value of the context clock when a packet was last accepted */
+};
+
+struct srtpContext {
+    uint8_t roundKeys[AES_KEY_SCHEDULE_BYTES];  /* session encryption key, expanded */
+    uint8_t salt[16];           /* session salt; the two last bytes are 0 */
+    uint32_t inner[5];          /* SHA-1 state after the HMAC inner pad */
+    uint32_t outer[5];          /* SHA-1 state after the HMAC outer pad */
+    int mask;                   /* number of entries in 'streams' - 1 */
+    int count;
+    int maxStreams;
+    uint64_t clock;             /* packets accepted, to find the stream used least recently */
+    struct srtpStream *streams;
+};
+
+/* AES tables, built once by srtp_create */
+static uint8_t sbox[256];
+static uint32_t te0[256];       /* SubBytes and MixColumns of one byte in row 0 */
+static int tablesReady = 0;
+
+
+/*=====================================================================*/
+/* AES-128, encryption only (counter mode does not need decryption) */
+
+static uint8_t _xtime (uint8_t x)
+{
+    return (uint8_t) ((x << 1) ^ ((x & 0x80) ? 0x1b : 0));
+}
+
+
+static void _aesTables (void)
+{
+    uint8_t p = 1, q = 1;
+    int i;
+
+    if (tablesReady) {
+        return;
+    }
+    /* p goes through all the non-zero elements of GF(2^8), q is its inverse */
+    do {
+        p = p ^ _xtime (p);
+        q ^= q << 1;
+        q ^= q << 2;
+        q ^= q << 4;
+        if (q & 0x80) {
+            q ^= 0x09;
+        }
+        sbox[p] = q ^ ROTL8 (q, 1) ^ ROTL8 (q, 2) ^ ROTL8 (q, 3) ^ ROTL8 (q, 4) ^ 0x63;
+    } while (p != 1);
+    sbox[0] = 0x63;
+    for (i = 0; i < 256; i++) {
+        uint8_t s = sbox[i];
+        uint8_t s2 = _xtime (s);
+        te0[i] = ((uint32_t) s2 << 24) | ((uint32_t) s << 16) | ((uint32_t) s << 8) | (uint8_t) (s2 ^ s);
+    }
+    tablesReady = 1;
+}
+
+
+static void _aesExpand (const uint8_t key[16], uint8_t roundKeys[AES_KEY_SCHEDULE_BYTES])
+{
+    uint8_t rcon = 1;
+    int i, k;
+
+    memcpy (roundKeys, key, 16);
+    for (i = 16; i < AES_KEY_SCHEDULE_BYTES; i += 4) {
+        uint8_t t[4];
+
+        memcpy (t, roundKeys + i - 4, 4);
+        if (i % 16 == 0) {
+            uint8_t first = t[0];
+            t[0] = sbox[t[1]] ^ rcon;
+            t[1] = sbox[t[2]];
+            t[2] = sbox[t[3]];
+            t[3] = sbox[first];
+            rcon = _xtime (rcon);
+        }
+        for (k = 0; k < 4; k++) {
+            roundKeys[i + k] = roundKeys[i + k - 16] ^ t[k];
+        }
+    }
+}
+
+
+#if defined(__AES__)
+
+/* 'base' with the counter of the block in its two last bytes, big endian */
+static __m128i _counterBlock (__m128i base, int counter)
+{
+    return _mm_insert_epi16 (base, ((counter & 0xff) << 8) | ((counter >> 8) & 0xff), 7);
+}
+
+
+/* out = in ^ keystream of AES counter mode, from 'iv' (two last bytes 0) and counter 0 */
+static void _aesCtr (const uint8_t roundKeys[AES_KEY_SCHEDULE_BYTES], const uint8_t iv[16],
+        const uint8_t *in, uint8_t *out, int length)
+{
+    __m128i rk[AES_ROUNDS + 1];
+    __m128i base = _mm_loadu_si128 ((const __m128i *) iv);
+    int counter = 0;
+    int r, k;
+
+    for (r = 0; r <= AES_ROUNDS; r++) {
+        rk[r] = _mm_loadu_si128 ((const __m128i *) (roundKeys + 16 * r));
+    }
+    /* 4 blocks at a time, so that the latency of aesenc is hidden */
+    for (; length >= 64; length -= 64, in += 64, out += 64, counter += 4) {
+        __m128i b[4];
+        for (k = 0; k < 4; k++) {
+            b[k] = _mm_xor_si128 (_counterBlock (base, counter + k), rk[0]);
+        }
+        for (r = 1; r < AES_ROUNDS; r++) {
+            for (k = 0; k < 4; k++) {
+                b[k] = _mm_aesenc_si128 (b[k], rk[r]);
+            }
+        }
+        for (k = 0; k < 4; k++) {
+            b[k] = _mm_aesenclast_si128 (b[k], rk[AES_ROUNDS]);
+            _mm_storeu_si128 ((__m128i *) (out + 16 * k), _mm_xor_si128 (b[k], _mm_loadu_si128 ((const __m128i *) (in + 16 * k))));
+        }
+    }
+    for (; length > 0; length -= 16, in += 16, out += 16, counter++) {
+        __m128i b = _mm_xor_si128 (_counterBlock (base, counter), rk[0]);
+        for (r = 1; r < AES_ROUNDS; r++) {
+            b = _mm_aesenc_si128 (b, rk[r]);
+        }
+        b = _mm_aesenclast_si128 (b, rk[AES_ROUNDS]);
+        if (length >= 16) {
+            _mm_storeu_si128 ((__m128i *) out, _mm_xor_si128 (b, _mm_loadu_si128 ((const __m128i *) in)));
+        } else {
+            uint8_t keystream[16];
+            _mm_storeu_si128 ((__m128i *) keystream, b);
+            for (k = 0; k < length; k++) {
+                out[k] = in[k] ^ keystream[k];
+            }
+        }
+    }
+}
+
+#else
+
+static void _aesEncrypt (const uint8_t roundKeys[AES_KEY_SCHEDULE_BYTES], const uint8_t in[16], uint8_t out[16])
+{
+    const uint8_t *rk = roundKeys;
+    uint32_t s0, s1, s2, s3, t0, t1, t2, t3;
+    int r;
+
+    s0 = GETU32 (in) ^ GETU32 (rk);
+    s1 = GETU32 (in + 4) ^ GETU32 (rk + 4);
+    s2 = GETU32 (in + 8) ^ GETU32 (rk + 8);
+    s3 = GETU32 (in + 12) ^ GETU32 (rk + 12);
+    for (r = 1; r < AES_ROUNDS; r++) {
+        rk += 16;
+        t0 = te0[s0 >> 24] ^ ROR32 (te0[(s1 >> 16) & 0xff], 8) ^ ROR32 (te0[(s2 >> 8) & 0xff], 16) ^ ROR32 (te0[s3 & 0xff], 24) ^ GETU32 (rk);
+        t1 = te0[s1 >> 24] ^ ROR32 (te0[(s2 >> 16) & 0xff], 8) ^ ROR32 (te0[(s3 >> 8) & 0xff], 16) ^ ROR32 (te0[s0 & 0xff], 24) ^ GETU32 (rk + 4);
+        t2 = te0[s2 >> 24] ^ ROR32 (te0[(s3 >> 16) & 0xff], 8) ^ ROR32 (te0[(s0 >> 8) & 0xff], 16) ^ ROR32 (te0[s1 & 0xff], 24) ^ GETU32 (rk + 8);
+        t3 = te0[s3 >> 24] ^ ROR32 (te0[(s0 >> 16) & 0xff], 8) ^ ROR32 (te0[(s1 >> 8) & 0xff], 16) ^ ROR32 (te0[s2 & 0xff], 24) ^ GETU32 (rk + 12);
+        s0 = t0;
+        s1 = t1;
+        s2 = t2;
+        s3 = t3;
+    }
+    rk += 16;
+    t0 = (((uint32_t) sbox[s0 >> 24] << 24) | ((uint32_t) sbox[(s1 >> 16) & 0xff] << 16) | ((uint32_t) sbox[(s2 >> 8) & 0xff] << 8) | sbox[s3 & 0xff]) ^ GETU32 (rk);
+    t1 = (((uint32_t) sbox[s1 >> 24] << 24) | ((uint32_t) sbox[(s2 >> 16) & 0xff] << 16) | ((uint32_t) sbox[(s3 >> 8) & 0xff] << 8) | sbox[s0 & 0xff]) ^ GETU32 (rk + 4);
+    t2 = (((uint32_t) sbox[s2 >> 24] << 24) | ((uint32_t) sbox[(s3 >> 16) & 0xff] << 16) | ((uint32_t) sbox[(s0 >> 8) & 0xff] << 8) | sbox[s1 & 0xff]) ^ GETU32 (rk + 8);
+    t3 = (((uint32_t) sbox[s3 >> 24] << 24) | ((uint32_t) sbox[(s0 >> 16) & 0xff] << 16) | ((uint32_t) sbox[(s1 >> 8) & 0xff] << 8) | sbox[s2 & 0xff]) ^ GETU32 (rk + 12);
+    PUTU32 (out, t0);
+    PUTU32 (out + 4, t1);
+    PUTU32 (out + 8, t2);
+    PUTU32 (out + 12, t3);
+}
+
+
+/* out = in ^ keystream of AES counter mode, from 'iv' (two last bytes 0) and counter 0 */
+static void _aesCtr (const uint8_t roundKeys[AES_KEY_SCHEDULE_BYTES], const uint8_t iv[16],
+        const uint8_t *in, uint8_t *out, int length)
+{
+    uint8_t block[16], keystream[16];
+    int counter, n, k;
+
+    memcpy (block, iv, 16);
+    for (counter = 0; length > 0; counter++) {
+        block[14] = (uint8_t) (counter >> 8);
+        block[15] = (uint8_t) counter;
+        _aesEncrypt (roundKeys, block, keystream);
+        n = length < 16 ? length : 16;
+        for (k = 0; k < n; k++) {
+            out[k] = in[k] ^ keystream[k];
+        }
+        in += n;
+        out += n;
+        length -= n;
+    }
+}
+
+#endif
+
+
+/*=====================================================================*/
+/* SHA-1 and HMAC-SHA1 */
+
+#if defined(SHA_EXTENSIONS)
+
+/* 4 rounds with function 'f', computing the message schedule of the next ones */
+#define SHA1_ROUNDS4(ecur, enext, m0, m1, m2, m3, f) \
+    ecur = _mm_sha1nexte_epu32 (ecur, m0); \
+    enext = abcd; \
+    m1 = _mm_sha1msg2_epu32 (m1, m0); \
+    abcd = _mm_sha1rnds4_epu32 (abcd, ecur, f); \
+    m3 = _mm_sha1msg1_epu32 (m3, m0); \
+    m2 = _mm_xor_si128 (m2, m0)
+
+static void _sha1Blocks (uint32_t state[5], const uint8_t *data, int blocks)
+{
+    const __m128i byteSwap = _mm_set_epi64x (0x0001020304050607LL, 0x08090a0b0c0d0e0fLL);
+    __m128i abcd = _mm_shuffle_epi32 (_mm_loadu_si128 ((const __m128i *) state), 0x1b);
+    __m128i e0 = _mm_set_epi32 ((int) state[4], 0, 0, 0);
+    __m128i e1;
+
+    for (; blocks > 0; blocks--, data += 64) {
+        __m128i abcdSaved = abcd;
+        __m128i e0Saved = e0;
+        __m128i m0 = _mm_shuffle_epi8 (_mm_loadu_si128 ((const __m128i *) data), byteSwap);
+        __m128i m1 = _mm_shuffle_epi8 (_mm_loadu_si128 ((const __m128i *) (data + 16)), byteSwap);
+        __m128i m2 = _mm_shuffle_epi8 (_mm_loadu_si128 ((const __m128i *) (data + 32)), byteSwap);
+        __m128i m3 = _mm_shuffle_epi8 (_mm_loadu_si128 ((const __m128i *) (data + 48)), byteSwap);
+
+        /* rounds 0-11 */
+        e0 = _mm_add_epi32 (e0, m0);
+        e1 = abcd;
+        abcd = _mm_sha1rnds4_epu32 (abcd, e0, 0);
+        e1 = _mm_sha1nexte_epu32 (e1, m1);
+        e0 = abcd;
+        abcd = _mm_sha1rnds4_epu32 (abcd, e1, 0);
+        m0 = _mm_sha1msg1_epu32 (m0, m1);
+        e0 = _mm_sha1nexte_epu32 (e0, m2);
+        e1 = abcd;
+        abcd = _mm_sha1rnds4_epu32 (abcd, e0, 0);
+        m1 = _mm_sha1msg1_epu32 (m1, m2);
+        m0 = _mm_xor_si128 (m0, m2);
+
+        /* rounds 12-67 */
+        SHA1_ROUNDS4 (e1, e0, m3, m0, m1, m2, 0);
+        SHA1_ROUNDS4 (e0, e1, m0, m1, m2, m3, 0);
+        SHA1_ROUNDS4 (e1, e0, m1, m2, m3, m0, 1);
+        SHA1_ROUNDS4 (e0, e1, m2, m3, m0, m1, 1);
+        SHA1_ROUNDS4 (e1, e0, m3, m0, m1, m2, 1);
+        SHA1_ROUNDS4 (e0, e1, m0, m1, m2, m3, 1);
+        SHA1_ROUNDS4 (e1, e0, m1, m2, m3, m0, 1);
+        SHA1_ROUNDS4 (e0, e1, m2, m3, m0, m1, 2);
+        SHA1_ROUNDS4 (e1, e0, m3, m0, m1, m2, 2);
+        SHA1_ROUNDS4 (e0, e1, m0, m1, m2, m3, 2);
+        SHA1_ROUNDS4 (e1, e0, m1, m2, m3, m0, 2);
+        SHA1_ROUNDS4 (e0, e1, m2, m3, m0, m1, 2);
+        SHA1_ROUNDS4 (e1, e0, m3, m0, m1, m2, 3);
+        SHA1_ROUNDS4 (e0, e1, m0, m1, m2, m3, 3);
+
+        /* rounds 68-79 */
+        e1 = _mm_sha1nexte_epu32 (e1, m1);
+        e0 = abcd;
+        m2 = _mm_sha1msg2_epu32 (m2, m1);
+        abcd = _mm_sha1rnds4_epu32 (abcd, e1, 3);
+        m3 = _mm_xor_si128 (m3, m1);
+        e0 = _mm_sha1nexte_epu32 (e0, m2);
+        e1 = abcd;
+        m3 = _mm_sha1msg2_epu32 (m3, m2);
+        abcd = _mm_sha1rnds4_epu32 (abcd, e0, 3);
+        e1 = _mm_sha1nexte_epu32 (e1, m3);
+        e0 = abcd;
+        abcd = _mm_sha1rnds4_epu32 (abcd, e1, 3);
+
+        e0 = _mm_sha1nexte_epu32 (e0, e0Saved);
+        abcd = _mm_add_epi32 (abcd, abcdSaved);
+    }
+    _mm_storeu_si128 ((__m128i *) state, _mm_shuffle_epi32 (abcd, 0x1b));
+    state[4] = (uint32_t) _mm_extract_epi32 (e0, 3);
+}
+
+#else
+
+static void _sha1Blocks (uint32_t state[5], const uint8_t *data, int blocks)
+{
+    uint32_t w[80];
+    int i;
+
+    for (; blocks > 0; blocks--, data += 64) {
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+
+        for (i = 0; i < 16; i++) {
+            w[i] = GETU32 (data + 4 * i);
+        }
+        for (; i < 80; i++) {
+            w[i] = ROL32 (w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        }
+        for (i = 0; i < 80; i++) {
+            uint32_t f, k, t;
+            if (i < 20) {
+                f = (b & c) | (~b & d);
+                k = 0x5a827999;
+            } else if (i < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ed9eba1;
+            } else if (i < 60) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8f1bbcdc;
+            } else {
+                f = b ^ c ^ d;
+                k = 0xca62c1d6;
+            }
+            t = ROL32 (a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = ROL32 (b, 30);
+            b = a;
+            a = t;
+        }
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+    }
+}
+
+#endif
+
+
+/* The HMAC pads are hashed once, here, instead of for each packet */
+static void _hmacInit (struct srtpContext *c, const uint8_t key[AUTH_KEY_BYTES])
+{
+    static const uint32_t initial[5] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0};
+    uint8_t pad[64];
+    int i;
+
+    memset (pad, 0x36, sizeof (pad));
+    for (i = 0; i < AUTH_KEY_BYTES; i++) {
+        pad[i] ^= key[i];
+    }
+    memcpy (c->inner, initial, sizeof (initial));
+    _sha1Blocks (c->inner, pad, 1);
+
+    memset (pad, 0x5c, sizeof (pad));
+    for (i = 0; i < AUTH_KEY_BYTES; i++) {
+        pad[i] ^= key[i];
+    }
+    memcpy (c->outer, initial, sizeof (initial));
+    _sha1Blocks (c->outer, pad, 1);
+}
+
+
+/* Writes in 'tag' the HMAC-SHA1 of 'length' bytes of 'data' followed by 'roc', truncated */
+static void _hmac (const struct srtpContext *c, const uint8_t *data, int length, uint32_t roc, uint8_t tag[SRTP_AUTH_TAG_BYTES])
+{
+    uint32_t state[5];
+    uint8_t block[128];
+    int full = length / 64;
+    int rest = length % 64;
+    int blocks = (rest + 4 + 1 + 8 <= 64) ? 1 : 2;   /* rest, roc, 0x80 and the bit length */
+    uint64_t bits = (uint64_t) (64 + length + 4) * 8;
+    int i;
+
+    /* inner hash: the pad (already in 'inner'), the packet and the roc */
+    memcpy (state, c->inner, sizeof (state));
+    _sha1Blocks (state, data, full);
+    memcpy (block, data + 64 * full, rest);
+    PUTU32 (block + rest, roc);
+    block[rest + 4] = 0x80;
+    memset (block + rest + 5, 0, 64 * blocks - 8 - (rest + 5));
+    PUTU32 (block + 64 * blocks - 8, (uint32_t) (bits >> 32));
+    PUTU32 (block + 64 * blocks - 4, (uint32_t) bits);
+    _sha1Blocks (state, block, blocks);
+
+    /* outer hash: the pad (already in 'outer') and the inner hash */
+    for (i = 0; i < 5; i++) {
+        PUTU32 (block + 4 * i, state[i]);
+    }
+    block[AUTH_KEY_BYTES] = 0x80;
+    memset (block + AUTH_KEY_BYTES + 1, 0, 64 - 4 - (AUTH_KEY_BYTES + 1));
+    PUTU32 (block + 60, (64 + AUTH_KEY_BYTES) * 8);
+    memcpy (state, c->outer, sizeof (state));
+    _sha1Blocks (state, block, 1);
+    for (i = 0; i < 3; i++) {
+        PUTU32 (block + 4 * i, state[i]);
+    }
+    memcpy (tag, block, SRTP_AUTH_TAG_BYTES);
+}
+
+
+/*=====================================================================*/
+/* SRTP */
+
+/* Session key 'label' from the master key (expanded) and salt, RFC 3711 4.3.1 with kdr 0 */
+static void _derive (const uint8_t masterRoundKeys[AES_KEY_SCHEDULE_BYTES], const uint8_t masterSalt[SRTP_MASTER_SALT_BYTES],
+        int label, uint8_t *out, int length)
+{
+    uint8_t iv[16] = {0};
+    uint8_t zero[AUTH_KEY_BYTES] = {0};   /* the longest key */
+
+    memcpy (iv, masterSalt, SRTP_MASTER_SALT_BYTES);
+    iv[7] ^= (uint8_t) label;
+    _aesCtr (masterRoundKeys, iv, zero, out, length);
+}
+
+
+/* Clears memory with keys; a plain memset could be removed by the compiler */
+static void _wipe (void *memory, size_t length)
+{
+    volatile uint8_t *p = memory;
+
+    while (length-- > 0) {
+        *p++ = 0;
+    }
+}
+
+
+static int _home (const struct srtpContext *c, uint32_t ssrc)
+{
+    return (int) (((ssrc ^ (ssrc >> 16)) * 0x45d9f3bu) & (uint32_t) c->mask);
+}
+
+
+/* Returns the entry of 'ssrc', or a free one for it (used == 0), or NULL if there is no room */
+static struct srtpStream *_lookup (struct srtpContext *c, uint32_t ssrc)
+{
+    int i = _home (c, ssrc);
+    int n;
+
+    for (n = 0; n <= c->mask; n++, i = (i + 1) & c->mask) {
+        if (!c->streams[i].used) {
+            return (c->count < c->maxStreams) ? &c->streams[i] : NULL;
+        }
+        if (c->streams[i].ssrc == ssrc) {
+            return &c->streams[i];
+        }
+    }
+    return NULL;
+}
+
+
+/* Drops the entry of 'ssrc'. Backward shift, as rtpSource.c: the entries
+ * after it in the same probe sequence are moved up, so that lookups do not
+ * stop at the hole */
+static void _remove (struct srtpContext *c, uint32_t ssrc)
+{
+    struct srtpStream *s = _lookup (c, ssrc);
+    int hole, i;
+
+    if (s == NULL || !s->used) {
+        return;
+    }
+    hole = s - c->streams;
+    memset (s, 0, sizeof (struct srtpStream));
+    c->count--;
+    i = (hole + 1) & c->mask;
+    while (c->streams[i].used) {
+        int home = _home (c, c->streams[i].ssrc);
+        /* the entry can fill the hole if its home slot is not in (hole, i] */
+        if (((i - home) & c->mask) >= ((i - hole) & c->mask)) {
+            c->streams[hole] = c->streams[i];
+            memset (&c->streams[i], 0, sizeof (struct srtpStream));
+            hole = i;
+        }
+        i = (i + 1) & c->mask;
+    }
+}
+
+
+/* Entry for 'ssrc', making room if the table is full: the stream used least
+ * recently is dropped */
+static struct srtpStream *_lookupOrEvict (struct srtpContext *c, uint32_t ssrc)
+{
+    struct srtpStream *s = _lookup (c, ssrc), *oldest = NULL;
+    int i;
+
+    if (s != NULL) {
+        return s;
+    }
+    for (i = 0; i <= c->mask; i++) {
+        if (c->streams[i].used && (oldest == NULL || c->streams[i].lastUsed < oldest->lastUsed)) {
+            oldest = &c->streams[i];
+        }
+    }
+    _remove (c, oldest->ssrc);
+    return _lookup (c, ssrc);
+}
+
+
+/* Packet index of 'seq', guessing the rollover counter from the highest
+ * sequence number received (RFC 3711 3.3.1). Negative if it is before the first one */
+static int64_t _index (const struct srtpStream *s, uint16_t seq)
+{
+    int64_t v = s->roc;
+
+    if (!s->used) {
+        return seq;
+    }
+    if (s->highestSeq < 32768) {
+        if (seq - s->highestSeq > 32768) {
+            v--;
+        }
+    } else if (s->highestSeq - 32768 > seq) {
+        v++;
+    }
+    return v * 65536 + seq;
+}
+
+
+static int _replayed (const struct srtpStream *s, int64_t index)
+{
+    int64_t highest = (int64_t) s->roc * 65536 + s->highestSeq;
+
+    if (!s->used) {
+        return 0;
+    }
+    if (index < 0 || highest - index >= SRTP_WINDOW) {
+        return 1;
+    }
+    return index <= highest && ((s->window >> (highest - index)) & 1);
+}
+
+
+static void _accept (struct srtpContext *c, struct srtpStream *s, uint32_t ssrc, int64_t index)
+{
+    int64_t highest = (int64_t) s->roc * 65536 + s->highestSeq;
+
+    s->lastUsed = ++c->clock;
+    if (!s->used) {
+        s->used = 1;
+        s->ssrc = ssrc;
+        s->window = 1;
+        s->roc = (uint32_t) (index >> 16);
+        s->highestSeq = (uint16_t) index;
+        c->count++;
+    } else if (index > highest) {
+        s->window = (index - highest >= SRTP_WINDOW) ? 1 : (s->window << (index - highest)) | 1;
+        s->roc = (uint32_t) (index >> 16);
+        s->highestSeq = (uint16_t) index;
+    } else {
+        s->window |= (uint64_t) 1 << (highest - index);
+    }
+}
+
+
+/* Length of the RTP header, with CSRCs and extension; -1 if 'packet' is not RTP */
+static int _headerLength (const uint8_t *packet, int length)
+{
+    int header;
+
+    if (length < RTP_HEADER_BYTES || (packet[0] >> 6) != 2) {
+        return -1;
+    }
+    header = RTP_HEADER_BYTES + 4 * (packet[0] & 0x0f);
+    if (packet[0] & 0x10) {
+        if (length < header + 4) {
+            return -1;
+        }
+        header += 4 + 4 * ((packet[header + 2] << 8) | packet[header + 3]);
+    }
+    return (header <= length) ? header : -1;
+}
+
+
+/* IV of the packet 'index' of 'ssrc', RFC 3711 4.1.1 */
+static void _packetIv (const struct srtpContext *c, uint32_t ssrc, int64_t index, uint8_t iv[16])
+{
+    int i;
+
+    memcpy (iv, c->salt, 16);
+    for (i = 0; i < 4; i++) {
+        iv[4 + i] ^= (uint8_t) (ssrc >> (24 - 8 * i));
+    }
+    for (i = 0; i < 6; i++) {
+        iv[8 + i] ^= (uint8_t) (index >> (40 - 8 * i));
+    }
+}
+
+
+/*=====================================================================*/
+int srtp_parse_key (const char *hex, unsigned char master[SRTP_MASTER_BYTES])
+{
+    int i;
+
+    if (strlen (hex) != 2 * SRTP_MASTER_BYTES) {
+        return -1;
+    }
+    for (i = 0; i < SRTP_MASTER_BYTES; i++) {
+        unsigned int byte;
+        if (!isxdigit ((unsigned char) hex[2 * i]) || !isxdigit ((unsigned char) hex[2 * i + 1])
+                || sscanf (hex + 2 * i, "%2x", &byte) != 1) {
+            return -1;
+        }
+        master[i] = (unsigned char) byte;
+    }
+    return 0;
+}
+
+
+void *srtp_create (const unsigned char master[SRTP_MASTER_BYTES], int maxStreams)
+{
+    struct srtpContext *c;
+    uint8_t masterRoundKeys[AES_KEY_SCHEDULE_BYTES];
+    uint8_t cipherKey[SRTP_MASTER_KEY_BYTES];
+    uint8_t authKey[AUTH_KEY_BYTES];
+    int size = 2;
+
+    _aesTables ();
+    if (maxStreams < 1) {
+        maxStreams = 1;
+    }
+    while (size < 2 * maxStreams) {
+        size *= 2;
+    }
+    if ((c = calloc (1, sizeof (struct srtpContext))) == NULL
+            || (c->streams = calloc (size, sizeof (struct srtpStream))) == NULL) {
+        printf ("Error reserving memory in srtp\n");
+        free (c);
+        return NULL;
+    }
+    c->mask = size - 1;
+    c->maxStreams = maxStreams;
+
+    _aesExpand (master, masterRoundKeys);
+    _derive (masterRoundKeys, master + SRTP_MASTER_KEY_BYTES, LABEL_CIPHER, cipherKey, sizeof (cipherKey));
+    _derive (masterRoundKeys, master + SRTP_MASTER_KEY_BYTES, LABEL_AUTH, authKey, sizeof (authKey));
+    _derive (masterRoundKeys, master + SRTP_MASTER_KEY_BYTES, LABEL_SALT, c->salt, SRTP_MASTER_SALT_BYTES);
+    _aesExpand (cipherKey, c->roundKeys);
+    _hmacInit (c, authKey);
+
+    _wipe (masterRoundKeys, sizeof (masterRoundKeys));
+    _wipe (cipherKey, sizeof (cipherKey));
+    _wipe (authKey, sizeof (authKey));
+    return c;
+}
+
+
+int srtp_protect (void *srtp, unsigned char *packet, int length)
+{
+    struct srtpContext *c = srtp;
+    int header = _headerLength (packet, length);
+    struct srtpStream *s;
+    uint32_t ssrc;
+    int64_t index;
+    uint8_t iv[16];
+
+    if (header < 0) {
+        return SRTP_MALFORMED;
+    }
+    ssrc = GETU32 (packet + 8);
+    s = _lookupOrEvict (c, ssrc);
+    index = _index (s, (uint16_t) ((packet[2] << 8) | packet[3]));
+    if (index < 0) {
+        return SRTP_REPLAYED;
+    }
+    _accept (c, s, ssrc, index);
+
+    _packetIv (c, ssrc, index, iv);
+    _aesCtr (c->roundKeys, iv, packet + header, packet + header, length - header);
+    _hmac (c, packet, length, (uint32_t) (index >> 16), packet + length);
+    return length + SRTP_AUTH_TAG_BYTES;
+}
+
+
+int srtp_unprotect (void *srtp, unsigned char *packet, int length)
+{
+    struct srtpContext *c = srtp;
+    struct srtpStream *s, fresh;
+    int header;
+    uint32_t ssrc;
+    int64_t index;
+    uint8_t iv[16];
+    uint8_t tag[SRTP_AUTH_TAG_BYTES];
+    uint8_t difference = 0;
+    int i;
+
+    length -= SRTP_AUTH_TAG_BYTES;
+    if (length < 0 || (header = _headerLength (packet, length)) < 0) {
+        return SRTP_MALFORMED;
+    }
+    ssrc = GETU32 (packet + 8);
+    if ((s = _lookup (c, ssrc)) == NULL) {
+        /* a new SSRC and no room: checked as new, and the room is made only if it is authenticated */
+        memset (&fresh, 0, sizeof (fresh));
+        s = &fresh;
+    }
+    index = _index (s, (uint16_t) ((packet[2] << 8) | packet[3]));
+    if (_replayed (s, index)) {
+        return SRTP_REPLAYED;
+    }
+    /* the state changes only for authenticated packets */
+    _hmac (c, packet, length, (uint32_t) (index >> 16), tag);
+    for (i = 0; i < SRTP_AUTH_TAG_BYTES; i++) {
+        difference |= tag[i] ^ packet[length + i];  /* the time does not depend on where they differ */
+    }
+    if (difference != 0) {
+        return SRTP_AUTH_FAILED;
+    }
+    if (s == &fresh) {
+        s = _lookupOrEvict (c, ssrc);
+    }
+    _accept (c, s, ssrc, index);
+
+    _packetIv (c, ssrc, index, iv);
+    _aesCtr (c->roundKeys, iv, packet + header, packet + header, length - header);
+    return length;
+}
+
+
+void srtp_remove (void *srtp, unsigned int ssrc)
+{
+    _remove (srtp, ssrc);
+}
+
+
+void srtp_destroy (void *srtp)
+{
+    struct srtpContext *c = srtp;
+
+    free (c->streams);
+    _wipe (c, sizeof (struct srtpContext));
+    free (c);
+}
+
+
+/* TEST for srtp functions.
+ * To execute it, use following code  */
+
+/* #include "srtp.h"
+void _srtp_test_vectors(void);
+void main (void)
+{
+    _srtp_test_vectors();
+} */
+
+
+static int _check (const char *what, const uint8_t *got, const char *expectedHex)
+{
+    unsigned char expected[256];
+    int length = (int) strlen (expectedHex) / 2;
+    int i;
+
+    for (i = 0; i < length; i++) {
+        unsigned int byte;
+        sscanf (expectedHex + 2 * i, "%2x", &byte);
+        expected[i] = (unsigned char) byte;
+    }
+    if (memcmp (got, expected, length) != 0) {
+        printf ("_srtp_test_vectors: %s is not right\n", what);
+        return 1;
+    }
+    return 0;
+}
+
+
+void _srtp_test_vectors (void)
+{
+    unsigned char master[SRTP_MASTER_BYTES];
+    uint8_t roundKeys[AES_KEY_SCHEDULE_BYTES];
+    uint8_t iv[16], zero[80] = {0}, out[80];
+    uint8_t packet[300], copy[300], rolled[4][200];
+    void *sender, *receiver;
+    int length, i, errors = 0;
+
+    _aesTables ();
+
+    /* 1: AES-CM keystream, RFC 3711 B.2 */
+    srtp_parse_key ("2b7e151628aed2a6abf7158809cf4f3cf0f1f2f3f4f5f6f7f8f9fafbfcfd", master);
+    _aesExpand (master, roundKeys);
+    memcpy (iv, master + 16, 14);
+    iv[14] = iv[15] = 0;
+    _aesCtr (roundKeys, iv, zero, out, 80);
+    errors += _check ("AES-CM keystream", out, "e03ead0935c95e80e166b16dd92b4eb4d23513162b02d0f72a43a2fe4a5f97ab"
+            "41e95b3bb0a2e8dd477901e4fca894c031d4c255ba4211eebc3fe4225478cbfdeeb138115f304527d4bfd9619045b2da");
+
+    /* 2: key derivation, RFC 3711 B.3 */
+    srtp_parse_key ("e1f97a0d3e018be0d64fa32c06de41390ec675ad498afeebb6960b3aabe6", master);
+    _aesExpand (master, roundKeys);
+    _derive (roundKeys, master + 16, LABEL_CIPHER, out, 16);
+    errors += _check ("cipher key", out, "c61e7a93744f39ee10734afe3ff7a087");
+    _derive (roundKeys, master + 16, LABEL_SALT, out, 14);
+    errors += _check ("cipher salt", out, "30cbbc08863d8c85d49db34a9ae1");
+    _derive (roundKeys, master + 16, LABEL_AUTH, out, 20);
+    errors += _check ("auth key", out, "cebe321f6ff7716b6fd4ab49af256a156d38baa4");
+
+    /* 3: a whole packet with the same master key (the libsrtp test vector), and one longer */
+    sender = srtp_create (master, 4);
+    receiver = srtp_create (master, 4);
+    if (sender == NULL || receiver == NULL) {
+        exit (1);
+    }
+    memcpy (packet, "\x80\x0f\x12\x34\xde\xca\xfb\xad\xca\xfe\xba\xbe", 12);
+    memset (packet + 12, 0xab, 16);
+    memcpy (copy, packet, 28);
+    length = srtp_protect (sender, packet, 28);
+    errors += _check ("SRTP packet", packet, "800f1234decafbadcafebabe4e55dc4ce79978d88ca4d215949d2402b78d6acc99ea179b8dbb");
+    if (length != 38 || srtp_unprotect (receiver, packet, length) != 28 || memcmp (packet, copy, 28) != 0) {
+        printf ("_srtp_test_vectors: the packet was not unprotected\n");
+        errors++;
+    }
+    packet[3] = 0x35;
+    memset (packet + 12, 0xab, 200);
+    length = srtp_protect (sender, packet, 212);
+    errors += _check ("long SRTP packet", packet + 204, "23feead625cd30ee1559f8aa1e9be5c8666a");
+
+    /* 4: modified and replayed packets are rejected */
+    packet[20] ^= 1;
+    if (srtp_unprotect (receiver, packet, length) != SRTP_AUTH_FAILED) {
+        printf ("_srtp_test_vectors: modified packet accepted\n");
+        errors++;
+    }
+    packet[20] ^= 1;
+    memcpy (copy, packet, length);
+    if (srtp_unprotect (receiver, packet, length) != 212
+            || srtp_unprotect (receiver, copy, length) != SRTP_REPLAYED) {
+        printf ("_srtp_test_vectors: replayed packet accepted\n");
+        errors++;
+    }
+
+    /* 5: sequence numbers rolling over: sent as 65534, 65535, 0, 1 and received as 65534, 0, 65535, 1 */
+    for (i = 0; i < 4; i++) {
+        memcpy (rolled[i], "\x80\x0f\x00\x00\x00\x00\x00\x00\x00\x00\x00\x05", 12);
+        rolled[i][2] = (uint8_t) ((65534 + i) >> 8);
+        rolled[i][3] = (uint8_t) (65534 + i);
+        memset (rolled[i] + 12, i, 160);
+        srtp_protect (sender, rolled[i], 172);
+    }
+    for (i = 0; i < 4; i++) {
+        int sent = (i == 1) ? 2 : (i == 2) ? 1 : i;
+        if (srtp_unprotect (receiver, rolled[sent], 172 + SRTP_AUTH_TAG_BYTES) != 172 || rolled[sent][12] != sent) {
+            printf ("_srtp_test_vectors: packet %d not received across the rollover\n", sent);
+            errors++;
+        }
+    }
+
+    srtp_destroy (receiver);
+
+    /* 6: with room for 2 SSRCs, a third one takes the place of the one used
+     * least recently, but not if it is not authenticated; srtp_remove drops one */
+    receiver = srtp_create (master, 2);
+    for (i = 0; i < 4; i++) {
+        memcpy (rolled[i], "\x80\x0f\x00\x01\x00\x00\x00\x00\x00\x00\x00\x00", 12);
+        rolled[i][11] = (uint8_t) (i + 1);     /* SSRC 1 to 4 */
+        memset (rolled[i] + 12, i, 160);
+        srtp_protect (sender, rolled[i], 172);
+    }
+    rolled[3][20] ^= 1;
+    for (i = 0; i < 3; i++) {
+        memcpy (copy, rolled[i], 172 + SRTP_AUTH_TAG_BYTES);
+        if (srtp_unprotect (receiver, copy, 172 + SRTP_AUTH_TAG_BYTES) != 172) {
+            printf ("_srtp_test_vectors: SSRC %d not received with the table full\n", i + 1);
+            errors++;
+        }
+    }
+    memcpy (copy, rolled[3], 172 + SRTP_AUTH_TAG_BYTES);
+    if (srtp_unprotect (receiver, copy, 172 + SRTP_AUTH_TAG_BYTES) != SRTP_AUTH_FAILED) {
+        printf ("_srtp_test_vectors: modified packet of a new SSRC accepted\n");
+        errors++;
+    }
+    memcpy (copy, rolled[1], 172 + SRTP_AUTH_TAG_BYTES);
+    if (srtp_unprotect (receiver, copy, 172 + SRTP_AUTH_TAG_BYTES) != SRTP_REPLAYED) {
+        printf ("_srtp_test_vectors: the state of SSRC 2 was dropped\n");
+        errors++;
+    }
+    srtp_remove (receiver, 2);
+    memcpy (copy, rolled[1], 172 + SRTP_AUTH_TAG_BYTES);
+    if (srtp_unprotect (receiver, copy, 172 + SRTP_AUTH_TAG_BYTES) != 172) {
+        printf ("_srtp_test_vectors: the state of SSRC 2 was not removed\n");
+        errors++;
+    }
+    memcpy (copy, rolled[2], 172 + SRTP_AUTH_TAG_BYTES);
+    if (srtp_unprotect (receiver, copy, 172 + SRTP_AUTH_TAG_BYTES) != SRTP_REPLAYED) {
+        printf ("_srtp_test_vectors: the state of SSRC 3 was lost in the removal\n");
+        errors++;
+    }
+
+    srtp_destroy (sender);
+    srtp_destroy (receiver);
+    if (errors > 0) {
+        exit (1);
+    }
+    printf ("Tests PASSED (number of tests: 6)\n");
+}
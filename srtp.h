@@ -0,0 +1,73 @@
+/* srtp.h */
+
+/* SRTP (RFC 3711) with the default crypto suite, AES_CM_128_HMAC_SHA1_80:
+ * the payload is encrypted with AES-128 in counter mode, and header and
+ * payload are authenticated with an HMAC-SHA1 tag of 80 bits appended to
+ * the packet. Session keys are derived from a pre-shared master key and
+ * master salt (key derivation rate 0: the session keys never change).
+ * Authentication is checked before anything is decrypted, and packets
+ * already received (replayed) are rejected with a window of SRTP_WINDOW
+ * packets for each SSRC.
+ *
+ * AES uses AES-NI if compiled with -maes, and SHA-1 uses the SHA extensions
+ * if compiled with -msha -msse4.1 (or -march=native in a CPU with them);
+ * otherwise both are portable C (AES with lookup tables).
+ * Nothing is allocated per packet.
+ *
+ * The same context can protect packets (sender) or unprotect them
+ * (receiver); it keeps the rollover counter of each SSRC, up to the
+ * 'maxStreams' given to srtp_create. When there is no room for a new SSRC,
+ * the state of the SSRC used least recently is dropped (for a receiver, only
+ * once the packet of the new one is authenticated): senders which restart
+ * take a new random SSRC, and the ones which left must not keep the room.
+ * srtp_remove drops the state of an SSRC known to have left.
+ * Restrictions
+ * - Use each context only in single-thread code, as circularBuffer.
+ * - The first srtp_create must be done before any other thread uses srtp
+ *   (it builds the shared AES tables).
+ */
+
+#ifndef SRTP_H
+#define SRTP_H
+
+#define SRTP_MASTER_KEY_BYTES 16
+#define SRTP_MASTER_SALT_BYTES 14
+#define SRTP_MASTER_BYTES (SRTP_MASTER_KEY_BYTES + SRTP_MASTER_SALT_BYTES)  /* key and salt, in this order */
+#define SRTP_AUTH_TAG_BYTES 10  /* the packet grows by this when protected */
+#define SRTP_WINDOW 64          /* replay window, packets */
+
+/* Results of srtp_protect and srtp_unprotect, when the packet is not accepted */
+enum srtp_error {
+    SRTP_MALFORMED = -1,        /* not RTP version 2, or too short */
+    SRTP_AUTH_FAILED = -2,      /* the tag is not right: wrong key, or modified packet */
+    SRTP_REPLAYED = -3          /* already received, or older than the replay window */
+};
+
+/* Parses 'hex', 2 * SRTP_MASTER_BYTES hexadecimal digits (master key then
+ * master salt), into 'master'. Returns 0, or -1 if it is not valid */
+int srtp_parse_key (const char *hex, unsigned char master[SRTP_MASTER_BYTES]);
+
+/* Returns a pointer which represents the SRTP context, to be used by the
+ * rest of functions, for the master key and salt in 'master', and up to
+ * 'maxStreams' SSRCs.
+ * On error, memory could not be allocated, returns NULL. */
+void *srtp_create (const unsigned char master[SRTP_MASTER_BYTES], int maxStreams);
+
+/* Encrypts the RTP packet of 'length' bytes in 'packet', in place, and
+ * appends the tag: 'packet' must have room for SRTP_AUTH_TAG_BYTES more.
+ * Returns the new length, or an enum srtp_error value */
+int srtp_protect (void *srtp, unsigned char *packet, int length);
+
+/* Checks and decrypts the SRTP packet of 'length' bytes in 'packet', in
+ * place. Returns the length of the RTP packet, without the tag, or an enum
+ * srtp_error value (then 'packet' is not modified) */
+int srtp_unprotect (void *srtp, unsigned char *packet, int length);
+
+/* Drops the state (rollover counter, replay window) of 'ssrc', if it is
+ * kept: for a source which sent BYE or timed out */
+void srtp_remove (void *srtp, unsigned int ssrc);
+
+/* Frees memory of the context, and clears its keys */
+void srtp_destroy (void *srtp);
+
+#endif /* SRTP_H */
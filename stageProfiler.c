@@ -0,0 +1,306 @@
+/* stageProfiler.c */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "stageProfiler.h"
+
+#define HISTOGRAM_BINS 40       /* powers of 2 of ns, up to 2^40 ns (18 minutes) */
+
+enum event {EV_TASK_CLOCK, EV_CYCLES, EV_INSTRUCTIONS, EV_CACHE_MISSES, EV_CONTEXT_SWITCHES, EVENTS};
+
+static const struct {
+    uint32_t type;
+    uint64_t config;
+    const char *name;
+} events[EVENTS] = {
+    { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK, "task-clock" },     /* group leader */
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "cycles" },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, "instructions" },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, "cache-misses" },
+    { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, "context-switches" },
+};
+
+static const char *stageNames[PROF_STAGES] = {"capture", "encode", "send", "receive", "decode", "playout"};
+
+struct stage {
+    unsigned long long packets;
+    unsigned long long intervals;
+    unsigned long long sum[EVENTS];
+    uint64_t begin[EVENTS];
+    unsigned long long maxNs;   /* highest CPU time per packet of an interval */
+    unsigned int histogram[HISTOGRAM_BINS];
+};
+
+struct stageProfiler {
+    int fd[EVENTS];             /* -1: not available */
+    int slot[EVENTS];           /* position in the values of the group read, -1: not available */
+    int members;
+    int kernel;                 /* kernel time is counted */
+    struct stage stage[PROF_STAGES];
+};
+
+
+/*=====================================================================*/
+static int _open (int event, int group, int excludeKernel)
+{
+    struct perf_event_attr attr;
+
+    memset (&attr, 0, sizeof (attr));
+    attr.size = sizeof (attr);
+    attr.type = events[event].type;
+    attr.config = events[event].config;
+    attr.read_format = PERF_FORMAT_GROUP;
+    attr.exclude_kernel = excludeKernel;
+    attr.exclude_hv = 1;
+    /* this thread, any CPU */
+    return syscall (__NR_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+
+/* Current values of the counters */
+static void _read (const struct stageProfiler *p, uint64_t values[EVENTS])
+{
+    uint64_t buffer[1 + EVENTS];
+    int e;
+
+    if (p->fd[EV_TASK_CLOCK] < 0) {
+        struct timespec t;
+        clock_gettime (CLOCK_THREAD_CPUTIME_ID, &t);
+        memset (values, 0, EVENTS * sizeof (uint64_t));
+        values[EV_TASK_CLOCK] = (uint64_t) t.tv_sec * 1000000000u + t.tv_nsec;
+        return;
+    }
+    if (read (p->fd[EV_TASK_CLOCK], buffer, (1 + p->members) * sizeof (uint64_t)) < 0) {
+        memset (buffer, 0, sizeof (buffer));
+    }
+    for (e = 0; e < EVENTS; e++) {
+        values[e] = (p->slot[e] >= 0) ? buffer[1 + p->slot[e]] : 0;
+    }
+}
+
+
+static int _bin (unsigned long long ns)
+{
+    int bin = 0;
+
+    while (ns > 1 && bin < HISTOGRAM_BINS - 1) {
+        ns >>= 1;
+        bin++;
+    }
+    return bin;
+}
+
+
+/*=====================================================================*/
+void *prof_create (void)
+{
+    struct stageProfiler *p;
+    int e;
+
+    if ((p = calloc (1, sizeof (struct stageProfiler))) == NULL) {
+        printf ("Error reserving memory in stageProfiler\n");
+        return NULL;
+    }
+    for (e = 0; e < EVENTS; e++) {
+        p->fd[e] = -1;
+        p->slot[e] = -1;
+    }
+    /* kernel and user time if allowed, user time otherwise */
+    p->kernel = 1;
+    if ((p->fd[EV_TASK_CLOCK] = _open (EV_TASK_CLOCK, -1, 0)) < 0) {
+        p->kernel = 0;
+        p->fd[EV_TASK_CLOCK] = _open (EV_TASK_CLOCK, -1, 1);
+    }
+    if (p->fd[EV_TASK_CLOCK] < 0) {
+        printf ("perf_event_open is not available: only CPU time is measured\n");
+        return p;
+    }
+    p->slot[EV_TASK_CLOCK] = p->members++;
+    for (e = EV_TASK_CLOCK + 1; e < EVENTS; e++) {
+        if ((p->fd[e] = _open (e, p->fd[EV_TASK_CLOCK], !p->kernel)) >= 0) {
+            p->slot[e] = p->members++;
+        }
+    }
+    return p;
+}
+
+
+void prof_begin (void *profiler, enum prof_stage stage)
+{
+    struct stageProfiler *p = profiler;
+
+    if (p == NULL) {
+        return;
+    }
+    _read (p, p->stage[stage].begin);
+}
+
+
+void prof_end (void *profiler, enum prof_stage stage, int packets)
+{
+    struct stageProfiler *p = profiler;
+    struct stage *s;
+    uint64_t values[EVENTS];
+    unsigned long long perPacket;
+    int e;
+
+    if (p == NULL) {
+        return;
+    }
+    s = &p->stage[stage];
+    _read (p, values);
+    for (e = 0; e < EVENTS; e++) {
+        s->sum[e] += values[e] - s->begin[e];
+    }
+    s->intervals++;
+    if (packets <= 0) {
+        return;
+    }
+    s->packets += packets;
+    perPacket = (values[EV_TASK_CLOCK] - s->begin[EV_TASK_CLOCK]) / packets;
+    s->histogram[_bin (perPacket)]++;
+    if (perPacket > s->maxNs) {
+        s->maxNs = perPacket;
+    }
+}
+
+
+long long prof_describe (const void *profiler, enum prof_stage stage, char *line, int size)
+{
+    const struct stageProfiler *p = profiler;
+    const struct stage *s = &p->stage[stage];
+    double n = (s->packets > 0) ? (double) s->packets : 1.0;
+    unsigned long long count = 0, target = 0;
+    unsigned long long p99 = 0;
+    int bin;
+
+    /* upper edge of the bin of the 99th percentile of the intervals with packets */
+    for (bin = 0; bin < HISTOGRAM_BINS; bin++) {
+        target += s->histogram[bin];
+    }
+    target -= target / 100;
+    for (bin = 0; bin < HISTOGRAM_BINS; bin++) {
+        count += s->histogram[bin];
+        if (count > 0 && count >= target) {
+            p99 = 1ull << (bin + 1);
+            break;
+        }
+    }
+    if (p99 > s->maxNs) {
+        p99 = s->maxNs;
+    }
+    snprintf (line, size, "%-8s %10llu packets: %8.0f ns %9.0f cycles %9.0f instructions (IPC %.2f) %7.1f cache misses %6.3f context switches per packet; p99 %llu ns, max %llu ns\n",
+            stageNames[stage], s->packets, s->sum[EV_TASK_CLOCK] / n, s->sum[EV_CYCLES] / n, s->sum[EV_INSTRUCTIONS] / n,
+            s->sum[EV_CYCLES] ? (double) s->sum[EV_INSTRUCTIONS] / s->sum[EV_CYCLES] : 0.0,
+            s->sum[EV_CACHE_MISSES] / n, s->sum[EV_CONTEXT_SWITCHES] / n, p99, s->maxNs);
+    return (long long) s->packets;
+}
+
+
+void prof_print (const void *profiler)
+{
+    const struct stageProfiler *p = profiler;
+    char line[512];
+    int e, stage;
+
+    printf ("Stage costs (%s, counters:", p->kernel ? "user and kernel" : "user space only");
+    for (e = 0; e < EVENTS; e++) {
+        if (p->fd[e] >= 0) {
+            printf (" %s", events[e].name);
+        }
+    }
+    printf (p->fd[EV_TASK_CLOCK] < 0 ? " none, CPU time only)\n" : ")\n");
+    for (stage = 0; stage < PROF_STAGES; stage++) {
+        if (prof_describe (p, stage, line, sizeof (line)) > 0) {
+            printf ("%s", line);
+        }
+    }
+}
+
+
+void prof_destroy (void *profiler)
+{
+    struct stageProfiler *p = profiler;
+    int e;
+
+    for (e = EVENTS - 1; e >= 0; e--) {
+        if (p->fd[e] >= 0) {
+            close (p->fd[e]);
+        }
+    }
+    free (p);
+}
+
+
+/* TEST for stageProfiler functions.
+ * To execute it, use following code  */
+
+/* #include "stageProfiler.h"
+void _prof_test_stages(void);
+void main (void)
+{
+    _prof_test_stages();
+} */
+
+
+void _prof_test_stages (void)
+{
+    void *p = prof_create ();
+    const struct stageProfiler *sp = p;
+    volatile unsigned int x = 1;
+    int i, k, errors = 0;
+    double light, heavy;
+
+    /* 1: a stage with 10 times the work per packet costs more per packet */
+    for (i = 0; i < 100; i++) {
+        prof_begin (p, PROF_ENCODE);
+        for (k = 0; k < 10000; k++) x = x * 3 + 1;
+        prof_end (p, PROF_ENCODE, 1);
+        prof_begin (p, PROF_DECODE);
+        for (k = 0; k < 100000; k++) x = x * 3 + 1;
+        prof_end (p, PROF_DECODE, 1);
+    }
+    light = (double) sp->stage[PROF_ENCODE].sum[EV_TASK_CLOCK] / sp->stage[PROF_ENCODE].packets;
+    heavy = (double) sp->stage[PROF_DECODE].sum[EV_TASK_CLOCK] / sp->stage[PROF_DECODE].packets;
+    if (heavy < 3 * light) {
+        printf ("_prof_test_stages: %.0f ns per packet for 10 times the work of %.0f ns\n", heavy, light);
+        errors++;
+    }
+
+    /* 2: packets are divided: 10 packets in an interval */
+    prof_begin (p, PROF_SEND);
+    for (k = 0; k < 100000; k++) x = x * 3 + 1;
+    prof_end (p, PROF_SEND, 10);
+    if (sp->stage[PROF_SEND].packets != 10 || sp->stage[PROF_SEND].maxNs * 10 > sp->stage[PROF_SEND].sum[EV_TASK_CLOCK] + 10) {
+        printf ("_prof_test_stages: interval of 10 packets not divided\n");
+        errors++;
+    }
+
+    /* 3: a sleep is not CPU time, and is a context switch if counted */
+    {
+        struct timespec pause = { 0, 20 * 1000000L };
+        prof_begin (p, PROF_PLAYOUT);
+        nanosleep (&pause, NULL);
+        prof_end (p, PROF_PLAYOUT, 1);
+        if (sp->stage[PROF_PLAYOUT].sum[EV_TASK_CLOCK] > 10 * 1000000ull
+                || (sp->fd[EV_CONTEXT_SWITCHES] >= 0 && sp->stage[PROF_PLAYOUT].sum[EV_CONTEXT_SWITCHES] < 1)) {
+            printf ("_prof_test_stages: a 20 ms sleep counted %llu ns, %llu context switches\n",
+                    sp->stage[PROF_PLAYOUT].sum[EV_TASK_CLOCK], sp->stage[PROF_PLAYOUT].sum[EV_CONTEXT_SWITCHES]);
+            errors++;
+        }
+    }
+    prof_print (p);
+    prof_destroy (p);
+
+    if (errors > 0) {
+        exit (1);
+    }
+    printf ("Tests PASSED (number of tests: 3)\n");
+}
@@ -0,0 +1,62 @@
+/* stageProfiler.h */
+
+/* Cost of each stage of the audio pipeline, per packet, measured with the
+ * performance counters of the thread (perf_event_open): CPU time
+ * (task clock), cycles, instructions, cache misses and context switches.
+ * Each stage is wrapped with prof_begin and prof_end; the counters of the
+ * interval are added to the stage and divided by the packets it handled.
+ * Besides the averages, the CPU time per packet of each interval is kept in
+ * a histogram of powers of 2, for the 99th percentile and the maximum
+ * (outliers).
+ *
+ * Kernel time is included if the system allows it
+ * (/proc/sys/kernel/perf_event_paranoid <= 1, or CAP_PERFMON); otherwise
+ * only user space is counted, and prof_print says so. Hardware counters
+ * which are not available (e.g. in some virtual machines) are shown as 0.
+ * Without perf_event_open at all, only CPU time is measured
+ * (CLOCK_THREAD_CPUTIME_ID).
+ * Each prof_begin and prof_end is a read system call: use it to find where
+ * the time goes, not in production.
+ * Restrictions
+ * - The counters are those of the thread which calls prof_create: use
+ *   each profiler only in that thread.
+ */
+
+#ifndef STAGE_PROFILER_H
+#define STAGE_PROFILER_H
+
+enum prof_stage {
+    PROF_CAPTURE,               /* read from the soundcard, per fragment */
+    PROF_ENCODE,                /* gain, reframing, packetize, SRTP */
+    PROF_SEND,                  /* socket */
+    PROF_RECEIVE,               /* socket, SRTP */
+    PROF_DECODE,                /* depacketize, gain, reframing */
+    PROF_PLAYOUT,               /* write to the soundcard, per fragment */
+    PROF_STAGES
+};
+
+/* Returns a pointer which represents the profiler, to be used by the rest
+ * of functions, with the counters of the calling thread.
+ * On error, memory could not be allocated, returns NULL. */
+void *prof_create (void);
+
+/* Starts an interval of 'stage'. prof_begin and prof_end do nothing if
+ * 'profiler' is NULL, so that they can stay in the code when it is not used */
+void prof_begin (void *profiler, enum prof_stage stage);
+
+/* Ends the interval of 'stage' started by the last prof_begin, in which
+ * 'packets' packets (or fragments) were handled (0: the cost of the interval
+ * is added, but not as packets, e.g. a flush of packets counted before) */
+void prof_end (void *profiler, enum prof_stage stage, int packets);
+
+/* Writes in 'line' (of 'size' bytes) the averages per packet and the
+ * outliers of 'stage'. Returns the number of packets of the stage */
+long long prof_describe (const void *profiler, enum prof_stage stage, char *line, int size);
+
+/* Prints the counters used, and a line for each stage with packets */
+void prof_print (const void *profiler);
+
+/* Closes the counters and frees memory */
+void prof_destroy (void *profiler);
+
+#endif /* STAGE_PROFILER_H */
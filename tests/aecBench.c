@@ -0,0 +1,180 @@
+/* Checks and measures the echo canceller of echoCanceller.c, with a
+ * simulated echo path: no soundcard is needed.
+ *
+ * Compile as (from the repository directory)
+ *    gcc -Wall -Wextra -O2 -I. -o aecBench tests/aecBench.c echoCanceller.c alignedMemory.c -lm
+ *    gcc -Wall -Wextra -O2 -mavx2 -I. -o aecBench tests/aecBench.c echoCanceller.c alignedMemory.c -lm   (AVX)
+ * Execute as
+ *    ./aecBench [SECONDS_PER_TEST]
+ *
+ * The far end is noise shaped as speech (low-pass), played in 20 ms frames;
+ * the captured signal is its echo (a delayed, decaying random impulse
+ * response) plus some noise of the room. The echo return loss enhancement
+ * (ERLE, how much quieter the echo is after the canceller) is checked after
+ * a few seconds; then the same with near-end speech in the middle (double
+ * talk), which must not spoil the filter. Finally prints the cost of a
+ * 128 ms tail at 8000 and 44100 Hz, as the number of channels one core can
+ * process in real time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "echoCanceller.h"
+#include "alignedMemory.h"
+
+#define FRAME_MS 20
+#define TAIL_MS 128
+#define ECHO_MS 64              /* length of the simulated impulse response */
+#define ECHO_DELAY_MS 5         /* device and acoustic delay */
+#define ECHO_LOSS 10.0          /* dB, the echo is quieter than the audio played */
+#define MIN_ERLE 20.0           /* dB */
+
+
+static double _now (void)
+{
+    struct timespec t;
+    clock_gettime (CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+
+/* noise through a one-pole low-pass filter, 'level' times full scale */
+static void _speechLike (int16_t *out, int samples, double level, double *state)
+{
+    int i;
+
+    for (i = 0; i < samples; i++) {
+        double white = (double) random () / RAND_MAX * 2.0 - 1.0;
+        *state = 0.9 * *state + 0.1 * white;
+        out[i] = (int16_t) (*state * level * 32767.0 * 3.0);
+    }
+}
+
+
+/* Simulates 'seconds' of a call at 'rate' Hz; with 'doubleTalk', the near end
+ * speaks in the second quarter. Returns the ERLE of the last quarter, dB */
+static double _simulate (int rate, double seconds, int doubleTalk)
+{
+    int frame = rate * FRAME_MS / 1000;
+    int echoLength = rate * ECHO_MS / 1000;
+    int delay = rate * ECHO_DELAY_MS / 1000;
+    int total = (int) (seconds * rate) / frame * frame;
+    double *response = calloc (echoLength, sizeof (double));
+    int16_t *played = calloc (total, sizeof (int16_t));
+    int16_t *near = calloc (total, sizeof (int16_t));
+    int16_t *captured = calloc (frame, sizeof (int16_t));
+    void *aec = aec_create (rate, TAIL_MS, AMEM_DEFAULT);
+    double farState = 0.0, nearState = 0.0;
+    double echoEnergy = 0.0, residualEnergy = 0.0;
+    double energy = 0.0;
+    int start, i, k;
+
+    if (response == NULL || played == NULL || near == NULL || captured == NULL || aec == NULL) {
+        printf ("Could not reserve memory\n");
+        exit (1);
+    }
+    for (k = delay; k < echoLength; k++) {
+        response[k] = ((double) random () / RAND_MAX * 2.0 - 1.0) * exp (-6.0 * (k - delay) / echoLength);
+        energy += response[k] * response[k];
+    }
+    /* echo return loss of ECHO_LOSS dB */
+    for (k = delay; k < echoLength; k++) {
+        response[k] *= sqrt (pow (10.0, -ECHO_LOSS / 10.0) / energy);
+    }
+    _speechLike (played, total, 0.3, &farState);
+    if (doubleTalk) {
+        _speechLike (near + total / 4, total / 4, 0.3, &nearState);
+    }
+
+    for (start = 0; start < total; start += frame) {
+        for (i = 0; i < frame; i++) {
+            double echo = 0.0;
+            int n = start + i;
+            for (k = delay; k < echoLength && k <= n; k++) {
+                echo += response[k] * played[n - k];
+            }
+            captured[i] = (int16_t) (echo + near[n] + ((double) random () / RAND_MAX - 0.5) * 4.0);
+            if (start >= total * 3 / 4) {
+                echoEnergy += echo * echo;
+            }
+        }
+        aec_playout (aec, played + start, frame);
+        aec_process (aec, captured, frame);
+        if (start >= total * 3 / 4) {
+            for (i = 0; i < frame; i++) {
+                residualEnergy += (double) captured[i] * captured[i];
+            }
+        }
+    }
+    aec_destroy (aec);
+    free (response);
+    free (played);
+    free (near);
+    free (captured);
+    return 10.0 * log10 (echoEnergy / (residualEnergy + 1.0));
+}
+
+
+/* Prints how many channels of 'rate' Hz one core can process in real time */
+static void _bench (int rate, double seconds)
+{
+    int frame = rate * FRAME_MS / 1000;
+    int16_t *played = malloc (frame * sizeof (int16_t));
+    int16_t *captured = malloc (frame * sizeof (int16_t));
+    void *aec = aec_create (rate, TAIL_MS, AMEM_DEFAULT);
+    double farState = 0.0;
+    double start, elapsed;
+    long frames = 0;
+
+    if (played == NULL || captured == NULL || aec == NULL) {
+        printf ("Could not reserve memory\n");
+        exit (1);
+    }
+    _speechLike (played, frame, 0.3, &farState);
+    start = _now ();
+    do {
+        memcpy (captured, played, frame * sizeof (int16_t));
+        aec_playout (aec, played, frame);
+        aec_process (aec, captured, frame);
+        frames++;
+    } while ((elapsed = _now () - start) < seconds);
+
+    printf ("%5d Hz, %d ms tail    %8.1f channels\n", rate, TAIL_MS, frames * FRAME_MS / 1000.0 / elapsed);
+    aec_destroy (aec);
+    free (played);
+    free (captured);
+}
+
+
+int main (int argc, char *argv[])
+{
+    double seconds = (argc > 1) ? atof (argv[1]) : 1.0;
+    int rates[] = {8000, 44100};
+    int errors = 0;
+    unsigned int r;
+
+    srandom (1);
+    for (r = 0; r < sizeof (rates) / sizeof (rates[0]); r++) {
+        double erle = _simulate (rates[r], 8.0, 0);
+        double erleDoubleTalk = _simulate (rates[r], 8.0, 1);
+
+        printf ("%5d Hz: ERLE %.1f dB, with double talk %.1f dB\n", rates[r], erle, erleDoubleTalk);
+        if (erle < MIN_ERLE || erleDoubleTalk < MIN_ERLE) {
+            printf ("ERLE under %.0f dB FAILED\n", MIN_ERLE);
+            errors++;
+        }
+    }
+    if (errors > 0) {
+        return 1;
+    }
+    printf ("Echo canceller checked OK\n\n");
+
+    for (r = 0; r < sizeof (rates) / sizeof (rates[0]); r++) {
+        _bench (rates[r], seconds);
+    }
+    return 0;
+}
@@ -0,0 +1,133 @@
+/* Checks and measures the sample conversions of sampleConvert.c
+ *
+ * Compile as (from the repository directory)
+ *    gcc -Wall -Wextra -O2 -I. -o convBench tests/convBench.c sampleConvert.c
+ *    gcc -Wall -Wextra -O2 -mavx2 -I. -o convBench tests/convBench.c sampleConvert.c   (AVX2 swap)
+ * Execute as
+ *    ./convBench [SECONDS_PER_TEST]
+ *
+ * First compares the vector conversions with the scalar ones, and checks that
+ * A-law decoding of every code is encoded back to the same code. Then prints
+ * the throughput of each conversion, also as the number of 44100 Hz stereo
+ * streams it could convert in real time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "sampleConvert.h"
+
+#define FRAMES 4410             /* 100 ms of 44100 Hz stereo, not a multiple of the vector size */
+#define SAMPLES (2 * FRAMES)
+
+static int16_t src[SAMPLES], dst[SAMPLES], ref[SAMPLES];
+static int16_t left[FRAMES], right[FRAMES], refLeft[FRAMES], refRight[FRAMES];
+static unsigned char alaw[SAMPLES];
+static volatile int16_t sink;
+
+
+static double _now (void)
+{
+    struct timespec t;
+    clock_gettime (CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+
+static int _check (void)
+{
+    int errors = 0;
+    int i;
+
+    conv_swap16 (dst, src, SAMPLES);
+    conv_swap16_scalar (ref, src, SAMPLES);
+    if (memcmp (dst, ref, sizeof (dst)) != 0 || (uint16_t) dst[1] != (uint16_t) ((src[1] << 8) | ((uint16_t) src[1] >> 8))) {
+        printf ("conv_swap16 FAILED\n");
+        errors++;
+    }
+    memcpy (dst, src, sizeof (dst));
+    conv_swap16 (dst, dst, SAMPLES);
+    if (memcmp (dst, ref, sizeof (dst)) != 0) {
+        printf ("conv_swap16 in place FAILED\n");
+        errors++;
+    }
+
+    conv_deinterleave16 (left, right, src, FRAMES);
+    conv_deinterleave16_scalar (refLeft, refRight, src, FRAMES);
+    if (memcmp (left, refLeft, sizeof (left)) != 0 || memcmp (right, refRight, sizeof (right)) != 0) {
+        printf ("conv_deinterleave16 FAILED\n");
+        errors++;
+    }
+    conv_interleave16 (dst, left, right, FRAMES);
+    if (memcmp (dst, src, sizeof (dst)) != 0) {
+        printf ("conv_interleave16 FAILED\n");
+        errors++;
+    }
+
+    for (i = 0; i < 256; i++) {
+        unsigned char code = i, back;
+        int16_t linear;
+        conv_alaw_decode (&linear, &code, 1);
+        conv_alaw_encode (&back, &linear, 1);
+        if (back != code) {
+            printf ("A-law code %02x decoded as %d, encoded back as %02x FAILED\n", code, linear, back);
+            errors++;
+        }
+    }
+    return errors;
+}
+
+
+/* Runs 'test' (which converts SAMPLES samples) for 'seconds' and prints its throughput */
+static void _bench (const char *name, void (*test) (void), double seconds)
+{
+    double start = _now (), elapsed;
+    long runs = 0;
+
+    do {
+        test ();
+        runs++;
+    } while ((elapsed = _now () - start) < seconds);
+
+    /* each run converts 100 ms of one 44100 Hz stereo stream */
+    printf ("%-22s %8.1f Msamples/s  %8.0f streams\n", name,
+            runs * (double) SAMPLES / elapsed / 1e6, runs * 0.1 / elapsed);
+}
+
+static void _swap (void) { conv_swap16 (dst, src, SAMPLES); sink = dst[7]; }
+static void _swapScalar (void) { conv_swap16_scalar (dst, src, SAMPLES); sink = dst[7]; }
+static void _interleave (void) { conv_interleave16 (dst, left, right, FRAMES); sink = dst[7]; }
+static void _interleaveScalar (void) { conv_interleave16_scalar (dst, left, right, FRAMES); sink = dst[7]; }
+static void _deinterleave (void) { conv_deinterleave16 (left, right, src, FRAMES); sink = left[7]; }
+static void _deinterleaveScalar (void) { conv_deinterleave16_scalar (left, right, src, FRAMES); sink = left[7]; }
+static void _alawEncode (void) { conv_alaw_encode (alaw, src, SAMPLES); sink = alaw[7]; }
+static void _alawDecode (void) { conv_alaw_decode (dst, alaw, SAMPLES); sink = dst[7]; }
+
+
+int main (int argc, char *argv[])
+{
+    double seconds = (argc > 1) ? atof (argv[1]) : 1.0;
+    int i;
+
+    srandom (1);
+    for (i = 0; i < SAMPLES; i++) {
+        src[i] = (int16_t) random ();
+    }
+
+    if (_check () > 0) {
+        return 1;
+    }
+    printf ("Conversions checked OK\n\n");
+
+    _bench ("swap16", _swap, seconds);
+    _bench ("swap16 scalar", _swapScalar, seconds);
+    _bench ("interleave16", _interleave, seconds);
+    _bench ("interleave16 scalar", _interleaveScalar, seconds);
+    _bench ("deinterleave16", _deinterleave, seconds);
+    _bench ("deinterleave16 scalar", _deinterleaveScalar, seconds);
+    _bench ("alaw encode", _alawEncode, seconds);
+    _bench ("alaw decode", _alawDecode, seconds);
+    return 0;
+}
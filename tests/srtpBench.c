@@ -0,0 +1,142 @@
+/* Checks and measures SRTP protection of srtp.c
+ *
+ * Compile as (from the repository directory)
+ *    gcc -Wall -Wextra -O2 -I. -o srtpBench tests/srtpBench.c srtp.c                      (portable)
+ *    gcc -Wall -Wextra -O2 -maes -msha -msse4.1 -I. -o srtpBench tests/srtpBench.c srtp.c (AES-NI and SHA extensions)
+ * Execute as
+ *    ./srtpBench [SECONDS_PER_TEST]
+ *
+ * First runs the test vectors of RFC 3711 (keystream and key derivation)
+ * and a whole packet. Then prints the cost of protecting (sender) and
+ * unprotecting (receiver) one packet, for the payload sizes of 20 ms of the
+ * payloads of payloadTable.c, also as the number of 20 ms streams (50
+ * packets per second) one core could protect or unprotect.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "srtp.h"
+
+#define RTP_HEADER 12
+#define PACKETS_PER_SECOND 50   /* 20 ms packets */
+#define SEQUENCES 1024          /* packets protected in advance for the unprotect test */
+
+void _srtp_test_vectors (void);
+
+static const unsigned char master[SRTP_MASTER_BYTES] = {
+    0xe1, 0xf9, 0x7a, 0x0d, 0x3e, 0x01, 0x8b, 0xe0, 0xd6, 0x4f, 0xa3, 0x2c, 0x06, 0xde, 0x41, 0x39,
+    0x0e, 0xc6, 0x75, 0xad, 0x49, 0x8a, 0xfe, 0xeb, 0xb6, 0x96, 0x0b, 0x3a, 0xab, 0xe6
+};
+
+
+static double _now (void)
+{
+    struct timespec t;
+    clock_gettime (CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+
+static void _header (unsigned char *packet, unsigned int seq)
+{
+    memcpy (packet, "\x80\x00\x00\x00\x00\x00\x00\x00\x12\x34\x56\x78", RTP_HEADER);
+    packet[2] = (unsigned char) (seq >> 8);
+    packet[3] = (unsigned char) seq;
+}
+
+
+/* Prints the ns per packet of srtp_protect and srtp_unprotect for 'payload' bytes */
+static void _bench (const char *name, int payload, double seconds)
+{
+    int length = RTP_HEADER + payload;
+    int protectedLength = length + SRTP_AUTH_TAG_BYTES;
+    unsigned char *packet = malloc (protectedLength);
+    unsigned char *protected = malloc ((size_t) SEQUENCES * protectedLength);
+    unsigned char *copy = malloc (protectedLength);
+    void *sender = srtp_create (master, 1);
+    void *receiver = srtp_create (master, 1);
+    double start, elapsed, protectNs, unprotectNs;
+    long packets;
+    unsigned int seq = 0;
+    int i;
+
+    if (packet == NULL || protected == NULL || copy == NULL || sender == NULL || receiver == NULL) {
+        printf ("Could not reserve memory\n");
+        exit (1);
+    }
+    memset (packet, 0x55, length);
+
+    packets = 0;
+    start = _now ();
+    do {
+        for (i = 0; i < SEQUENCES; i++) {
+            _header (packet, seq++);
+            srtp_protect (sender, packet, length);
+        }
+        packets += SEQUENCES;
+    } while ((elapsed = _now () - start) < seconds);
+    protectNs = elapsed * 1e9 / packets;
+
+    /* the receiver needs new sequence numbers: the packets are protected in
+     * advance and copied before each unprotect (the copy is measured too) */
+    srtp_destroy (sender);
+    sender = srtp_create (master, 1);
+    packets = 0;
+    seq = 0;
+    start = _now ();
+    do {
+        double pause = _now ();
+        for (i = 0; i < SEQUENCES; i++) {
+            _header (protected + (size_t) i * protectedLength, seq++);
+            memset (protected + (size_t) i * protectedLength + RTP_HEADER, 0x55, payload);
+            srtp_protect (sender, protected + (size_t) i * protectedLength, length);
+        }
+        start += _now () - pause;
+        for (i = 0; i < SEQUENCES; i++) {
+            memcpy (copy, protected + (size_t) i * protectedLength, protectedLength);
+            if (srtp_unprotect (receiver, copy, protectedLength) != length) {
+                printf ("Packet %u not accepted\n", seq - SEQUENCES + i);
+                exit (1);
+            }
+        }
+        packets += SEQUENCES;
+    } while ((elapsed = _now () - start) < seconds);
+    unprotectNs = elapsed * 1e9 / packets;
+
+    printf ("%-10s %5d bytes   protect %7.0f ns %9.0f streams   unprotect %7.0f ns %9.0f streams\n",
+            name, payload, protectNs, 1e9 / protectNs / PACKETS_PER_SECOND,
+            unprotectNs, 1e9 / unprotectNs / PACKETS_PER_SECOND);
+
+    srtp_destroy (sender);
+    srtp_destroy (receiver);
+    free (packet);
+    free (protected);
+    free (copy);
+}
+
+
+int main (int argc, char *argv[])
+{
+    double seconds = (argc > 1) ? atof (argv[1]) : 1.0;
+
+    _srtp_test_vectors ();
+#if defined(__AES__)
+    printf ("AES-NI");
+#else
+    printf ("AES portable");
+#endif
+#if defined(__SHA__) && defined(__SSE4_1__)
+    printf (", SHA extensions\n\n");
+#else
+    printf (", SHA-1 portable\n\n");
+#endif
+
+    /* 20 ms of each payload */
+    _bench ("PCMU/PCMA", 160, seconds);
+    _bench ("L16 mono", 1764, seconds);
+    _bench ("L16 48k", 3840, seconds);
+    return 0;
+}
@@ -7,27 +7,31 @@
 #include <string.h>
 #include <errno.h>
 
-#include "easyUDPSockets_1.h"
+#include "easyUDPSockets.h"
+
+#define GROUP "225.0.1.29"
+#define PORT 5004
 
 const char message[16]= "Sent from host1"; /* 16 bytes is enough space for accomodating the message */
 char buf[MAXBUF]; /* to receive data from remote node */
 
 void main(int argc, char *argv[]){
 
-	if(easy_init_1() < 0){
-		printf("easy_init_1");
+	struct easySocket *s;
+
+	if((s = easy_open(GROUP, PORT, EASY_SEND, NULL)) == NULL){
 		exit(1);
 	}
 
-	if(easy_send_1(message) < 0){
-		printf("easy_send_1");
+	if(easy_send(s, message, sizeof(message)) < 0){
 		exit(1);
 	}
 
-	if(easy_receive_1(buf) < 0){
-		printf("easy_receive_1");
+	if(easy_receive(s, buf, MAXBUF) < 0){
 		exit(1);
 	}
 
+	easy_close(s);
+
 
 }
\ No newline at end of file
@@ -7,26 +7,30 @@
 #include <string.h>
 #include <errno.h>
 
-#include "easyUDPSockets_2.h"
+#include "easyUDPSockets.h"
+
+#define GROUP "225.0.1.29"
+#define PORT 5004
 
 const char message[16]= "Sent from host2";
 char buf[MAXBUF]; /* to receive data from remote node */
 
 void main(int argc, char *argv[]){
 
-	if(easy_init_2() < 0){
-		printf("easy_init_2");
+	struct easySocket *s;
+
+	if((s = easy_open(GROUP, PORT, EASY_RECEIVE, NULL)) == NULL){
 		exit(1);
 	}
 
-	if(easy_receive_2(buf) < 0){
-		printf("easy_receive_2");
+	if(easy_receive(s, buf, MAXBUF) < 0){
 		exit(1);
 	}
 
-	if(easy_send_2(message) < 0){
-		printf("easy_send_2");
+	if(easy_reply(s, message, sizeof(message)) < 0){
 		exit(1);
 	}
 
+	easy_close(s);
+
 }
\ No newline at end of file
@@ -0,0 +1,367 @@
+/* timerWheel.c */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <limits.h>
+
+#include "timerWheel.h"
+
+#define MASK (TWHEEL_SLOTS - 1)
+#define SPAN_BITS (TWHEEL_SLOT_BITS * TWHEEL_LEVELS)   /* ticks covered by the wheels, log2 */
+#define SHIFT(level) (TWHEEL_SLOT_BITS * (level))
+
+struct timerWheel {
+    long long current;                                  /* next tick to be processed */
+    unsigned long long used[TWHEEL_LEVELS];             /* a bit for each slot with timers */
+    struct twheelTimer *slots[TWHEEL_LEVELS][TWHEEL_SLOTS];
+};
+
+
+/*=====================================================================*/
+static void _link (struct twheelTimer **head, struct twheelTimer *t)
+{
+    t->next = *head;
+    if (t->next != NULL) {
+        t->next->prev = &t->next;
+    }
+    t->prev = head;
+    *head = t;
+}
+
+
+static void _unlink (struct timerWheel *w, struct twheelTimer *t)
+{
+    *t->prev = t->next;
+    if (t->next != NULL) {
+        t->next->prev = t->prev;
+    }
+    if (t->level >= 0 && w->slots[t->level][t->slot] == NULL) {
+        w->used[t->level] &= ~(1ULL << t->slot);
+    }
+    t->prev = NULL;
+}
+
+
+/* A timer goes to the lowest wheel whose span reaches its expiry, in the
+ * slot of its expiry: in the first wheel, the timers of a slot are due in
+ * the same tick; above, they are moved down when the tick of their slot
+ * comes. The timers further than all the wheels go to the last slot of the
+ * last one, from which they are placed again */
+static void _insert (struct timerWheel *w, struct twheelTimer *t)
+{
+    long long expires = (t->expiresMs < w->current) ? w->current : t->expiresMs;
+    long long delta = expires - w->current;
+    int level = 0;
+
+    while (level < TWHEEL_LEVELS - 1 && delta >= (1LL << SHIFT (level + 1))) {
+        level++;
+    }
+    if (delta >= (1LL << SPAN_BITS)) {
+        expires = w->current + (1LL << SPAN_BITS) - 1;
+    }
+    t->level = level;
+    t->slot = (expires >> SHIFT (level)) & MASK;
+    _link (&w->slots[level][t->slot], t);
+    w->used[level] |= 1ULL << t->slot;
+}
+
+
+/* Slots from 'from' (included) to the first used one, in circular order */
+static int _firstUsed (unsigned long long used, int from)
+{
+    unsigned long long rotated = (from == 0) ? used : (used >> from) | (used << (TWHEEL_SLOTS - from));
+    return __builtin_ctzll (rotated);
+}
+
+
+/* Tick of the next work of the wheel: a slot of the first wheel with timers,
+ * or a slot of a wheel above to be moved down. -1 if there are no timers */
+static long long _nextTick (const struct timerWheel *w)
+{
+    long long next = -1;
+    int level;
+
+    for (level = 0; level < TWHEEL_LEVELS; level++) {
+        long long from = w->current >> SHIFT (level);
+        long long tick;
+        if (w->used[level] == 0) {
+            continue;
+        }
+        /* the slot of the current tick was already moved down, unless the tick starts it */
+        if ((w->current & ((1LL << SHIFT (level)) - 1)) != 0) {
+            from++;
+        }
+        tick = (from + _firstUsed (w->used[level], from & MASK)) << SHIFT (level);
+        if (next < 0 || tick < next) {
+            next = tick;
+        }
+    }
+    return next;
+}
+
+
+/* Detaches the timers of a slot, to be run or placed again */
+static struct twheelTimer *_takeSlot (struct timerWheel *w, int level, int slot)
+{
+    struct twheelTimer *list = w->slots[level][slot];
+
+    w->slots[level][slot] = NULL;
+    w->used[level] &= ~(1ULL << slot);
+    return list;
+}
+
+
+/* Processes tick w->current: moves down the slots of the wheels above
+ * which start in it, then runs the timers due */
+static int _runTick (struct timerWheel *w)
+{
+    long long tick = w->current;
+    struct twheelTimer *expired, *t;
+    int level, count = 0;
+
+    for (level = 1; level < TWHEEL_LEVELS && (tick & ((1LL << SHIFT (level)) - 1)) == 0; level++) {
+        struct twheelTimer *moved = _takeSlot (w, level, (tick >> SHIFT (level)) & MASK);
+        while (moved != NULL) {
+            t = moved;
+            moved = t->next;
+            _insert (w, t);
+        }
+    }
+
+    /* the list is kept linked, so that callbacks can cancel the timers not run yet */
+    expired = _takeSlot (w, 0, tick & MASK);
+    if (expired != NULL) {
+        expired->prev = &expired;
+    }
+    for (t = expired; t != NULL; t = t->next) {
+        t->level = -1;
+    }
+    w->current = tick + 1;
+    while (expired != NULL) {
+        t = expired;
+        _unlink (w, t);
+        t->callback (t->context, tick);
+        count++;
+    }
+    return count;
+}
+
+
+/*=====================================================================*/
+void *twheel_create (long long nowMs)
+{
+    struct timerWheel *w;
+
+    if ((w = calloc (1, sizeof (struct timerWheel))) == NULL) {
+        printf ("Error reserving memory in timerWheel\n");
+        return NULL;
+    }
+    w->current = nowMs + 1;
+    return w;
+}
+
+
+void twheel_init_timer (struct twheelTimer *timer, TWHEEL_CALLBACK *callback, void *context)
+{
+    timer->next = NULL;
+    timer->prev = NULL;
+    timer->expiresMs = 0;
+    timer->level = -1;
+    timer->slot = 0;
+    timer->callback = callback;
+    timer->context = context;
+}
+
+
+void twheel_add (void *wheel, struct twheelTimer *timer, long long expiresMs)
+{
+    struct timerWheel *w = wheel;
+
+    if (timer->prev != NULL) {
+        _unlink (w, timer);
+    }
+    timer->expiresMs = expiresMs;
+    _insert (w, timer);
+}
+
+
+void twheel_cancel (void *wheel, struct twheelTimer *timer)
+{
+    if (timer->prev != NULL) {
+        _unlink (wheel, timer);
+    }
+}
+
+
+int twheel_pending (const struct twheelTimer *timer)
+{
+    return timer->prev != NULL;
+}
+
+
+long long twheel_now (const void *wheel)
+{
+    return ((const struct timerWheel *) wheel)->current - 1;
+}
+
+
+int twheel_timeout (const void *wheel, long long nowMs)
+{
+    long long next = _nextTick (wheel);
+
+    if (next < 0) {
+        return -1;
+    }
+    if (next <= nowMs) {
+        return 0;
+    }
+    return (next - nowMs > INT_MAX) ? INT_MAX : (int) (next - nowMs);
+}
+
+
+/* Empty stretches are skipped: the loop only stops in ticks with work */
+int twheel_advance (void *wheel, long long nowMs)
+{
+    struct timerWheel *w = wheel;
+    int count = 0;
+
+    while (w->current <= nowMs) {
+        long long next = _nextTick (w);
+        if (next < 0 || next > nowMs) {
+            w->current = nowMs + 1;
+            break;
+        }
+        w->current = next;
+        count += _runTick (w);
+    }
+    return count;
+}
+
+
+void twheel_destroy (void *wheel)
+{
+    free (wheel);
+}
+
+
+/* TEST for timerWheel functions.
+ * To execute it, use following code  */
+
+/* #include "timerWheel.h"
+void _twheel_test_random(void);
+void main (void)
+{
+    _twheel_test_random();
+} */
+
+
+#define TEST_TIMERS 5000
+#define TEST_START 123456789LL
+
+struct testTimer {
+    struct twheelTimer timer;
+    long long expires;          /* expected tick of the next expiry */
+    int period;                 /* > 0: started again from the callback */
+    int fired;
+    int errors;
+};
+
+static void *testWheel;
+static struct testTimer *testTimers;
+
+static void _testCallback (void *context, long long nowMs)
+{
+    struct testTimer *t = context;
+
+    t->fired++;
+    if (nowMs != t->expires) {
+        t->errors++;
+    }
+    if (t->period > 0 && t->fired < 3) {
+        t->expires = nowMs + t->period;
+        twheel_add (testWheel, &t->timer, t->expires);
+    }
+    /* every timer of a multiple of 100 cancels the next one, which may be due in this same tick */
+    if ((t - testTimers) % 100 == 0 && (t - testTimers) + 1 < TEST_TIMERS) {
+        twheel_cancel (testWheel, &t[1].timer);
+    }
+}
+
+
+void _twheel_test_random (void)
+{
+    long long now = TEST_START, earliest;
+    int i, steps = 0, errors = 0, expected = 0, fired = 0, cancelled = 0;
+
+    if ((testWheel = twheel_create (now)) == NULL || (testTimers = calloc (TEST_TIMERS, sizeof (struct testTimer))) == NULL) {
+        exit (1);
+    }
+    srandom (1);
+
+    /* 1: an empty wheel has no timeout */
+    if (twheel_timeout (testWheel, now) != -1) {
+        printf ("_twheel_test_random: an empty wheel has a timeout\n");
+        errors++;
+    }
+
+    /* 2: every timer expires once in its tick, across all the wheels and beyond,
+     * including restarts from callbacks and cancels */
+    for (i = 0; i < TEST_TIMERS; i++) {
+        struct testTimer *t = &testTimers[i];
+        int bits = random () % (SPAN_BITS + 2);
+        twheel_init_timer (&t->timer, _testCallback, t);
+        t->expires = now + 1 + random () % (1LL << bits);
+        t->period = (i % 3 == 0) ? 1 + random () % 5000 : 0;
+        twheel_add (testWheel, &t->timer, t->expires);
+    }
+    for (i = 0; i < TEST_TIMERS; i += 7) {
+        twheel_cancel (testWheel, &testTimers[i].timer);
+    }
+    /* waits as an event loop would, sometimes woken up before the timeout */
+    while (twheel_timeout (testWheel, now) >= 0) {
+        int timeout = twheel_timeout (testWheel, now);
+        earliest = -1;
+        for (i = 0; i < TEST_TIMERS; i++) {
+            if (twheel_pending (&testTimers[i].timer) && (earliest < 0 || testTimers[i].expires < earliest)) {
+                earliest = testTimers[i].expires;
+            }
+        }
+        if (earliest >= 0 && now + timeout > earliest) {
+            printf ("_twheel_test_random: timeout %d ms at %lld, but a timer expires at %lld\n", timeout, now, earliest);
+            errors++;
+            break;
+        }
+        now += (random () % 4 == 0 && timeout > 1) ? random () % timeout : timeout;
+        twheel_advance (testWheel, now);
+        steps++;
+    }
+    for (i = 0; i < TEST_TIMERS; i++) {
+        struct testTimer *t = &testTimers[i];
+        if (t->errors > 0 || twheel_pending (&t->timer)) {
+            printf ("_twheel_test_random: timer %d expired out of its tick %d times\n", i, t->errors);
+            errors++;
+        }
+        fired += t->fired;
+        cancelled += (t->fired == 0);
+        expected += (i % 7 == 0) ? 0 : (t->period > 0) ? 3 : 1;
+    }
+    /* the timers cancelled from callbacks may have fired before */
+    if (fired > expected || fired < expected - TEST_TIMERS / 100 * 3 || cancelled < TEST_TIMERS / 7) {
+        printf ("_twheel_test_random: %d expiries, %d expected\n", fired, expected);
+        errors++;
+    }
+
+    /* 3: a timer in the first wheel gives the exact timeout */
+    twheel_add (testWheel, &testTimers[0].timer, now + 10);
+    if (twheel_timeout (testWheel, now) != 10) {
+        printf ("_twheel_test_random: timeout %d for a timer in 10 ms\n", twheel_timeout (testWheel, now));
+        errors++;
+    }
+    twheel_destroy (testWheel);
+    free (testTimers);
+
+    if (errors > 0) {
+        exit (1);
+    }
+    printf ("Tests PASSED (number of tests: 3, %d waits)\n", steps);
+}
@@ -0,0 +1,75 @@
+/* timerWheel.h */
+
+/* Hierarchical timing wheel with 1 ms ticks, for many timers of an event
+ * loop (as in the Linux kernel). TWHEEL_LEVELS wheels of TWHEEL_SLOTS slots:
+ * the first one has a slot per ms for the next TWHEEL_SLOTS ms, each one
+ * above has slots TWHEEL_SLOTS times longer, and its timers are moved to
+ * the wheel below when their slot is reached. Starting, cancelling and
+ * restarting a timer are O(1), whatever the number of timers, and a bitmap
+ * of the slots in use finds the next one to be processed without looking at
+ * the empty ones, for the timeout of the wait of the event loop (see
+ * twheel_timeout). Timers further than the span of the wheels
+ * (TWHEEL_SLOTS ^ TWHEEL_LEVELS ms, 4.6 hours) are moved down more times.
+ * Timers are owned by the caller (usually, a field of the structure they are
+ * for), so the wheel allocates nothing after twheel_create.
+ * Times are ms of the monotonic clock.
+ * Restrictions
+ * - Use only in single-thread code, as circularBuffer.
+ */
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#define TWHEEL_LEVELS 4
+#define TWHEEL_SLOT_BITS 6
+#define TWHEEL_SLOTS (1 << TWHEEL_SLOT_BITS)    /* 64: a bit of an unsigned long long for each */
+
+/* Called when the timer expires, with the tick (ms) it was due. The timer
+ * is not pending any more: it can be started again from the callback */
+typedef void TWHEEL_CALLBACK (void *context, long long nowMs);
+
+/* Fields are private to timerWheel.c */
+struct twheelTimer {
+    struct twheelTimer *next;
+    struct twheelTimer **prev;      /* pointer which points to this timer; NULL if it is not pending */
+    long long expiresMs;
+    int level;                      /* of the slot it is in, -1 while the wheel is running it */
+    int slot;
+    TWHEEL_CALLBACK *callback;
+    void *context;
+};
+
+/* Returns a pointer which represents the wheel, to be used by the rest of
+ * functions, with 'nowMs' as its current time. Returns NULL if memory could
+ * not be allocated */
+void *twheel_create (long long nowMs);
+
+/* Prepares 'timer' to call 'callback' with 'context'; it is not pending */
+void twheel_init_timer (struct twheelTimer *timer, TWHEEL_CALLBACK *callback, void *context);
+
+/* Starts 'timer' to expire at 'expiresMs' (in the next tick if it already
+ * passed). If it was pending, it is restarted */
+void twheel_add (void *wheel, struct twheelTimer *timer, long long expiresMs);
+
+/* Stops 'timer' if it is pending */
+void twheel_cancel (void *wheel, struct twheelTimer *timer);
+
+/* 1 if 'timer' is waiting to expire */
+int twheel_pending (const struct twheelTimer *timer);
+
+/* Last time passed to twheel_advance (or twheel_create) */
+long long twheel_now (const void *wheel);
+
+/* ms from 'nowMs' until the wheel has work (a timer expires, or timers are
+ * moved to a lower wheel), to be used as the timeout of poll or epoll_wait:
+ * 0 if it is due, -1 if there are no timers */
+int twheel_timeout (const void *wheel, long long nowMs);
+
+/* Calls the callbacks of the timers due up to 'nowMs', in order of expiry.
+ * Returns the number of timers expired */
+int twheel_advance (void *wheel, long long nowMs);
+
+/* Frees the wheel; the timers pending are forgotten */
+void twheel_destroy (void *wheel);
+
+#endif /* TIMER_WHEEL_H */